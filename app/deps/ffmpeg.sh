@@ -51,7 +51,6 @@ else
         --extra-cflags="-O2 -fPIC"
         --disable-programs
         --disable-doc
-        --disable-swscale
         --disable-postproc
         --disable-avfilter
         --disable-network
@@ -60,6 +59,7 @@ else
         --disable-vaapi
         --disable-vdpau
         --enable-swresample
+        --enable-swscale
         --enable-libdav1d
         --enable-decoder=h264
         --enable-decoder=hevc
@@ -70,6 +70,9 @@ else
         --enable-decoder=aac
         --enable-decoder=flac
         --enable-decoder=png
+        --enable-encoder=mpeg4
+        --enable-encoder=png
+        --enable-encoder=mjpeg
         --enable-protocol=file
         --enable-demuxer=image2
         --enable-parser=png
@@ -1,16 +1,24 @@
 #include "audio_player.h"
 
+#include <inttypes.h>
+#include <libavutil/samplefmt.h>
+
 #include "util/log.h"
 
 /** Downcast frame_sink to sc_audio_player */
 #define DOWNCAST(SINK) container_of(SINK, struct sc_audio_player, frame_sink)
 
-#define SC_SDL_SAMPLE_FMT AUDIO_F32
-
 static void SDLCALL
 sc_audio_player_sdl_callback(void *userdata, uint8_t *stream, int len_int) {
     struct sc_audio_player *ap = userdata;
 
+    if (!ap->perf_registered) {
+        // The SDL audio thread is not created by scrcpy, register it on the
+        // first callback
+        ap->perf = sc_perf_thread_register("audio", NULL, "callback");
+        ap->perf_registered = true;
+    }
+
     assert(len_int > 0);
     size_t len = len_int;
 
@@ -18,6 +26,8 @@ sc_audio_player_sdl_callback(void *userdata, uint8_t *stream, int len_int) {
     uint32_t out_samples = len / ap->audioreg.sample_size;
 
     sc_audio_regulator_pull(&ap->audioreg, stream, out_samples);
+
+    sc_perf_thread_add_item(ap->perf);
 }
 
 static bool
@@ -28,6 +38,27 @@ sc_audio_player_frame_sink_push(struct sc_frame_sink *sink,
     return sc_audio_regulator_push(&ap->audioreg, frame);
 }
 
+static bool
+sc_audio_player_get_output_format(const SDL_AudioSpec *spec,
+                                  struct sc_audio_output_format *out) {
+    switch (spec->format) {
+        case AUDIO_F32SYS:
+            out->sample_fmt = AV_SAMPLE_FMT_FLT;
+            break;
+        case AUDIO_S16SYS:
+            out->sample_fmt = AV_SAMPLE_FMT_S16;
+            break;
+        default:
+            return false;
+    }
+
+    assert(spec->freq > 0);
+    assert(spec->channels > 0);
+    out->sample_rate = spec->freq;
+    out->channels = spec->channels;
+    return true;
+}
+
 static bool
 sc_audio_player_frame_sink_open(struct sc_frame_sink *sink,
                                 const AVCodecContext *ctx) {
@@ -43,19 +74,6 @@ sc_audio_player_frame_sink_open(struct sc_frame_sink *sink,
 #endif
 
     assert(ctx->sample_rate > 0);
-    assert(!av_sample_fmt_is_planar(SC_AV_SAMPLE_FMT));
-    int out_bytes_per_sample = av_get_bytes_per_sample(SC_AV_SAMPLE_FMT);
-    assert(out_bytes_per_sample > 0);
-
-    uint32_t target_buffering_samples =
-        ap->target_buffering_delay * ctx->sample_rate / SC_TICK_FREQ;
-
-    size_t sample_size = nb_channels * out_bytes_per_sample;
-    bool ok = sc_audio_regulator_init(&ap->audioreg, sample_size, ctx,
-                                      target_buffering_samples);
-    if (!ok) {
-        return false;
-    }
 
     uint64_t aout_samples = ap->output_buffer_duration * ctx->sample_rate
                                                        / SC_TICK_FREQ;
@@ -63,7 +81,7 @@ sc_audio_player_frame_sink_open(struct sc_frame_sink *sink,
 
     SDL_AudioSpec desired = {
         .freq = ctx->sample_rate,
-        .format = SC_SDL_SAMPLE_FMT,
+        .format = AUDIO_F32SYS,
         .channels = nb_channels,
         .samples = aout_samples,
         .callback = sc_audio_player_sdl_callback,
@@ -71,10 +89,56 @@ sc_audio_player_frame_sink_open(struct sc_frame_sink *sink,
     };
     SDL_AudioSpec obtained;
 
-    ap->device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained, 0);
+    // Accept the native sample rate, format and channels of the device, so
+    // that the conversion, if any, is performed by the regulator on the
+    // decoder thread rather than by SDL in the audio callback. The number of
+    // samples must not change, it is the configured audio output buffer.
+    int allowed_changes = SDL_AUDIO_ALLOW_FREQUENCY_CHANGE
+                        | SDL_AUDIO_ALLOW_FORMAT_CHANGE
+                        | SDL_AUDIO_ALLOW_CHANNELS_CHANGE;
+    ap->device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained,
+                                     allowed_changes);
+
+    struct sc_audio_output_format out;
+    if (ap->device && !sc_audio_player_get_output_format(&obtained, &out)) {
+        // Unsupported native sample format, let SDL convert the samples
+        LOGD("Unsupported native audio format 0x%x, use float samples",
+             (unsigned) obtained.format);
+        SDL_CloseAudioDevice(ap->device);
+        allowed_changes &= ~SDL_AUDIO_ALLOW_FORMAT_CHANGE;
+        ap->device = SDL_OpenAudioDevice(NULL, 0, &desired, &obtained,
+                                         allowed_changes);
+        if (ap->device) {
+            bool ok = sc_audio_player_get_output_format(&obtained, &out);
+            assert(ok);
+            (void) ok;
+        }
+    }
+
     if (!ap->device) {
         LOGE("Could not open audio device: %s", SDL_GetError());
-        sc_audio_regulator_destroy(&ap->audioreg);
+        return false;
+    }
+
+    LOGD("Audio output: %" PRIu32 " Hz, %u channels, %s", out.sample_rate,
+         (unsigned) out.channels, av_get_sample_fmt_name(out.sample_fmt));
+
+    // The buffering is expressed in output samples
+    uint32_t target_buffering_samples =
+        ap->target_buffering_delay * out.sample_rate / SC_TICK_FREQ;
+    uint32_t min_target_buffering_samples =
+        ap->min_target_buffering_delay * out.sample_rate / SC_TICK_FREQ;
+    uint32_t max_target_buffering_samples =
+        ap->max_target_buffering_delay * out.sample_rate / SC_TICK_FREQ;
+
+    // The device is paused, the callback is not called until it is resumed
+    bool ok = sc_audio_regulator_init(&ap->audioreg, ctx, &out,
+                                      target_buffering_samples,
+                                      min_target_buffering_samples,
+                                      max_target_buffering_samples,
+                                      ap->stats);
+    if (!ok) {
+        SDL_CloseAudioDevice(ap->device);
         return false;
     }
 
@@ -99,14 +163,27 @@ sc_audio_player_frame_sink_close(struct sc_frame_sink *sink) {
     SDL_PauseAudioDevice(ap->device, 1);
     SDL_CloseAudioDevice(ap->device);
 
+    // The SDL audio thread is stopped, its counters may be closed from here
+    sc_perf_thread_unregister(ap->perf);
+    ap->perf = NULL;
+    ap->perf_registered = false;
+
     sc_audio_regulator_destroy(&ap->audioreg);
 }
 
 void
 sc_audio_player_init(struct sc_audio_player *ap, sc_tick target_buffering,
-                     sc_tick output_buffer_duration) {
+                     sc_tick min_target_buffering,
+                     sc_tick max_target_buffering,
+                     sc_tick output_buffer_duration, struct sc_stats *stats) {
+    assert(min_target_buffering <= max_target_buffering);
     ap->target_buffering_delay = target_buffering;
+    ap->min_target_buffering_delay = min_target_buffering;
+    ap->max_target_buffering_delay = max_target_buffering;
     ap->output_buffer_duration = output_buffer_duration;
+    ap->stats = stats;
+    ap->perf_registered = false;
+    ap->perf = NULL;
 
     static const struct sc_frame_sink_ops ops = {
         .open = sc_audio_player_frame_sink_open,
@@ -6,6 +6,7 @@
 #include <SDL2/SDL_audio.h>
 
 #include "audio_regulator.h"
+#include "perf_counter.h"
 #include "trait/frame_sink.h"
 #include "util/tick.h"
 
@@ -18,16 +19,29 @@ struct sc_audio_player {
     // blocks of 960 samples (20ms) or 1024 samples (~21.3ms), this target
     // value should be higher.
     sc_tick target_buffering_delay;
+    // If they are different, the target buffering is adjusted automatically
+    // within these bounds (--audio-buffer=auto)
+    sc_tick min_target_buffering_delay;
+    sc_tick max_target_buffering_delay;
 
     // SDL audio output buffer size
     sc_tick output_buffer_duration;
 
     SDL_AudioDeviceID device;
     struct sc_audio_regulator audioreg;
+
+    struct sc_stats *stats; // may be NULL
+
+    // only accessed from the SDL audio thread
+    bool perf_registered;
+    struct sc_perf_thread *perf;
 };
 
+// The stats may be NULL
 void
 sc_audio_player_init(struct sc_audio_player *ap, sc_tick target_buffering,
-                     sc_tick audio_output_buffer);
+                     sc_tick min_target_buffering,
+                     sc_tick max_target_buffering,
+                     sc_tick audio_output_buffer, struct sc_stats *stats);
 
 #endif
@@ -0,0 +1,283 @@
+#include "audio_plc.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/log.h"
+
+// Durations in milliseconds (converted to samples on init)
+#define SC_AUDIO_PLC_HISTORY_MS 20
+// The extension is played at full volume, then faded out to silence
+#define SC_AUDIO_PLC_FULL_GAIN_MS 10
+#define SC_AUDIO_PLC_MAX_MS 40
+#define SC_AUDIO_PLC_CROSSFADE_MS 5
+
+// Range of the repeated period (pitch from 100 Hz to 400 Hz), in tenths of
+// milliseconds
+#define SC_AUDIO_PLC_MIN_PERIOD_DMS 25
+#define SC_AUDIO_PLC_MAX_PERIOD_DMS 100
+
+bool
+sc_audio_plc_init(struct sc_audio_plc *plc, enum sc_audio_plc_format format,
+                  unsigned channels, uint32_t sample_rate) {
+    assert(channels);
+
+    plc->format = format;
+    plc->channels = channels;
+    plc->history_size = sample_rate * SC_AUDIO_PLC_HISTORY_MS / 1000;
+    plc->min_period = sample_rate * SC_AUDIO_PLC_MIN_PERIOD_DMS / 10000;
+    plc->max_period = sample_rate * SC_AUDIO_PLC_MAX_PERIOD_DMS / 10000;
+    plc->full_gain_duration = sample_rate * SC_AUDIO_PLC_FULL_GAIN_MS / 1000;
+    plc->max_duration = sample_rate * SC_AUDIO_PLC_MAX_MS / 1000;
+    plc->crossfade_duration = sample_rate * SC_AUDIO_PLC_CROSSFADE_MS / 1000;
+
+    // The history must contain at least two periods to find the pitch
+    assert(plc->history_size >= 2 * plc->max_period);
+    assert(plc->crossfade_duration);
+
+    plc->history = malloc(plc->history_size * channels * sizeof(float));
+    if (!plc->history) {
+        LOG_OOM();
+        return false;
+    }
+
+    plc->pattern = malloc(plc->max_period * channels * sizeof(float));
+    if (!plc->pattern) {
+        LOG_OOM();
+        free(plc->history);
+        return false;
+    }
+
+    plc->history_len = 0;
+    plc->active = false;
+    plc->period = 0;
+    plc->pos = 0;
+    plc->crossfade_pos = 0;
+
+    return true;
+}
+
+void
+sc_audio_plc_destroy(struct sc_audio_plc *plc) {
+    free(plc->pattern);
+    free(plc->history);
+}
+
+// Read the i-th sample (for a single channel) of an interleaved buffer
+static inline float
+sc_audio_plc_load(struct sc_audio_plc *plc, const void *buf, size_t i) {
+    if (plc->format == SC_AUDIO_PLC_FORMAT_S16) {
+        return ((const int16_t *) buf)[i] / 32768.f;
+    }
+
+    assert(plc->format == SC_AUDIO_PLC_FORMAT_FLT);
+    return ((const float *) buf)[i];
+}
+
+// Write the i-th sample (for a single channel) of an interleaved buffer
+static inline void
+sc_audio_plc_store(struct sc_audio_plc *plc, void *buf, size_t i,
+                   float value) {
+    if (plc->format == SC_AUDIO_PLC_FORMAT_S16) {
+        float v = CLAMP(value * 32768.f, -32768.f, 32767.f);
+        // Round to the nearest integer
+        ((int16_t *) buf)[i] = (int16_t) (v < 0 ? v - .5f : v + .5f);
+        return;
+    }
+
+    assert(plc->format == SC_AUDIO_PLC_FORMAT_FLT);
+    ((float *) buf)[i] = value;
+}
+
+static inline float
+sc_audio_plc_mono(struct sc_audio_plc *plc, uint32_t i) {
+    const float *frame = &plc->history[i * plc->channels];
+    float sum = 0;
+    for (unsigned c = 0; c < plc->channels; ++c) {
+        sum += frame[c];
+    }
+    return sum;
+}
+
+// Return the period (in samples) most similar to the end of the history, or
+// 0 if there is not enough history
+static uint32_t
+sc_audio_plc_find_period(struct sc_audio_plc *plc) {
+    uint32_t len = plc->history_len;
+    uint32_t max_period = MIN(plc->max_period, len / 2);
+    if (max_period < plc->min_period) {
+        return 0;
+    }
+
+    // Compare the last samples with the samples one period before, for each
+    // candidate period, using the normalized cross-correlation (the energy of
+    // the last samples is the same for all candidates, so it is omitted, and
+    // the score is squared to avoid a square root)
+    uint32_t window = len - max_period;
+    uint32_t best_period = max_period;
+    double best_score = 0;
+
+    for (uint32_t period = plc->min_period; period <= max_period; ++period) {
+        double corr = 0;
+        double energy = 0;
+        for (uint32_t i = len - window; i < len; ++i) {
+            float cur = sc_audio_plc_mono(plc, i);
+            float prev = sc_audio_plc_mono(plc, i - period);
+            corr += cur * prev;
+            energy += prev * prev;
+        }
+
+        if (corr > 0 && energy > 0) {
+            double score = corr * corr / energy;
+            if (score > best_score) {
+                best_score = score;
+                best_period = period;
+            }
+        }
+    }
+
+    return best_period;
+}
+
+static void
+sc_audio_plc_start(struct sc_audio_plc *plc) {
+    plc->active = true;
+    plc->period = sc_audio_plc_find_period(plc);
+    plc->pos = 0;
+
+    uint32_t start = plc->history_len - plc->period;
+    memcpy(plc->pattern, &plc->history[start * plc->channels],
+           plc->period * plc->channels * sizeof(float));
+    plc->crossfade_pos = 0;
+}
+
+// Return the next frame of the waveform extension (to multiply by the gain),
+// or NULL if it is silent
+static const float *
+sc_audio_plc_next(struct sc_audio_plc *plc, float *gain) {
+    assert(plc->active);
+
+    uint32_t pos = plc->pos++;
+    if (!plc->period || pos >= plc->max_duration) {
+        return NULL;
+    }
+
+    if (pos < plc->full_gain_duration) {
+        *gain = 1;
+    } else {
+        *gain = (float) (plc->max_duration - pos)
+              / (plc->max_duration - plc->full_gain_duration);
+    }
+
+    return &plc->pattern[(pos % plc->period) * plc->channels];
+}
+
+static void
+sc_audio_plc_record(struct sc_audio_plc *plc, const void *samples,
+                    uint32_t count);
+
+void
+sc_audio_plc_conceal(struct sc_audio_plc *plc, void *out, uint32_t count) {
+    if (!plc->active) {
+        sc_audio_plc_start(plc);
+    } else {
+        // Continue the current concealment (a crossfade may be interrupted)
+        plc->crossfade_pos = 0;
+    }
+
+    for (uint32_t k = 0; k < count; ++k) {
+        size_t frame = (size_t) k * plc->channels;
+        float gain;
+        const float *ext = sc_audio_plc_next(plc, &gain);
+        for (unsigned c = 0; c < plc->channels; ++c) {
+            sc_audio_plc_store(plc, out, frame + c, ext ? ext[c] * gain : 0);
+        }
+    }
+
+    // The history contains the played samples, so that it remains continuous
+    sc_audio_plc_record(plc, out, count);
+}
+
+void
+sc_audio_plc_discontinuity(struct sc_audio_plc *plc) {
+    if (!plc->active) {
+        sc_audio_plc_start(plc);
+    }
+}
+
+// Copy count samples (for all channels) to the history, starting at the
+// sample index src_offset
+static void
+sc_audio_plc_copy(struct sc_audio_plc *plc, float *dst, const void *samples,
+                  uint32_t src_offset, uint32_t count) {
+    size_t first = (size_t) src_offset * plc->channels;
+    size_t n = (size_t) count * plc->channels;
+
+    if (plc->format == SC_AUDIO_PLC_FORMAT_FLT) {
+        memcpy(dst, (const float *) samples + first, n * sizeof(float));
+        return;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = sc_audio_plc_load(plc, samples, first + i);
+    }
+}
+
+static void
+sc_audio_plc_record(struct sc_audio_plc *plc, const void *samples,
+                    uint32_t count) {
+    size_t sample_size = plc->channels * sizeof(float);
+
+    if (count >= plc->history_size) {
+        sc_audio_plc_copy(plc, plc->history, samples,
+                          count - plc->history_size, plc->history_size);
+        plc->history_len = plc->history_size;
+        return;
+    }
+
+    uint32_t len = plc->history_len;
+    if (len + count > plc->history_size) {
+        // Keep only the most recent samples
+        uint32_t drop = len + count - plc->history_size;
+        memmove(plc->history, &plc->history[drop * plc->channels],
+                (len - drop) * sample_size);
+        len -= drop;
+    }
+
+    sc_audio_plc_copy(plc, &plc->history[len * plc->channels], samples, 0,
+                      count);
+    plc->history_len = len + count;
+}
+
+void
+sc_audio_plc_play(struct sc_audio_plc *plc, void *samples, uint32_t count) {
+    if (!count) {
+        return;
+    }
+
+    if (plc->active) {
+        // Crossfade from the waveform extension to the real samples
+        uint32_t k = 0;
+        while (k < count && plc->crossfade_pos < plc->crossfade_duration) {
+            size_t frame = (size_t) k * plc->channels;
+            float w = (float) plc->crossfade_pos / plc->crossfade_duration;
+            float gain;
+            const float *ext = sc_audio_plc_next(plc, &gain);
+            for (unsigned c = 0; c < plc->channels; ++c) {
+                float e = ext ? ext[c] * gain : 0;
+                float v = sc_audio_plc_load(plc, samples, frame + c);
+                sc_audio_plc_store(plc, samples, frame + c, e + w * (v - e));
+            }
+
+            ++plc->crossfade_pos;
+            ++k;
+        }
+
+        if (plc->crossfade_pos == plc->crossfade_duration) {
+            plc->active = false;
+        }
+    }
+
+    sc_audio_plc_record(plc, samples, count);
+}
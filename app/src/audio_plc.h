@@ -0,0 +1,86 @@
+#ifndef SC_AUDIO_PLC_H
+#define SC_AUDIO_PLC_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Audio packet loss concealment
+ *
+ * On buffer underflow, the missing samples are replaced by a waveform
+ * extension of the last played samples (repeating the last pitch period,
+ * faded out progressively) rather than by silence. When real samples are
+ * available again, they are crossfaded with the extension.
+ *
+ * It works on interleaved samples (in the native format of the audio output),
+ * independently of the codec. It is only used from the audio playback thread.
+ */
+enum sc_audio_plc_format {
+    SC_AUDIO_PLC_FORMAT_FLT, // float samples
+    SC_AUDIO_PLC_FORMAT_S16, // signed 16-bit samples (native endianness)
+};
+
+struct sc_audio_plc {
+    enum sc_audio_plc_format format;
+    unsigned channels;
+
+    // Number of samples (for all channels) of the history and the concealment
+    // parameters, depending on the sample rate
+    uint32_t history_size;
+    uint32_t min_period;
+    uint32_t max_period;
+    uint32_t full_gain_duration;
+    uint32_t max_duration;
+    uint32_t crossfade_duration;
+
+    // Last played samples, including the concealment (interleaved, converted
+    // to float)
+    float *history;
+    uint32_t history_len; // number of valid samples in history
+
+    bool active; // the output is being concealed
+    // Last period of the history when the concealment started, repeated to
+    // extend the waveform (the history may change during the crossfade)
+    float *pattern;
+    uint32_t period; // number of samples in pattern
+    uint32_t pos; // position (in samples) in the active concealment
+    // position (in samples) in the crossfade to the real samples
+    uint32_t crossfade_pos;
+};
+
+bool
+sc_audio_plc_init(struct sc_audio_plc *plc, enum sc_audio_plc_format format,
+                  unsigned channels, uint32_t sample_rate);
+
+void
+sc_audio_plc_destroy(struct sc_audio_plc *plc);
+
+/**
+ * Replace count missing samples by a concealment waveform
+ *
+ * Successive calls continue the same concealment.
+ */
+void
+sc_audio_plc_conceal(struct sc_audio_plc *plc, void *out, uint32_t count);
+
+/**
+ * Indicate that the next samples are not continuous with the previous ones
+ * (some samples have been dropped)
+ *
+ * The next played samples will be crossfaded with the waveform extension.
+ */
+void
+sc_audio_plc_discontinuity(struct sc_audio_plc *plc);
+
+/**
+ * Process real samples before they are played
+ *
+ * If a concealment was active, the beginning of the samples is crossfaded
+ * with the concealment waveform (so the samples may be modified in place).
+ */
+void
+sc_audio_plc_play(struct sc_audio_plc *plc, void *samples, uint32_t count);
+
+#endif
@@ -29,6 +29,15 @@
  * too high, then latency will become unacceptable. This target value is
  * configured using the scrcpy option --audio-buffer.
  *
+ * With --audio-buffer=auto, the target value itself is adjusted within bounds
+ * from the underflow events and the arrival jitter (see sc_audio_tuner).
+ * Changing the target does not drop or insert samples: the compensation
+ * converges progressively to the new value.
+ *
+ * The samples are converted to the native format of the audio output device
+ * (sample rate, sample format and channels) while they are pushed, so that the
+ * audio callback only copies them from the buffer.
+ *
  * The regulator cannot adjust the sample input rate (it receives samples
  * produced in real-time) or the sample output rate (it must provide samples as
  * requested by the audio player). Therefore, it may only apply compensation by
@@ -41,19 +50,21 @@
  * The estimated buffering level is the result of averaging the "natural"
  * buffering (samples are produced and consumed by blocks, so it must be
  * smoothed), and making instant adjustments resulting of its own actions
- * (explicit compensation and silence insertion on underflow), which are not
+ * (explicit compensation and concealment on underflow), which are not
  * smoothed.
  *
  * Buffer underflow events can occur when packets arrive too late. In that case,
- * the regulator inserts silence. Once the packets finally arrive (late), one
- * strategy could be to drop the samples that were replaced by silence, in
- * order to keep a minimal latency. However, dropping samples in case of buffer
- * underflow is inadvisable, as it would temporarily increase the underflow
- * even more and cause very noticeable audio glitches.
+ * the regulator conceals the missing samples by extending the waveform of the
+ * last played samples (see sc_audio_plc), which is far less audible than
+ * silence, independently of the codec.
  *
- * Therefore, the regulator doesn't drop any sample on underflow. The
- * compensation mechanism will absorb the delay introduced by the inserted
- * silence.
+ * Once the packets finally arrive (late), the concealed samples could be
+ * dropped, in order to keep a minimal latency. Dropping them immediately would
+ * increase the underflow even more, so the regulator only drops the late
+ * samples in excess of the target buffering (typically when the late packets
+ * arrive in a burst), at most as many as the concealed samples. The player
+ * crossfades the resulting discontinuity. The compensation mechanism absorbs
+ * the remaining delay.
  */
 
 #define TO_BYTES(SAMPLES) sc_audiobuf_to_bytes(&ar->buf, (SAMPLES))
@@ -91,27 +102,41 @@ sc_audio_regulator_pull(struct sc_audio_regulator *ar, uint8_t *out,
 
     uint32_t read = sc_audiobuf_read(&ar->buf, out, out_samples);
 
+    bool discontinuity = ar->discontinuity;
+    ar->discontinuity = false;
+
     sc_mutex_unlock(&ar->mutex);
 
+    if (discontinuity) {
+        // Some samples have been dropped by the receiver
+        sc_audio_plc_discontinuity(&ar->plc);
+    }
+
+    // Crossfade with the previous concealment, if any
+    sc_audio_plc_play(&ar->plc, out, read);
+
     if (read < out_samples) {
-        uint32_t silence = out_samples - read;
-        // Insert silence. In theory, the inserted silent samples replace the
-        // missing real samples, which will arrive later, so they should be
-        // dropped to keep the latency minimal. However, this would cause very
-        // audible glitches, so let the clock compensation restore the target
-        // latency.
-#ifdef SC_AUDIO_REGULATOR_DEBUG
-        LOGD("[Audio] Buffer underflow, inserting silence: %" PRIu32 " samples",
-             silence);
-#endif
-        memset(out + TO_BYTES(read), 0, TO_BYTES(silence));
+        uint32_t missing = out_samples - read;
 
         bool received = atomic_load_explicit(&ar->received,
                                              memory_order_relaxed);
         if (received) {
+            // Conceal the missing samples. The real samples will arrive
+            // later, the receiver may drop them (see the comment on top).
+#ifdef SC_AUDIO_REGULATOR_DEBUG
+            LOGD("[Audio] Buffer underflow, concealing %" PRIu32 " samples",
+                 missing);
+#endif
+            sc_audio_plc_conceal(&ar->plc, out + TO_BYTES(read), missing);
+
             // Inserting additional samples immediately increases buffering
-            atomic_fetch_add_explicit(&ar->underflow, silence,
+            atomic_fetch_add_explicit(&ar->underflow, missing,
                                       memory_order_relaxed);
+            if (ar->stats) {
+                sc_stats_add(&ar->stats->audio_underflows, 1);
+            }
+        } else {
+            memset(out + TO_BYTES(read), 0, TO_BYTES(missing));
         }
     }
 
@@ -137,12 +162,55 @@ sc_audio_regulator_get_swr_buf(struct sc_audio_regulator *ar,
     return ar->swr_buf;
 }
 
+static void
+sc_audio_regulator_publish_target(struct sc_audio_regulator *ar,
+                                  enum sc_audio_tuner_reason reason) {
+    if (ar->stats) {
+        uint32_t target = (sc_tick) ar->target_buffering * SC_TICK_FREQ
+                        / ar->sample_rate;
+        atomic_store_explicit(&ar->stats->audio_target, target,
+                              memory_order_relaxed);
+        atomic_store_explicit(&ar->stats->audio_target_reason, reason,
+                              memory_order_relaxed);
+    }
+}
+
+static void
+sc_audio_regulator_tune(struct sc_audio_regulator *ar, int64_t pts,
+                        uint32_t samples, uint32_t underflow) {
+    assert(ar->adaptive);
+
+    bool changed = sc_audio_tuner_push(&ar->tuner, sc_tick_now(), pts,
+                                       samples, underflow > 0);
+    if (!changed) {
+        return;
+    }
+
+    uint32_t old_target = ar->target_buffering;
+    ar->target_buffering = ar->tuner.target;
+
+    enum sc_audio_tuner_reason reason = ar->tuner.reason;
+    LOGD("[Audio] Target buffering: %" PRIu32 "ms -> %" PRIu32 "ms (%s)",
+         old_target * 1000 / ar->sample_rate,
+         ar->target_buffering * 1000 / ar->sample_rate,
+         sc_audio_tuner_reason_name(reason));
+
+    sc_audio_regulator_publish_target(ar, reason);
+}
+
 bool
 sc_audio_regulator_push(struct sc_audio_regulator *ar, const AVFrame *frame) {
     SwrContext *swr_ctx = ar->swr_ctx;
 
     uint32_t input_samples = frame->nb_samples;
 
+    // Number of output samples corresponding to the input samples, without
+    // compensation
+    uint64_t scaled = (uint64_t) input_samples * ar->sample_rate
+                    + ar->resample_remainder;
+    uint32_t expected_samples = scaled / ar->input_sample_rate;
+    ar->resample_remainder = scaled % ar->input_sample_rate;
+
     assert(frame->pts >= 0);
     int64_t pts = frame->pts;
     if (ar->next_expected_pts && pts - ar->next_expected_pts > 100000) {
@@ -151,9 +219,10 @@ sc_audio_regulator_push(struct sc_audio_regulator *ar, const AVFrame *frame) {
         // More than 100ms: consider it as a discontinuity
         // (typically because silence packets were not captured)
         uint32_t can_read = sc_audiobuf_can_read(&ar->buf);
-        if (input_samples + can_read < ar->target_buffering) {
+        if (expected_samples + can_read < ar->target_buffering) {
             // Adjust buffering to the target value directly
-            uint32_t silence = ar->target_buffering - can_read - input_samples;
+            uint32_t silence =
+                ar->target_buffering - can_read - expected_samples;
             sc_audiobuf_write_silence(&ar->buf, silence);
         }
 
@@ -164,17 +233,23 @@ sc_audio_regulator_push(struct sc_audio_regulator *ar, const AVFrame *frame) {
         assert(!ret); // disabling compensation should never fail
         ar->compensation_active = false;
         ar->samples_since_resync = 0;
+        ar->concealed = 0;
         atomic_store_explicit(&ar->underflow, 0, memory_order_relaxed);
+
+        if (ar->adaptive) {
+            // The transit delays are not comparable across the discontinuity
+            sc_audio_tuner_reset(&ar->tuner);
+        }
     }
 
     int64_t packet_duration = input_samples * INT64_C(1000000)
-                            / ar->sample_rate;
+                            / ar->input_sample_rate;
     ar->next_expected_pts = pts + packet_duration;
 
+    // The delay of the samples buffered by the resampler, in output samples
     int64_t swr_delay = swr_get_delay(swr_ctx, ar->sample_rate);
-    // No need to av_rescale_rnd(), input and output sample rates are the same.
-    // Add more space (256) for clock compensation.
-    int dst_nb_samples = swr_delay + frame->nb_samples + 256;
+    // Add more space (256) for clock compensation and rounding.
+    int dst_nb_samples = swr_delay + expected_samples + 256;
 
     uint8_t *swr_buf = sc_audio_regulator_get_swr_buf(ar, dst_nb_samples);
     if (!swr_buf) {
@@ -223,6 +298,7 @@ sc_audio_regulator_push(struct sc_audio_regulator *ar, const AVFrame *frame) {
             // Still insufficient, drop old samples to make space
             skipped_samples = sc_audiobuf_read(&ar->buf, NULL, remaining);
             assert(skipped_samples == remaining);
+            ar->discontinuity = true;
         }
 
         sc_mutex_unlock(&ar->mutex);
@@ -244,6 +320,11 @@ sc_audio_regulator_push(struct sc_audio_regulator *ar, const AVFrame *frame) {
         underflow = atomic_exchange_explicit(&ar->underflow, 0,
                                              memory_order_relaxed);
         ar->underflow_report += underflow;
+        ar->concealed += underflow;
+
+        if (ar->adaptive) {
+            sc_audio_regulator_tune(ar, pts, expected_samples, underflow);
+        }
 
         max_buffered_samples = ar->target_buffering * 11 / 10
                              + 60 * ar->sample_rate / 1000 /* 60 ms */;
@@ -267,6 +348,7 @@ sc_audio_regulator_push(struct sc_audio_regulator *ar, const AVFrame *frame) {
             assert(r == skip_samples);
             (void) r;
             skipped_samples += skip_samples;
+            ar->discontinuity = true;
         }
         sc_mutex_unlock(&ar->mutex);
 
@@ -283,6 +365,29 @@ sc_audio_regulator_push(struct sc_audio_regulator *ar, const AVFrame *frame) {
         }
     }
 
+    if (ar->concealed) {
+        // Drop the late samples in excess of the target buffering, they have
+        // already been replaced by the concealment (see the comment on top)
+        uint32_t drop = 0;
+
+        sc_mutex_lock(&ar->mutex);
+        uint32_t buffered = sc_audiobuf_can_read(&ar->buf);
+        if (buffered > ar->target_buffering) {
+            drop = MIN(buffered - ar->target_buffering, ar->concealed);
+            uint32_t r = sc_audiobuf_read(&ar->buf, NULL, drop);
+            assert(r == drop);
+            (void) r;
+            ar->discontinuity = true;
+        }
+        sc_mutex_unlock(&ar->mutex);
+
+        if (drop) {
+            LOGV("[Audio] Dropping %" PRIu32 " late samples (concealed)", drop);
+            ar->concealed -= drop;
+            skipped_samples += drop;
+        }
+    }
+
     atomic_store_explicit(&ar->received, true, memory_order_relaxed);
     if (!played) {
         // Nothing more to do
@@ -290,8 +395,8 @@ sc_audio_regulator_push(struct sc_audio_regulator *ar, const AVFrame *frame) {
     }
 
     // Number of samples added (or removed, if negative) for compensation
-    int32_t instant_compensation = (int32_t) written - input_samples;
-    // Inserting silence instantly increases buffering
+    int32_t instant_compensation = (int32_t) written - expected_samples;
+    // Concealing missing samples instantly increases buffering
     int32_t inserted_silence = (int32_t) underflow;
     // Dropping input samples instantly decreases buffering
     int32_t dropped = (int32_t) skipped_samples;
@@ -312,6 +417,13 @@ sc_audio_regulator_push(struct sc_audio_regulator *ar, const AVFrame *frame) {
     // However, the buffering level must be smoothed
     sc_average_push(&ar->avg_buffering, can_read);
 
+    if (ar->stats) {
+        float avg = sc_average_get(&ar->avg_buffering);
+        uint32_t buffering = avg * SC_TICK_FREQ / ar->sample_rate;
+        atomic_store_explicit(&ar->stats->audio_buffering, buffering,
+                              memory_order_relaxed);
+    }
+
 #ifdef SC_AUDIO_REGULATOR_DEBUG
     LOGD("[Audio] can_read=%" PRIu32 " avg_buffering=%f",
          can_read, sc_average_get(&ar->avg_buffering));
@@ -322,6 +434,10 @@ sc_audio_regulator_push(struct sc_audio_regulator *ar, const AVFrame *frame) {
         // Recompute compensation every second
         ar->samples_since_resync = 0;
 
+        // The late samples not received within 1 second will not be dropped,
+        // the compensation will absorb the delay
+        ar->concealed = 0;
+
         float avg = sc_average_get(&ar->avg_buffering);
         int diff = ar->target_buffering - avg;
 
@@ -362,9 +478,26 @@ sc_audio_regulator_push(struct sc_audio_regulator *ar, const AVFrame *frame) {
     return true;
 }
 
+static enum sc_audio_plc_format
+sc_audio_regulator_get_plc_format(enum AVSampleFormat sample_fmt) {
+    if (sample_fmt == AV_SAMPLE_FMT_S16) {
+        return SC_AUDIO_PLC_FORMAT_S16;
+    }
+
+    assert(sample_fmt == AV_SAMPLE_FMT_FLT);
+    return SC_AUDIO_PLC_FORMAT_FLT;
+}
+
 bool
-sc_audio_regulator_init(struct sc_audio_regulator *ar, size_t sample_size,
-                        const AVCodecContext *ctx, uint32_t target_buffering) {
+sc_audio_regulator_init(struct sc_audio_regulator *ar,
+                        const AVCodecContext *ctx,
+                        const struct sc_audio_output_format *out,
+                        uint32_t target_buffering,
+                        uint32_t min_target_buffering,
+                        uint32_t max_target_buffering,
+                        struct sc_stats *stats) {
+    assert(min_target_buffering <= max_target_buffering);
+
     SwrContext *swr_ctx = swr_alloc();
     if (!swr_ctx) {
         LOG_OOM();
@@ -372,21 +505,30 @@ sc_audio_regulator_init(struct sc_audio_regulator *ar, size_t sample_size,
     }
     ar->swr_ctx = swr_ctx;
 
+    assert(out->sample_fmt == AV_SAMPLE_FMT_FLT
+            || out->sample_fmt == AV_SAMPLE_FMT_S16);
+    assert(out->sample_rate > 0);
+    assert(out->channels > 0);
+
 #ifdef SCRCPY_LAVU_HAS_CHLAYOUT
+    AVChannelLayout out_ch_layout;
+    av_channel_layout_default(&out_ch_layout, out->channels);
     av_opt_set_chlayout(swr_ctx, "in_chlayout", &ctx->ch_layout, 0);
-    av_opt_set_chlayout(swr_ctx, "out_chlayout", &ctx->ch_layout, 0);
+    av_opt_set_chlayout(swr_ctx, "out_chlayout", &out_ch_layout, 0);
+    av_channel_layout_uninit(&out_ch_layout);
 #else
+    int64_t out_ch_layout = av_get_default_channel_layout(out->channels);
     av_opt_set_channel_layout(swr_ctx, "in_channel_layout",
                               ctx->channel_layout, 0);
-    av_opt_set_channel_layout(swr_ctx, "out_channel_layout",
-                              ctx->channel_layout, 0);
+    av_opt_set_channel_layout(swr_ctx, "out_channel_layout", out_ch_layout,
+                              0);
 #endif
 
     av_opt_set_int(swr_ctx, "in_sample_rate", ctx->sample_rate, 0);
-    av_opt_set_int(swr_ctx, "out_sample_rate", ctx->sample_rate, 0);
+    av_opt_set_int(swr_ctx, "out_sample_rate", out->sample_rate, 0);
 
     av_opt_set_sample_fmt(swr_ctx, "in_sample_fmt", ctx->sample_fmt, 0);
-    av_opt_set_sample_fmt(swr_ctx, "out_sample_fmt", SC_AV_SAMPLE_FMT, 0);
+    av_opt_set_sample_fmt(swr_ctx, "out_sample_fmt", out->sample_fmt, 0);
 
     int ret = swr_init(swr_ctx);
     if (ret) {
@@ -399,15 +541,28 @@ sc_audio_regulator_init(struct sc_audio_regulator *ar, size_t sample_size,
         goto error_free_swr_ctx;
     }
 
-    ar->target_buffering = target_buffering;
+    ar->adaptive = min_target_buffering < max_target_buffering;
+    if (ar->adaptive) {
+        sc_audio_tuner_init(&ar->tuner, out->sample_rate, target_buffering,
+                            min_target_buffering, max_target_buffering);
+        ar->target_buffering = ar->tuner.target;
+    } else {
+        ar->target_buffering = target_buffering;
+    }
+    int bytes_per_sample = av_get_bytes_per_sample(out->sample_fmt);
+    assert(bytes_per_sample > 0);
+    size_t sample_size = out->channels * bytes_per_sample;
     ar->sample_size = sample_size;
-    ar->sample_rate = ctx->sample_rate;
+    ar->sample_rate = out->sample_rate;
+    ar->input_sample_rate = ctx->sample_rate;
+    ar->resample_remainder = 0;
 
-    // Use a ring-buffer of the target buffering size plus 1 second between the
-    // producer and the consumer. It's too big on purpose, to guarantee that
-    // the producer and the consumer will be able to access it in parallel
-    // without locking.
-    uint32_t audiobuf_samples = target_buffering + ar->sample_rate;
+    // Use a ring-buffer of the (maximal) target buffering size plus 1 second
+    // between the producer and the consumer. It's too big on purpose, to
+    // guarantee that the producer and the consumer will be able to access it
+    // in parallel without locking.
+    uint32_t max_target = MAX(ar->target_buffering, max_target_buffering);
+    uint32_t audiobuf_samples = max_target + ar->sample_rate;
 
     ok = sc_audiobuf_init(&ar->buf, sample_size, audiobuf_samples);
     if (!ok) {
@@ -422,6 +577,14 @@ sc_audio_regulator_init(struct sc_audio_regulator *ar, size_t sample_size,
     }
     ar->swr_buf_alloc_size = initial_swr_buf_size;
 
+    enum sc_audio_plc_format plc_format =
+        sc_audio_regulator_get_plc_format(out->sample_fmt);
+    ok = sc_audio_plc_init(&ar->plc, plc_format, out->channels,
+                           ar->sample_rate);
+    if (!ok) {
+        goto error_free_swr_buf;
+    }
+
     // Samples are produced and consumed by blocks, so the buffering must be
     // smoothed to get a relatively stable value.
     sc_average_init(&ar->avg_buffering, 128);
@@ -432,11 +595,20 @@ sc_audio_regulator_init(struct sc_audio_regulator *ar, size_t sample_size,
     atomic_init(&ar->received, false);
     atomic_init(&ar->underflow, 0);
     ar->underflow_report = 0;
+    ar->concealed = 0;
+    ar->discontinuity = false;
     ar->compensation_active = false;
     ar->next_expected_pts = 0;
+    ar->stats = stats;
+
+    sc_audio_regulator_publish_target(ar, ar->adaptive
+                                            ? ar->tuner.reason
+                                            : SC_AUDIO_TUNER_REASON_FIXED);
 
     return true;
 
+error_free_swr_buf:
+    free(ar->swr_buf);
 error_destroy_audiobuf:
     sc_audiobuf_destroy(&ar->buf);
 error_destroy_mutex:
@@ -449,6 +621,7 @@ error_free_swr_ctx:
 
 void
 sc_audio_regulator_destroy(struct sc_audio_regulator *ar) {
+    sc_audio_plc_destroy(&ar->plc);
     free(ar->swr_buf);
     sc_audiobuf_destroy(&ar->buf);
     sc_mutex_destroy(&ar->mutex);
@@ -9,29 +9,52 @@
 #include <stdint.h>
 #include <libavcodec/avcodec.h>
 #include <libswresample/swresample.h>
+#include "audio_plc.h"
+#include "audio_tuner.h"
+#include "stats.h"
 #include "util/audiobuf.h"
 #include "util/average.h"
 #include "util/thread.h"
 
-#define SC_AV_SAMPLE_FMT AV_SAMPLE_FMT_FLT
+// Format of the samples produced by the regulator (the native format of the
+// audio output device)
+struct sc_audio_output_format {
+    enum AVSampleFormat sample_fmt; // AV_SAMPLE_FMT_FLT or AV_SAMPLE_FMT_S16
+    uint32_t sample_rate;
+    uint8_t channels;
+};
 
 struct sc_audio_regulator {
     sc_mutex mutex;
 
     // Target buffering between the producer and the consumer (in samples)
+    // (only used by the receiver thread once playback started)
     uint32_t target_buffering;
 
+    // Adjust the target buffering automatically (only used by the receiver
+    // thread)
+    bool adaptive;
+    struct sc_audio_tuner tuner;
+
     // Audio buffer to communicate between the receiver and the player
     struct sc_audiobuf buf;
 
-    // Resampler (only used from the receiver thread)
+    // Resampler, also converting to the output format (only used from the
+    // receiver thread)
     struct SwrContext *swr_ctx;
 
-    // The sample rate is the same for input and output
+    // The output sample rate (the buffering is expressed in output samples)
     uint32_t sample_rate;
-    // The number of bytes per sample (for all channels)
+    // The input (decoded) sample rate
+    uint32_t input_sample_rate;
+    // The number of bytes per output sample (for all channels)
     size_t sample_size;
 
+    // Remainder of the conversion of the number of input samples to output
+    // samples, to avoid accumulating rounding errors (only used by the
+    // receiver thread)
+    uint64_t resample_remainder;
+
     // Target buffer for resampling (only used by the receiver thread)
     uint8_t *swr_buf;
     size_t swr_buf_alloc_size;
@@ -43,12 +66,23 @@ struct sc_audio_regulator {
     // (only used by the receiver thread)
     uint32_t samples_since_resync;
 
-    // Number of silence samples inserted since the last received packet
+    // Number of samples concealed since the last received packet
     atomic_uint_least32_t underflow;
 
-    // Number of silence samples inserted since the last log
+    // Number of samples concealed since the last log
     uint32_t underflow_report;
 
+    // Number of concealed samples which may be replaced by the late samples
+    // (only used by the receiver thread)
+    uint32_t concealed;
+
+    // Packet loss concealment (only used by the player thread)
+    struct sc_audio_plc plc;
+
+    // Set by the receiver when samples are dropped from the buffer, so that
+    // the player crossfades the discontinuity (protected by the mutex)
+    bool discontinuity;
+
     // Non-zero compensation applied (only used by the receiver thread)
     bool compensation_active;
 
@@ -60,11 +94,26 @@ struct sc_audio_regulator {
 
     // PTS of the next expected packet (useful to detect discontinuities)
     int64_t next_expected_pts;
+
+    struct sc_stats *stats; // may be NULL
 };
 
+/**
+ * The decoded samples (described by ctx) are converted to the output format.
+ *
+ * The target buffering (in output samples) is adjusted automatically between
+ * min_target_buffering and max_target_buffering if they are different.
+ *
+ * The stats may be NULL.
+ */
 bool
-sc_audio_regulator_init(struct sc_audio_regulator *ar, size_t sample_size,
-                        const AVCodecContext *ctx, uint32_t target_buffering);
+sc_audio_regulator_init(struct sc_audio_regulator *ar,
+                        const AVCodecContext *ctx,
+                        const struct sc_audio_output_format *out,
+                        uint32_t target_buffering,
+                        uint32_t min_target_buffering,
+                        uint32_t max_target_buffering,
+                        struct sc_stats *stats);
 
 void
 sc_audio_regulator_destroy(struct sc_audio_regulator *ar);
@@ -0,0 +1,180 @@
+#include "audio_tuner.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The target is updated at the end of each period
+#define SC_AUDIO_TUNER_PERIOD SC_TICK_FROM_SEC(2)
+#define SC_AUDIO_TUNER_WINDOW (SC_AUDIO_TUNER_SLOTS * SC_AUDIO_TUNER_PERIOD)
+// Minimum number of packets in the window to estimate the jitter
+#define SC_AUDIO_TUNER_MIN_PACKETS 25
+// Percentile of the transit delays to absorb
+#define SC_AUDIO_TUNER_PERCENTILE 95
+// Margin added to the jitter and the packet duration
+#define SC_AUDIO_TUNER_MARGIN_MS 10
+
+void
+sc_audio_tuner_init(struct sc_audio_tuner *tuner, uint32_t sample_rate,
+                    uint32_t initial_target, uint32_t min_target,
+                    uint32_t max_target) {
+    assert(min_target <= max_target);
+
+    tuner->sample_rate = sample_rate;
+    tuner->min_target = min_target;
+    tuner->max_target = max_target;
+    tuner->target = CLAMP(initial_target, min_target, max_target);
+    tuner->reason = SC_AUDIO_TUNER_REASON_INITIAL;
+    tuner->head = 0;
+    tuner->count = 0;
+    tuner->max_packet_samples = 0;
+    memset(tuner->underflows, 0, sizeof(tuner->underflows));
+    tuner->started = false;
+    tuner->period_start = 0;
+}
+
+void
+sc_audio_tuner_reset(struct sc_audio_tuner *tuner) {
+    tuner->head = 0;
+    tuner->count = 0;
+}
+
+static int
+sc_audio_tuner_cmp_delay(const void *a, const void *b) {
+    sc_tick da = *(const sc_tick *) a;
+    sc_tick db = *(const sc_tick *) b;
+    return (da > db) - (da < db);
+}
+
+// Compute the jitter (in samples) of the packets received in the window
+static bool
+sc_audio_tuner_get_jitter(struct sc_audio_tuner *tuner, sc_tick now,
+                          uint32_t *jitter) {
+    sc_tick delays[SC_AUDIO_TUNER_MAX_PACKETS];
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < tuner->count; ++i) {
+        unsigned index = (tuner->head + SC_AUDIO_TUNER_MAX_PACKETS - 1 - i)
+                       % SC_AUDIO_TUNER_MAX_PACKETS;
+        if (now - tuner->arrivals[index] > SC_AUDIO_TUNER_WINDOW) {
+            // Older packets are out of the window
+            break;
+        }
+        delays[n++] = tuner->delays[index];
+    }
+
+    if (n < SC_AUDIO_TUNER_MIN_PACKETS) {
+        return false;
+    }
+
+    qsort(delays, n, sizeof(delays[0]), sc_audio_tuner_cmp_delay);
+
+    // The PTS and the local clock have an unknown offset, so only the
+    // difference with the minimal delay is meaningful
+    unsigned p = (n - 1) * SC_AUDIO_TUNER_PERCENTILE / 100;
+    sc_tick spread = delays[p] - delays[0];
+
+    *jitter = spread * tuner->sample_rate / SC_TICK_FREQ;
+    return true;
+}
+
+static bool
+sc_audio_tuner_update(struct sc_audio_tuner *tuner, sc_tick now) {
+    unsigned recent_underflows = tuner->underflows[0];
+    unsigned window_underflows = 0;
+    for (unsigned i = 0; i < SC_AUDIO_TUNER_SLOTS; ++i) {
+        window_underflows += tuner->underflows[i];
+    }
+
+    uint32_t margin = tuner->sample_rate * SC_AUDIO_TUNER_MARGIN_MS / 1000;
+
+    uint32_t jitter;
+    bool has_jitter = sc_audio_tuner_get_jitter(tuner, now, &jitter);
+    // The buffer must absorb the jitter, with at least one packet
+    uint32_t needed = has_jitter
+                    ? jitter + tuner->max_packet_samples + margin
+                    : 0;
+
+    uint32_t target = tuner->target;
+    enum sc_audio_tuner_reason reason = tuner->reason;
+
+    if (recent_underflows) {
+        // Raise quickly
+        uint32_t raise = MAX(target / 4, margin);
+        target = MAX(target + raise, needed);
+        reason = SC_AUDIO_TUNER_REASON_UNDERFLOW;
+    } else if (needed > target) {
+        target = needed;
+        reason = SC_AUDIO_TUNER_REASON_JITTER;
+    } else if (has_jitter && !window_underflows && needed < target) {
+        // Lower slowly, only if stable for the whole window
+        uint32_t lowered = target - target / 10;
+        target = MAX(lowered, needed);
+        reason = SC_AUDIO_TUNER_REASON_STABLE;
+    }
+
+    target = CLAMP(target, tuner->min_target, tuner->max_target);
+    if (target == tuner->target) {
+        return false;
+    }
+
+    tuner->target = target;
+    tuner->reason = reason;
+    return true;
+}
+
+bool
+sc_audio_tuner_push(struct sc_audio_tuner *tuner, sc_tick now, int64_t pts,
+                    uint32_t samples, bool underflow) {
+    if (!tuner->started) {
+        tuner->period_start = now;
+        tuner->started = true;
+    }
+
+    unsigned head = tuner->head;
+    tuner->delays[head] = now - SC_TICK_FROM_US(pts);
+    tuner->arrivals[head] = now;
+    tuner->head = (head + 1) % SC_AUDIO_TUNER_MAX_PACKETS;
+    if (tuner->count < SC_AUDIO_TUNER_MAX_PACKETS) {
+        ++tuner->count;
+    }
+
+    tuner->max_packet_samples = MAX(tuner->max_packet_samples, samples);
+
+    if (underflow) {
+        ++tuner->underflows[0];
+    }
+
+    if (now - tuner->period_start < SC_AUDIO_TUNER_PERIOD) {
+        return false;
+    }
+
+    bool changed = sc_audio_tuner_update(tuner, now);
+
+    // Start a new period
+    memmove(&tuner->underflows[1], &tuner->underflows[0],
+            (SC_AUDIO_TUNER_SLOTS - 1) * sizeof(tuner->underflows[0]));
+    tuner->underflows[0] = 0;
+    tuner->period_start = now;
+
+    return changed;
+}
+
+const char *
+sc_audio_tuner_reason_name(enum sc_audio_tuner_reason reason) {
+    switch (reason) {
+        case SC_AUDIO_TUNER_REASON_FIXED:
+            return "fixed";
+        case SC_AUDIO_TUNER_REASON_INITIAL:
+            return "initial";
+        case SC_AUDIO_TUNER_REASON_UNDERFLOW:
+            return "underflow";
+        case SC_AUDIO_TUNER_REASON_JITTER:
+            return "jitter";
+        case SC_AUDIO_TUNER_REASON_STABLE:
+            return "stable";
+        default:
+            assert(!"unexpected reason");
+            return "unknown";
+    }
+}
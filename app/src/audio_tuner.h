@@ -0,0 +1,85 @@
+#ifndef SC_AUDIO_TUNER_H
+#define SC_AUDIO_TUNER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/tick.h"
+
+// Capacity of the sliding window (enough for 10 seconds of 10 ms packets)
+#define SC_AUDIO_TUNER_MAX_PACKETS 1024
+// Number of periods in the sliding window for underflow events
+#define SC_AUDIO_TUNER_SLOTS 5
+
+enum sc_audio_tuner_reason {
+    SC_AUDIO_TUNER_REASON_FIXED, // not adaptive
+    SC_AUDIO_TUNER_REASON_INITIAL,
+    SC_AUDIO_TUNER_REASON_UNDERFLOW,
+    SC_AUDIO_TUNER_REASON_JITTER,
+    SC_AUDIO_TUNER_REASON_STABLE,
+};
+
+/**
+ * Audio buffer tuner, for --audio-buffer=auto
+ *
+ * It adjusts the target buffering of the audio regulator, within bounds, from
+ * the statistics observed over a sliding window of 10 seconds:
+ *  - the arrival jitter: the 95th percentile of the transit delay (arrival
+ *    time minus PTS), relative to the minimal delay;
+ *  - the underflow events.
+ *
+ * Every 2 seconds, the target is raised immediately on underflow or if the
+ * jitter requires it, and lowered progressively if the connection has been
+ * stable for the whole window. The regulator compensation then converges
+ * smoothly to the new target.
+ */
+struct sc_audio_tuner {
+    uint32_t sample_rate;
+    uint32_t min_target; // in samples
+    uint32_t max_target; // in samples
+
+    uint32_t target; // in samples
+    enum sc_audio_tuner_reason reason;
+
+    // Transit delays (arrival time minus PTS) of the last packets (ring)
+    sc_tick delays[SC_AUDIO_TUNER_MAX_PACKETS];
+    sc_tick arrivals[SC_AUDIO_TUNER_MAX_PACKETS];
+    unsigned head;
+    unsigned count;
+    uint32_t max_packet_samples;
+
+    // Number of underflow events per period, the current period first
+    unsigned underflows[SC_AUDIO_TUNER_SLOTS];
+    bool started;
+    sc_tick period_start;
+};
+
+void
+sc_audio_tuner_init(struct sc_audio_tuner *tuner, uint32_t sample_rate,
+                    uint32_t initial_target, uint32_t min_target,
+                    uint32_t max_target);
+
+/**
+ * Register a received packet
+ *
+ * The `underflow` flag indicates that samples have been concealed since the
+ * previous packet.
+ *
+ * Return true if the target changed.
+ */
+bool
+sc_audio_tuner_push(struct sc_audio_tuner *tuner, sc_tick now, int64_t pts,
+                    uint32_t samples, bool underflow);
+
+/**
+ * Forget the transit delays (on discontinuity, the PTS may jump)
+ */
+void
+sc_audio_tuner_reset(struct sc_audio_tuner *tuner);
+
+const char *
+sc_audio_tuner_reason_name(enum sc_audio_tuner_reason reason);
+
+#endif
@@ -0,0 +1,611 @@
+#include "automation.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "events.h"
+#include "screen.h"
+#include "util/log.h"
+
+/** Downcast frame sink to sc_automation */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_automation, frame_sink)
+
+// Large enough for any request (a UHID_CREATE with the max report descriptor
+// size), and for many small requests per recv()
+#define SC_AUTOMATION_RECV_BUFFER_SIZE (1 << 17) // 128k
+
+// Pending events to send to the client
+#define SC_AUTOMATION_EVENT_QUEUE_LIMIT 64
+
+// Events serialized in a single send()
+#define SC_AUTOMATION_SEND_BATCH_SIZE 16
+
+// UHID devices created by automation clients (their data is kept until the
+// end)
+#define SC_AUTOMATION_UHID_CREATE_LIMIT 256
+
+static bool
+sc_automation_frame_sink_open(struct sc_frame_sink *sink,
+                              const AVCodecContext *ctx) {
+    (void) sink;
+    (void) ctx;
+    return true;
+}
+
+static void
+sc_automation_frame_sink_close(struct sc_frame_sink *sink) {
+    (void) sink;
+}
+
+static bool
+sc_automation_frame_sink_push(struct sc_frame_sink *sink,
+                              const AVFrame *frame) {
+    struct sc_automation *automation = DOWNCAST(sink);
+
+    struct sc_size size = {
+        .width = frame->width,
+        .height = frame->height,
+    };
+
+    sc_mutex_lock(&automation->mutex);
+    automation->video_size = size;
+    if (automation->subscribed && !automation->client_closed) {
+        // Never block the decoder
+        if (sc_vecdeque_size(&automation->events)
+                < SC_AUTOMATION_EVENT_QUEUE_LIMIT) {
+            struct sc_automation_event event = {
+                .type = SC_AUTOMATION_EVENT_TYPE_FRAME,
+                .frame = {
+                    .pts = frame->pts,
+                    .size = size,
+                },
+            };
+            sc_vecdeque_push_noresize(&automation->events, event);
+            sc_cond_signal(&automation->event_cond);
+        } else {
+            ++automation->dropped_frame_events;
+        }
+    }
+    sc_mutex_unlock(&automation->mutex);
+
+    return true;
+}
+
+bool
+sc_automation_init(struct sc_automation *automation, const char *path,
+                   struct sc_controller *controller, struct sc_screen *screen,
+                   struct sc_stats *stats) {
+    struct stat st;
+    if (!stat(path, &st)) {
+        // Never remove an existing file, it could be the socket of another
+        // running instance
+        LOGE("Automation socket already exists (remove it if it is stale): "
+             "%s", path);
+        return false;
+    }
+
+    sc_vecdeque_init(&automation->events);
+    bool ok = sc_vecdeque_reserve(&automation->events,
+                                  SC_AUTOMATION_EVENT_QUEUE_LIMIT);
+    if (!ok) {
+        LOG_OOM();
+        return false;
+    }
+
+    ok = sc_mutex_init(&automation->mutex);
+    if (!ok) {
+        goto error_destroy_events;
+    }
+
+    ok = sc_cond_init(&automation->event_cond);
+    if (!ok) {
+        goto error_destroy_mutex;
+    }
+
+    ok = sc_cond_init(&automation->space_cond);
+    if (!ok) {
+        goto error_destroy_event_cond;
+    }
+
+    automation->server_socket = net_socket_unix();
+    if (automation->server_socket == SC_SOCKET_NONE) {
+        LOGE("Could not create automation socket");
+        goto error_destroy_space_cond;
+    }
+
+    // The socket file is created with permissions restricted to the current
+    // user, so that only the current user may inject events
+    ok = net_listen_unix(automation->server_socket, path, 1);
+    if (!ok) {
+        LOGE("Could not listen on automation socket: %s", path);
+        goto error_close_socket;
+    }
+
+    automation->path = path;
+    automation->controller = controller;
+    automation->screen = screen;
+    automation->stats = stats;
+    automation->stopped = false;
+    automation->client_socket = SC_SOCKET_NONE;
+    automation->client_closed = true;
+    automation->json = false;
+    automation->subscribed = false;
+    automation->video_size.width = 0;
+    automation->video_size.height = 0;
+    automation->dropped_frame_events = 0;
+    automation->injected_events = 0;
+    sc_vector_init(&automation->uhid_data);
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_automation_frame_sink_open,
+        .close = sc_automation_frame_sink_close,
+        .push = sc_automation_frame_sink_push,
+    };
+
+    automation->frame_sink.ops = &ops;
+
+    LOGI("Automation socket: %s", path);
+
+    return true;
+
+error_close_socket:
+    net_close(automation->server_socket);
+error_destroy_space_cond:
+    sc_cond_destroy(&automation->space_cond);
+error_destroy_event_cond:
+    sc_cond_destroy(&automation->event_cond);
+error_destroy_mutex:
+    sc_mutex_destroy(&automation->mutex);
+error_destroy_events:
+    sc_vecdeque_destroy(&automation->events);
+
+    return false;
+}
+
+// Queue an event for the writer thread, waiting for space if necessary
+static bool
+sc_automation_push_event(struct sc_automation *automation,
+                         const struct sc_automation_event *event) {
+    sc_mutex_lock(&automation->mutex);
+    while (!automation->stopped && !automation->client_closed
+            && sc_vecdeque_size(&automation->events)
+                    >= SC_AUTOMATION_EVENT_QUEUE_LIMIT) {
+        sc_cond_wait(&automation->space_cond, &automation->mutex);
+    }
+
+    if (automation->stopped || automation->client_closed) {
+        sc_mutex_unlock(&automation->mutex);
+        return false;
+    }
+
+    sc_vecdeque_push_noresize(&automation->events, *event);
+    sc_cond_signal(&automation->event_cond);
+    sc_mutex_unlock(&automation->mutex);
+
+    return true;
+}
+
+static bool
+sc_automation_inject(struct sc_automation *automation,
+                     struct sc_automation_request *req) {
+    assert(req->type == SC_AUTOMATION_REQUEST_TYPE_CONTROL);
+
+    if (!automation->controller) {
+        LOGW("Automation: could not inject input events, control is "
+             "disabled");
+        sc_automation_request_destroy(req);
+        return false;
+    }
+
+    if (req->control.uhid_data) {
+        if (automation->uhid_data.size >= SC_AUTOMATION_UHID_CREATE_LIMIT) {
+            LOGW("Automation: too many UHID devices created");
+            sc_automation_request_destroy(req);
+            return false;
+        }
+
+        bool ok = sc_vector_push(&automation->uhid_data,
+                                 req->control.uhid_data);
+        if (!ok) {
+            LOG_OOM();
+            sc_automation_request_destroy(req);
+            return false;
+        }
+
+        // Now owned by the automation instance
+        req->control.uhid_data = NULL;
+    }
+
+    // The controller takes ownership of the message on success
+    bool ok = sc_controller_push_msg_wait(automation->controller,
+                                          &req->control.msg);
+    if (!ok) {
+        // The input events must not be lost silently: disconnect the client
+        LOGW("Automation: could not inject input event");
+        sc_automation_request_destroy(req);
+        return false;
+    }
+
+    ++automation->injected_events;
+    return true;
+}
+
+static void
+sc_automation_get_state(struct sc_automation *automation,
+                        struct sc_automation_state *state) {
+    struct sc_stats *stats = automation->stats;
+
+    sc_mutex_lock(&automation->mutex);
+    state->video_size = automation->video_size;
+    state->dropped_frame_events = automation->dropped_frame_events;
+    sc_mutex_unlock(&automation->mutex);
+
+    state->decoded_frames = sc_stats_get(&stats->decoded_frames);
+    state->skipped_frames = sc_stats_get(&stats->skipped_frames);
+    state->presented_frames = sc_stats_get(&stats->presented_frames);
+    state->video_bytes = sc_stats_get(&stats->video_bytes);
+    state->reconnections = sc_stats_get(&stats->reconnections);
+    state->injected_events = automation->injected_events;
+}
+
+static void
+task_take_screenshot(void *userdata) {
+    struct sc_screen *screen = userdata;
+    sc_screen_take_screenshot(screen);
+}
+
+static void
+sc_automation_take_screenshot(struct sc_automation *automation) {
+    if (!automation->screen) {
+        LOGW("Automation: screenshots not available without video playback");
+        return;
+    }
+
+    // The screen frame is only accessed from the main thread. The screen
+    // remains valid while the main thread processes the
+    // SC_EVENT_RUN_ON_MAIN_THREAD events (they are not processed anymore on
+    // exit, when everything gets deinitialized).
+    bool ok = sc_post_to_main_thread(task_take_screenshot,
+                                     automation->screen);
+    if (!ok) {
+        LOGW("Automation: could not post screenshot to main thread");
+    }
+}
+
+static bool
+sc_automation_handle_request(struct sc_automation *automation,
+                             struct sc_automation_request *req) {
+    switch (req->type) {
+        case SC_AUTOMATION_REQUEST_TYPE_CONTROL:
+            return sc_automation_inject(automation, req);
+        case SC_AUTOMATION_REQUEST_TYPE_PING: {
+            // All the previous input events have been pushed to the
+            // controller, so they will be sent to the device before any
+            // input event requested after this PING
+            struct sc_automation_event event = {
+                .type = SC_AUTOMATION_EVENT_TYPE_PONG,
+                .pong = {
+                    .token = req->ping.token,
+                },
+            };
+            return sc_automation_push_event(automation, &event);
+        }
+        case SC_AUTOMATION_REQUEST_TYPE_GET_STATE: {
+            struct sc_automation_event event = {
+                .type = SC_AUTOMATION_EVENT_TYPE_STATE,
+            };
+            sc_automation_get_state(automation, &event.state);
+            return sc_automation_push_event(automation, &event);
+        }
+        case SC_AUTOMATION_REQUEST_TYPE_SUBSCRIBE_FRAMES:
+            sc_mutex_lock(&automation->mutex);
+            automation->subscribed = req->subscribe_frames.enable;
+            sc_mutex_unlock(&automation->mutex);
+            return true;
+        case SC_AUTOMATION_REQUEST_TYPE_SCREENSHOT:
+            // Not an error for the client, the warning is logged
+            sc_automation_take_screenshot(automation);
+            return true;
+        default:
+            assert(!"unexpected automation request type");
+            return false;
+    }
+}
+
+// Process the complete requests in buf, and return the number of bytes
+// consumed (or -1 on error)
+static ssize_t
+sc_automation_process_binary(struct sc_automation *automation,
+                             const uint8_t *buf, size_t len) {
+    size_t consumed = 0;
+    for (;;) {
+        struct sc_automation_request req;
+        ssize_t r = sc_automation_request_parse_binary(&buf[consumed],
+                                                       len - consumed, &req);
+        if (r == -1) {
+            return -1;
+        }
+        if (!r) {
+            // No complete request
+            return consumed;
+        }
+
+        if (!sc_automation_handle_request(automation, &req)) {
+            return -1;
+        }
+        consumed += r;
+    }
+}
+
+static ssize_t
+sc_automation_process_json(struct sc_automation *automation, uint8_t *buf,
+                           size_t len) {
+    size_t consumed = 0;
+    for (;;) {
+        char *line = (char *) &buf[consumed];
+        char *eol = memchr(line, '\n', len - consumed);
+        if (!eol) {
+            // No complete line
+            return consumed;
+        }
+
+        consumed += eol - line + 1;
+
+        *eol = '\0';
+        if (eol != line && eol[-1] == '\r') {
+            eol[-1] = '\0';
+        }
+
+        if (!*line) {
+            // Ignore empty lines
+            continue;
+        }
+
+        struct sc_automation_request req;
+        if (!sc_automation_request_parse_json(line, &req)) {
+            return -1;
+        }
+
+        if (!sc_automation_handle_request(automation, &req)) {
+            return -1;
+        }
+    }
+}
+
+static void
+sc_automation_process_client(struct sc_automation *automation,
+                             sc_socket socket) {
+    uint8_t *buf = malloc(SC_AUTOMATION_RECV_BUFFER_SIZE);
+    if (!buf) {
+        LOG_OOM();
+        return;
+    }
+
+    size_t head = 0;
+    bool first = true;
+    bool json = false;
+    for (;;) {
+        assert(head < SC_AUTOMATION_RECV_BUFFER_SIZE);
+        ssize_t r = net_recv(socket, &buf[head],
+                             SC_AUTOMATION_RECV_BUFFER_SIZE - head);
+        if (r <= 0) {
+            // Disconnected
+            break;
+        }
+
+        if (first) {
+            // The protocol is selected by the first byte
+            first = false;
+            json = buf[0] == '{';
+            sc_mutex_lock(&automation->mutex);
+            automation->json = json;
+            sc_mutex_unlock(&automation->mutex);
+        }
+
+        head += r;
+
+        ssize_t consumed = json
+                ? sc_automation_process_json(automation, buf, head)
+                : sc_automation_process_binary(automation, buf, head);
+        if (consumed == -1) {
+            LOGW("Automation: invalid request, disconnecting client");
+            break;
+        }
+
+        head -= consumed;
+        if (head) {
+            if (head == SC_AUTOMATION_RECV_BUFFER_SIZE) {
+                LOGW("Automation: request too large, disconnecting client");
+                break;
+            }
+            memmove(buf, &buf[consumed], head);
+        }
+    }
+
+    free(buf);
+}
+
+static int
+run_automation_writer(void *data) {
+    struct sc_automation *automation = data;
+
+    uint8_t buf[SC_AUTOMATION_SEND_BATCH_SIZE * SC_AUTOMATION_EVENT_MAX_SIZE];
+
+    sc_mutex_lock(&automation->mutex);
+    sc_socket socket = automation->client_socket;
+    sc_mutex_unlock(&automation->mutex);
+
+    for (;;) {
+        sc_mutex_lock(&automation->mutex);
+        while (!automation->stopped && !automation->client_closed
+                && sc_vecdeque_is_empty(&automation->events)) {
+            sc_cond_wait(&automation->event_cond, &automation->mutex);
+        }
+
+        if (automation->stopped || automation->client_closed) {
+            sc_mutex_unlock(&automation->mutex);
+            break;
+        }
+
+        // Send all the pending events at once (up to the batch size)
+        size_t len = 0;
+        unsigned count = 0;
+        bool json = automation->json;
+        while (!sc_vecdeque_is_empty(&automation->events)
+                && count < SC_AUTOMATION_SEND_BATCH_SIZE) {
+            struct sc_automation_event event =
+                sc_vecdeque_pop(&automation->events);
+            len += json
+                ? sc_automation_event_serialize_json(&event,
+                                                     (char *) &buf[len])
+                : sc_automation_event_serialize_binary(&event, &buf[len]);
+            ++count;
+        }
+        sc_cond_broadcast(&automation->space_cond);
+        sc_mutex_unlock(&automation->mutex);
+
+        ssize_t w = net_send_all(socket, buf, len);
+        if (w < 0 || (size_t) w != len) {
+            break;
+        }
+    }
+
+    sc_mutex_lock(&automation->mutex);
+    // Wake up the automation thread if it waits for space
+    automation->client_closed = true;
+    sc_cond_broadcast(&automation->space_cond);
+    sc_mutex_unlock(&automation->mutex);
+
+    // Interrupt the automation thread if it waits for requests
+    net_interrupt(socket);
+
+    return 0;
+}
+
+static int
+run_automation(void *data) {
+    struct sc_automation *automation = data;
+
+    for (;;) {
+        sc_socket socket = net_accept(automation->server_socket);
+        if (socket == SC_SOCKET_NONE) {
+            sc_mutex_lock(&automation->mutex);
+            bool stopped = automation->stopped;
+            sc_mutex_unlock(&automation->mutex);
+            if (!stopped) {
+                LOGE("Automation: could not accept client");
+            }
+            break;
+        }
+
+        sc_mutex_lock(&automation->mutex);
+        if (automation->stopped) {
+            sc_mutex_unlock(&automation->mutex);
+            net_close(socket);
+            break;
+        }
+        assert(sc_vecdeque_is_empty(&automation->events));
+        automation->client_socket = socket;
+        automation->client_closed = false;
+        automation->json = false;
+        automation->subscribed = false;
+        sc_mutex_unlock(&automation->mutex);
+
+        LOGI("Automation client connected");
+
+        bool ok = sc_thread_create(&automation->writer_thread,
+                                   run_automation_writer, "scrcpy-autow",
+                                   automation);
+        if (ok) {
+            sc_automation_process_client(automation, socket);
+        } else {
+            LOGE("Could not start automation writer thread");
+        }
+
+        sc_mutex_lock(&automation->mutex);
+        automation->client_closed = true;
+        sc_cond_signal(&automation->event_cond);
+        sc_mutex_unlock(&automation->mutex);
+
+        if (ok) {
+            // Interrupt the writer if it is blocked on send()
+            net_interrupt(socket);
+            sc_thread_join(&automation->writer_thread, NULL);
+        }
+
+        sc_mutex_lock(&automation->mutex);
+        automation->client_socket = SC_SOCKET_NONE;
+        automation->subscribed = false;
+        // Discard the pending events (without releasing the capacity)
+        while (!sc_vecdeque_is_empty(&automation->events)) {
+            (void) sc_vecdeque_pop(&automation->events);
+        }
+        sc_mutex_unlock(&automation->mutex);
+
+        net_close(socket);
+
+        LOGI("Automation client disconnected");
+    }
+
+    return 0;
+}
+
+bool
+sc_automation_start(struct sc_automation *automation) {
+    LOGD("Starting automation thread");
+
+    bool ok = sc_thread_create(&automation->thread, run_automation,
+                               "scrcpy-auto", automation);
+    if (!ok) {
+        LOGE("Could not start automation thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_automation_stop(struct sc_automation *automation) {
+    sc_mutex_lock(&automation->mutex);
+    automation->stopped = true;
+    sc_cond_broadcast(&automation->event_cond);
+    sc_cond_broadcast(&automation->space_cond);
+    if (automation->client_socket != SC_SOCKET_NONE) {
+        net_interrupt(automation->client_socket);
+    }
+    sc_mutex_unlock(&automation->mutex);
+
+    net_interrupt(automation->server_socket);
+}
+
+void
+sc_automation_join(struct sc_automation *automation) {
+    sc_thread_join(&automation->thread, NULL);
+}
+
+void
+sc_automation_destroy(struct sc_automation *automation) {
+    net_close(automation->server_socket);
+    if (unlink(automation->path)) {
+        LOGW("Could not remove automation socket: %s (%s)", automation->path,
+             strerror(errno));
+    }
+
+    LOGD("Automation: %" PRIu64 " input events injected",
+         automation->injected_events);
+
+    for (size_t i = 0; i < automation->uhid_data.size; ++i) {
+        free(automation->uhid_data.data[i]);
+    }
+    sc_vector_destroy(&automation->uhid_data);
+
+    sc_cond_destroy(&automation->space_cond);
+    sc_cond_destroy(&automation->event_cond);
+    sc_mutex_destroy(&automation->mutex);
+    sc_vecdeque_destroy(&automation->events);
+}
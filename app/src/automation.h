@@ -0,0 +1,102 @@
+#ifndef SC_AUTOMATION_H
+#define SC_AUTOMATION_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "automation_msg.h"
+#include "controller.h"
+#include "coords.h"
+#include "stats.h"
+#include "trait/frame_sink.h"
+#include "util/net.h"
+#include "util/thread.h"
+#include "util/vecdeque.h"
+#include "util/vector.h"
+
+// forward declarations
+struct sc_screen;
+
+struct sc_automation_event_queue SC_VECDEQUE(struct sc_automation_event);
+struct sc_automation_uhid_data SC_VECTOR(void *);
+
+/**
+ * Local automation socket (--automation-socket)
+ *
+ * A Unix socket accepting one client at a time, to inject input events and
+ * query the stream state (see automation_msg.h for the protocol).
+ *
+ * The requests are processed in order on the automation thread. The input
+ * events are pushed to the controller without ever being dropped: if the
+ * controller queue is full, the automation thread waits, so the client is
+ * slowed down by the socket flow control.
+ *
+ * The events (replies and frame notifications) are sent to the client by a
+ * separate writer thread, so that a slow client never blocks the decoder: if
+ * the client does not read them fast enough, the frame notifications are
+ * dropped (and counted).
+ *
+ * It is a frame sink of the video decoder, to notify the decoded frames.
+ */
+struct sc_automation {
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    const char *path;
+    sc_socket server_socket;
+    struct sc_controller *controller; // NULL if control is disabled
+    struct sc_screen *screen; // NULL if there is no video playback
+    struct sc_stats *stats;
+
+    sc_thread thread; // accept the clients and process their requests
+    sc_thread writer_thread; // send the events to the current client
+
+    sc_mutex mutex;
+    sc_cond event_cond; // signaled when an event is queued
+    sc_cond space_cond; // signaled when an event is removed from the queue
+    bool stopped;
+
+    // The current client, or SC_SOCKET_NONE
+    sc_socket client_socket;
+    // The current client is disconnected (the writer must terminate)
+    bool client_closed;
+    bool json;
+    bool subscribed;
+    struct sc_automation_event_queue events;
+
+    // Size of the last decoded frame
+    struct sc_size video_size;
+    uint64_t dropped_frame_events;
+
+    // Only accessed from the automation thread
+    uint64_t injected_events;
+    // The UHID_CREATE messages only reference their name and report
+    // descriptor, which must remain valid until the controller has sent them
+    struct sc_automation_uhid_data uhid_data;
+};
+
+// The path must outlive the automation instance
+//
+// The screen is only accessed from the main thread, it need not be initialized
+// yet.
+bool
+sc_automation_init(struct sc_automation *automation, const char *path,
+                   struct sc_controller *controller, struct sc_screen *screen,
+                   struct sc_stats *stats);
+
+bool
+sc_automation_start(struct sc_automation *automation);
+
+void
+sc_automation_stop(struct sc_automation *automation);
+
+void
+sc_automation_join(struct sc_automation *automation);
+
+// Must be called after the controller is joined (the pending UHID_CREATE
+// messages reference data owned by the automation instance)
+void
+sc_automation_destroy(struct sc_automation *automation);
+
+#endif
@@ -0,0 +1,1008 @@
+#include "automation_msg.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/binary.h"
+#include "util/log.h"
+
+#define SC_JSON_MAX_FIELDS 16
+
+// Max length of the UHID device name (as serialized by the control message)
+#define SC_AUTOMATION_UHID_NAME_MAX_LENGTH 127
+
+static const char *const key_action_names[] = {
+    "down",
+    "up",
+};
+
+static const char *const touch_action_names[] = {
+    "down",
+    "up",
+    "move",
+    "cancel",
+};
+
+static void
+init_control(struct sc_automation_request *req, enum sc_control_msg_type type) {
+    req->type = SC_AUTOMATION_REQUEST_TYPE_CONTROL;
+    req->control.msg.type = type;
+    req->control.uhid_data = NULL;
+}
+
+static bool
+init_uhid_create(struct sc_automation_request *req, uint16_t id,
+                 uint16_t vendor_id, uint16_t product_id, const char *name,
+                 size_t name_len, const uint8_t *report_desc,
+                 size_t report_desc_size) {
+    assert(name_len <= SC_AUTOMATION_UHID_NAME_MAX_LENGTH);
+    assert(report_desc_size <= UINT16_MAX);
+
+    // The name (null-terminated), then the report descriptor
+    char *data = malloc(name_len + 1 + report_desc_size);
+    if (!data) {
+        LOG_OOM();
+        return false;
+    }
+
+    memcpy(data, name, name_len);
+    data[name_len] = '\0';
+    uint8_t *desc = (uint8_t *) &data[name_len + 1];
+    if (report_desc_size) {
+        memcpy(desc, report_desc, report_desc_size);
+    }
+
+    init_control(req, SC_CONTROL_MSG_TYPE_UHID_CREATE);
+    req->control.uhid_data = data;
+    req->control.msg.uhid_create.id = id;
+    req->control.msg.uhid_create.vendor_id = vendor_id;
+    req->control.msg.uhid_create.product_id = product_id;
+    req->control.msg.uhid_create.name = data;
+    req->control.msg.uhid_create.report_desc_size = report_desc_size;
+    req->control.msg.uhid_create.report_desc = desc;
+    return true;
+}
+
+static void
+read_position(const uint8_t *buf, struct sc_position *position) {
+    position->point.x = (int32_t) sc_read32be(&buf[0]);
+    position->point.y = (int32_t) sc_read32be(&buf[4]);
+    position->screen_size.width = sc_read16be(&buf[8]);
+    position->screen_size.height = sc_read16be(&buf[10]);
+}
+
+// Inverse of sc_float_to_u16fp() (0xffff is the serialization of 1.0f)
+static float
+read_u16fp(const uint8_t *buf) {
+    uint16_t value = sc_read16be(buf);
+    return value == 0xffff ? 1.0f : value / 0x1p16f;
+}
+
+// Inverse of sc_float_to_i16fp() (0x7fff is the serialization of 1.0f)
+static float
+read_i16fp(const uint8_t *buf) {
+    int16_t value = (int16_t) sc_read16be(buf);
+    return value == 0x7fff ? 1.0f : value / 0x1p15f;
+}
+
+ssize_t
+sc_automation_request_parse_binary(const uint8_t *buf, size_t len,
+                                   struct sc_automation_request *req) {
+    if (!len) {
+        return 0; // no request
+    }
+
+    uint8_t type = buf[0];
+    switch (type) {
+        case SC_AUTOMATION_MSG_TYPE_PING:
+            if (len < 5) {
+                return 0; // no complete request
+            }
+            req->type = SC_AUTOMATION_REQUEST_TYPE_PING;
+            req->ping.token = sc_read32be(&buf[1]);
+            return 5;
+        case SC_AUTOMATION_MSG_TYPE_GET_STATE:
+            req->type = SC_AUTOMATION_REQUEST_TYPE_GET_STATE;
+            return 1;
+        case SC_AUTOMATION_MSG_TYPE_SUBSCRIBE_FRAMES:
+            if (len < 2) {
+                return 0; // no complete request
+            }
+            req->type = SC_AUTOMATION_REQUEST_TYPE_SUBSCRIBE_FRAMES;
+            req->subscribe_frames.enable = buf[1];
+            return 2;
+        case SC_AUTOMATION_MSG_TYPE_SCREENSHOT:
+            req->type = SC_AUTOMATION_REQUEST_TYPE_SCREENSHOT;
+            return 1;
+        case SC_CONTROL_MSG_TYPE_INJECT_KEYCODE:
+            if (len < 14) {
+                return 0; // no complete request
+            }
+            if (buf[1] > AKEY_EVENT_ACTION_UP) {
+                LOGW("Invalid key action: %u", (unsigned) buf[1]);
+                return -1;
+            }
+            init_control(req, SC_CONTROL_MSG_TYPE_INJECT_KEYCODE);
+            req->control.msg.inject_keycode.action = buf[1];
+            req->control.msg.inject_keycode.keycode = sc_read32be(&buf[2]);
+            req->control.msg.inject_keycode.repeat = sc_read32be(&buf[6]);
+            req->control.msg.inject_keycode.metastate = sc_read32be(&buf[10]);
+            return 14;
+        case SC_CONTROL_MSG_TYPE_INJECT_TEXT: {
+            if (len < 5) {
+                return 0; // no complete request
+            }
+            size_t text_len = sc_read32be(&buf[1]);
+            if (text_len > SC_CONTROL_MSG_INJECT_TEXT_MAX_LENGTH) {
+                LOGW("Text too long: %" SC_PRIsizet, text_len);
+                return -1;
+            }
+            if (text_len > len - 5) {
+                return 0; // no complete request
+            }
+            char *text = malloc(text_len + 1);
+            if (!text) {
+                LOG_OOM();
+                return -1;
+            }
+            memcpy(text, &buf[5], text_len);
+            text[text_len] = '\0';
+
+            init_control(req, SC_CONTROL_MSG_TYPE_INJECT_TEXT);
+            req->control.msg.inject_text.text = text;
+            return 5 + text_len;
+        }
+        case SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT:
+            if (len < 32) {
+                return 0; // no complete request
+            }
+            if (buf[1] > AMOTION_EVENT_ACTION_BUTTON_RELEASE) {
+                LOGW("Invalid touch action: %u", (unsigned) buf[1]);
+                return -1;
+            }
+            init_control(req, SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT);
+            req->control.msg.inject_touch_event.action = buf[1];
+            req->control.msg.inject_touch_event.pointer_id =
+                sc_read64be(&buf[2]);
+            read_position(&buf[10],
+                          &req->control.msg.inject_touch_event.position);
+            req->control.msg.inject_touch_event.pressure =
+                read_u16fp(&buf[22]);
+            req->control.msg.inject_touch_event.action_button =
+                sc_read32be(&buf[24]);
+            req->control.msg.inject_touch_event.buttons =
+                sc_read32be(&buf[28]);
+            return 32;
+        case SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT: {
+            if (len < 21) {
+                return 0; // no complete request
+            }
+            init_control(req, SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT);
+            read_position(&buf[1],
+                          &req->control.msg.inject_scroll_event.position);
+            // The values are normalized to [-1, 1] on the wire (the control
+            // message accepts values in [-16, 16])
+            req->control.msg.inject_scroll_event.hscroll =
+                read_i16fp(&buf[13]) * 16;
+            req->control.msg.inject_scroll_event.vscroll =
+                read_i16fp(&buf[15]) * 16;
+            req->control.msg.inject_scroll_event.buttons =
+                sc_read32be(&buf[17]);
+            return 21;
+        }
+        case SC_CONTROL_MSG_TYPE_UHID_CREATE: {
+            if (len < 8) {
+                // at least id + vendor_id + product_id + name length
+                return 0; // no complete request
+            }
+            size_t name_len = buf[7];
+            if (name_len > SC_AUTOMATION_UHID_NAME_MAX_LENGTH) {
+                LOGW("UHID name too long: %" SC_PRIsizet, name_len);
+                return -1;
+            }
+            if (len < 10 + name_len) {
+                return 0; // no complete request
+            }
+            size_t desc_size = sc_read16be(&buf[8 + name_len]);
+            size_t size = 10 + name_len + desc_size;
+            if (len < size) {
+                return 0; // no complete request
+            }
+            bool ok = init_uhid_create(req, sc_read16be(&buf[1]),
+                                       sc_read16be(&buf[3]),
+                                       sc_read16be(&buf[5]),
+                                       (const char *) &buf[8], name_len,
+                                       &buf[10 + name_len], desc_size);
+            if (!ok) {
+                return -1;
+            }
+            return size;
+        }
+        case SC_CONTROL_MSG_TYPE_UHID_INPUT: {
+            if (len < 5) {
+                // at least id + size
+                return 0; // no complete request
+            }
+            size_t size = sc_read16be(&buf[3]);
+            if (size > SC_HID_MAX_SIZE) {
+                LOGW("UHID input too large: %" SC_PRIsizet, size);
+                return -1;
+            }
+            if (len < 5 + size) {
+                return 0; // no complete request
+            }
+            init_control(req, SC_CONTROL_MSG_TYPE_UHID_INPUT);
+            req->control.msg.uhid_input.id = sc_read16be(&buf[1]);
+            req->control.msg.uhid_input.size = size;
+            memcpy(req->control.msg.uhid_input.data, &buf[5], size);
+            return 5 + size;
+        }
+        case SC_CONTROL_MSG_TYPE_UHID_DESTROY:
+            if (len < 3) {
+                return 0; // no complete request
+            }
+            init_control(req, SC_CONTROL_MSG_TYPE_UHID_DESTROY);
+            req->control.msg.uhid_destroy.id = sc_read16be(&buf[1]);
+            return 3;
+        default:
+            LOGW("Unknown automation request type: %u", (unsigned) type);
+            return -1; // error, we cannot recover
+    }
+}
+
+enum sc_json_type {
+    SC_JSON_TYPE_STRING,
+    SC_JSON_TYPE_NUMBER,
+    SC_JSON_TYPE_BOOL,
+    SC_JSON_TYPE_NULL,
+};
+
+struct sc_json_field {
+    const char *key;
+    enum sc_json_type type;
+    union {
+        char *str; // decoded in place, null-terminated
+        double number;
+        bool boolean;
+    };
+};
+
+// A flat JSON object (the values may not be objects or arrays)
+struct sc_json_object {
+    struct sc_json_field fields[SC_JSON_MAX_FIELDS];
+    unsigned count;
+};
+
+static char *
+json_skip_ws(char *s) {
+    while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n') {
+        ++s;
+    }
+    return s;
+}
+
+static int
+json_hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool
+json_parse_hex4(const char *s, uint32_t *value) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+        int d = json_hex_digit(s[i]);
+        if (d < 0) {
+            return false;
+        }
+        v = (v << 4) | d;
+    }
+    *value = v;
+    return true;
+}
+
+static size_t
+json_write_utf8(char *w, uint32_t cp) {
+    if (cp < 0x80) {
+        w[0] = cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        w[0] = 0xC0 | (cp >> 6);
+        w[1] = 0x80 | (cp & 0x3F);
+        return 2;
+    }
+    if (cp < 0x10000) {
+        w[0] = 0xE0 | (cp >> 12);
+        w[1] = 0x80 | ((cp >> 6) & 0x3F);
+        w[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+    w[0] = 0xF0 | (cp >> 18);
+    w[1] = 0x80 | ((cp >> 12) & 0x3F);
+    w[2] = 0x80 | ((cp >> 6) & 0x3F);
+    w[3] = 0x80 | (cp & 0x3F);
+    return 4;
+}
+
+// Parse the string starting at s (on the opening quote), and decode it in
+// place (the decoded string is never longer than the encoded one)
+//
+// Return the position after the closing quote, or NULL on error.
+static char *
+json_parse_string(char *s, char **out) {
+    assert(*s == '"');
+    char *r = s + 1;
+    char *w = s + 1;
+    char *start = w;
+
+    for (;;) {
+        char c = *r++;
+        if (c == '"') {
+            break;
+        }
+        if (!c || (unsigned char) c < 0x20) {
+            return NULL;
+        }
+        if (c != '\\') {
+            *w++ = c;
+            continue;
+        }
+
+        c = *r++;
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                *w++ = c;
+                break;
+            case 'b':
+                *w++ = '\b';
+                break;
+            case 'f':
+                *w++ = '\f';
+                break;
+            case 'n':
+                *w++ = '\n';
+                break;
+            case 'r':
+                *w++ = '\r';
+                break;
+            case 't':
+                *w++ = '\t';
+                break;
+            case 'u': {
+                uint32_t cp;
+                if (!json_parse_hex4(r, &cp)) {
+                    return NULL;
+                }
+                r += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    // High surrogate, must be followed by a low surrogate
+                    uint32_t low;
+                    if (r[0] != '\\' || r[1] != 'u'
+                            || !json_parse_hex4(&r[2], &low)
+                            || low < 0xDC00 || low > 0xDFFF) {
+                        return NULL;
+                    }
+                    r += 6;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    return NULL;
+                }
+                w += json_write_utf8(w, cp);
+                break;
+            }
+            default:
+                return NULL;
+        }
+    }
+
+    *w = '\0';
+    *out = start;
+    return r;
+}
+
+static char *
+json_parse_value(char *s, struct sc_json_field *field) {
+    if (*s == '"') {
+        field->type = SC_JSON_TYPE_STRING;
+        return json_parse_string(s, &field->str);
+    }
+    if (!strncmp(s, "true", 4)) {
+        field->type = SC_JSON_TYPE_BOOL;
+        field->boolean = true;
+        return s + 4;
+    }
+    if (!strncmp(s, "false", 5)) {
+        field->type = SC_JSON_TYPE_BOOL;
+        field->boolean = false;
+        return s + 5;
+    }
+    if (!strncmp(s, "null", 4)) {
+        field->type = SC_JSON_TYPE_NULL;
+        return s + 4;
+    }
+    if (*s == '-' || (*s >= '0' && *s <= '9')) {
+        char *end;
+        double number = strtod(s, &end);
+        // Reject inf and nan
+        if (end == s || !(number >= -1e300 && number <= 1e300)) {
+            return NULL;
+        }
+        field->type = SC_JSON_TYPE_NUMBER;
+        field->number = number;
+        return end;
+    }
+    // Nested objects and arrays are not supported
+    return NULL;
+}
+
+static bool
+json_parse_object(char *s, struct sc_json_object *obj) {
+    obj->count = 0;
+
+    s = json_skip_ws(s);
+    if (*s++ != '{') {
+        return false;
+    }
+
+    s = json_skip_ws(s);
+    if (*s == '}') {
+        ++s;
+    } else {
+        for (;;) {
+            if (obj->count == SC_JSON_MAX_FIELDS) {
+                return false;
+            }
+            struct sc_json_field *field = &obj->fields[obj->count++];
+
+            s = json_skip_ws(s);
+            if (*s != '"') {
+                return false;
+            }
+            char *key;
+            s = json_parse_string(s, &key);
+            if (!s) {
+                return false;
+            }
+            field->key = key;
+
+            s = json_skip_ws(s);
+            if (*s++ != ':') {
+                return false;
+            }
+
+            s = json_parse_value(json_skip_ws(s), field);
+            if (!s) {
+                return false;
+            }
+
+            s = json_skip_ws(s);
+            if (*s == ',') {
+                ++s;
+                continue;
+            }
+            if (*s == '}') {
+                ++s;
+                break;
+            }
+            return false;
+        }
+    }
+
+    s = json_skip_ws(s);
+    return !*s;
+}
+
+static const struct sc_json_field *
+json_get(const struct sc_json_object *obj, const char *key) {
+    for (unsigned i = 0; i < obj->count; ++i) {
+        if (!strcmp(obj->fields[i].key, key)) {
+            return &obj->fields[i];
+        }
+    }
+    return NULL;
+}
+
+// Return false (and log) if the field is absent but required, or if it does
+// not have the expected type; *out is set to NULL if the field is absent
+static bool
+json_get_typed(const struct sc_json_object *obj, const char *key,
+               enum sc_json_type type, bool required,
+               const struct sc_json_field **out) {
+    const struct sc_json_field *field = json_get(obj, key);
+    if (!field) {
+        if (required) {
+            LOGW("Missing field \"%s\"", key);
+            return false;
+        }
+        *out = NULL;
+        return true;
+    }
+
+    if (field->type != type) {
+        LOGW("Invalid type for field \"%s\"", key);
+        return false;
+    }
+
+    *out = field;
+    return true;
+}
+
+// If the field is absent and not required, *value is left unchanged (it
+// contains the default value)
+static bool
+json_get_int(const struct sc_json_object *obj, const char *key, bool required,
+             int64_t min, int64_t max, int64_t *value) {
+    const struct sc_json_field *field;
+    if (!json_get_typed(obj, key, SC_JSON_TYPE_NUMBER, required, &field)) {
+        return false;
+    }
+    if (!field) {
+        return true;
+    }
+
+    double number = field->number;
+    if (!(number >= min && number <= max)
+            || (double) (int64_t) number != number) {
+        LOGW("Invalid value for field \"%s\"", key);
+        return false;
+    }
+
+    *value = (int64_t) number;
+    return true;
+}
+
+static bool
+json_get_float(const struct sc_json_object *obj, const char *key,
+               bool required, float min, float max, float *value) {
+    const struct sc_json_field *field;
+    if (!json_get_typed(obj, key, SC_JSON_TYPE_NUMBER, required, &field)) {
+        return false;
+    }
+    if (!field) {
+        return true;
+    }
+
+    double number = field->number;
+    if (!(number >= min && number <= max)) {
+        LOGW("Invalid value for field \"%s\"", key);
+        return false;
+    }
+
+    *value = (float) number;
+    return true;
+}
+
+static bool
+json_get_bool(const struct sc_json_object *obj, const char *key, bool required,
+              bool *value) {
+    const struct sc_json_field *field;
+    if (!json_get_typed(obj, key, SC_JSON_TYPE_BOOL, required, &field)) {
+        return false;
+    }
+    if (field) {
+        *value = field->boolean;
+    }
+    return true;
+}
+
+static bool
+json_get_string(const struct sc_json_object *obj, const char *key,
+                bool required, char **value) {
+    const struct sc_json_field *field;
+    if (!json_get_typed(obj, key, SC_JSON_TYPE_STRING, required, &field)) {
+        return false;
+    }
+    if (field) {
+        *value = field->str;
+    }
+    return true;
+}
+
+// The action is either a name (its index in names) or a number in [0, max]
+static bool
+json_get_action(const struct sc_json_object *obj, const char *const names[],
+                size_t count, int64_t max, int64_t *value) {
+    const struct sc_json_field *field = json_get(obj, "action");
+    if (field && field->type == SC_JSON_TYPE_STRING) {
+        for (size_t i = 0; i < count; ++i) {
+            if (!strcmp(field->str, names[i])) {
+                *value = i;
+                return true;
+            }
+        }
+        LOGW("Invalid action: %s", field->str);
+        return false;
+    }
+
+    return json_get_int(obj, "action", true, 0, max, value);
+}
+
+// Decode a hex string in place, and return the number of bytes (or -1 on
+// error)
+static ssize_t
+json_decode_hex(char *s) {
+    uint8_t *out = (uint8_t *) s;
+    size_t i = 0;
+    while (s[2 * i]) {
+        int hi = json_hex_digit(s[2 * i]);
+        int lo = hi < 0 ? -1 : json_hex_digit(s[2 * i + 1]);
+        if (lo < 0) {
+            return -1;
+        }
+        out[i++] = (hi << 4) | lo;
+    }
+    return i;
+}
+
+static bool
+json_get_hex(const struct sc_json_object *obj, const char *key,
+             size_t max_size, uint8_t **data, size_t *size) {
+    char *str;
+    if (!json_get_string(obj, key, true, &str)) {
+        return false;
+    }
+
+    ssize_t r = json_decode_hex(str);
+    if (r < 0 || (size_t) r > max_size) {
+        LOGW("Invalid hex data for field \"%s\"", key);
+        return false;
+    }
+
+    *data = (uint8_t *) str;
+    *size = r;
+    return true;
+}
+
+static bool
+json_get_position(const struct sc_json_object *obj,
+                  struct sc_position *position) {
+    int64_t x, y, width, height;
+    if (!json_get_int(obj, "x", true, INT32_MIN, INT32_MAX, &x)
+            || !json_get_int(obj, "y", true, INT32_MIN, INT32_MAX, &y)
+            || !json_get_int(obj, "width", true, 0, UINT16_MAX, &width)
+            || !json_get_int(obj, "height", true, 0, UINT16_MAX, &height)) {
+        return false;
+    }
+
+    position->point.x = x;
+    position->point.y = y;
+    position->screen_size.width = width;
+    position->screen_size.height = height;
+    return true;
+}
+
+static bool
+parse_json_key(const struct sc_json_object *obj,
+               struct sc_automation_request *req) {
+    int64_t action;
+    int64_t keycode;
+    int64_t repeat = 0;
+    int64_t metastate = 0;
+    if (!json_get_action(obj, key_action_names, ARRAY_LEN(key_action_names),
+                         AKEY_EVENT_ACTION_UP, &action)
+            || !json_get_int(obj, "keycode", true, 0, INT32_MAX, &keycode)
+            || !json_get_int(obj, "repeat", false, 0, UINT32_MAX, &repeat)
+            || !json_get_int(obj, "metastate", false, 0, UINT32_MAX,
+                             &metastate)) {
+        return false;
+    }
+
+    init_control(req, SC_CONTROL_MSG_TYPE_INJECT_KEYCODE);
+    req->control.msg.inject_keycode.action = action;
+    req->control.msg.inject_keycode.keycode = keycode;
+    req->control.msg.inject_keycode.repeat = repeat;
+    req->control.msg.inject_keycode.metastate = metastate;
+    return true;
+}
+
+static bool
+parse_json_text(const struct sc_json_object *obj,
+                struct sc_automation_request *req) {
+    char *text;
+    if (!json_get_string(obj, "text", true, &text)) {
+        return false;
+    }
+
+    if (strlen(text) > SC_CONTROL_MSG_INJECT_TEXT_MAX_LENGTH) {
+        LOGW("Text too long");
+        return false;
+    }
+
+    char *dup = strdup(text);
+    if (!dup) {
+        LOG_OOM();
+        return false;
+    }
+
+    init_control(req, SC_CONTROL_MSG_TYPE_INJECT_TEXT);
+    req->control.msg.inject_text.text = dup;
+    return true;
+}
+
+static bool
+parse_json_touch(const struct sc_json_object *obj,
+                 struct sc_automation_request *req) {
+    int64_t action;
+    int64_t pointer_id = 0;
+    int64_t action_button = 0;
+    int64_t buttons = 0;
+    struct sc_position position;
+    if (!json_get_action(obj, touch_action_names,
+                         ARRAY_LEN(touch_action_names),
+                         AMOTION_EVENT_ACTION_BUTTON_RELEASE, &action)
+            // Negative values for the well-known pointer ids
+            // (SC_POINTER_ID_MOUSE, etc.)
+            || !json_get_int(obj, "pointer_id", false, -3, INT32_MAX,
+                             &pointer_id)
+            || !json_get_position(obj, &position)
+            || !json_get_int(obj, "action_button", false, 0, UINT32_MAX,
+                             &action_button)
+            || !json_get_int(obj, "buttons", false, 0, UINT32_MAX,
+                             &buttons)) {
+        return false;
+    }
+
+    float pressure = action == AMOTION_EVENT_ACTION_UP ? 0.0f : 1.0f;
+    if (!json_get_float(obj, "pressure", false, 0.0f, 1.0f, &pressure)) {
+        return false;
+    }
+
+    init_control(req, SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT);
+    req->control.msg.inject_touch_event.action = action;
+    req->control.msg.inject_touch_event.pointer_id = (uint64_t) pointer_id;
+    req->control.msg.inject_touch_event.position = position;
+    req->control.msg.inject_touch_event.pressure = pressure;
+    req->control.msg.inject_touch_event.action_button = action_button;
+    req->control.msg.inject_touch_event.buttons = buttons;
+    return true;
+}
+
+static bool
+parse_json_scroll(const struct sc_json_object *obj,
+                  struct sc_automation_request *req) {
+    struct sc_position position;
+    float hscroll = 0;
+    float vscroll = 0;
+    int64_t buttons = 0;
+    if (!json_get_position(obj, &position)
+            || !json_get_float(obj, "hscroll", false, -16, 16, &hscroll)
+            || !json_get_float(obj, "vscroll", false, -16, 16, &vscroll)
+            || !json_get_int(obj, "buttons", false, 0, UINT32_MAX,
+                             &buttons)) {
+        return false;
+    }
+
+    init_control(req, SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT);
+    req->control.msg.inject_scroll_event.position = position;
+    req->control.msg.inject_scroll_event.hscroll = hscroll;
+    req->control.msg.inject_scroll_event.vscroll = vscroll;
+    req->control.msg.inject_scroll_event.buttons = buttons;
+    return true;
+}
+
+static bool
+parse_json_uhid_create(const struct sc_json_object *obj,
+                       struct sc_automation_request *req) {
+    int64_t id;
+    int64_t vendor_id = 0;
+    int64_t product_id = 0;
+    char *name = NULL;
+    uint8_t *report_desc;
+    size_t report_desc_size;
+    if (!json_get_int(obj, "id", true, 0, UINT16_MAX, &id)
+            || !json_get_int(obj, "vendor_id", false, 0, UINT16_MAX,
+                             &vendor_id)
+            || !json_get_int(obj, "product_id", false, 0, UINT16_MAX,
+                             &product_id)
+            || !json_get_string(obj, "name", false, &name)
+            || !json_get_hex(obj, "report_desc", UINT16_MAX, &report_desc,
+                             &report_desc_size)) {
+        return false;
+    }
+
+    size_t name_len = name ? strlen(name) : 0;
+    if (name_len > SC_AUTOMATION_UHID_NAME_MAX_LENGTH) {
+        LOGW("UHID name too long");
+        return false;
+    }
+
+    return init_uhid_create(req, id, vendor_id, product_id, name ? name : "",
+                            name_len, report_desc, report_desc_size);
+}
+
+static bool
+parse_json_uhid_input(const struct sc_json_object *obj,
+                      struct sc_automation_request *req) {
+    int64_t id;
+    uint8_t *data;
+    size_t size;
+    if (!json_get_int(obj, "id", true, 0, UINT16_MAX, &id)
+            || !json_get_hex(obj, "data", SC_HID_MAX_SIZE, &data, &size)) {
+        return false;
+    }
+
+    init_control(req, SC_CONTROL_MSG_TYPE_UHID_INPUT);
+    req->control.msg.uhid_input.id = id;
+    req->control.msg.uhid_input.size = size;
+    memcpy(req->control.msg.uhid_input.data, data, size);
+    return true;
+}
+
+static bool
+parse_json_uhid_destroy(const struct sc_json_object *obj,
+                        struct sc_automation_request *req) {
+    int64_t id;
+    if (!json_get_int(obj, "id", true, 0, UINT16_MAX, &id)) {
+        return false;
+    }
+
+    init_control(req, SC_CONTROL_MSG_TYPE_UHID_DESTROY);
+    req->control.msg.uhid_destroy.id = id;
+    return true;
+}
+
+bool
+sc_automation_request_parse_json(char *line,
+                                 struct sc_automation_request *req) {
+    struct sc_json_object obj;
+    if (!json_parse_object(line, &obj)) {
+        LOGW("Invalid JSON automation request");
+        return false;
+    }
+
+    char *type;
+    if (!json_get_string(&obj, "type", true, &type)) {
+        return false;
+    }
+
+    if (!strcmp(type, "key")) {
+        return parse_json_key(&obj, req);
+    }
+    if (!strcmp(type, "text")) {
+        return parse_json_text(&obj, req);
+    }
+    if (!strcmp(type, "touch")) {
+        return parse_json_touch(&obj, req);
+    }
+    if (!strcmp(type, "scroll")) {
+        return parse_json_scroll(&obj, req);
+    }
+    if (!strcmp(type, "uhid_create")) {
+        return parse_json_uhid_create(&obj, req);
+    }
+    if (!strcmp(type, "uhid_input")) {
+        return parse_json_uhid_input(&obj, req);
+    }
+    if (!strcmp(type, "uhid_destroy")) {
+        return parse_json_uhid_destroy(&obj, req);
+    }
+    if (!strcmp(type, "ping")) {
+        int64_t token = 0;
+        if (!json_get_int(&obj, "token", false, 0, UINT32_MAX, &token)) {
+            return false;
+        }
+        req->type = SC_AUTOMATION_REQUEST_TYPE_PING;
+        req->ping.token = token;
+        return true;
+    }
+    if (!strcmp(type, "get_state")) {
+        req->type = SC_AUTOMATION_REQUEST_TYPE_GET_STATE;
+        return true;
+    }
+    if (!strcmp(type, "subscribe_frames")) {
+        bool enable = true;
+        if (!json_get_bool(&obj, "enable", false, &enable)) {
+            return false;
+        }
+        req->type = SC_AUTOMATION_REQUEST_TYPE_SUBSCRIBE_FRAMES;
+        req->subscribe_frames.enable = enable;
+        return true;
+    }
+    if (!strcmp(type, "screenshot")) {
+        req->type = SC_AUTOMATION_REQUEST_TYPE_SCREENSHOT;
+        return true;
+    }
+
+    LOGW("Unknown automation request type: %s", type);
+    return false;
+}
+
+void
+sc_automation_request_destroy(struct sc_automation_request *req) {
+    if (req->type == SC_AUTOMATION_REQUEST_TYPE_CONTROL) {
+        sc_control_msg_destroy(&req->control.msg);
+        free(req->control.uhid_data);
+    }
+}
+
+size_t
+sc_automation_event_serialize_binary(const struct sc_automation_event *event,
+                                     uint8_t *buf) {
+    switch (event->type) {
+        case SC_AUTOMATION_EVENT_TYPE_PONG:
+            buf[0] = SC_AUTOMATION_MSG_TYPE_PONG;
+            sc_write32be(&buf[1], event->pong.token);
+            return 5;
+        case SC_AUTOMATION_EVENT_TYPE_STATE: {
+            const struct sc_automation_state *state = &event->state;
+            buf[0] = SC_AUTOMATION_MSG_TYPE_STATE;
+            sc_write16be(&buf[1], state->video_size.width);
+            sc_write16be(&buf[3], state->video_size.height);
+            sc_write64be(&buf[5], state->decoded_frames);
+            sc_write64be(&buf[13], state->skipped_frames);
+            sc_write64be(&buf[21], state->presented_frames);
+            sc_write64be(&buf[29], state->video_bytes);
+            sc_write64be(&buf[37], state->reconnections);
+            sc_write64be(&buf[45], state->injected_events);
+            sc_write64be(&buf[53], state->dropped_frame_events);
+            return 61;
+        }
+        case SC_AUTOMATION_EVENT_TYPE_FRAME:
+            buf[0] = SC_AUTOMATION_MSG_TYPE_FRAME;
+            sc_write64be(&buf[1], (uint64_t) event->frame.pts);
+            sc_write16be(&buf[9], event->frame.size.width);
+            sc_write16be(&buf[11], event->frame.size.height);
+            return 13;
+        default:
+            assert(!"unexpected automation event type");
+            return 0;
+    }
+}
+
+size_t
+sc_automation_event_serialize_json(const struct sc_automation_event *event,
+                                   char *buf) {
+    int r;
+    switch (event->type) {
+        case SC_AUTOMATION_EVENT_TYPE_PONG:
+            r = snprintf(buf, SC_AUTOMATION_EVENT_MAX_SIZE,
+                         "{\"type\":\"pong\",\"token\":%" PRIu32 "}\n",
+                         event->pong.token);
+            break;
+        case SC_AUTOMATION_EVENT_TYPE_STATE: {
+            const struct sc_automation_state *state = &event->state;
+            r = snprintf(buf, SC_AUTOMATION_EVENT_MAX_SIZE,
+                         "{\"type\":\"state\",\"width\":%u,\"height\":%u,"
+                         "\"decoded_frames\":%" PRIu64 ","
+                         "\"skipped_frames\":%" PRIu64 ","
+                         "\"presented_frames\":%" PRIu64 ","
+                         "\"video_bytes\":%" PRIu64 ","
+                         "\"reconnections\":%" PRIu64 ","
+                         "\"injected_events\":%" PRIu64 ","
+                         "\"dropped_frame_events\":%" PRIu64 "}\n",
+                         state->video_size.width, state->video_size.height,
+                         state->decoded_frames, state->skipped_frames,
+                         state->presented_frames, state->video_bytes,
+                         state->reconnections, state->injected_events,
+                         state->dropped_frame_events);
+            break;
+        }
+        case SC_AUTOMATION_EVENT_TYPE_FRAME:
+            r = snprintf(buf, SC_AUTOMATION_EVENT_MAX_SIZE,
+                         "{\"type\":\"frame\",\"pts\":%" PRId64 ","
+                         "\"width\":%u,\"height\":%u}\n",
+                         event->frame.pts, event->frame.size.width,
+                         event->frame.size.height);
+            break;
+        default:
+            assert(!"unexpected automation event type");
+            return 0;
+    }
+
+    assert(r > 0 && r < SC_AUTOMATION_EVENT_MAX_SIZE);
+    return r;
+}
@@ -0,0 +1,181 @@
+#ifndef SC_AUTOMATION_MSG_H
+#define SC_AUTOMATION_MSG_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "control_msg.h"
+#include "coords.h"
+
+/**
+ * Automation protocol (see --automation-socket)
+ *
+ * A client sends requests and receives events. The protocol is selected by
+ * the first byte sent by the client:
+ *  - '{': JSON, one object per line (for debugging or scripting);
+ *  - anything else: binary.
+ *
+ * Binary requests start with a type byte. The input injection requests use
+ * the serialization of the corresponding control messages (see
+ * sc_control_msg_serialize()):
+ *  - SC_CONTROL_MSG_TYPE_INJECT_KEYCODE
+ *  - SC_CONTROL_MSG_TYPE_INJECT_TEXT
+ *  - SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT
+ *  - SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT
+ *  - SC_CONTROL_MSG_TYPE_UHID_CREATE
+ *  - SC_CONTROL_MSG_TYPE_UHID_INPUT
+ *  - SC_CONTROL_MSG_TYPE_UHID_DESTROY
+ *
+ * The other requests are specific to the automation protocol:
+ *  - PING: u32 token
+ *  - GET_STATE: no payload
+ *  - SUBSCRIBE_FRAMES: u8 enable
+ *  - SCREENSHOT: no payload
+ *
+ * Binary events start with a type byte:
+ *  - PONG: u32 token
+ *  - STATE: u16 width, u16 height, then u64 decoded_frames, skipped_frames,
+ *    presented_frames, video_bytes, reconnections, injected_events and
+ *    dropped_frame_events
+ *  - FRAME: u64 pts (in microseconds), u16 width, u16 height
+ *
+ * All values are big-endian.
+ *
+ * The JSON requests and events contain a "type" field ("key", "text", "touch",
+ * "scroll", "uhid_create", "uhid_input", "uhid_destroy", "ping", "get_state",
+ * "subscribe_frames" or "screenshot" for requests; "pong", "state" or "frame"
+ * for events), and the fields of the binary format with the same names (see
+ * sc_automation_request_parse_json()).
+ */
+
+#define SC_AUTOMATION_MSG_TYPE_PING 0x80
+#define SC_AUTOMATION_MSG_TYPE_GET_STATE 0x81
+#define SC_AUTOMATION_MSG_TYPE_SUBSCRIBE_FRAMES 0x82
+#define SC_AUTOMATION_MSG_TYPE_SCREENSHOT 0x83
+
+#define SC_AUTOMATION_MSG_TYPE_PONG 0x80
+#define SC_AUTOMATION_MSG_TYPE_STATE 0x81
+#define SC_AUTOMATION_MSG_TYPE_FRAME 0x82
+
+// Large enough for any event, in both formats
+#define SC_AUTOMATION_EVENT_MAX_SIZE 512
+
+enum sc_automation_request_type {
+    // Inject an input event (forward the control message to the device)
+    SC_AUTOMATION_REQUEST_TYPE_CONTROL,
+    // Reply with a PONG once all the previous requests have been processed
+    SC_AUTOMATION_REQUEST_TYPE_PING,
+    SC_AUTOMATION_REQUEST_TYPE_GET_STATE,
+    SC_AUTOMATION_REQUEST_TYPE_SUBSCRIBE_FRAMES,
+    // Take a screenshot of the displayed frame (like the shortcut)
+    SC_AUTOMATION_REQUEST_TYPE_SCREENSHOT,
+};
+
+struct sc_automation_request {
+    enum sc_automation_request_type type;
+    union {
+        struct {
+            struct sc_control_msg msg;
+            // For UHID_CREATE, the name and the report descriptor (the msg
+            // only references them), to be freed by free()
+            void *uhid_data;
+        } control;
+        struct {
+            uint32_t token;
+        } ping;
+        struct {
+            bool enable;
+        } subscribe_frames;
+    };
+};
+
+struct sc_automation_state {
+    struct sc_size video_size; // 0x0 if no frame has been decoded yet
+    uint64_t decoded_frames;
+    uint64_t skipped_frames;
+    uint64_t presented_frames;
+    uint64_t video_bytes;
+    uint64_t reconnections;
+    // Input events forwarded to the controller
+    uint64_t injected_events;
+    // FRAME events not sent because the client did not read them fast enough
+    uint64_t dropped_frame_events;
+};
+
+enum sc_automation_event_type {
+    SC_AUTOMATION_EVENT_TYPE_PONG,
+    SC_AUTOMATION_EVENT_TYPE_STATE,
+    SC_AUTOMATION_EVENT_TYPE_FRAME,
+};
+
+struct sc_automation_event {
+    enum sc_automation_event_type type;
+    union {
+        struct {
+            uint32_t token;
+        } pong;
+        struct sc_automation_state state;
+        struct {
+            int64_t pts;
+            struct sc_size size;
+        } frame;
+    };
+};
+
+/**
+ * Parse a binary request
+ *
+ * Return the number of bytes consumed, 0 if the buffer does not contain a
+ * complete request yet, or -1 if the request is invalid.
+ */
+ssize_t
+sc_automation_request_parse_binary(const uint8_t *buf, size_t len,
+                                   struct sc_automation_request *req);
+
+/**
+ * Parse a JSON request (a single object, without the line terminator)
+ *
+ * The line is modified in place.
+ *
+ * The fields are:
+ *  - key: action ("down", "up" or a number), keycode, repeat, metastate
+ *  - text: text
+ *  - touch: action ("down", "up", "move", "cancel" or a number), pointer_id,
+ *    x, y, width, height (the current video size), pressure, action_button,
+ *    buttons
+ *  - scroll: x, y, width, height, hscroll, vscroll, buttons
+ *  - uhid_create: id, vendor_id, product_id, name, report_desc (hex string)
+ *  - uhid_input: id, data (hex string)
+ *  - uhid_destroy: id
+ *  - ping: token
+ *  - get_state
+ *  - subscribe_frames: enable (true or false)
+ *  - screenshot
+ *
+ * Return false if the request is invalid.
+ */
+bool
+sc_automation_request_parse_json(char *line,
+                                 struct sc_automation_request *req);
+
+void
+sc_automation_request_destroy(struct sc_automation_request *req);
+
+// buf size must be at least SC_AUTOMATION_EVENT_MAX_SIZE
+// return the number of bytes written
+size_t
+sc_automation_event_serialize_binary(const struct sc_automation_event *event,
+                                     uint8_t *buf);
+
+// buf size must be at least SC_AUTOMATION_EVENT_MAX_SIZE
+// return the number of bytes written (a JSON object and a '\n', without any
+// null byte)
+size_t
+sc_automation_event_serialize_json(const struct sc_automation_event *event,
+                                   char *buf);
+
+#endif
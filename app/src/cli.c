@@ -116,6 +116,18 @@ enum {
     OPT_NO_VD_SYSTEM_DECORATIONS,
     OPT_NO_VD_DESTROY_CONTENT,
     OPT_DISPLAY_IME_POLICY,
+    OPT_PERF_COUNTERS,
+    OPT_AUTO_RECONNECT,
+    OPT_RECORD_PROXY,
+    OPT_RECORD_PROXY_SIZE,
+    OPT_RECORD_PROXY_BIT_RATE,
+    OPT_SCREENSHOT_DIR,
+    OPT_SCREENSHOT_FORMAT,
+    OPT_MEMORY_BUDGET,
+    OPT_VIDEO_DECODER,
+    OPT_REPLAY,
+    OPT_NO_REPLAY_PACING,
+    OPT_AUTOMATION_SOCKET,
 };
 
 struct sc_option {
@@ -179,6 +191,9 @@ static const struct sc_option options[] = {
         .text = "Configure the audio buffering delay (in milliseconds).\n"
                 "Lower values decrease the latency, but increase the "
                 "likelihood of buffer underrun (causing audio glitches).\n"
+                "If the value is \"auto\" or \"auto:min:max\", the buffering "
+                "delay is adjusted automatically, within bounds (20 to 200 "
+                "by default), from the underflows and the network jitter.\n"
                 "Default is 50.",
     },
     {
@@ -256,6 +271,29 @@ static const struct sc_option options[] = {
                 "a higher value (10). Do not change this setting otherwise.\n"
                 "Default is 5.",
     },
+    {
+        .longopt_id = OPT_AUTO_RECONNECT,
+        .longopt = "auto-reconnect",
+        .text = "On disconnection, keep the window, the audio playback and the "
+                "recording alive, and reconnect to the same device as soon "
+                "as it is available again.\n"
+                "The recording continues in the same file (the interruption "
+                "is recorded as a pause).",
+    },
+    {
+        .longopt_id = OPT_AUTOMATION_SOCKET,
+        .longopt = "automation-socket",
+        .argdesc = "path",
+        .text = "Listen on a local Unix socket for an automation client, to "
+                "inject input events (touches, keys, text and UHID events) "
+                "at high rate, query the stream state and be notified of the "
+                "decoded frames.\n"
+                "The client may use a compact binary protocol, or JSON (one "
+                "object per line) for debugging.\n"
+                "The input events are forwarded in order, and are never "
+                "dropped (the client is slowed down instead).\n"
+                "This feature is not available on Windows.",
+    },
     {
         .shortopt = 'b',
         .longopt = "video-bit-rate",
@@ -575,6 +613,19 @@ static const struct sc_option options[] = {
         .text = "Limit the frame rate of screen capture (officially supported "
                 "since Android 10, but may work on earlier versions).",
     },
+    {
+        .longopt_id = OPT_MEMORY_BUDGET,
+        .longopt = "memory-budget",
+        .argdesc = "value",
+        .text = "Limit the memory used by the queues which may grow if a "
+                "component could not keep up (recording, video buffering and "
+                "control messages), in megabytes.\n"
+                "The budget is shared between them, and each one degrades "
+                "gracefully once its share is exhausted: the recorder slows "
+                "down the stream, the video buffer and the controller drop "
+                "frames and messages. The memory usage is printed on exit.\n"
+                "Default is 0 (unlimited).",
+    },
     {
         .longopt_id = OPT_MOUSE,
         .longopt = "mouse",
@@ -706,6 +757,13 @@ static const struct sc_option options[] = {
         .longopt = "no-power-on",
         .text = "Do not power on the device on start.",
     },
+    {
+        .longopt_id = OPT_NO_REPLAY_PACING,
+        .longopt = "no-replay-pacing",
+        .text = "With --replay, push the packets as fast as possible instead "
+                "of at the speed of the recording (to benchmark the "
+                "decoding and the rendering).",
+    },
     {
         .longopt_id = OPT_NO_VD_DESTROY_CONTENT,
         .longopt = "no-vd-destroy-content",
@@ -779,6 +837,15 @@ static const struct sc_option options[] = {
                 "Passing the option without argument is equivalent to passing "
                 "\"true\".",
     },
+    {
+        .longopt_id = OPT_PERF_COUNTERS,
+        .longopt = "perf-counters",
+        .text = "Measure CPU cycles, instructions, cache misses and context "
+                "switches of each pipeline thread (demuxers and decoders, "
+                "buffering, audio output, controller, recorder and screen), "
+                "and print them with the cost per packet or frame on exit.\n"
+                "This feature is only available on Linux.",
+    },
     {
         .longopt_id = OPT_POWER_OFF_ON_CLOSE,
         .longopt = "power-off-on-close",
@@ -824,8 +891,11 @@ static const struct sc_option options[] = {
         .longopt_id = OPT_RECORD_FORMAT,
         .longopt = "record-format",
         .argdesc = "format",
-        .text = "Force recording format (mp4, mkv, m4a, mka, opus, aac, flac "
-                "or wav).",
+        .text = "Force recording format (mp4, fmp4, mkv, m4a, mka, opus, aac, "
+                "flac or wav).\n"
+                "The fmp4 format is a fragmented MP4: it is written "
+                "progressively, so that the file remains playable even if "
+                "scrcpy is killed.",
     },
     {
         .longopt_id = OPT_RECORD_ORIENTATION,
@@ -836,6 +906,35 @@ static const struct sc_option options[] = {
                 "the clockwise rotation in degrees.\n"
                 "Default is 0.",
     },
+    {
+        .longopt_id = OPT_RECORD_PROXY,
+        .longopt = "record-proxy",
+        .argdesc = "file.mp4",
+        .text = "Record a downscaled, low bit-rate copy of the video to file "
+                "(a proxy), re-encoded from the decoded frames.\n"
+                "The format (mp4 or mkv) is determined by the file "
+                "extension.\n"
+                "If the CPU could not keep up, frames are dropped from the "
+                "proxy (the mirroring and the --record file are not "
+                "affected).",
+    },
+    {
+        .longopt_id = OPT_RECORD_PROXY_BIT_RATE,
+        .longopt = "record-proxy-bit-rate",
+        .argdesc = "value",
+        .text = "Encode the proxy recording at the given bit rate, expressed "
+                "in bits/s. Unit suffixes are supported: 'K' (x1000) and 'M' "
+                "(x1000000).\n"
+                "Default is 2M (2000000).",
+    },
+    {
+        .longopt_id = OPT_RECORD_PROXY_SIZE,
+        .longopt = "record-proxy-size",
+        .argdesc = "value",
+        .text = "Limit both the width and height of the proxy recording to "
+                "value. The aspect ratio is preserved.\n"
+                "Default is 720.",
+    },
     {
         .longopt_id = OPT_RENDER_DRIVER,
         .longopt = "render-driver",
@@ -846,6 +945,20 @@ static const struct sc_option options[] = {
                 "\"opengles2\", \"opengles\", \"metal\" and \"software\".\n"
                 "<https://wiki.libsdl.org/SDL_HINT_RENDER_DRIVER>",
     },
+    {
+        .longopt_id = OPT_REPLAY,
+        .longopt = "replay",
+        .argdesc = "file",
+        .text = "Play the video and audio streams of a local file (typically "
+                "a recording) instead of mirroring a device.\n"
+                "The packets go through the same pipeline as the device "
+                "streams (decoders, recording, display, V4L2 sink, audio "
+                "playback), which allows to test and profile it without any "
+                "device. Control is disabled.\n"
+                "The supported codecs are the ones the device may send "
+                "(H.264, H.265, AV1, Opus, AAC, FLAC and raw audio), in any "
+                "container supported by FFmpeg.",
+    },
     {
         .longopt_id = OPT_REQUIRE_AUDIO,
         .longopt = "require-audio",
@@ -878,6 +991,21 @@ static const struct sc_option options[] = {
         .text = "Set the screen off timeout while scrcpy is running (restore "
                 "the initial value on exit).",
     },
+    {
+        .longopt_id = OPT_SCREENSHOT_DIR,
+        .longopt = "screenshot-dir",
+        .argdesc = "path",
+        .text = "Set the directory where the screenshots (MOD+Shift+s) are "
+                "written.\n"
+                "Default is the current directory.",
+    },
+    {
+        .longopt_id = OPT_SCREENSHOT_FORMAT,
+        .longopt = "screenshot-format",
+        .argdesc = "format",
+        .text = "Select the screenshot format (png, jpeg or webp).\n"
+                "Default is png.",
+    },
     {
         .longopt_id = OPT_SHORTCUT_MOD,
         .longopt = "shortcut-mod",
@@ -1014,6 +1142,21 @@ static const struct sc_option options[] = {
                 "Android documentation: "
                 "<https://d.android.com/reference/android/media/MediaFormat>",
     },
+    {
+        .longopt_id = OPT_VIDEO_DECODER,
+        .longopt = "video-decoder",
+        .argdesc = "name",
+        .text = "Use a specific FFmpeg video decoder (depending on the codec "
+                "provided by --video-codec), for example 'libdav1d' or "
+                "'libopenh264'.\n"
+                "If the value is 'auto', the available decoders are "
+                "benchmarked once (in the background, on the first seconds "
+                "of the stream), and the fastest decoder meeting the latency "
+                "target is used from the next start. The result is cached "
+                "until FFmpeg is upgraded.\n"
+                "By default, the default FFmpeg decoder for the codec is "
+                "used.",
+    },
     {
         .longopt_id = OPT_VIDEO_ENCODER,
         .longopt = "video-encoder",
@@ -1106,6 +1249,15 @@ static const struct sc_shortcut shortcuts[] = {
         .shortcuts = { "MOD+Shift+z" },
         .text = "Unpause display",
     },
+    {
+        .shortcuts = { "MOD+a" },
+        .text = "Stream only the area around the mouse pointer, at native "
+                "resolution (repeat to narrow it)",
+    },
+    {
+        .shortcuts = { "MOD+Shift+a" },
+        .text = "Stream the full screen again",
+    },
     {
         .shortcuts = { "MOD+Shift+r" },
         .text = "Reset video capture/encoding",
@@ -1199,6 +1351,15 @@ static const struct sc_shortcut shortcuts[] = {
         .shortcuts = { "MOD+i" },
         .text = "Enable/disable FPS counter (print frames/second in logs)",
     },
+    {
+        .shortcuts = { "MOD+Shift+i" },
+        .text = "Show/hide the stats overlay (frame rates, decoding time, "
+                "bitrate, buffering and latency)",
+    },
+    {
+        .shortcuts = { "MOD+Shift+s" },
+        .text = "Take a screenshot (keep pressed to capture every frame)",
+    },
     {
         .shortcuts = { "Ctrl+click-and-move" },
         .text = "Pinch-to-zoom and rotate from the center of the screen",
@@ -1628,6 +1789,21 @@ parse_max_size(const char *s, uint16_t *max_size) {
     return true;
 }
 
+static bool
+parse_memory_budget(const char *s, uint32_t *memory_budget) {
+    long value;
+    // Limit it to some arbitrary value (1 TB) to prevent overflow when
+    // converted to bytes
+    bool ok = parse_integer_arg(s, &value, false, 0, 1 << 20,
+                                "memory budget");
+    if (!ok) {
+        return false;
+    }
+
+    *memory_budget = (uint32_t) value;
+    return true;
+}
+
 static bool
 parse_buffering_time(const char *s, sc_tick *tick) {
     long value;
@@ -1645,6 +1821,42 @@ parse_buffering_time(const char *s, sc_tick *tick) {
     return true;
 }
 
+static bool
+parse_audio_buffer(const char *s, struct scrcpy_options *opts) {
+    if (!strncmp(s, "auto", 4)) {
+        opts->audio_buffer_auto = true;
+        if (s[4] == '\0') {
+            // Default bounds
+            return true;
+        }
+
+        if (s[4] != ':') {
+            LOGE("Could not parse audio buffer: %s", s);
+            return false;
+        }
+
+        long values[2];
+        size_t count = parse_integers_arg(&s[5], ':', 2, values, 0,
+                                          60 * 60 * 1000, "audio buffer");
+        if (!count) {
+            return false;
+        }
+
+        if (count != 2 || values[0] > values[1]) {
+            LOGE("Invalid audio buffer bounds, expected auto:min:max (in ms): "
+                 "%s", s);
+            return false;
+        }
+
+        opts->audio_buffer_min = SC_TICK_FROM_MS(values[0]);
+        opts->audio_buffer_max = SC_TICK_FROM_MS(values[1]);
+        return true;
+    }
+
+    opts->audio_buffer_auto = false;
+    return parse_buffering_time(s, &opts->audio_buffer);
+}
+
 static bool
 parse_audio_output_buffer(const char *s, sc_tick *tick) {
     long value;
@@ -1677,6 +1889,26 @@ parse_display_ime_policy(const char *s, enum sc_display_ime_policy *policy) {
     return false;
 }
 
+#ifdef HAVE_SWSCALE
+static bool
+parse_screenshot_format(const char *s, enum sc_screenshot_format *format) {
+    if (!strcmp(s, "png")) {
+        *format = SC_SCREENSHOT_FORMAT_PNG;
+        return true;
+    }
+    if (!strcmp(s, "jpeg")) {
+        *format = SC_SCREENSHOT_FORMAT_JPEG;
+        return true;
+    }
+    if (!strcmp(s, "webp")) {
+        *format = SC_SCREENSHOT_FORMAT_WEBP;
+        return true;
+    }
+    LOGE("Unsupported screenshot format: %s (expected png, jpeg or webp)", s);
+    return false;
+}
+#endif
+
 static bool
 parse_orientation(const char *s, enum sc_orientation *orientation) {
     if (!strcmp(s, "0")) {
@@ -1929,6 +2161,9 @@ get_record_format(const char *name) {
     if (!strcmp(name, "mp4")) {
         return SC_RECORD_FORMAT_MP4;
     }
+    if (!strcmp(name, "fmp4")) {
+        return SC_RECORD_FORMAT_FMP4;
+    }
     if (!strcmp(name, "mkv")) {
         return SC_RECORD_FORMAT_MKV;
     }
@@ -1957,8 +2192,8 @@ static bool
 parse_record_format(const char *optarg, enum sc_record_format *format) {
     enum sc_record_format fmt = get_record_format(optarg);
     if (!fmt) {
-        LOGE("Unsupported record format: %s (expected mp4, mkv, m4a, mka, "
-             "opus, aac, flac or wav)", optarg);
+        LOGE("Unsupported record format: %s (expected mp4, fmp4, mkv, m4a, "
+             "mka, opus, aac, flac or wav)", optarg);
         return false;
     }
 
@@ -2437,6 +2672,11 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     return false;
                 }
                 break;
+            case OPT_MEMORY_BUDGET:
+                if (!parse_memory_budget(optarg, &opts->memory_budget)) {
+                    return false;
+                }
+                break;
             case 'M':
                 opts->mouse_input_mode = SC_MOUSE_INPUT_MODE_UHID_OR_AOA;
                 break;
@@ -2618,6 +2858,9 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_VIDEO_ENCODER:
                 opts->video_encoder = optarg;
                 break;
+            case OPT_VIDEO_DECODER:
+                opts->video_decoder = optarg;
+                break;
             case OPT_AUDIO_ENCODER:
                 opts->audio_encoder = optarg;
                 break;
@@ -2676,6 +2919,15 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             case OPT_PRINT_FPS:
                 opts->start_fps_counter = true;
                 break;
+            case OPT_PERF_COUNTERS:
+#ifdef HAVE_PERF_EVENT
+                opts->perf_counters = true;
+                break;
+#else
+                LOGE("Performance counters (--perf-counters) are not "
+                     "supported on this platform.");
+                return false;
+#endif
             case OPT_CODEC:
                 LOGE("--codec has been removed, "
                      "use --video-codec or --audio-codec.");
@@ -2743,7 +2995,7 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                 opts->require_audio = true;
                 break;
             case OPT_AUDIO_BUFFER:
-                if (!parse_buffering_time(optarg, &opts->audio_buffer)) {
+                if (!parse_audio_buffer(optarg, opts)) {
                     return false;
                 }
                 break;
@@ -2839,6 +3091,71 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
                     return false;
                 }
                 break;
+            case OPT_AUTO_RECONNECT:
+                opts->auto_reconnect = true;
+                break;
+            case OPT_REPLAY:
+                opts->replay_filename = optarg;
+                break;
+            case OPT_NO_REPLAY_PACING:
+                opts->replay_pacing = false;
+                break;
+            case OPT_AUTOMATION_SOCKET:
+#ifdef HAVE_AUTOMATION
+                opts->automation_socket = optarg;
+                break;
+#else
+                LOGE("Automation (--automation-socket) is disabled (or "
+                     "unsupported on this platform).");
+                return false;
+#endif
+            case OPT_RECORD_PROXY:
+#ifdef HAVE_SWSCALE
+                opts->record_proxy_filename = optarg;
+                break;
+#else
+                LOGE("Proxy recording (--record-proxy) is disabled.");
+                return false;
+#endif
+            case OPT_RECORD_PROXY_SIZE:
+#ifdef HAVE_SWSCALE
+                if (!parse_max_size(optarg, &opts->record_proxy_size)) {
+                    return false;
+                }
+                break;
+#else
+                LOGE("Proxy recording (--record-proxy-size) is disabled.");
+                return false;
+#endif
+            case OPT_RECORD_PROXY_BIT_RATE:
+#ifdef HAVE_SWSCALE
+                if (!parse_bit_rate(optarg, &opts->record_proxy_bit_rate)) {
+                    return false;
+                }
+                break;
+#else
+                LOGE("Proxy recording (--record-proxy-bit-rate) is disabled.");
+                return false;
+#endif
+            case OPT_SCREENSHOT_DIR:
+#ifdef HAVE_SWSCALE
+                opts->screenshot_dir = optarg;
+                break;
+#else
+                LOGE("Screenshots (--screenshot-dir) are disabled.");
+                return false;
+#endif
+            case OPT_SCREENSHOT_FORMAT:
+#ifdef HAVE_SWSCALE
+                if (!parse_screenshot_format(optarg,
+                                             &opts->screenshot_format)) {
+                    return false;
+                }
+                break;
+#else
+                LOGE("Screenshots (--screenshot-format) are disabled.");
+                return false;
+#endif
             default:
                 // getopt prints the error message on stderr
                 return false;
@@ -2869,12 +3186,51 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
 
     bool otg = false;
     bool v4l2 = false;
+    bool proxy = false;
 #ifdef HAVE_USB
     otg = opts->otg;
 #endif
 #ifdef HAVE_V4L2
     v4l2 = !!opts->v4l2_device;
 #endif
+#ifdef HAVE_SWSCALE
+    proxy = !!opts->record_proxy_filename;
+#endif
+
+    // Only set if automation is supported
+    bool automation = !!opts->automation_socket;
+    if (automation && otg) {
+        LOGE("OTG mode: could not listen on an automation socket");
+        return false;
+    }
+
+    if (!opts->replay_pacing && !opts->replay_filename) {
+        LOGE("--no-replay-pacing requires --replay");
+        return false;
+    }
+
+    if (opts->replay_filename) {
+        // There is no device
+        if (otg) {
+            LOGE("OTG mode: could not replay a file");
+            return false;
+        }
+        if (opts->list) {
+            LOGE("Could not list device properties when replaying a file");
+            return false;
+        }
+        if (opts->auto_reconnect) {
+            LOGE("Could not reconnect automatically when replaying a file");
+            return false;
+        }
+        if (opts->video_decoder && !strcmp(opts->video_decoder, "auto")) {
+            // The codec is not known before the file is read
+            LOGE("--video-decoder=auto is not supported when replaying a "
+                 "file");
+            return false;
+        }
+        opts->control = false;
+    }
 
     if (!opts->window) {
         // Without window, there cannot be any video playback
@@ -2893,8 +3249,9 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         opts->audio_playback = false;
     }
 
+    // An automation client may subscribe to the decoded frames
     if (opts->video && !opts->video_playback && !opts->record_filename
-            && !v4l2) {
+            && !v4l2 && !proxy && !automation) {
         LOGI("No video playback, no recording, no V4L2 sink: video disabled");
         opts->video = false;
     }
@@ -2927,6 +3284,12 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         }
     }
 
+    if (opts->audio_buffer_auto && opts->audio_buffer != -1) {
+        // Start from the default value, within the bounds
+        opts->audio_buffer = CLAMP(opts->audio_buffer, opts->audio_buffer_min,
+                                   opts->audio_buffer_max);
+    }
+
 #ifdef HAVE_V4L2
     if (v4l2) {
         if (!opts->video) {
@@ -2946,6 +3309,25 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
     }
 #endif
 
+#ifdef HAVE_SWSCALE
+    if (proxy) {
+        if (!opts->video) {
+            LOGE("Proxy recording requires video capture, but --no-video was "
+                 "set.");
+            return false;
+        }
+
+        opts->record_proxy_format =
+            guess_record_format(opts->record_proxy_filename);
+        if (opts->record_proxy_format != SC_RECORD_FORMAT_MP4
+                && opts->record_proxy_format != SC_RECORD_FORMAT_MKV) {
+            LOGE("Unsupported proxy recording format for \"%s\" "
+                 "(expected .mp4 or .mkv)", opts->record_proxy_filename);
+            return false;
+        }
+    }
+#endif
+
     if (opts->control) {
         if (opts->keyboard_input_mode == SC_KEYBOARD_INPUT_MODE_AUTO) {
             opts->keyboard_input_mode = otg ? SC_KEYBOARD_INPUT_MODE_AOA
@@ -3240,6 +3622,7 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         }
 
         if ((opts->record_format == SC_RECORD_FORMAT_MP4 ||
+             opts->record_format == SC_RECORD_FORMAT_FMP4 ||
              opts->record_format == SC_RECORD_FORMAT_M4A)
                 && opts->audio_codec == SC_CODEC_RAW) {
             LOGE("Recording to MP4 container does not support RAW audio");
@@ -3302,6 +3685,27 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
         opts->start_fps_counter = false;
     }
 
+    if (opts->auto_reconnect) {
+        if (otg) {
+            LOGE("OTG mode: could not reconnect automatically");
+            return false;
+        }
+
+        // The HID devices are created once on the device, they would not
+        // exist anymore after a reconnection
+        if (opts->control
+                && (opts->keyboard_input_mode == SC_KEYBOARD_INPUT_MODE_UHID
+                 || opts->keyboard_input_mode == SC_KEYBOARD_INPUT_MODE_AOA
+                 || opts->mouse_input_mode == SC_MOUSE_INPUT_MODE_UHID
+                 || opts->mouse_input_mode == SC_MOUSE_INPUT_MODE_AOA
+                 || opts->gamepad_input_mode
+                        != SC_GAMEPAD_INPUT_MODE_DISABLED)) {
+            LOGE("--auto-reconnect is only supported with SDK keyboard and "
+                 "mouse, without gamepad");
+            return false;
+        }
+    }
+
     if (otg) {
         // OTG mode is compatible with only very few options.
         // Only report obvious errors.
@@ -3333,6 +3737,10 @@ parse_args_with_getopt(struct scrcpy_cli_args *args, int argc, char *argv[],
             LOGE("OTG mode: could not sink to V4L2 device");
             return false;
         }
+        if (proxy) {
+            LOGE("OTG mode: could not record a proxy");
+            return false;
+        }
     }
 
     return true;
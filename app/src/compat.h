@@ -6,6 +6,9 @@
 #include <libavcodec/version.h>
 #include <libavformat/version.h>
 #include <libavutil/version.h>
+#ifdef HAVE_SWSCALE
+# include <libswscale/version.h>
+#endif
 #include <SDL2/SDL_version.h>
 
 #ifndef _WIN32
@@ -27,6 +30,15 @@
 # define SCRCPY_LAVF_REQUIRES_REGISTER_ALL
 #endif
 
+// In ffmpeg/doc/APIchanges:
+// 2018-02-06 - 36c85d6e77 - lavc 58.10.100 - avcodec.h
+//   Deprecate use of avcodec_register(), avcodec_register_all(),
+//   av_codec_next(), av_register_codec_parser(), and av_parser_next().
+//   Add av_codec_iterate() and av_parser_iterate().
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 10, 100)
+# define SCRCPY_LAVC_HAS_CODEC_ITERATE
+#endif
+
 // Not documented in ffmpeg/doc/APIchanges, but AV_CODEC_ID_AV1 has been added
 // by FFmpeg commit d42809f9835a4e9e5c7c63210abb09ad0ef19cfb (included in tag
 // n3.3).
@@ -61,6 +73,27 @@
 # define SCRCPY_LAVC_HAS_CODECPAR_CODEC_SIDEDATA
 #endif
 
+// AV_PKT_DATA_PRFT and AVProducerReferenceTime are available in FFmpeg 4.3
+// (lavc 58.91.100)
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 91, 100)
+# define SCRCPY_LAVC_HAS_PRFT
+#endif
+
+// In ffmpeg/doc/APIchanges:
+// 2020-05-21 - 7c59e1b0f2 - lavc 58.87.100 - avcodec.h codec_desc.h
+//   Move AVBitStreamFilter and the av_bsf_*() functions to bsf.h (which may
+//   not be included by avcodec.h).
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 87, 100)
+# define SCRCPY_LAVC_HAS_BSF_HEADER
+#endif
+
+// sws_scale_frame() and the "threads" option (slice threading) are available
+// in FFmpeg 5.0 (lsws 6.4.100)
+#if defined(HAVE_SWSCALE) \
+        && LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 4, 100)
+# define SCRCPY_LSWS_HAS_SLICE_THREADS
+#endif
+
 #if SDL_VERSION_ATLEAST(2, 0, 6)
 // <https://github.com/libsdl-org/SDL/commit/d7a318de563125e5bb465b1000d6bc9576fbc6fc>
 # define SCRCPY_SDL_HAS_HINT_TOUCH_MOUSE_EVENTS
@@ -83,6 +116,10 @@
 # define SCRCPY_SDL_HAS_HINT_AUDIO_DEVICE_APP_NAME
 #endif
 
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+# define SCRCPY_SDL_HAS_TEXTURE_SCALE_MODE
+#endif
+
 #ifndef HAVE_STRDUP
 char *strdup(const char *s);
 #endif
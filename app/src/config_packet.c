@@ -0,0 +1,506 @@
+#include "config_packet.h"
+
+#include <assert.h>
+
+#define SC_H264_NAL_SPS 7
+#define SC_H265_NAL_SPS 33
+#define SC_AV1_OBU_SEQUENCE_HEADER 1
+
+// Read the bits of a parameter set (MSB first)
+struct sc_bit_reader {
+    const uint8_t *data;
+    size_t len;
+    size_t pos; // current byte
+    unsigned bit; // current bit in the current byte
+    // Skip the emulation prevention bytes (0x000003) of H.26x NAL units
+    bool h26x;
+    unsigned zeros; // number of consecutive 0x00 bytes read
+    bool error; // read past the end
+};
+
+static void
+sc_bit_reader_init(struct sc_bit_reader *br, const uint8_t *data, size_t len,
+                   bool h26x) {
+    br->data = data;
+    br->len = len;
+    br->pos = 0;
+    br->bit = 0;
+    br->h26x = h26x;
+    br->zeros = 0;
+    br->error = false;
+}
+
+static void
+sc_bit_reader_next_byte(struct sc_bit_reader *br) {
+    br->zeros = br->data[br->pos] ? 0 : br->zeros + 1;
+    ++br->pos;
+    br->bit = 0;
+
+    if (br->h26x && br->zeros >= 2 && br->pos < br->len
+            && br->data[br->pos] == 0x03) {
+        // emulation_prevention_three_byte
+        ++br->pos;
+        br->zeros = 0;
+    }
+}
+
+static uint32_t
+sc_bit_reader_read_bit(struct sc_bit_reader *br) {
+    if (br->pos >= br->len) {
+        br->error = true;
+        return 0;
+    }
+
+    uint32_t bit = (br->data[br->pos] >> (7 - br->bit)) & 1;
+    if (++br->bit == 8) {
+        sc_bit_reader_next_byte(br);
+    }
+    return bit;
+}
+
+static uint32_t
+sc_bit_reader_read(struct sc_bit_reader *br, unsigned n) {
+    assert(n <= 32);
+    uint32_t value = 0;
+    for (unsigned i = 0; i < n; ++i) {
+        value = (value << 1) | sc_bit_reader_read_bit(br);
+    }
+    return value;
+}
+
+static void
+sc_bit_reader_skip(struct sc_bit_reader *br, unsigned n) {
+    for (unsigned i = 0; i < n && !br->error; ++i) {
+        sc_bit_reader_read_bit(br);
+    }
+}
+
+// Exp-Golomb code: ue(v) in H.26x, uvlc() in AV1
+static uint32_t
+sc_bit_reader_read_ue(struct sc_bit_reader *br) {
+    unsigned leading_zeros = 0;
+    while (!sc_bit_reader_read_bit(br)) {
+        if (br->error || ++leading_zeros == 32) {
+            br->error = true;
+            return 0;
+        }
+    }
+
+    return (UINT32_C(1) << leading_zeros) - 1
+         + sc_bit_reader_read(br, leading_zeros);
+}
+
+// Signed Exp-Golomb code: se(v)
+static int64_t
+sc_bit_reader_read_se(struct sc_bit_reader *br) {
+    uint32_t k = sc_bit_reader_read_ue(br);
+    // 0, 1, 2, 3, 4... -> 0, 1, -1, 2, -2...
+    return k & 1 ? (int64_t) (k >> 1) + 1 : -(int64_t) (k >> 1);
+}
+
+static bool
+sc_config_packet_set_size(uint64_t width, uint64_t height, uint64_t crop_x,
+                          uint64_t crop_y, struct sc_size *size) {
+    if (crop_x >= width || crop_y >= height) {
+        return false;
+    }
+
+    width -= crop_x;
+    height -= crop_y;
+    if (width > 0xFFFF || height > 0xFFFF) {
+        return false;
+    }
+
+    size->width = width;
+    size->height = height;
+    return true;
+}
+
+static const uint8_t *
+sc_config_packet_find_start_code(const uint8_t *p, const uint8_t *end) {
+    while (end - p >= 3) {
+        if (!p[0] && !p[1] && p[2] == 1) {
+            return p;
+        }
+        ++p;
+    }
+    return end;
+}
+
+// Find the first NAL unit of the given type in an Annex B stream
+static bool
+sc_config_packet_find_nal(const uint8_t *data, size_t len, bool h265,
+                          unsigned type, const uint8_t **nal,
+                          size_t *nal_len) {
+    const uint8_t *end = data + len;
+    const uint8_t *p = sc_config_packet_find_start_code(data, end);
+    while (p != end) {
+        const uint8_t *start = p + 3;
+        p = sc_config_packet_find_start_code(start, end);
+
+        // Remove the trailing zero bytes (or the leading zero of a 4-byte
+        // start code)
+        const uint8_t *nal_end = p;
+        while (nal_end > start && !nal_end[-1]) {
+            --nal_end;
+        }
+
+        if (nal_end - start < 2) {
+            continue;
+        }
+
+        unsigned nal_type = h265 ? (start[0] >> 1) & 0x3F : start[0] & 0x1F;
+        if (nal_type == type) {
+            *nal = start;
+            *nal_len = nal_end - start;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool
+sc_h264_has_chroma_format(uint32_t profile_idc) {
+    switch (profile_idc) {
+        case 44: case 83: case 86: case 100: case 110: case 118: case 122:
+        case 128: case 134: case 135: case 138: case 139: case 244:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void
+sc_h264_skip_scaling_list(struct sc_bit_reader *br, unsigned count) {
+    int64_t last_scale = 8;
+    for (unsigned i = 0; i < count && !br->error; ++i) {
+        int64_t delta_scale = sc_bit_reader_read_se(br);
+        int64_t next_scale = (last_scale + delta_scale + 256) % 256;
+        if (!next_scale) {
+            // The remaining values are not coded
+            break;
+        }
+        last_scale = next_scale;
+    }
+}
+
+// H.264 7.3.2.1.1
+static bool
+sc_config_packet_parse_h264_sps(const uint8_t *data, size_t len,
+                                struct sc_size *size) {
+    struct sc_bit_reader br;
+    sc_bit_reader_init(&br, data, len, true);
+
+    sc_bit_reader_skip(&br, 8); // NAL unit header
+    uint32_t profile_idc = sc_bit_reader_read(&br, 8);
+    sc_bit_reader_skip(&br, 16); // constraint_set flags and level_idc
+    sc_bit_reader_read_ue(&br); // seq_parameter_set_id
+
+    uint32_t chroma_format_idc = 1; // 4:2:0 if not present
+    bool separate_colour_plane = false;
+    if (sc_h264_has_chroma_format(profile_idc)) {
+        chroma_format_idc = sc_bit_reader_read_ue(&br);
+        if (chroma_format_idc == 3) {
+            separate_colour_plane = sc_bit_reader_read(&br, 1);
+        }
+        sc_bit_reader_read_ue(&br); // bit_depth_luma_minus8
+        sc_bit_reader_read_ue(&br); // bit_depth_chroma_minus8
+        sc_bit_reader_skip(&br, 1); // qpprime_y_zero_transform_bypass_flag
+        if (sc_bit_reader_read(&br, 1)) { // seq_scaling_matrix_present_flag
+            unsigned count = chroma_format_idc != 3 ? 8 : 12;
+            for (unsigned i = 0; i < count; ++i) {
+                if (sc_bit_reader_read(&br, 1)) {
+                    sc_h264_skip_scaling_list(&br, i < 6 ? 16 : 64);
+                }
+            }
+        }
+    }
+
+    sc_bit_reader_read_ue(&br); // log2_max_frame_num_minus4
+    uint32_t pic_order_cnt_type = sc_bit_reader_read_ue(&br);
+    if (pic_order_cnt_type == 0) {
+        sc_bit_reader_read_ue(&br); // log2_max_pic_order_cnt_lsb_minus4
+    } else if (pic_order_cnt_type == 1) {
+        sc_bit_reader_skip(&br, 1); // delta_pic_order_always_zero_flag
+        sc_bit_reader_read_se(&br); // offset_for_non_ref_pic
+        sc_bit_reader_read_se(&br); // offset_for_top_to_bottom_field
+        uint32_t count = sc_bit_reader_read_ue(&br);
+        if (count > 255) {
+            return false;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            sc_bit_reader_read_se(&br); // offset_for_ref_frame[i]
+        }
+    }
+
+    sc_bit_reader_read_ue(&br); // max_num_ref_frames
+    sc_bit_reader_skip(&br, 1); // gaps_in_frame_num_value_allowed_flag
+    uint64_t width_in_mbs = (uint64_t) sc_bit_reader_read_ue(&br) + 1;
+    uint64_t height_in_map_units = (uint64_t) sc_bit_reader_read_ue(&br) + 1;
+    bool frame_mbs_only = sc_bit_reader_read(&br, 1);
+    if (!frame_mbs_only) {
+        sc_bit_reader_skip(&br, 1); // mb_adaptive_frame_field_flag
+    }
+    sc_bit_reader_skip(&br, 1); // direct_8x8_inference_flag
+
+    uint64_t crop_left = 0;
+    uint64_t crop_right = 0;
+    uint64_t crop_top = 0;
+    uint64_t crop_bottom = 0;
+    if (sc_bit_reader_read(&br, 1)) { // frame_cropping_flag
+        crop_left = sc_bit_reader_read_ue(&br);
+        crop_right = sc_bit_reader_read_ue(&br);
+        crop_top = sc_bit_reader_read_ue(&br);
+        crop_bottom = sc_bit_reader_read_ue(&br);
+    }
+
+    if (br.error) {
+        return false;
+    }
+
+    // Table 6-1 and equations 7-19 to 7-22
+    unsigned field_factor = 2 - frame_mbs_only;
+    unsigned crop_unit_x = 1;
+    unsigned crop_unit_y = field_factor;
+    if (chroma_format_idc && !separate_colour_plane) {
+        // SubWidthC and SubHeightC
+        crop_unit_x = chroma_format_idc == 3 ? 1 : 2;
+        crop_unit_y *= chroma_format_idc == 1 ? 2 : 1;
+    }
+
+    uint64_t width = width_in_mbs * 16;
+    uint64_t height = height_in_map_units * 16 * field_factor;
+    uint64_t crop_x = (crop_left + crop_right) * crop_unit_x;
+    uint64_t crop_y = (crop_top + crop_bottom) * crop_unit_y;
+    return sc_config_packet_set_size(width, height, crop_x, crop_y, size);
+}
+
+// H.265 7.3.2.2.1
+static bool
+sc_config_packet_parse_h265_sps(const uint8_t *data, size_t len,
+                                struct sc_size *size) {
+    struct sc_bit_reader br;
+    sc_bit_reader_init(&br, data, len, true);
+
+    sc_bit_reader_skip(&br, 16); // NAL unit header
+    sc_bit_reader_skip(&br, 4); // sps_video_parameter_set_id
+    unsigned max_sub_layers_minus1 = sc_bit_reader_read(&br, 3);
+    sc_bit_reader_skip(&br, 1); // sps_temporal_id_nesting_flag
+
+    // profile_tier_level(1, sps_max_sub_layers_minus1)
+    sc_bit_reader_skip(&br, 96); // general profile, tier and level
+    bool sub_layer_profile_present[8];
+    bool sub_layer_level_present[8];
+    for (unsigned i = 0; i < max_sub_layers_minus1; ++i) {
+        sub_layer_profile_present[i] = sc_bit_reader_read(&br, 1);
+        sub_layer_level_present[i] = sc_bit_reader_read(&br, 1);
+    }
+    if (max_sub_layers_minus1) {
+        sc_bit_reader_skip(&br, 2 * (8 - max_sub_layers_minus1)); // reserved
+    }
+    for (unsigned i = 0; i < max_sub_layers_minus1; ++i) {
+        if (sub_layer_profile_present[i]) {
+            sc_bit_reader_skip(&br, 88);
+        }
+        if (sub_layer_level_present[i]) {
+            sc_bit_reader_skip(&br, 8);
+        }
+    }
+
+    sc_bit_reader_read_ue(&br); // sps_seq_parameter_set_id
+    uint32_t chroma_format_idc = sc_bit_reader_read_ue(&br);
+    bool separate_colour_plane = false;
+    if (chroma_format_idc == 3) {
+        separate_colour_plane = sc_bit_reader_read(&br, 1);
+    }
+    uint64_t width = sc_bit_reader_read_ue(&br); // pic_width_in_luma_samples
+    uint64_t height = sc_bit_reader_read_ue(&br); // pic_height_in_luma_samples
+
+    uint64_t conf_win_left = 0;
+    uint64_t conf_win_right = 0;
+    uint64_t conf_win_top = 0;
+    uint64_t conf_win_bottom = 0;
+    if (sc_bit_reader_read(&br, 1)) { // conformance_window_flag
+        conf_win_left = sc_bit_reader_read_ue(&br);
+        conf_win_right = sc_bit_reader_read_ue(&br);
+        conf_win_top = sc_bit_reader_read_ue(&br);
+        conf_win_bottom = sc_bit_reader_read_ue(&br);
+    }
+
+    if (br.error) {
+        return false;
+    }
+
+    // Table 6-1
+    unsigned sub_width_c = 1;
+    unsigned sub_height_c = 1;
+    if (chroma_format_idc && !separate_colour_plane) {
+        sub_width_c = chroma_format_idc == 3 ? 1 : 2;
+        sub_height_c = chroma_format_idc == 1 ? 2 : 1;
+    }
+
+    uint64_t crop_x = (conf_win_left + conf_win_right) * sub_width_c;
+    uint64_t crop_y = (conf_win_top + conf_win_bottom) * sub_height_c;
+    return sc_config_packet_set_size(width, height, crop_x, crop_y, size);
+}
+
+#ifdef SCRCPY_LAVC_HAS_AV1
+static bool
+sc_config_packet_read_leb128(const uint8_t **data, size_t *len,
+                             uint64_t *value) {
+    *value = 0;
+    for (unsigned i = 0; i < 8 && i < *len; ++i) {
+        uint8_t byte = (*data)[i];
+        *value |= (uint64_t) (byte & 0x7F) << (i * 7);
+        if (!(byte & 0x80)) {
+            *data += i + 1;
+            *len -= i + 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// AV1 5.5
+static bool
+sc_config_packet_parse_av1_sequence_header(const uint8_t *data, size_t len,
+                                           struct sc_size *size) {
+    struct sc_bit_reader br;
+    sc_bit_reader_init(&br, data, len, false);
+
+    sc_bit_reader_skip(&br, 3); // seq_profile
+    sc_bit_reader_skip(&br, 1); // still_picture
+    bool reduced_still_picture_header = sc_bit_reader_read(&br, 1);
+    if (reduced_still_picture_header) {
+        sc_bit_reader_skip(&br, 5); // seq_level_idx[0]
+    } else {
+        bool decoder_model_info_present = false;
+        unsigned buffer_delay_length = 0;
+        if (sc_bit_reader_read(&br, 1)) { // timing_info_present_flag
+            // num_units_in_display_tick and time_scale
+            sc_bit_reader_skip(&br, 64);
+            if (sc_bit_reader_read(&br, 1)) { // equal_picture_interval
+                sc_bit_reader_read_ue(&br); // num_ticks_per_picture_minus_1
+            }
+            decoder_model_info_present = sc_bit_reader_read(&br, 1);
+            if (decoder_model_info_present) {
+                buffer_delay_length = sc_bit_reader_read(&br, 5) + 1;
+                sc_bit_reader_skip(&br, 32); // num_units_in_decoding_tick
+                // buffer_removal_time_length_minus_1 and
+                // frame_presentation_time_length_minus_1
+                sc_bit_reader_skip(&br, 10);
+            }
+        }
+
+        bool initial_display_delay_present = sc_bit_reader_read(&br, 1);
+        unsigned operating_points = sc_bit_reader_read(&br, 5) + 1;
+        for (unsigned i = 0; i < operating_points && !br.error; ++i) {
+            sc_bit_reader_skip(&br, 12); // operating_point_idc[i]
+            uint32_t seq_level_idx = sc_bit_reader_read(&br, 5);
+            if (seq_level_idx > 7) {
+                sc_bit_reader_skip(&br, 1); // seq_tier[i]
+            }
+            if (decoder_model_info_present) {
+                // decoder_model_present_for_this_op[i]
+                if (sc_bit_reader_read(&br, 1)) {
+                    // decoder_buffer_delay, encoder_buffer_delay and
+                    // low_delay_mode_flag
+                    sc_bit_reader_skip(&br, 2 * buffer_delay_length + 1);
+                }
+            }
+            if (initial_display_delay_present) {
+                // initial_display_delay_present_for_this_op[i]
+                if (sc_bit_reader_read(&br, 1)) {
+                    // initial_display_delay_minus_1[i]
+                    sc_bit_reader_skip(&br, 4);
+                }
+            }
+        }
+    }
+
+    unsigned width_bits = sc_bit_reader_read(&br, 4) + 1;
+    unsigned height_bits = sc_bit_reader_read(&br, 4) + 1;
+    uint64_t width = (uint64_t) sc_bit_reader_read(&br, width_bits) + 1;
+    uint64_t height = (uint64_t) sc_bit_reader_read(&br, height_bits) + 1;
+
+    if (br.error) {
+        return false;
+    }
+
+    return sc_config_packet_set_size(width, height, 0, 0, size);
+}
+
+static bool
+sc_config_packet_parse_av1(const uint8_t *data, size_t len,
+                           struct sc_size *size) {
+    if (len >= 4 && data[0] == 0x81) {
+        // AV1CodecConfigurationRecord (marker and version 1), followed by
+        // the configOBUs (an OBU header never starts with a 1 bit)
+        data += 4;
+        len -= 4;
+    }
+
+    while (len) {
+        uint8_t header = data[0];
+        if (header & 0x80) {
+            // obu_forbidden_bit
+            return false;
+        }
+
+        unsigned type = (header >> 3) & 0xF;
+        bool has_extension = header & 0x04;
+        bool has_size_field = header & 0x02;
+
+        size_t header_size = has_extension ? 2 : 1;
+        if (len < header_size) {
+            return false;
+        }
+        data += header_size;
+        len -= header_size;
+
+        uint64_t obu_size = len;
+        if (has_size_field
+                && (!sc_config_packet_read_leb128(&data, &len, &obu_size)
+                    || obu_size > len)) {
+            return false;
+        }
+
+        if (type == SC_AV1_OBU_SEQUENCE_HEADER) {
+            return sc_config_packet_parse_av1_sequence_header(data, obu_size,
+                                                              size);
+        }
+
+        data += obu_size;
+        len -= obu_size;
+    }
+
+    return false;
+}
+#endif
+
+bool
+sc_config_packet_parse_video_size(enum AVCodecID codec_id,
+                                  const uint8_t *data, size_t len,
+                                  struct sc_size *size) {
+    const uint8_t *sps;
+    size_t sps_len;
+
+    switch (codec_id) {
+        case AV_CODEC_ID_H264:
+            return sc_config_packet_find_nal(data, len, false,
+                                             SC_H264_NAL_SPS, &sps, &sps_len)
+                && sc_config_packet_parse_h264_sps(sps, sps_len, size);
+        case AV_CODEC_ID_HEVC:
+            return sc_config_packet_find_nal(data, len, true,
+                                             SC_H265_NAL_SPS, &sps, &sps_len)
+                && sc_config_packet_parse_h265_sps(sps, sps_len, size);
+#ifdef SCRCPY_LAVC_HAS_AV1
+        case AV_CODEC_ID_AV1:
+            return sc_config_packet_parse_av1(data, len, size);
+#endif
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef SC_CONFIG_PACKET_H
+#define SC_CONFIG_PACKET_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+
+#include "coords.h"
+
+/**
+ * Parse the video size from a config packet, without decoding:
+ *  - H.264: the SPS (Annex B);
+ *  - H.265: the SPS (Annex B);
+ *  - AV1: the sequence header OBU (optionally wrapped in an
+ *    AV1CodecConfigurationRecord).
+ *
+ * The size is the size of the decoded frames (after cropping, if any). For
+ * AV1, it is the maximal frame size, which is the frame size in practice.
+ *
+ * Return false if the packet does not contain a valid parameter set for the
+ * codec.
+ */
+bool
+sc_config_packet_parse_video_size(enum AVCodecID codec_id,
+                                  const uint8_t *data, size_t len,
+                                  struct sc_size *size);
+
+#endif
@@ -182,12 +182,18 @@ sc_control_msg_serialize(const struct sc_control_msg *msg, uint8_t *buf) {
             size_t len = write_string_tiny(&buf[1], msg->start_app.name, 255);
             return 1 + len;
         }
+        case SC_CONTROL_MSG_TYPE_SET_CROP:
+            write_position(&buf[1], &msg->set_crop.position);
+            sc_write16be(&buf[13], msg->set_crop.size.width);
+            sc_write16be(&buf[15], msg->set_crop.size.height);
+            return 17;
         case SC_CONTROL_MSG_TYPE_EXPAND_NOTIFICATION_PANEL:
         case SC_CONTROL_MSG_TYPE_EXPAND_SETTINGS_PANEL:
         case SC_CONTROL_MSG_TYPE_COLLAPSE_PANELS:
         case SC_CONTROL_MSG_TYPE_ROTATE_DEVICE:
         case SC_CONTROL_MSG_TYPE_OPEN_HARD_KEYBOARD_SETTINGS:
         case SC_CONTROL_MSG_TYPE_RESET_VIDEO:
+        case SC_CONTROL_MSG_TYPE_REQUEST_SYNC_FRAME:
             // no additional data
             return 1;
         default:
@@ -318,6 +324,20 @@ sc_control_msg_log(const struct sc_control_msg *msg) {
         case SC_CONTROL_MSG_TYPE_RESET_VIDEO:
             LOG_CMSG("reset video");
             break;
+        case SC_CONTROL_MSG_TYPE_REQUEST_SYNC_FRAME:
+            LOG_CMSG("request sync frame");
+            break;
+        case SC_CONTROL_MSG_TYPE_SET_CROP:
+            if (msg->set_crop.size.width && msg->set_crop.size.height) {
+                LOG_CMSG("set crop %" PRIu16 "x%" PRIu16 " at %" PRIi32 ",%"
+                         PRIi32,
+                         msg->set_crop.size.width, msg->set_crop.size.height,
+                         msg->set_crop.position.point.x,
+                         msg->set_crop.position.point.y);
+            } else {
+                LOG_CMSG("reset crop");
+            }
+            break;
         default:
             LOG_CMSG("unknown type: %u", (unsigned) msg->type);
             break;
@@ -330,8 +350,11 @@ sc_control_msg_is_droppable(const struct sc_control_msg *msg) {
     // UHID_INPUT messages for this device to be invalid.
     // Cannot drop UHID_DESTROY messages either, because a further UHID_CREATE
     // with the same id may fail.
+    // Cannot drop REQUEST_SYNC_FRAME messages, because the client discards
+    // the video packets until the next key frame.
     return msg->type != SC_CONTROL_MSG_TYPE_UHID_CREATE
-        && msg->type != SC_CONTROL_MSG_TYPE_UHID_DESTROY;
+        && msg->type != SC_CONTROL_MSG_TYPE_UHID_DESTROY
+        && msg->type != SC_CONTROL_MSG_TYPE_REQUEST_SYNC_FRAME;
 }
 
 void
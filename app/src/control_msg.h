@@ -43,6 +43,8 @@ enum sc_control_msg_type {
     SC_CONTROL_MSG_TYPE_OPEN_HARD_KEYBOARD_SETTINGS,
     SC_CONTROL_MSG_TYPE_START_APP,
     SC_CONTROL_MSG_TYPE_RESET_VIDEO,
+    SC_CONTROL_MSG_TYPE_REQUEST_SYNC_FRAME,
+    SC_CONTROL_MSG_TYPE_SET_CROP,
 };
 
 enum sc_copy_key {
@@ -111,6 +113,12 @@ struct sc_control_msg {
         struct {
             char *name;
         } start_app;
+        struct {
+            // Region of the current video (position is its top-left corner),
+            // an empty size restores the initial crop
+            struct sc_position position;
+            struct sc_size size;
+        } set_crop;
     };
 };
 
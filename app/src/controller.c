@@ -1,12 +1,25 @@
 #include "controller.h"
 
 #include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "memory_budget.h"
+#include "perf_counter.h"
 #include "util/log.h"
 
 // Drop droppable events above this limit
 #define SC_CONTROL_MSG_QUEUE_LIMIT 60
 
+enum sc_controller_send_result {
+    SC_CONTROLLER_SEND_OK,
+    SC_CONTROLLER_SEND_PARTIAL, // the tail must be sent by the thread
+    SC_CONTROLLER_SEND_WOULD_BLOCK, // nothing has been written
+    SC_CONTROLLER_SEND_EOS,
+    SC_CONTROLLER_SEND_ERROR,
+};
+
 static void
 sc_controller_receiver_on_ended(struct sc_receiver *receiver, bool error,
                                 void *userdata) {
@@ -17,6 +30,34 @@ sc_controller_receiver_on_ended(struct sc_receiver *receiver, bool error,
     controller->cbs->on_ended(controller, error, controller->cbs_userdata);
 }
 
+static size_t
+sc_control_msg_memory_size(const struct sc_control_msg *msg) {
+    size_t size = sizeof(*msg);
+    switch (msg->type) {
+        case SC_CONTROL_MSG_TYPE_INJECT_TEXT:
+            size += strlen(msg->inject_text.text) + 1;
+            break;
+        case SC_CONTROL_MSG_TYPE_SET_CLIPBOARD:
+            size += strlen(msg->set_clipboard.text) + 1;
+            break;
+        case SC_CONTROL_MSG_TYPE_START_APP:
+            size += strlen(msg->start_app.name) + 1;
+            break;
+        default:
+            break;
+    }
+    return size;
+}
+
+// The controller mutex must be locked
+static struct sc_control_msg
+sc_controller_queue_pop(struct sc_controller *controller) {
+    struct sc_control_msg msg = sc_vecdeque_pop(&controller->queue);
+    sc_memory_budget_release(SC_MEMORY_POOL_CONTROLLER,
+                             sc_control_msg_memory_size(&msg));
+    return msg;
+}
+
 bool
 sc_controller_init(struct sc_controller *controller, sc_socket control_socket,
                    const struct sc_controller_callbacks *cbs,
@@ -34,9 +75,17 @@ sc_controller_init(struct sc_controller *controller, sc_socket control_socket,
         .on_ended = sc_controller_receiver_on_ended,
     };
 
+    controller->serialized_msg = malloc(SC_CONTROL_MSG_MAX_SIZE);
+    if (!controller->serialized_msg) {
+        LOG_OOM();
+        sc_vecdeque_destroy(&controller->queue);
+        return false;
+    }
+
     ok = sc_receiver_init(&controller->receiver, control_socket, &receiver_cbs,
                           controller);
     if (!ok) {
+        free(controller->serialized_msg);
         sc_vecdeque_destroy(&controller->queue);
         return false;
     }
@@ -44,6 +93,7 @@ sc_controller_init(struct sc_controller *controller, sc_socket control_socket,
     ok = sc_mutex_init(&controller->mutex);
     if (!ok) {
         sc_receiver_destroy(&controller->receiver);
+        free(controller->serialized_msg);
         sc_vecdeque_destroy(&controller->queue);
         return false;
     }
@@ -52,12 +102,30 @@ sc_controller_init(struct sc_controller *controller, sc_socket control_socket,
     if (!ok) {
         sc_receiver_destroy(&controller->receiver);
         sc_mutex_destroy(&controller->mutex);
+        free(controller->serialized_msg);
+        sc_vecdeque_destroy(&controller->queue);
+        return false;
+    }
+
+    ok = sc_cond_init(&controller->space_cond);
+    if (!ok) {
+        sc_cond_destroy(&controller->msg_cond);
+        sc_receiver_destroy(&controller->receiver);
+        sc_mutex_destroy(&controller->mutex);
+        free(controller->serialized_msg);
         sc_vecdeque_destroy(&controller->queue);
         return false;
     }
 
     controller->control_socket = control_socket;
     controller->stopped = false;
+    controller->sending = false;
+    controller->eos = false;
+    controller->tail_offset = 0;
+    controller->tail_length = 0;
+    controller->ended = false;
+    controller->inline_count = 0;
+    controller->queued_count = 0;
 
     assert(cbs && cbs->on_ended);
     controller->cbs = cbs;
@@ -76,22 +144,78 @@ sc_controller_configure(struct sc_controller *controller,
 
 void
 sc_controller_destroy(struct sc_controller *controller) {
+    LOGD("Control messages: %" PRIu64 " sent inline, %" PRIu64 " queued",
+         controller->inline_count, controller->queued_count);
+
+    sc_cond_destroy(&controller->space_cond);
     sc_cond_destroy(&controller->msg_cond);
     sc_mutex_destroy(&controller->mutex);
 
     while (!sc_vecdeque_is_empty(&controller->queue)) {
-        struct sc_control_msg *msg = sc_vecdeque_popref(&controller->queue);
-        assert(msg);
-        sc_control_msg_destroy(msg);
+        struct sc_control_msg msg = sc_controller_queue_pop(controller);
+        sc_control_msg_destroy(&msg);
     }
     sc_vecdeque_destroy(&controller->queue);
+    free(controller->serialized_msg);
 
     sc_receiver_destroy(&controller->receiver);
 }
 
-bool
-sc_controller_push_msg(struct sc_controller *controller,
-                       const struct sc_control_msg *msg) {
+void
+sc_controller_reset(struct sc_controller *controller,
+                    sc_socket control_socket) {
+    sc_mutex_lock(&controller->mutex);
+    while (!sc_vecdeque_is_empty(&controller->queue)) {
+        struct sc_control_msg msg = sc_controller_queue_pop(controller);
+        sc_control_msg_destroy(&msg);
+    }
+    controller->control_socket = control_socket;
+    controller->stopped = false;
+    controller->sending = false;
+    controller->eos = false;
+    controller->tail_length = 0;
+    controller->ended = false;
+    sc_mutex_unlock(&controller->mutex);
+
+    controller->receiver.control_socket = control_socket;
+}
+
+#ifdef SC_NET_HAS_SEND_NONBLOCKING
+// On SC_CONTROLLER_SEND_PARTIAL, the bytes of serialized_msg in
+// [*written; *length) remain to be sent
+static enum sc_controller_send_result
+send_msg_inline(struct sc_controller *controller,
+                const struct sc_control_msg *msg, size_t *written,
+                size_t *length) {
+    size_t len = sc_control_msg_serialize(msg, controller->serialized_msg);
+    if (!len) {
+        return SC_CONTROLLER_SEND_ERROR;
+    }
+
+    ssize_t w = net_send_nonblocking(controller->control_socket,
+                                     controller->serialized_msg, len);
+    if (w == 0) {
+        return SC_CONTROLLER_SEND_WOULD_BLOCK;
+    }
+    if (w < 0) {
+        return SC_CONTROLLER_SEND_EOS;
+    }
+
+    if ((size_t) w < len) {
+        // Never block the calling thread (typically the UI thread) to send the
+        // remaining bytes
+        *written = w;
+        *length = len;
+        return SC_CONTROLLER_SEND_PARTIAL;
+    }
+
+    return SC_CONTROLLER_SEND_OK;
+}
+#endif
+
+static bool
+sc_controller_push(struct sc_controller *controller,
+                   const struct sc_control_msg *msg, bool wait) {
     if (sc_get_log_level() <= SC_LOG_LEVEL_VERBOSE) {
         sc_control_msg_log(msg);
     }
@@ -99,6 +223,91 @@ sc_controller_push_msg(struct sc_controller *controller,
     bool pushed = false;
 
     sc_mutex_lock(&controller->mutex);
+
+#ifdef SC_NET_HAS_SEND_NONBLOCKING
+    if (!controller->stopped && !controller->eos && !controller->sending
+            && sc_vecdeque_is_empty(&controller->queue)) {
+        // The controller is idle: send the message from the current thread,
+        // to avoid a thread wake-up (and context switch) for every event
+        controller->sending = true;
+        sc_mutex_unlock(&controller->mutex);
+
+        size_t written;
+        size_t length;
+        enum sc_controller_send_result result =
+            send_msg_inline(controller, msg, &written, &length);
+
+        sc_mutex_lock(&controller->mutex);
+        if (result == SC_CONTROLLER_SEND_PARTIAL) {
+            // Hand over the "sending" token (kept set) to the controller
+            // thread, which sends the tail before any queued message
+            controller->tail_offset = written;
+            controller->tail_length = length - written;
+            sc_cond_signal(&controller->msg_cond);
+        } else {
+            controller->sending = false;
+        }
+
+        if (result == SC_CONTROLLER_SEND_EOS) {
+            // Let the controller thread report the end of stream
+            controller->eos = true;
+            sc_cond_signal(&controller->msg_cond);
+        } else if (!sc_vecdeque_is_empty(&controller->queue)) {
+            // Messages have been queued by other threads in the meantime
+            sc_cond_signal(&controller->msg_cond);
+        }
+
+        if (result == SC_CONTROLLER_SEND_OK
+                || result == SC_CONTROLLER_SEND_PARTIAL) {
+            ++controller->inline_count;
+            sc_mutex_unlock(&controller->mutex);
+
+            struct sc_control_msg sent = *msg;
+            sc_control_msg_destroy(&sent);
+            return true;
+        }
+
+        if (result != SC_CONTROLLER_SEND_WOULD_BLOCK) {
+            sc_mutex_unlock(&controller->mutex);
+            return false;
+        }
+
+        // The socket send buffer is full, queue the message
+    }
+#endif
+
+    if (wait) {
+        // Wait for the controller thread to make room in the queue, rather
+        // than dropping the message
+        while (!controller->stopped && !controller->eos && !controller->ended
+                && sc_vecdeque_size(&controller->queue)
+                        >= SC_CONTROL_MSG_QUEUE_LIMIT) {
+            sc_cond_wait(&controller->space_cond, &controller->mutex);
+        }
+    }
+
+    size_t mem_size = sc_control_msg_memory_size(msg);
+    if (!sc_control_msg_is_droppable(msg)) {
+        // Account the message, but never refuse it
+        sc_memory_budget_force_acquire(SC_MEMORY_POOL_CONTROLLER, mem_size);
+    } else {
+        bool acquired =
+            sc_memory_budget_acquire(SC_MEMORY_POOL_CONTROLLER, mem_size);
+        while (!acquired && wait && !controller->stopped && !controller->eos
+                && !controller->ended) {
+            // Wait for the controller thread to release memory (the budget
+            // is released when a message is removed from the queue)
+            sc_cond_wait(&controller->space_cond, &controller->mutex);
+            acquired =
+                sc_memory_budget_acquire(SC_MEMORY_POOL_CONTROLLER, mem_size);
+        }
+        if (!acquired) {
+            sc_mutex_unlock(&controller->mutex);
+            LOGW("Control message dropped (memory budget exhausted)");
+            return false;
+        }
+    }
+
     size_t size = sc_vecdeque_size(&controller->queue);
     if (size < SC_CONTROL_MSG_QUEUE_LIMIT) {
         bool was_empty = sc_vecdeque_is_empty(&controller->queue);
@@ -118,23 +327,40 @@ sc_controller_push_msg(struct sc_controller *controller,
     }
     // Otherwise, the msg is discarded
 
+    if (pushed) {
+        ++controller->queued_count;
+    } else {
+        sc_memory_budget_release(SC_MEMORY_POOL_CONTROLLER, mem_size);
+    }
+
     sc_mutex_unlock(&controller->mutex);
 
     return pushed;
 }
 
+bool
+sc_controller_push_msg(struct sc_controller *controller,
+                       const struct sc_control_msg *msg) {
+    return sc_controller_push(controller, msg, false);
+}
+
+bool
+sc_controller_push_msg_wait(struct sc_controller *controller,
+                            const struct sc_control_msg *msg) {
+    return sc_controller_push(controller, msg, true);
+}
+
 static bool
 process_msg(struct sc_controller *controller,
             const struct sc_control_msg *msg, bool *eos) {
-    static uint8_t serialized_msg[SC_CONTROL_MSG_MAX_SIZE];
-    size_t length = sc_control_msg_serialize(msg, serialized_msg);
+    size_t length = sc_control_msg_serialize(msg, controller->serialized_msg);
     if (!length) {
         *eos = false;
         return false;
     }
 
-    ssize_t w =
-        net_send_all(controller->control_socket, serialized_msg, length);
+    ssize_t w = net_send_all(controller->control_socket,
+                             controller->serialized_msg, length);
     if ((size_t) w != length) {
         *eos = true;
         return false;
@@ -147,12 +373,17 @@ static int
 run_controller(void *data) {
     struct sc_controller *controller = data;
 
+    struct sc_perf_thread *perf =
+        sc_perf_thread_register("controller", NULL, "message");
+
     bool error = false;
 
     for (;;) {
         sc_mutex_lock(&controller->mutex);
-        while (!controller->stopped
-                && sc_vecdeque_is_empty(&controller->queue)) {
+        while (!controller->stopped && !controller->eos
+                && !controller->tail_length
+                && (controller->sending
+                    || sc_vecdeque_is_empty(&controller->queue))) {
             sc_cond_wait(&controller->msg_cond, &controller->mutex);
         }
         if (controller->stopped) {
@@ -161,14 +392,50 @@ run_controller(void *data) {
             LOGD("Controller stopped");
             break;
         }
+        if (controller->eos) {
+            sc_mutex_unlock(&controller->mutex);
+            LOGD("Controller stopped (socket closed)");
+            break;
+        }
+
+        if (controller->tail_length) {
+            // The tail of a message partially written inline must be sent
+            // before the next message (the "sending" token is still set)
+            assert(controller->sending);
+            size_t offset = controller->tail_offset;
+            size_t length = controller->tail_length;
+            sc_mutex_unlock(&controller->mutex);
+
+            ssize_t w = net_send_all(controller->control_socket,
+                                     controller->serialized_msg + offset,
+                                     length);
+
+            sc_mutex_lock(&controller->mutex);
+            controller->tail_length = 0;
+            controller->sending = false;
+            sc_mutex_unlock(&controller->mutex);
+
+            if ((size_t) w != length) {
+                LOGD("Controller stopped (socket closed)");
+                break;
+            }
+            continue;
+        }
 
         assert(!sc_vecdeque_is_empty(&controller->queue));
-        struct sc_control_msg msg = sc_vecdeque_pop(&controller->queue);
+        struct sc_control_msg msg = sc_controller_queue_pop(controller);
+        controller->sending = true;
+        sc_cond_signal(&controller->space_cond);
         sc_mutex_unlock(&controller->mutex);
 
         bool eos;
         bool ok = process_msg(controller, &msg, &eos);
         sc_control_msg_destroy(&msg);
+
+        sc_mutex_lock(&controller->mutex);
+        controller->sending = false;
+        sc_mutex_unlock(&controller->mutex);
+
         if (!ok) {
             if (eos) {
                 LOGD("Controller stopped (socket closed)");
@@ -176,8 +443,18 @@ run_controller(void *data) {
             error = !eos;
             break;
         }
+
+        sc_perf_thread_add_item(perf);
     }
 
+    sc_perf_thread_unregister(perf);
+
+    sc_mutex_lock(&controller->mutex);
+    controller->ended = true;
+    // Wake up the threads waiting for space in the queue
+    sc_cond_broadcast(&controller->space_cond);
+    sc_mutex_unlock(&controller->mutex);
+
     controller->cbs->on_ended(controller, error, controller->cbs_userdata);
 
     return 0;
@@ -208,6 +485,7 @@ sc_controller_stop(struct sc_controller *controller) {
     sc_mutex_lock(&controller->mutex);
     controller->stopped = true;
     sc_cond_signal(&controller->msg_cond);
+    sc_cond_broadcast(&controller->space_cond);
     sc_mutex_unlock(&controller->mutex);
 }
 
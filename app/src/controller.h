@@ -4,6 +4,7 @@
 #include "common.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "control_msg.h"
 #include "receiver.h"
@@ -19,8 +20,24 @@ struct sc_controller {
     sc_thread thread;
     sc_mutex mutex;
     sc_cond msg_cond;
+    sc_cond space_cond; // signaled when a message is removed from the queue
     bool stopped;
     struct sc_control_msg_queue queue;
+    // A message is being sent, either by the controller thread or inline by
+    // the thread which pushed it (only one at a time, to preserve ordering)
+    bool sending;
+    // The socket has been closed during an inline send
+    bool eos;
+    // Serialization buffer, only accessed by the owner of the "sending" token
+    uint8_t *serialized_msg;
+    // Unsent tail of a message partially written inline (in serialized_msg),
+    // to be sent by the controller thread before any other message
+    size_t tail_offset;
+    size_t tail_length; // 0 if none
+    // The controller thread has terminated (no more messages will be sent)
+    bool ended;
+    uint64_t inline_count;
+    uint64_t queued_count;
     struct sc_receiver receiver;
 
     const struct sc_controller_callbacks *cbs;
@@ -45,6 +62,16 @@ sc_controller_configure(struct sc_controller *controller,
 void
 sc_controller_destroy(struct sc_controller *controller);
 
+/**
+ * Use a new control socket (on reconnection)
+ *
+ * The controller must not be running (it must have been joined). The pending
+ * messages are discarded, because they were intended for the previous
+ * connection.
+ */
+void
+sc_controller_reset(struct sc_controller *controller, sc_socket control_socket);
+
 bool
 sc_controller_start(struct sc_controller *controller);
 
@@ -54,8 +81,37 @@ sc_controller_stop(struct sc_controller *controller);
 void
 sc_controller_join(struct sc_controller *controller);
 
+/**
+ * Push a message to send to the device
+ *
+ * If the controller is idle (no message pending or being sent), the message
+ * is sent immediately from the calling thread, provided that it can be
+ * written without blocking. If only part of it can be written, the
+ * controller thread sends the rest. Otherwise, it is queued for the
+ * controller thread.
+ *
+ * In any case, the calling thread never blocks on the socket.
+ *
+ * On success, the controller takes ownership of the message.
+ */
 bool
 sc_controller_push_msg(struct sc_controller *controller,
                        const struct sc_control_msg *msg);
 
+/**
+ * Push a message to send to the device, waiting for space in the queue
+ *
+ * Contrary to sc_controller_push_msg(), if the queue is full (or if the
+ * controller memory budget is exhausted), droppable messages are not dropped:
+ * the calling thread blocks until the controller thread has consumed enough
+ * messages (or until the controller is stopped).
+ * This provides backpressure to producers which must not lose any event (and
+ * which must not be the UI thread).
+ *
+ * On success, the controller takes ownership of the message.
+ */
+bool
+sc_controller_push_msg_wait(struct sc_controller *controller,
+                            const struct sc_control_msg *msg);
+
 #endif
@@ -1,9 +1,11 @@
 #include "decoder.h"
 
+#include <assert.h>
 #include <errno.h>
 #include <libavcodec/packet.h>
 #include <libavutil/avutil.h>
 
+#include "demuxer.h"
 #include "util/log.h"
 
 /** Downcast packet_sink to decoder */
@@ -33,6 +35,24 @@ sc_decoder_close(struct sc_decoder *decoder) {
     av_frame_free(&decoder->frame);
 }
 
+static void
+sc_decoder_update_stats(struct sc_decoder *decoder, sc_tick decode_start,
+                        bool has_arrival, sc_tick arrival, bool has_frame) {
+    struct sc_stats *stats = decoder->stats;
+    assert(stats);
+
+    sc_tick now = sc_tick_now();
+    sc_stats_add(&stats->decode_time, now - decode_start);
+
+    if (has_frame) {
+        sc_stats_add(&stats->decoded_frames, 1);
+        if (has_arrival) {
+            sc_stats_add(&stats->receive_delay, now - arrival);
+            sc_stats_add(&stats->receive_delay_count, 1);
+        }
+    }
+}
+
 static bool
 sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
     bool is_config = packet->pts == AV_NOPTS_VALUE;
@@ -41,6 +61,23 @@ sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
         return true;
     }
 
+    if (decoder->stats) {
+        sc_stats_add(&decoder->stats->video_bytes, packet->size);
+    }
+
+    bool key_frame = packet->flags & AV_PKT_FLAG_KEY;
+    if (sc_key_frame_filter_must_discard(&decoder->filter, key_frame)) {
+        return true;
+    }
+
+    sc_tick decode_start = 0;
+    sc_tick arrival = 0;
+    bool has_arrival = false;
+    if (decoder->stats) {
+        has_arrival = sc_demuxer_get_packet_arrival(packet, &arrival);
+        decode_start = sc_tick_now();
+    }
+
     int ret = avcodec_send_packet(decoder->ctx, packet);
     if (ret < 0 && ret != AVERROR(EAGAIN)) {
         LOGE("Decoder '%s': could not send video packet: %d",
@@ -50,6 +87,11 @@ sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
 
     for (;;) {
         ret = avcodec_receive_frame(decoder->ctx, decoder->frame);
+        if (decoder->stats) {
+            // Do not include the time spent by the sinks
+            sc_decoder_update_stats(decoder, decode_start, has_arrival,
+                                    arrival, !ret);
+        }
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
             break;
         }
@@ -61,6 +103,7 @@ sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
         }
 
         // a frame was received
+        sc_key_frame_filter_on_frame(&decoder->filter);
         bool ok = sc_frame_source_sinks_push(&decoder->frame_source,
                                              decoder->frame);
         av_frame_unref(decoder->frame);
@@ -68,6 +111,10 @@ sc_decoder_push(struct sc_decoder *decoder, const AVPacket *packet) {
             // Error already logged
             return false;
         }
+
+        if (decoder->stats) {
+            decode_start = sc_tick_now();
+        }
     }
 
     return true;
@@ -93,8 +140,11 @@ sc_decoder_packet_sink_push(struct sc_packet_sink *sink,
 }
 
 void
-sc_decoder_init(struct sc_decoder *decoder, const char *name) {
+sc_decoder_init(struct sc_decoder *decoder, const char *name,
+                struct sc_stats *stats) {
     decoder->name = name; // statically allocated
+    decoder->stats = stats;
+    sc_key_frame_filter_init(&decoder->filter);
     sc_frame_source_init(&decoder->frame_source);
 
     static const struct sc_packet_sink_ops ops = {
@@ -105,3 +155,13 @@ sc_decoder_init(struct sc_decoder *decoder, const char *name) {
 
     decoder->packet_sink.ops = &ops;
 }
+
+void
+sc_decoder_set_discard_non_key(struct sc_decoder *decoder, bool discard) {
+    sc_key_frame_filter_set_discard(&decoder->filter, discard);
+}
+
+bool
+sc_decoder_has_current_frame(struct sc_decoder *decoder) {
+    return sc_key_frame_filter_is_current(&decoder->filter);
+}
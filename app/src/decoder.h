@@ -3,8 +3,11 @@
 
 #include "common.h"
 
+#include <stdbool.h>
 #include <libavcodec/avcodec.h>
 
+#include "key_frame_filter.h"
+#include "stats.h"
 #include "trait/frame_source.h"
 #include "trait/packet_sink.h"
 
@@ -16,10 +19,37 @@ struct sc_decoder {
 
     AVCodecContext *ctx;
     AVFrame *frame;
+
+    struct sc_stats *stats; // may be NULL
+
+    // To discard the non-key packets while the display is paused
+    struct sc_key_frame_filter filter;
 };
 
 // The name must be statically allocated (e.g. a string literal)
+// The stats may be NULL.
+void
+sc_decoder_init(struct sc_decoder *decoder, const char *name,
+                struct sc_stats *stats);
+
+/**
+ * Discard (or stop discarding) all the packets except key frames
+ *
+ * Once disabled, the packets are still discarded until the next key frame. The
+ * caller should request one.
+ *
+ * This function may be called from any thread.
+ */
 void
-sc_decoder_init(struct sc_decoder *decoder, const char *name);
+sc_decoder_set_discard_non_key(struct sc_decoder *decoder, bool discard);
+
+/**
+ * Return true if the last decoded frame is the current one (no packet has been
+ * discarded since)
+ *
+ * This function may be called from any thread.
+ */
+bool
+sc_decoder_has_current_frame(struct sc_decoder *decoder);
 
 #endif
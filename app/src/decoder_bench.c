@@ -0,0 +1,440 @@
+#include "decoder_bench.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/file.h"
+#include "util/log.h"
+#include "util/tick.h"
+
+#define SC_DECODER_BENCH_CACHE_FILENAME "decoders.txt"
+#define SC_DECODER_BENCH_CACHE_MAX_ENTRIES 8
+
+// A frame must be decoded in less than half a frame period at 60 fps (to keep
+// some time for rendering), and must not be delayed by the decoder
+#define SC_DECODER_BENCH_MAX_FRAME_TIME SC_TICK_FROM_MS(8)
+
+/** Downcast packet_sink to sc_decoder_bench */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_decoder_bench, packet_sink)
+
+struct sc_decoder_bench_entry {
+    char codec[32];
+    char decoder[64];
+};
+
+struct sc_decoder_bench_result {
+    sc_tick frame_time; // average decoding time per frame
+    unsigned delayed; // number of frames not output immediately
+};
+
+static enum AVCodecID
+sc_decoder_bench_get_codec_id(enum sc_codec codec) {
+    switch (codec) {
+        case SC_CODEC_H264:
+            return AV_CODEC_ID_H264;
+        case SC_CODEC_H265:
+            return AV_CODEC_ID_HEVC;
+#ifdef SCRCPY_LAVC_HAS_AV1
+        case SC_CODEC_AV1:
+            return AV_CODEC_ID_AV1;
+#endif
+        default:
+            return AV_CODEC_ID_NONE;
+    }
+}
+
+static bool
+sc_decoder_bench_is_candidate(const AVCodec *codec, enum AVCodecID codec_id) {
+    if (codec->id != codec_id || !av_codec_is_decoder(codec)) {
+        return false;
+    }
+
+    int excluded = AV_CODEC_CAP_EXPERIMENTAL;
+#ifdef AV_CODEC_CAP_HARDWARE
+    // Hardware decoders require a specific setup and output hardware frames
+    excluded |= AV_CODEC_CAP_HARDWARE;
+#endif
+    return !(codec->capabilities & excluded);
+}
+
+static const AVCodec *
+sc_decoder_bench_next_candidate(enum AVCodecID codec_id, void **opaque) {
+    const AVCodec *codec;
+#ifdef SCRCPY_LAVC_HAS_CODEC_ITERATE
+    while ((codec = av_codec_iterate(opaque))) {
+#else
+    codec = *opaque;
+    while ((codec = av_codec_next(codec))) {
+        *opaque = (void *) codec;
+#endif
+        if (sc_decoder_bench_is_candidate(codec, codec_id)) {
+            return codec;
+        }
+    }
+
+    return NULL;
+}
+
+static unsigned
+sc_decoder_bench_count_candidates(enum AVCodecID codec_id) {
+    unsigned count = 0;
+    void *opaque = NULL;
+    while (sc_decoder_bench_next_candidate(codec_id, &opaque)) {
+        ++count;
+    }
+    return count;
+}
+
+// Return the number of entries read
+static unsigned
+sc_decoder_bench_read_cache(struct sc_decoder_bench_entry *entries) {
+    char *path = sc_file_get_cache_path(SC_DECODER_BENCH_CACHE_FILENAME);
+    if (!path) {
+        return 0;
+    }
+
+    FILE *file = fopen(path, "r");
+    free(path);
+    if (!file) {
+        // No benchmark run yet
+        return 0;
+    }
+
+    unsigned count = 0;
+
+    // The results are invalidated when FFmpeg is upgraded
+    unsigned version;
+    if (fscanf(file, "libavcodec %u", &version) == 1
+            && version == avcodec_version()) {
+        while (count < SC_DECODER_BENCH_CACHE_MAX_ENTRIES
+                && fscanf(file, "%31s %63s", entries[count].codec,
+                          entries[count].decoder) == 2) {
+            ++count;
+        }
+    }
+
+    fclose(file);
+    return count;
+}
+
+static bool
+sc_decoder_bench_write_cache(const char *codec, const char *decoder) {
+    struct sc_decoder_bench_entry entries[SC_DECODER_BENCH_CACHE_MAX_ENTRIES];
+    unsigned count = sc_decoder_bench_read_cache(entries);
+
+    unsigned i;
+    for (i = 0; i < count; ++i) {
+        if (!strcmp(entries[i].codec, codec)) {
+            break;
+        }
+    }
+    if (i == SC_DECODER_BENCH_CACHE_MAX_ENTRIES) {
+        // Should never happen, there are not so many video codecs
+        i = SC_DECODER_BENCH_CACHE_MAX_ENTRIES - 1;
+    }
+    if (i == count) {
+        ++count;
+    }
+
+    struct sc_decoder_bench_entry *entry = &entries[i];
+    snprintf(entry->codec, sizeof(entry->codec), "%s", codec);
+    snprintf(entry->decoder, sizeof(entry->decoder), "%s", decoder);
+
+    char *path = sc_file_get_cache_path(SC_DECODER_BENCH_CACHE_FILENAME);
+    if (!path) {
+        return false;
+    }
+
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        LOGW("Could not write decoder benchmark cache: %s", path);
+        free(path);
+        return false;
+    }
+
+    fprintf(file, "libavcodec %u\n", avcodec_version());
+    for (i = 0; i < count; ++i) {
+        fprintf(file, "%s %s\n", entries[i].codec, entries[i].decoder);
+    }
+
+    bool ok = !ferror(file);
+    if (fclose(file) || !ok) {
+        LOGW("Could not write decoder benchmark cache: %s", path);
+        ok = false;
+    }
+
+    free(path);
+    return ok;
+}
+
+const char *
+sc_decoder_bench_select(enum sc_codec codec, bool *needs_bench) {
+    *needs_bench = false;
+
+    enum AVCodecID codec_id = sc_decoder_bench_get_codec_id(codec);
+    if (codec_id == AV_CODEC_ID_NONE) {
+        LOGW("Automatic video decoder selection not supported for this codec");
+        return NULL;
+    }
+
+    const char *codec_name = avcodec_get_name(codec_id);
+
+    struct sc_decoder_bench_entry entries[SC_DECODER_BENCH_CACHE_MAX_ENTRIES];
+    unsigned count = sc_decoder_bench_read_cache(entries);
+    for (unsigned i = 0; i < count; ++i) {
+        if (!strcmp(entries[i].codec, codec_name)) {
+            const AVCodec *decoder =
+                avcodec_find_decoder_by_name(entries[i].decoder);
+            if (decoder && sc_decoder_bench_is_candidate(decoder, codec_id)) {
+                LOGI("Video decoder: %s (selected by benchmark)",
+                     decoder->name);
+                return decoder->name;
+            }
+            // The decoder is not available anymore, run the benchmark again
+            break;
+        }
+    }
+
+    unsigned candidates = sc_decoder_bench_count_candidates(codec_id);
+    if (candidates < 2) {
+        LOGD("Video decoder: only one decoder available for %s", codec_name);
+        return NULL;
+    }
+
+    LOGI("Video decoder: benchmarking %u decoders for %s, the fastest will be "
+         "used from the next start", candidates, codec_name);
+    *needs_bench = true;
+    return NULL;
+}
+
+static bool
+sc_decoder_bench_run_decoder(struct sc_decoder_bench *bench,
+                             const AVCodec *codec,
+                             struct sc_decoder_bench_result *result) {
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    // Same configuration as the stream decoder (see run_demuxer())
+    ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    ctx->width = bench->width;
+    ctx->height = bench->height;
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+
+    bool ok = false;
+
+    if (avcodec_open2(ctx, codec, NULL) < 0) {
+        LOGD("Decoder benchmark: could not open %s", codec->name);
+        goto free_context;
+    }
+
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        LOG_OOM();
+        goto free_context;
+    }
+
+    sc_tick total = 0;
+    unsigned frames = 0;
+    unsigned delayed = 0;
+
+    for (unsigned i = 0; i < bench->count; ++i) {
+        if (atomic_load_explicit(&bench->stopped, memory_order_relaxed)) {
+            goto free_frame;
+        }
+
+        const AVPacket *packet = bench->packets[i];
+
+        sc_tick start = sc_tick_now();
+
+        int ret = avcodec_send_packet(ctx, packet);
+        if (ret < 0 && ret != AVERROR(EAGAIN)) {
+            LOGD("Decoder benchmark: %s could not decode", codec->name);
+            goto free_frame;
+        }
+
+        bool output = false;
+        while ((ret = avcodec_receive_frame(ctx, frame)) == 0) {
+            // The other formats are not supported by the pipeline
+            bool supported = frame->format == AV_PIX_FMT_YUV420P;
+            av_frame_unref(frame);
+            if (!supported) {
+                LOGD("Decoder benchmark: %s output format not supported",
+                     codec->name);
+                goto free_frame;
+            }
+            output = true;
+            ++frames;
+        }
+
+        total += sc_tick_now() - start;
+
+        if (ret != AVERROR(EAGAIN)) {
+            LOGD("Decoder benchmark: %s could not decode", codec->name);
+            goto free_frame;
+        }
+
+        if (!output && packet->pts != AV_NOPTS_VALUE) {
+            // The decoder buffers frames, this adds latency
+            ++delayed;
+        }
+    }
+
+    if (!frames) {
+        LOGD("Decoder benchmark: %s did not output any frame", codec->name);
+        goto free_frame;
+    }
+
+    result->frame_time = total / frames;
+    result->delayed = delayed;
+    ok = true;
+
+free_frame:
+    av_frame_free(&frame);
+free_context:
+    avcodec_free_context(&ctx);
+
+    return ok;
+}
+
+static int
+run_decoder_bench(void *data) {
+    struct sc_decoder_bench *bench = data;
+
+    const char *codec_name = avcodec_get_name(bench->codec_id);
+
+    const AVCodec *best = NULL;
+    sc_tick best_frame_time = 0;
+
+    void *opaque = NULL;
+    const AVCodec *codec;
+    while ((codec = sc_decoder_bench_next_candidate(bench->codec_id,
+                                                    &opaque))) {
+        struct sc_decoder_bench_result result;
+        bool ok = sc_decoder_bench_run_decoder(bench, codec, &result);
+
+        if (atomic_load_explicit(&bench->stopped, memory_order_relaxed)) {
+            LOGD("Decoder benchmark interrupted");
+            return 0;
+        }
+
+        if (!ok) {
+            continue;
+        }
+
+        LOGD("Decoder benchmark: %s: %" PRItick " us/frame, %u delayed "
+             "frames", codec->name, result.frame_time, result.delayed);
+
+        bool meets_target = !result.delayed
+                && result.frame_time <= SC_DECODER_BENCH_MAX_FRAME_TIME;
+        if (meets_target && (!best || result.frame_time < best_frame_time)) {
+            best = codec;
+            best_frame_time = result.frame_time;
+        }
+    }
+
+    if (best) {
+        LOGI("Video decoder benchmark: %s selected for %s (%" PRItick
+             " us/frame), it will be used from the next start", best->name,
+             codec_name, best_frame_time);
+    } else {
+        // Store the default decoder, so that the benchmark is not run again
+        best = avcodec_find_decoder(bench->codec_id);
+        if (!best) {
+            return 0;
+        }
+        LOGW("Video decoder benchmark: no decoder meets the latency target for "
+             "%s, keeping the default decoder (%s)", codec_name, best->name);
+    }
+
+    sc_decoder_bench_write_cache(codec_name, best->name);
+
+    return 0;
+}
+
+static bool
+sc_decoder_bench_packet_sink_open(struct sc_packet_sink *sink,
+                                  AVCodecContext *ctx) {
+    struct sc_decoder_bench *bench = DOWNCAST(sink);
+
+    assert(ctx->codec_type == AVMEDIA_TYPE_VIDEO);
+    bench->codec_id = ctx->codec_id;
+    bench->width = ctx->width;
+    bench->height = ctx->height;
+
+    return true;
+}
+
+static void
+sc_decoder_bench_packet_sink_close(struct sc_packet_sink *sink) {
+    struct sc_decoder_bench *bench = DOWNCAST(sink);
+
+    atomic_store_explicit(&bench->stopped, true, memory_order_relaxed);
+}
+
+static bool
+sc_decoder_bench_packet_sink_push(struct sc_packet_sink *sink,
+                                  const AVPacket *packet) {
+    struct sc_decoder_bench *bench = DOWNCAST(sink);
+
+    if (bench->count == SC_DECODER_BENCH_PACKETS) {
+        // Already recorded
+        return true;
+    }
+
+    AVPacket *copy = av_packet_clone(packet);
+    if (!copy) {
+        LOG_OOM();
+        return false;
+    }
+
+    bench->packets[bench->count++] = copy;
+
+    if (bench->count == SC_DECODER_BENCH_PACKETS) {
+        bool ok = sc_thread_create(&bench->thread, run_decoder_bench,
+                                   "scrcpy-decbench", bench);
+        if (!ok) {
+            // Not fatal, the stream is not impacted
+            LOGW("Could not start decoder benchmark thread");
+            return true;
+        }
+
+        bench->started = true;
+    }
+
+    return true;
+}
+
+void
+sc_decoder_bench_init(struct sc_decoder_bench *bench) {
+    bench->codec_id = AV_CODEC_ID_NONE;
+    bench->width = 0;
+    bench->height = 0;
+    bench->count = 0;
+    bench->started = false;
+    atomic_init(&bench->stopped, false);
+
+    static const struct sc_packet_sink_ops ops = {
+        .open = sc_decoder_bench_packet_sink_open,
+        .close = sc_decoder_bench_packet_sink_close,
+        .push = sc_decoder_bench_packet_sink_push,
+    };
+
+    bench->packet_sink.ops = &ops;
+}
+
+void
+sc_decoder_bench_destroy(struct sc_decoder_bench *bench) {
+    if (bench->started) {
+        sc_thread_join(&bench->thread, NULL);
+    }
+
+    for (unsigned i = 0; i < bench->count; ++i) {
+        av_packet_free(&bench->packets[i]);
+    }
+}
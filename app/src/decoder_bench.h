@@ -0,0 +1,63 @@
+#ifndef SC_DECODER_BENCH_H
+#define SC_DECODER_BENCH_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <libavcodec/avcodec.h>
+
+#include "options.h"
+#include "trait/packet_sink.h"
+#include "util/thread.h"
+
+// Number of packets (from the start of the stream) decoded by each decoder
+#define SC_DECODER_BENCH_PACKETS 60
+
+/**
+ * Video decoder benchmark, for --video-decoder=auto
+ *
+ * Several FFmpeg decoders may be available for the same codec (e.g. "h264"
+ * and "libopenh264", "libdav1d" and "av1"), with very different performance
+ * depending on the CPU.
+ *
+ * The benchmark is a packet sink: it records the first packets of the stream,
+ * then decodes them with each candidate decoder on a separate thread (it never
+ * delays the stream). The fastest decoder meeting the latency target is
+ * stored in a cache file, so the benchmark runs only once per machine (and
+ * per FFmpeg version): the selected decoder is used from the next start.
+ */
+struct sc_decoder_bench {
+    struct sc_packet_sink packet_sink; // packet sink trait
+
+    enum AVCodecID codec_id;
+    int width;
+    int height;
+
+    AVPacket *packets[SC_DECODER_BENCH_PACKETS];
+    unsigned count;
+
+    sc_thread thread;
+    bool started;
+    atomic_bool stopped; // the stream is closed, abort the benchmark
+};
+
+/**
+ * Resolve --video-decoder=auto
+ *
+ * Return the name of the decoder selected by a previous benchmark for the
+ * video codec, or NULL to use the default decoder. Set *needs_bench if a
+ * benchmark should be run (the result is not cached and several decoders are
+ * available).
+ */
+const char *
+sc_decoder_bench_select(enum sc_codec codec, bool *needs_bench);
+
+void
+sc_decoder_bench_init(struct sc_decoder_bench *bench);
+
+// Wait for the benchmark to complete (it is aborted if the stream is closed)
+void
+sc_decoder_bench_destroy(struct sc_decoder_bench *bench);
+
+#endif
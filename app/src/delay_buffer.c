@@ -1,16 +1,30 @@
 #include "delay_buffer.h"
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <libavcodec/avcodec.h>
 
+#include "memory_budget.h"
+#include "perf_counter.h"
 #include "util/log.h"
 
 /** Downcast frame_sink to sc_delay_buffer */
 #define DOWNCAST(SINK) container_of(SINK, struct sc_delay_buffer, frame_sink)
 
+static size_t
+sc_frame_memory_size(const AVFrame *frame) {
+    size_t size = sizeof(*frame);
+    for (unsigned i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; ++i) {
+        size += frame->buf[i]->size;
+    }
+    return size;
+}
+
 static bool
-sc_delayed_frame_init(struct sc_delayed_frame *dframe, const AVFrame *frame) {
+sc_delayed_frame_init(struct sc_delayed_frame *dframe, const AVFrame *frame,
+                      size_t size) {
+    dframe->size = size;
     dframe->frame = av_frame_alloc();
     if (!dframe->frame) {
         LOG_OOM();
@@ -30,6 +44,7 @@ static void
 sc_delayed_frame_destroy(struct sc_delayed_frame *dframe) {
     av_frame_unref(dframe->frame);
     av_frame_free(&dframe->frame);
+    sc_memory_budget_release(SC_MEMORY_POOL_DELAY_BUFFER, dframe->size);
 }
 
 static int
@@ -38,6 +53,9 @@ run_buffering(void *data) {
 
     assert(db->delay > 0);
 
+    struct sc_perf_thread *perf =
+        sc_perf_thread_register("buffering", NULL, "frame");
+
     for (;;) {
         sc_mutex_lock(&db->mutex);
 
@@ -91,6 +109,8 @@ run_buffering(void *data) {
             sc_mutex_unlock(&db->mutex);
             goto stopped;
         }
+
+        sc_perf_thread_add_item(perf);
     }
 
 stopped:
@@ -102,6 +122,8 @@ stopped:
         sc_delayed_frame_destroy(dframe);
     }
 
+    sc_perf_thread_unregister(perf);
+
     LOGD("Buffering thread ended");
 
     return 0;
@@ -131,6 +153,7 @@ sc_delay_buffer_frame_sink_open(struct sc_frame_sink *sink,
     sc_clock_init(&db->clock);
     sc_vecdeque_init(&db->queue);
     db->stopped = false;
+    db->dropped = 0;
 
     if (!sc_frame_source_sinks_open(&db->frame_source, ctx)) {
         goto error_destroy_wait_cond;
@@ -168,6 +191,11 @@ sc_delay_buffer_frame_sink_close(struct sc_frame_sink *sink) {
 
     sc_thread_join(&db->thread, NULL);
 
+    if (db->dropped) {
+        LOGW("Delay buffer: %" PRIu64 " frames dropped (memory budget "
+             "exhausted)", db->dropped);
+    }
+
     sc_frame_source_sinks_close(&db->frame_source);
 
     sc_cond_destroy(&db->wait_cond);
@@ -196,9 +224,22 @@ sc_delay_buffer_frame_sink_push(struct sc_frame_sink *sink,
         return sc_frame_source_sinks_push(&db->frame_source, frame);
     }
 
+    size_t size = sc_frame_memory_size(frame);
+    if (!sc_memory_budget_acquire(SC_MEMORY_POOL_DELAY_BUFFER, size)) {
+        // Drop the frame, the next ones will be buffered once the queue is
+        // consumed
+        if (!db->dropped) {
+            LOGW("Delay buffer: memory budget exhausted, dropping frames");
+        }
+        ++db->dropped;
+        sc_mutex_unlock(&db->mutex);
+        return true;
+    }
+
     struct sc_delayed_frame dframe;
-    bool ok = sc_delayed_frame_init(&dframe, frame);
+    bool ok = sc_delayed_frame_init(&dframe, frame, size);
     if (!ok) {
+        sc_memory_budget_release(SC_MEMORY_POOL_DELAY_BUFFER, size);
         sc_mutex_unlock(&db->mutex);
         return false;
     }
@@ -211,6 +252,7 @@ sc_delay_buffer_frame_sink_push(struct sc_frame_sink *sink,
     if (!ok) {
         sc_mutex_unlock(&db->mutex);
         LOG_OOM();
+        sc_delayed_frame_destroy(&dframe);
         return false;
     }
 
@@ -4,6 +4,8 @@
 #include "common.h"
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <libavutil/frame.h>
 
 #include "clock.h"
@@ -20,6 +22,7 @@ typedef struct AVFrame AVFrame;
 
 struct sc_delayed_frame {
     AVFrame *frame;
+    size_t size; // memory accounted in the memory budget
 #ifdef SC_BUFFERING_DEBUG
     sc_tick push_date;
 #endif
@@ -42,6 +45,8 @@ struct sc_delay_buffer {
     struct sc_clock clock;
     struct sc_delayed_frame_queue queue;
     bool stopped;
+    // frames dropped because the memory budget was exhausted
+    uint64_t dropped;
 };
 
 struct sc_delay_buffer_callbacks {
@@ -4,8 +4,11 @@
 #include <inttypes.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/channel_layout.h>
+#include <libavutil/time.h>
 
+#include "config_packet.h"
 #include "packet_merger.h"
+#include "perf_counter.h"
 #include "util/binary.h"
 #include "util/log.h"
 
@@ -77,6 +80,47 @@ sc_demuxer_recv_video_size(struct sc_demuxer *demuxer, uint32_t *width,
     return true;
 }
 
+static bool
+sc_demuxer_set_packet_arrival(AVPacket *packet, int64_t timestamp) {
+#ifdef SCRCPY_LAVC_HAS_PRFT
+    // The producer reference time side data contains a wall clock time in
+    // microseconds, which is exactly what the kernel provides
+    AVProducerReferenceTime *prft = (AVProducerReferenceTime *)
+        av_packet_new_side_data(packet, AV_PKT_DATA_PRFT, sizeof(*prft));
+    if (!prft) {
+        LOG_OOM();
+        return false;
+    }
+
+    prft->wallclock = timestamp;
+    prft->flags = 0;
+#else
+    (void) packet;
+    (void) timestamp;
+#endif
+    return true;
+}
+
+bool
+sc_demuxer_get_packet_arrival(const AVPacket *packet, sc_tick *arrival) {
+#ifdef SCRCPY_LAVC_HAS_PRFT
+    const AVProducerReferenceTime *prft = (const AVProducerReferenceTime *)
+        av_packet_get_side_data(packet, AV_PKT_DATA_PRFT, NULL);
+    if (!prft) {
+        return false;
+    }
+
+    // Convert from the wall clock to the monotonic clock
+    int64_t elapsed = av_gettime() - prft->wallclock;
+    *arrival = sc_tick_now() - SC_TICK_FROM_US(elapsed);
+    return true;
+#else
+    (void) packet;
+    (void) arrival;
+    return false;
+#endif
+}
+
 static bool
 sc_demuxer_recv_packet(struct sc_demuxer *demuxer, AVPacket *packet) {
     // The video and audio streams contain a sequence of raw packets (as
@@ -100,7 +144,11 @@ sc_demuxer_recv_packet(struct sc_demuxer *demuxer, AVPacket *packet) {
     //  `-- config packet
 
     uint8_t header[SC_PACKET_HEADER_SIZE];
-    ssize_t r = net_recv_all(demuxer->socket, header, SC_PACKET_HEADER_SIZE);
+    int64_t timestamp = -1;
+    ssize_t r = demuxer->recv_timestamps
+              ? net_recv_all_timestamped(demuxer->socket, header,
+                                         SC_PACKET_HEADER_SIZE, &timestamp)
+              : net_recv_all(demuxer->socket, header, SC_PACKET_HEADER_SIZE);
     if (r < SC_PACKET_HEADER_SIZE) {
         return false;
     }
@@ -131,9 +179,39 @@ sc_demuxer_recv_packet(struct sc_demuxer *demuxer, AVPacket *packet) {
     }
 
     packet->dts = packet->pts;
+
+    if (timestamp != -1 && !sc_demuxer_set_packet_arrival(packet, timestamp)) {
+        av_packet_unref(packet);
+        return false;
+    }
+
     return true;
 }
 
+static void
+sc_demuxer_announce_video_size(struct sc_demuxer *demuxer,
+                               enum AVCodecID codec_id, const AVPacket *packet,
+                               struct sc_size *video_size) {
+    struct sc_size size;
+    bool ok = sc_config_packet_parse_video_size(codec_id, packet->data,
+                                                packet->size, &size);
+    if (!ok) {
+        LOGD("Demuxer '%s': could not parse the video size from the config "
+             "packet", demuxer->name);
+        return;
+    }
+
+    if (size.width == video_size->width
+            && size.height == video_size->height) {
+        return;
+    }
+
+    LOGD("Demuxer '%s': new video size: %" PRIu16 "x%" PRIu16, demuxer->name,
+         size.width, size.height);
+    *video_size = size;
+    demuxer->cbs->on_video_size(demuxer, size, demuxer->cbs_userdata);
+}
+
 static int
 run_demuxer(void *data) {
     struct sc_demuxer *demuxer = data;
@@ -141,6 +219,20 @@ run_demuxer(void *data) {
     // Flag to report end-of-stream (i.e. device disconnected)
     enum sc_demuxer_status status = SC_DEMUXER_STATUS_ERROR;
 
+    // The packet sinks (including the decoder) run on the demuxer thread
+    struct sc_perf_thread *perf =
+        sc_perf_thread_register("demuxer", demuxer->name, "packet");
+
+#ifdef SCRCPY_LAVC_HAS_PRFT
+    // Record the kernel arrival time of each packet, to separate the network
+    // latency from the scheduling latency of the demuxer thread
+    demuxer->recv_timestamps = net_set_recv_timestamps(demuxer->socket, true);
+    if (!demuxer->recv_timestamps) {
+        LOGD("Demuxer '%s': kernel receive timestamps not available",
+             demuxer->name);
+    }
+#endif
+
     uint32_t raw_codec_id;
     bool ok = sc_demuxer_recv_codec_id(demuxer, &raw_codec_id);
     if (!ok) {
@@ -171,14 +263,28 @@ run_demuxer(void *data) {
         goto end;
     }
 
-    const AVCodec *codec = avcodec_find_decoder(codec_id);
-    if (!codec) {
-        LOGE("Demuxer '%s': stream disabled due to missing decoder",
-             demuxer->name);
-        sc_packet_source_sinks_disable(&demuxer->packet_source);
-        goto end;
+    const AVCodec *codec;
+    if (demuxer->decoder_name) {
+        codec = avcodec_find_decoder_by_name(demuxer->decoder_name);
+        if (!codec || codec->id != codec_id) {
+            LOGE("Demuxer '%s': decoder '%s' not found for codec %s",
+                 demuxer->name, demuxer->decoder_name,
+                 avcodec_get_name(codec_id));
+            sc_packet_source_sinks_disable(&demuxer->packet_source);
+            goto end;
+        }
+    } else {
+        codec = avcodec_find_decoder(codec_id);
+        if (!codec) {
+            LOGE("Demuxer '%s': stream disabled due to missing decoder",
+                 demuxer->name);
+            sc_packet_source_sinks_disable(&demuxer->packet_source);
+            goto end;
+        }
     }
 
+    LOGD("Demuxer '%s': using decoder %s", demuxer->name, codec->name);
+
     AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
     if (!codec_ctx) {
         LOG_OOM();
@@ -187,6 +293,9 @@ run_demuxer(void *data) {
 
     codec_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
 
+    // The last video size, to announce the changes
+    struct sc_size video_size = {0, 0};
+
     if (codec->type == AVMEDIA_TYPE_VIDEO) {
         uint32_t width;
         uint32_t height;
@@ -198,6 +307,8 @@ run_demuxer(void *data) {
         codec_ctx->width = width;
         codec_ctx->height = height;
         codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+        video_size.width = width;
+        video_size.height = height;
     } else {
         // Hardcoded audio properties
 #ifdef SCRCPY_LAVU_HAS_CHLAYOUT
@@ -223,6 +334,11 @@ run_demuxer(void *data) {
         goto finally_free_context;
     }
 
+    // Parse the config packets to announce the video size changes before the
+    // frames are decoded
+    bool announce_video_size = codec->type == AVMEDIA_TYPE_VIDEO
+                            && demuxer->cbs->on_video_size;
+
     // Config packets must be merged with the next non-config packet only for
     // H.26x
     bool must_merge_config_packet = raw_codec_id == SC_CODEC_ID_H264
@@ -248,6 +364,11 @@ run_demuxer(void *data) {
             break;
         }
 
+        if (announce_video_size && packet->pts == AV_NOPTS_VALUE) {
+            sc_demuxer_announce_video_size(demuxer, codec_id, packet,
+                                           &video_size);
+        }
+
         if (must_merge_config_packet) {
             // Prepend any config packet to the next media packet
             ok = sc_packet_merger_merge(&merger, packet);
@@ -263,6 +384,8 @@ run_demuxer(void *data) {
             // The sink already logged its concrete error
             break;
         }
+
+        sc_perf_thread_add_item(perf);
     }
 
     LOGD("Demuxer '%s': end of frames", demuxer->name);
@@ -277,6 +400,8 @@ finally_close_sinks:
 finally_free_context:
     avcodec_free_context(&codec_ctx);
 end:
+    sc_perf_thread_unregister(perf);
+
     demuxer->cbs->on_ended(demuxer, status, demuxer->cbs_userdata);
 
     return 0;
@@ -284,11 +409,14 @@ end:
 
 void
 sc_demuxer_init(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
+                const char *decoder_name,
                 const struct sc_demuxer_callbacks *cbs, void *cbs_userdata) {
     assert(socket != SC_SOCKET_NONE);
 
     demuxer->name = name; // statically allocated
+    demuxer->decoder_name = decoder_name;
     demuxer->socket = socket;
+    demuxer->recv_timestamps = false;
     sc_packet_source_init(&demuxer->packet_source);
 
     assert(cbs && cbs->on_ended);
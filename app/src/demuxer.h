@@ -4,19 +4,26 @@
 #include "common.h"
 
 #include <stdbool.h>
+#include <libavcodec/avcodec.h>
 
+#include "coords.h"
 #include "trait/packet_source.h"
 #include "util/net.h"
 #include "util/thread.h"
+#include "util/tick.h"
 
 struct sc_demuxer {
     struct sc_packet_source packet_source; // packet source trait
 
     const char *name; // must be statically allocated (e.g. a string literal)
+    // FFmpeg decoder name, or NULL for the default decoder of the codec
+    const char *decoder_name;
 
     sc_socket socket;
     sc_thread thread;
 
+    bool recv_timestamps; // kernel receive timestamps enabled
+
     const struct sc_demuxer_callbacks *cbs;
     void *cbs_userdata;
 };
@@ -30,11 +37,19 @@ enum sc_demuxer_status {
 struct sc_demuxer_callbacks {
     void (*on_ended)(struct sc_demuxer *demuxer, enum sc_demuxer_status,
                      void *userdata);
+
+    // Called (if not NULL) from the demuxer thread when a config packet
+    // announces a new video size, before the frames of that size are decoded
+    void (*on_video_size)(struct sc_demuxer *demuxer, struct sc_size size,
+                          void *userdata);
 };
 
 // The name must be statically allocated (e.g. a string literal)
+//
+// The decoder_name (if not NULL) must outlive the demuxer.
 void
 sc_demuxer_init(struct sc_demuxer *demuxer, const char *name, sc_socket socket,
+                const char *decoder_name,
                 const struct sc_demuxer_callbacks *cbs, void *cbs_userdata);
 
 bool
@@ -43,4 +58,14 @@ sc_demuxer_start(struct sc_demuxer *demuxer);
 void
 sc_demuxer_join(struct sc_demuxer *demuxer);
 
+/**
+ * Retrieve the time when the first byte of the packet has been received by the
+ * kernel (converted to sc_tick), as recorded by the demuxer
+ *
+ * This excludes the scheduling delay of the demuxer thread. Return false if
+ * kernel receive timestamps are not available.
+ */
+bool
+sc_demuxer_get_packet_arrival(const AVPacket *packet, sc_tick *arrival);
+
 #endif
@@ -44,6 +44,7 @@ sc_display_init(struct sc_display *display, SDL_Window *window,
     LOGI("Renderer: %s", renderer_name ? renderer_name : "(unknown)");
 
     display->mipmaps = false;
+    display->mipmaps_max_level = false;
 
 #ifdef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
     display->gl_context = NULL;
@@ -80,6 +81,9 @@ sc_display_init(struct sc_display *display, SDL_Window *window,
             if (supports_mipmaps) {
                 LOGI("Trilinear filtering enabled");
                 display->mipmaps = true;
+                display->mipmaps_max_level =
+                    sc_opengl_version_at_least(gl, 1, 2, /* OpenGL 1.2+ */
+                                                   3, 0  /* OpenGL ES 3.0+ */);
             } else {
                 LOGW("Trilinear filtering disabled "
                      "(OpenGL 3.0+ or ES 2.0+ required)");
@@ -92,6 +96,7 @@ sc_display_init(struct sc_display *display, SDL_Window *window,
     }
 
     display->texture = NULL;
+    display->prepared.texture = NULL;
     display->pending.flags = 0;
     display->pending.frame = NULL;
     display->has_frame = false;
@@ -119,6 +124,9 @@ sc_display_destroy(struct sc_display *display) {
 #ifdef SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
     SDL_GL_DeleteContext(display->gl_context);
 #endif
+    if (display->prepared.texture) {
+        SDL_DestroyTexture(display->prepared.texture);
+    }
     if (display->texture) {
         SDL_DestroyTexture(display->texture);
     }
@@ -142,9 +150,9 @@ sc_display_create_texture(struct sc_display *display,
 
         SDL_GL_BindTexture(texture, NULL, NULL);
 
-        // Enable trilinear filtering for downscaling
-        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                          GL_LINEAR_MIPMAP_LINEAR);
+        // Trilinear filtering is enabled on render, only if the texture is
+        // downscaled
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         gl->TexParameterf(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, -1.f);
 
         SDL_GL_UnbindTexture(texture);
@@ -153,6 +161,105 @@ sc_display_create_texture(struct sc_display *display,
     return texture;
 }
 
+// Must be called whenever display->texture is replaced
+static void
+sc_display_reset_mipmap_state(struct sc_display *display) {
+    if (display->mipmaps) {
+        display->mipmap_state.dirty = true;
+        display->mipmap_state.level = 0;
+        display->mipmap_state.min_filter_mipmap = false;
+    }
+}
+
+// Return the index of the last level of a full mipmap chain
+static int
+sc_display_get_mipmap_max_level(int tex_w, int tex_h) {
+    int level = 0;
+    int size = MAX(tex_w, tex_h);
+    while (size > 1) {
+        size >>= 1;
+        ++level;
+    }
+    return level;
+}
+
+/**
+ * Return the highest mipmap level sampled to render a texture of size
+ * (tex_w, tex_h) into (dst_w, dst_h), 0 if no mipmaps are necessary
+ */
+static int
+sc_display_compute_mipmap_level(int tex_w, int tex_h, int dst_w, int dst_h) {
+    if (dst_w <= 0 || dst_h <= 0) {
+        return 0;
+    }
+
+    // With a LOD bias of -1, the level of detail is log2(ratio) - 1 (where
+    // ratio is the downscaling factor), and trilinear filtering samples the
+    // two levels around it. The level 0 alone is used (magnification filter)
+    // if the level of detail is not positive.
+    //
+    // So the highest level sampled is the smallest L such that
+    // ratio <= 2^(L+1).
+    int max_level = sc_display_get_mipmap_max_level(tex_w, tex_h);
+    int level = 0;
+    while (level < max_level
+            && ((int64_t) dst_w << (level + 1) < tex_w
+                || (int64_t) dst_h << (level + 1) < tex_h)) {
+        ++level;
+    }
+    return level;
+}
+
+static void
+sc_display_update_mipmaps(struct sc_display *display, int dst_w, int dst_h) {
+    assert(display->mipmaps);
+
+    int tex_w;
+    int tex_h;
+    if (SDL_QueryTexture(display->texture, NULL, NULL, &tex_w, &tex_h)) {
+        return;
+    }
+
+    int level = sc_display_compute_mipmap_level(tex_w, tex_h, dst_w, dst_h);
+    if (!display->mipmaps_max_level && level) {
+        // Only the full mipmap chain may be generated
+        level = sc_display_get_mipmap_max_level(tex_w, tex_h);
+    }
+
+    bool use_mipmaps = level > 0;
+    bool generate = use_mipmaps && (display->mipmap_state.dirty
+                                    || level > display->mipmap_state.level);
+    bool set_filter =
+        use_mipmaps != display->mipmap_state.min_filter_mipmap;
+    if (!generate && !set_filter) {
+        // Nothing to do (e.g. the window is not smaller than the video)
+        return;
+    }
+
+    struct sc_opengl *gl = &display->gl;
+
+    SDL_GL_BindTexture(display->texture, NULL, NULL);
+
+    if (generate) {
+        if (display->mipmaps_max_level) {
+            // glGenerateMipmap() only generates the levels up to
+            // GL_TEXTURE_MAX_LEVEL
+            gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+        }
+        gl->GenerateMipmap(GL_TEXTURE_2D);
+        display->mipmap_state.dirty = false;
+        display->mipmap_state.level = level;
+    }
+
+    if (set_filter) {
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                          use_mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        display->mipmap_state.min_filter_mipmap = use_mipmaps;
+    }
+
+    SDL_GL_UnbindTexture(display->texture);
+}
+
 static inline void
 sc_display_set_pending_size(struct sc_display *display, struct sc_size size) {
     assert(!display->texture);
@@ -197,6 +304,7 @@ sc_display_apply_pending(struct sc_display *display) {
             return false;
         }
 
+        sc_display_reset_mipmap_state(display);
         display->pending.flags &= ~SC_DISPLAY_PENDING_FLAG_SIZE;
     }
 
@@ -222,14 +330,26 @@ sc_display_set_texture_size_internal(struct sc_display *display,
 
     if (display->texture) {
         SDL_DestroyTexture(display->texture);
+        display->texture = NULL;
     }
 
-    display->texture = sc_display_create_texture(display, size);
-    if (!display->texture) {
-        return false;
+    bool prepared = display->prepared.texture
+                 && display->prepared.size.width == size.width
+                 && display->prepared.size.height == size.height;
+    if (prepared) {
+        display->texture = display->prepared.texture;
+        display->prepared.texture = NULL;
+    } else {
+        display->texture = sc_display_create_texture(display, size);
+        if (!display->texture) {
+            return false;
+        }
     }
 
-    LOGI("Texture: %" PRIu16 "x%" PRIu16, size.width, size.height);
+    sc_display_reset_mipmap_state(display);
+
+    LOGI("Texture: %" PRIu16 "x%" PRIu16 "%s", size.width, size.height,
+         prepared ? " (prepared)" : "");
     return true;
 }
 
@@ -245,6 +365,29 @@ sc_display_set_texture_size(struct sc_display *display, struct sc_size size) {
     return SC_DISPLAY_RESULT_OK;
 }
 
+void
+sc_display_prepare_texture(struct sc_display *display, struct sc_size size) {
+    assert(size.width && size.height);
+
+    if (display->prepared.texture) {
+        if (display->prepared.size.width == size.width
+                && display->prepared.size.height == size.height) {
+            // Already prepared
+            return;
+        }
+
+        SDL_DestroyTexture(display->prepared.texture);
+    }
+
+    // On error, the texture will just be created when the frame size changes
+    display->prepared.texture = sc_display_create_texture(display, size);
+    display->prepared.size = size;
+    if (display->prepared.texture) {
+        LOGD("Texture prepared: %" PRIu16 "x%" PRIu16, size.width,
+                                                       size.height);
+    }
+}
+
 static SDL_YUV_CONVERSION_MODE
 sc_display_to_sdl_color_range(enum AVColorRange color_range) {
     return color_range == AVCOL_RANGE_JPEG ? SDL_YUV_CONVERSION_JPEG
@@ -274,9 +417,8 @@ sc_display_update_texture_internal(struct sc_display *display,
     }
 
     if (display->mipmaps) {
-        SDL_GL_BindTexture(display->texture, NULL, NULL);
-        display->gl.GenerateMipmap(GL_TEXTURE_2D);
-        SDL_GL_UnbindTexture(display->texture);
+        // The mipmaps will be generated on render, if necessary
+        display->mipmap_state.dirty = true;
     }
 
     return true;
@@ -300,7 +442,8 @@ sc_display_update_texture(struct sc_display *display, const AVFrame *frame) {
 
 enum sc_display_result
 sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
-                  enum sc_orientation orientation) {
+                  enum sc_orientation orientation,
+                  struct sc_overlay *overlay) {
     SDL_RenderClear(display->renderer);
 
     if (display->pending.flags) {
@@ -313,6 +456,13 @@ sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
     SDL_Renderer *renderer = display->renderer;
     SDL_Texture *texture = display->texture;
 
+    if (display->mipmaps && geometry) {
+        bool swap = sc_orientation_is_swap(orientation);
+        int dst_w = swap ? geometry->h : geometry->w;
+        int dst_h = swap ? geometry->w : geometry->h;
+        sc_display_update_mipmaps(display, dst_w, dst_h);
+    }
+
     if (orientation == SC_ORIENTATION_0) {
         int ret = SDL_RenderCopy(renderer, texture, NULL, geometry);
         if (ret) {
@@ -346,6 +496,10 @@ sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
         }
     }
 
+    if (overlay) {
+        sc_overlay_render(overlay);
+    }
+
     SDL_RenderPresent(display->renderer);
     return SC_DISPLAY_RESULT_OK;
 }
@@ -11,6 +11,7 @@
 #include "coords.h"
 #include "opengl.h"
 #include "options.h"
+#include "overlay.h"
 
 #ifdef __APPLE__
 # define SC_DISPLAY_FORCE_OPENGL_CORE_PROFILE
@@ -26,6 +27,23 @@ struct sc_display {
 #endif
 
     bool mipmaps;
+    // GL_TEXTURE_MAX_LEVEL is supported, so that only the mipmap levels
+    // actually sampled may be generated
+    bool mipmaps_max_level;
+    // The mipmaps are generated lazily, on render, up to the level required
+    // by the rendering size
+    struct {
+        bool dirty; // the texture content changed since the last generation
+        int level; // highest level generated, 0 if none
+        bool min_filter_mipmap; // GL_LINEAR_MIPMAP_LINEAR is set
+    } mipmap_state;
+
+    // Texture created in advance for an announced frame size, to be used
+    // (instead of creating a new one) when the frame size changes
+    struct {
+        SDL_Texture *texture; // may be NULL
+        struct sc_size size;
+    } prepared;
 
     struct {
 #define SC_DISPLAY_PENDING_FLAG_SIZE 1
@@ -54,11 +72,18 @@ sc_display_destroy(struct sc_display *display);
 enum sc_display_result
 sc_display_set_texture_size(struct sc_display *display, struct sc_size size);
 
+// Create a texture in advance for a frame size announced by the stream (before
+// the frames of that size are decoded)
+void
+sc_display_prepare_texture(struct sc_display *display, struct sc_size size);
+
 enum sc_display_result
 sc_display_update_texture(struct sc_display *display, const AVFrame *frame);
 
+// The overlay may be NULL
 enum sc_display_result
 sc_display_render(struct sc_display *display, const SDL_Rect *geometry,
-                  enum sc_orientation orientation);
+                  enum sc_orientation orientation,
+                  struct sc_overlay *overlay);
 
 #endif
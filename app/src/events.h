@@ -17,9 +17,13 @@ enum {
     SC_EVENT_DEMUXER_ERROR,
     SC_EVENT_RECORDER_ERROR,
     SC_EVENT_SCREEN_INIT_SIZE,
+    SC_EVENT_SCREEN_PREPARE_SIZE,
     SC_EVENT_TIME_LIMIT_REACHED,
     SC_EVENT_CONTROLLER_ERROR,
     SC_EVENT_AOA_OPEN_ERROR,
+    SC_EVENT_OVERLAY_REFRESH,
+    SC_EVENT_RECONNECT,
+    SC_EVENT_REPLAY_ENDED,
 };
 
 bool
@@ -0,0 +1,520 @@
+#include "file_demuxer.h"
+
+#include <assert.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+#ifdef SCRCPY_LAVC_HAS_BSF_HEADER
+# include <libavcodec/bsf.h>
+#endif
+#include <libavformat/avformat.h>
+
+#include "packet_merger.h"
+#include "perf_counter.h"
+#include "util/log.h"
+
+// Like the packets received from the device, timestamps are in microseconds
+static const AVRational SC_FILE_DEMUXER_TIME_BASE = {1, 1000000};
+
+// The stream being read
+struct sc_file_demuxer_stream {
+    int index;
+    AVRational time_base; // of the packets to push (after filtering)
+    int64_t origin; // start time of the file, in microseconds
+    // To prepend the config packet to the next media packet (H.26x only)
+    struct sc_packet_merger *merger;
+    struct sc_perf_thread *perf;
+};
+
+static bool
+sc_file_demuxer_is_supported(enum AVCodecID codec_id) {
+    // The codecs which may be sent by the device
+    switch (codec_id) {
+        case AV_CODEC_ID_H264:
+        case AV_CODEC_ID_HEVC:
+#ifdef SCRCPY_LAVC_HAS_AV1
+        case AV_CODEC_ID_AV1:
+#endif
+        case AV_CODEC_ID_OPUS:
+        case AV_CODEC_ID_AAC:
+        case AV_CODEC_ID_FLAC:
+        case AV_CODEC_ID_PCM_S16LE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static const char *
+sc_file_demuxer_get_bsf_name(enum AVCodecID codec_id) {
+    // The device sends H.26x in Annex B format, while containers like MP4 or
+    // MKV store it in AVCC/HVCC format
+    switch (codec_id) {
+        case AV_CODEC_ID_H264:
+            return "h264_mp4toannexb";
+        case AV_CODEC_ID_HEVC:
+            return "hevc_mp4toannexb";
+        default:
+            return NULL;
+    }
+}
+
+static inline bool
+sc_file_demuxer_is_stopped(struct sc_file_demuxer *demuxer) {
+    return atomic_load_explicit(&demuxer->stopped, memory_order_relaxed);
+}
+
+static int
+sc_file_demuxer_interrupt_cb(void *opaque) {
+    struct sc_file_demuxer *demuxer = opaque;
+    // Interrupt blocking I/O on stop
+    return sc_file_demuxer_is_stopped(demuxer);
+}
+
+// Return false if the demuxer is stopped
+static bool
+sc_file_demuxer_wait(struct sc_file_demuxer *demuxer, sc_tick deadline) {
+    sc_mutex_lock(&demuxer->mutex);
+    bool timed_out = false;
+    while (!sc_file_demuxer_is_stopped(demuxer) && !timed_out) {
+        timed_out = !sc_cond_timedwait(&demuxer->cond, &demuxer->mutex,
+                                       deadline);
+    }
+    bool stopped = sc_file_demuxer_is_stopped(demuxer);
+    sc_mutex_unlock(&demuxer->mutex);
+
+    return !stopped;
+}
+
+static const AVCodec *
+sc_file_demuxer_find_decoder(struct sc_file_demuxer *demuxer,
+                             enum AVCodecID codec_id) {
+    if (demuxer->decoder_name) {
+        const AVCodec *codec =
+            avcodec_find_decoder_by_name(demuxer->decoder_name);
+        if (!codec || codec->id != codec_id) {
+            LOGE("Demuxer '%s': decoder '%s' not found for codec %s",
+                 demuxer->name, demuxer->decoder_name,
+                 avcodec_get_name(codec_id));
+            return NULL;
+        }
+        return codec;
+    }
+
+    const AVCodec *codec = avcodec_find_decoder(codec_id);
+    if (!codec) {
+        LOGE("Demuxer '%s': stream disabled due to missing decoder",
+             demuxer->name);
+    }
+    return codec;
+}
+
+static AVBSFContext *
+sc_file_demuxer_open_bsf(struct sc_file_demuxer *demuxer, const char *name,
+                         const AVStream *stream) {
+    const AVBitStreamFilter *filter = av_bsf_get_by_name(name);
+    if (!filter) {
+        LOGE("Demuxer '%s': bitstream filter %s not found", demuxer->name,
+             name);
+        return NULL;
+    }
+
+    AVBSFContext *bsf;
+    if (av_bsf_alloc(filter, &bsf) < 0) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    if (avcodec_parameters_copy(bsf->par_in, stream->codecpar) < 0) {
+        LOG_OOM();
+        av_bsf_free(&bsf);
+        return NULL;
+    }
+
+    bsf->time_base_in = stream->time_base;
+
+    if (av_bsf_init(bsf) < 0) {
+        LOGE("Demuxer '%s': could not initialize bitstream filter %s",
+             demuxer->name, name);
+        av_bsf_free(&bsf);
+        return NULL;
+    }
+
+    return bsf;
+}
+
+static bool
+sc_file_demuxer_push_config(struct sc_file_demuxer *demuxer,
+                            struct sc_file_demuxer_stream *stream,
+                            const AVCodecParameters *par, AVPacket *packet) {
+    if (av_new_packet(packet, par->extradata_size)) {
+        LOG_OOM();
+        return false;
+    }
+
+    memcpy(packet->data, par->extradata, par->extradata_size);
+    packet->pts = AV_NOPTS_VALUE;
+    packet->dts = AV_NOPTS_VALUE;
+
+    bool ok = !stream->merger
+           || sc_packet_merger_merge(stream->merger, packet);
+    if (ok) {
+        ok = sc_packet_source_sinks_push(&demuxer->packet_source, packet);
+    }
+
+    av_packet_unref(packet);
+    return ok;
+}
+
+// The packet timestamps are in the stream time base
+static bool
+sc_file_demuxer_push(struct sc_file_demuxer *demuxer,
+                     struct sc_file_demuxer_stream *stream, AVPacket *packet) {
+    av_packet_rescale_ts(packet, stream->time_base,
+                         SC_FILE_DEMUXER_TIME_BASE);
+
+    int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    if (pts == AV_NOPTS_VALUE) {
+        // It would be considered as a config packet by the sinks
+        LOGD("Demuxer '%s': packet without timestamp ignored",
+             demuxer->name);
+        return true;
+    }
+
+    int64_t dts = packet->dts != AV_NOPTS_VALUE ? packet->dts : pts;
+
+    if (demuxer->paced) {
+        // Pace in decoding order
+        sc_tick deadline =
+            demuxer->epoch + SC_TICK_FROM_US(dts - stream->origin);
+        if (!sc_file_demuxer_wait(demuxer, deadline)) {
+            return false;
+        }
+    }
+
+    packet->pts = pts - stream->origin;
+    packet->dts = dts - stream->origin;
+
+#ifdef SCRCPY_LAVC_HAS_PRFT
+    // A producer reference time stored in the file must not be interpreted as
+    // the arrival time of the packet
+    if (av_packet_get_side_data(packet, AV_PKT_DATA_PRFT, NULL)) {
+        av_packet_free_side_data(packet);
+    }
+#endif
+
+    if (stream->merger && !sc_packet_merger_merge(stream->merger, packet)) {
+        return false;
+    }
+
+    if (!sc_packet_source_sinks_push(&demuxer->packet_source, packet)) {
+        // The sink already logged its concrete error
+        return false;
+    }
+
+    sc_perf_thread_add_item(stream->perf);
+    return true;
+}
+
+// Push all the packets available from the bitstream filter
+static bool
+sc_file_demuxer_drain_bsf(struct sc_file_demuxer *demuxer,
+                          struct sc_file_demuxer_stream *stream,
+                          AVBSFContext *bsf, AVPacket *packet) {
+    int r;
+    while ((r = av_bsf_receive_packet(bsf, packet)) >= 0) {
+        bool ok = sc_file_demuxer_push(demuxer, stream, packet);
+        av_packet_unref(packet);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    if (r != AVERROR(EAGAIN) && r != AVERROR_EOF) {
+        LOGE("Demuxer '%s': could not filter packet", demuxer->name);
+        return false;
+    }
+
+    return true;
+}
+
+static int
+run_file_demuxer(void *data) {
+    struct sc_file_demuxer *demuxer = data;
+
+    enum sc_demuxer_status status = SC_DEMUXER_STATUS_ERROR;
+
+    // The packet sinks (including the decoder) run on the demuxer thread
+    struct sc_file_demuxer_stream stream = {
+        .perf = sc_perf_thread_register("demuxer", demuxer->name, "packet"),
+    };
+
+    AVFormatContext *fmt = avformat_alloc_context();
+    if (!fmt) {
+        LOG_OOM();
+        goto end;
+    }
+
+    fmt->interrupt_callback.callback = sc_file_demuxer_interrupt_cb;
+    fmt->interrupt_callback.opaque = demuxer;
+
+    // On error, fmt is freed
+    if (avformat_open_input(&fmt, demuxer->filename, NULL, NULL) < 0) {
+        LOGE("Demuxer '%s': could not open file: %s", demuxer->name,
+             demuxer->filename);
+        goto end;
+    }
+
+    if (avformat_find_stream_info(fmt, NULL) < 0) {
+        LOGE("Demuxer '%s': could not read stream info: %s", demuxer->name,
+             demuxer->filename);
+        goto finally_close_input;
+    }
+
+    int index = av_find_best_stream(fmt, demuxer->type, -1, -1, NULL, 0);
+    if (index < 0) {
+        LOGW("Demuxer '%s': no %s stream in %s", demuxer->name,
+             av_get_media_type_string(demuxer->type), demuxer->filename);
+        sc_packet_source_sinks_disable(&demuxer->packet_source);
+        status = SC_DEMUXER_STATUS_DISABLED;
+        goto finally_close_input;
+    }
+
+    // Only read the selected stream (the other one is read by another
+    // instance)
+    for (unsigned i = 0; i < fmt->nb_streams; ++i) {
+        if ((int) i != index) {
+            fmt->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    AVStream *st = fmt->streams[index];
+    stream.index = index;
+    stream.time_base = st->time_base;
+    stream.origin = fmt->start_time != AV_NOPTS_VALUE ? fmt->start_time : 0;
+
+    enum AVCodecID codec_id = st->codecpar->codec_id;
+    if (!sc_file_demuxer_is_supported(codec_id)) {
+        LOGE("Demuxer '%s': stream disabled due to unsupported codec %s",
+             demuxer->name, avcodec_get_name(codec_id));
+        sc_packet_source_sinks_disable(&demuxer->packet_source);
+        goto finally_close_input;
+    }
+
+    const AVCodec *codec = sc_file_demuxer_find_decoder(demuxer, codec_id);
+    if (!codec) {
+        sc_packet_source_sinks_disable(&demuxer->packet_source);
+        goto finally_close_input;
+    }
+
+    LOGD("Demuxer '%s': using decoder %s", demuxer->name, codec->name);
+
+    AVBSFContext *bsf = NULL;
+    const char *bsf_name = sc_file_demuxer_get_bsf_name(codec_id);
+    if (bsf_name) {
+        bsf = sc_file_demuxer_open_bsf(demuxer, bsf_name, st);
+        if (!bsf) {
+            goto finally_close_input;
+        }
+        stream.time_base = bsf->time_base_out;
+    }
+
+    // The parameters of the packets actually pushed
+    const AVCodecParameters *par = bsf ? bsf->par_out : st->codecpar;
+
+    // The device sends a config packet for all codecs except raw audio
+    bool has_config_packet = codec_id != AV_CODEC_ID_PCM_S16LE;
+    if (has_config_packet && !par->extradata_size) {
+        LOGE("Demuxer '%s': no codec configuration in %s", demuxer->name,
+             demuxer->filename);
+        goto finally_free_bsf;
+    }
+
+    AVCodecContext *codec_ctx = avcodec_alloc_context3(codec);
+    if (!codec_ctx) {
+        LOG_OOM();
+        goto finally_free_bsf;
+    }
+
+    if (avcodec_parameters_to_context(codec_ctx, par) < 0) {
+        LOG_OOM();
+        goto finally_free_context;
+    }
+
+    if (codec_ctx->has_b_frames > 0) {
+        // The device never sends B-frames: the decoders are configured for
+        // low delay, and the sinks expect the packets in presentation order
+        LOGE("Demuxer '%s': stream with B-frames not supported: %s",
+             demuxer->name, demuxer->filename);
+        goto finally_free_context;
+    }
+
+    codec_ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
+    if (codec_id == AV_CODEC_ID_FLAC
+            && codec_ctx->sample_fmt == AV_SAMPLE_FMT_NONE) {
+        // The sample_fmt is not set by the FLAC decoder
+        codec_ctx->sample_fmt = AV_SAMPLE_FMT_S16;
+    }
+
+    if (avcodec_open2(codec_ctx, codec, NULL) < 0) {
+        LOGE("Demuxer '%s': could not open codec", demuxer->name);
+        goto finally_free_context;
+    }
+
+    if (!sc_packet_source_sinks_open(&demuxer->packet_source, codec_ctx)) {
+        goto finally_free_context;
+    }
+
+    // Config packets must be merged with the next non-config packet only for
+    // H.26x (like sc_demuxer)
+    struct sc_packet_merger merger;
+    if (bsf) {
+        sc_packet_merger_init(&merger);
+        stream.merger = &merger;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        LOG_OOM();
+        goto finally_close_sinks;
+    }
+
+    if (has_config_packet
+            && !sc_file_demuxer_push_config(demuxer, &stream, par, packet)) {
+        goto finally_free_packet;
+    }
+
+    for (;;) {
+        int r = av_read_frame(fmt, packet);
+        if (r < 0) {
+            if (r == AVERROR_EOF || sc_file_demuxer_is_stopped(demuxer)) {
+                // Push the packets retained by the filter, if any
+                if (!bsf || (av_bsf_send_packet(bsf, NULL) >= 0
+                        && sc_file_demuxer_drain_bsf(demuxer, &stream, bsf,
+                                                     packet))) {
+                    status = SC_DEMUXER_STATUS_EOS;
+                }
+            } else {
+                LOGE("Demuxer '%s': could not read packet", demuxer->name);
+            }
+            break;
+        }
+
+        if (packet->stream_index != stream.index) {
+            av_packet_unref(packet);
+            continue;
+        }
+
+        bool ok;
+        if (bsf) {
+            // On success, the filter takes ownership of the packet data
+            ok = av_bsf_send_packet(bsf, packet) >= 0;
+            av_packet_unref(packet);
+            ok = ok && sc_file_demuxer_drain_bsf(demuxer, &stream, bsf,
+                                                 packet);
+        } else {
+            ok = sc_file_demuxer_push(demuxer, &stream, packet);
+            av_packet_unref(packet);
+        }
+
+        if (!ok) {
+            if (sc_file_demuxer_is_stopped(demuxer)) {
+                status = SC_DEMUXER_STATUS_EOS;
+            }
+            break;
+        }
+    }
+
+    LOGD("Demuxer '%s': end of frames", demuxer->name);
+
+finally_free_packet:
+    av_packet_free(&packet);
+finally_close_sinks:
+    if (bsf) {
+        sc_packet_merger_destroy(&merger);
+    }
+    sc_packet_source_sinks_close(&demuxer->packet_source);
+finally_free_context:
+    avcodec_free_context(&codec_ctx);
+finally_free_bsf:
+    av_bsf_free(&bsf);
+finally_close_input:
+    avformat_close_input(&fmt);
+end:
+    sc_perf_thread_unregister(stream.perf);
+
+    demuxer->cbs->on_ended(demuxer, status, demuxer->cbs_userdata);
+
+    return 0;
+}
+
+bool
+sc_file_demuxer_init(struct sc_file_demuxer *demuxer, const char *name,
+                     const char *filename, enum AVMediaType type,
+                     const char *decoder_name, bool paced,
+                     const struct sc_file_demuxer_callbacks *cbs,
+                     void *cbs_userdata) {
+    assert(filename);
+    assert(type == AVMEDIA_TYPE_VIDEO || type == AVMEDIA_TYPE_AUDIO);
+
+    bool ok = sc_mutex_init(&demuxer->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&demuxer->cond);
+    if (!ok) {
+        sc_mutex_destroy(&demuxer->mutex);
+        return false;
+    }
+
+    demuxer->name = name; // statically allocated
+    demuxer->filename = filename;
+    demuxer->type = type;
+    demuxer->decoder_name = decoder_name;
+    demuxer->paced = paced;
+    demuxer->epoch = 0;
+    atomic_init(&demuxer->stopped, false);
+    sc_packet_source_init(&demuxer->packet_source);
+
+    assert(cbs && cbs->on_ended);
+
+    demuxer->cbs = cbs;
+    demuxer->cbs_userdata = cbs_userdata;
+
+    return true;
+}
+
+bool
+sc_file_demuxer_start(struct sc_file_demuxer *demuxer, sc_tick epoch) {
+    LOGD("Demuxer '%s': starting thread", demuxer->name);
+
+    demuxer->epoch = epoch;
+
+    bool ok = sc_thread_create(&demuxer->thread, run_file_demuxer,
+                               "scrcpy-demuxer", demuxer);
+    if (!ok) {
+        LOGE("Demuxer '%s': could not start thread", demuxer->name);
+        return false;
+    }
+    return true;
+}
+
+void
+sc_file_demuxer_stop(struct sc_file_demuxer *demuxer) {
+    sc_mutex_lock(&demuxer->mutex);
+    atomic_store_explicit(&demuxer->stopped, true, memory_order_relaxed);
+    sc_cond_signal(&demuxer->cond);
+    sc_mutex_unlock(&demuxer->mutex);
+}
+
+void
+sc_file_demuxer_join(struct sc_file_demuxer *demuxer) {
+    sc_thread_join(&demuxer->thread, NULL);
+}
+
+void
+sc_file_demuxer_destroy(struct sc_file_demuxer *demuxer) {
+    sc_cond_destroy(&demuxer->cond);
+    sc_mutex_destroy(&demuxer->mutex);
+}
@@ -0,0 +1,81 @@
+#ifndef SC_FILE_DEMUXER_H
+#define SC_FILE_DEMUXER_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <libavutil/avutil.h>
+
+#include "demuxer.h"
+#include "trait/packet_source.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+/**
+ * Demuxer reading a stream from a local file, for --replay
+ *
+ * The file may be any container supported by libavformat (typically a
+ * recording), with a codec supported by scrcpy (H.264, H.265 or AV1 for
+ * video; Opus, AAC, FLAC or raw PCM for audio).
+ *
+ * It provides the packets to its sinks exactly like sc_demuxer (a config
+ * packet, then the media packets, with their PTS in microseconds), so that the
+ * whole pipeline (decoders, recorder, screen, V4L2 sink, audio player) may be
+ * exercised without any device. Like the device streams, the video stream
+ * must not contain B-frames (such a file is rejected).
+ *
+ * Like for the sockets, each stream is read by its own instance (and thread).
+ * If pacing is enabled, each packet is pushed at the time given by its
+ * timestamp, relative to the epoch passed to sc_file_demuxer_start() (the
+ * same epoch for all streams keeps them synchronized). Otherwise, the packets
+ * are pushed as fast as the sinks accept them.
+ */
+struct sc_file_demuxer {
+    struct sc_packet_source packet_source; // packet source trait
+
+    const char *name; // must be statically allocated (e.g. a string literal)
+    const char *filename;
+    enum AVMediaType type; // AVMEDIA_TYPE_VIDEO or AVMEDIA_TYPE_AUDIO
+    // FFmpeg decoder name, or NULL for the default decoder of the codec
+    const char *decoder_name;
+    bool paced;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    atomic_bool stopped;
+    sc_tick epoch; // time of the start of the file, if paced
+
+    const struct sc_file_demuxer_callbacks *cbs;
+    void *cbs_userdata;
+};
+
+struct sc_file_demuxer_callbacks {
+    void (*on_ended)(struct sc_file_demuxer *demuxer, enum sc_demuxer_status,
+                     void *userdata);
+};
+
+// The name must be statically allocated (e.g. a string literal)
+//
+// The filename and the decoder_name (if not NULL) must outlive the demuxer.
+bool
+sc_file_demuxer_init(struct sc_file_demuxer *demuxer, const char *name,
+                     const char *filename, enum AVMediaType type,
+                     const char *decoder_name, bool paced,
+                     const struct sc_file_demuxer_callbacks *cbs,
+                     void *cbs_userdata);
+
+bool
+sc_file_demuxer_start(struct sc_file_demuxer *demuxer, sc_tick epoch);
+
+void
+sc_file_demuxer_stop(struct sc_file_demuxer *demuxer);
+
+void
+sc_file_demuxer_join(struct sc_file_demuxer *demuxer);
+
+void
+sc_file_demuxer_destroy(struct sc_file_demuxer *demuxer);
+
+#endif
@@ -0,0 +1,192 @@
+#include "frame_checker.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <libavutil/pixdesc.h>
+
+#include "frame_marker.h"
+#include "util/log.h"
+
+/** Downcast frame_sink to sc_frame_checker */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_frame_checker, frame_sink)
+
+static bool
+sc_frame_checker_is_supported(const AVFrame *frame) {
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    uint64_t unsupported_flags = AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL;
+    if (!desc || (desc->flags & unsupported_flags)) {
+        return false;
+    }
+
+    // The marker is read from a 8-bit luma plane
+    const AVComponentDescriptor *luma = &desc->comp[0];
+    return luma->plane == 0 && luma->step == 1 && luma->depth == 8
+        && frame->width >= SC_FRAME_MARKER_WIDTH
+        && frame->height >= SC_FRAME_MARKER_HEIGHT;
+}
+
+static bool
+sc_frame_checker_frame_sink_open(struct sc_frame_sink *sink,
+                                 const AVCodecContext *ctx) {
+    (void) sink;
+    (void) ctx;
+
+    // Nothing to do, the state is initialized by sc_frame_checker_init()
+    return true;
+}
+
+static void
+sc_frame_checker_frame_sink_close(struct sc_frame_sink *sink) {
+    struct sc_frame_checker *checker = DOWNCAST(sink);
+    const struct sc_frame_checker_stats *stats = &checker->stats;
+
+    uint64_t valid = stats->frames - stats->unreadable;
+    if (!valid) {
+        LOGI("Frame checker: %" PRIu64 " frames, no valid marker",
+             stats->frames);
+        return;
+    }
+
+    LOGI("Frame checker: %" PRIu64 " frames (%" PRIu64 " unreadable), "
+         "%" PRIu64 " dropped, %" PRIu64 " duplicated, %" PRIu64 " reordered, "
+         "%" PRIu64 " too late", stats->frames, stats->unreadable,
+         stats->dropped, stats->duplicated, stats->reordered,
+         stats->too_late);
+    LOGI("Frame checker: latency min=%" PRItick "us avg=%" PRItick "us "
+         "max=%" PRItick "us", stats->latency_min,
+         stats->latency_sum / (sc_tick) valid, stats->latency_max);
+}
+
+static bool
+sc_frame_checker_frame_sink_push(struct sc_frame_sink *sink,
+                                 const AVFrame *frame) {
+    struct sc_frame_checker *checker = DOWNCAST(sink);
+    struct sc_frame_checker_stats *stats = &checker->stats;
+
+    sc_tick now = sc_tick_now();
+
+    ++stats->frames;
+    atomic_fetch_add_explicit(&checker->received, 1, memory_order_relaxed);
+
+    struct sc_frame_marker marker;
+    if (!sc_frame_checker_is_supported(frame)
+            || !sc_frame_marker_read(frame->data[0], frame->linesize[0],
+                                     &marker)) {
+        LOGV("Frame checker: no valid marker in frame %" PRIu64,
+             stats->frames - 1);
+        ++stats->unreadable;
+        return true;
+    }
+
+    sc_tick latency = now - marker.timestamp;
+    stats->latency_min = MIN(stats->latency_min, latency);
+    stats->latency_max = MAX(stats->latency_max, latency);
+    stats->latency_sum += latency;
+
+    sc_tick bucket = latency / SC_FRAME_CHECKER_LATENCY_BUCKET_SIZE;
+    bucket = CLAMP(bucket, 0, SC_FRAME_CHECKER_LATENCY_BUCKETS - 1);
+    atomic_fetch_add_explicit(&checker->latency_histogram[bucket], 1,
+                              memory_order_relaxed);
+
+    // The first frame generated is numbered 0
+    uint32_t expected = checker->has_number ? checker->last_number + 1 : 0;
+    if (marker.number >= expected) {
+        if (marker.number > expected) {
+            LOGV("Frame checker: frames %" PRIu32 " to %" PRIu32 " missing",
+                 expected, marker.number - 1);
+            stats->dropped += marker.number - expected;
+        }
+
+        uint32_t shift = marker.number - expected + 1;
+        checker->received_mask =
+            shift < 64 ? checker->received_mask << shift : 0;
+        checker->received_mask |= 1;
+        checker->last_number = marker.number;
+        checker->has_number = true;
+        return true;
+    }
+
+    uint32_t age = checker->last_number - marker.number;
+    if (age >= 64) {
+        // Beyond the window, it is unknown whether the frame was missing
+        LOGV("Frame checker: frame %" PRIu32 " too late", marker.number);
+        ++stats->too_late;
+        return true;
+    }
+
+    uint64_t bit = UINT64_C(1) << age;
+    if (checker->received_mask & bit) {
+        LOGV("Frame checker: frame %" PRIu32 " duplicated", marker.number);
+        ++stats->duplicated;
+    } else {
+        // The frame was counted as dropped when a later frame was received
+        LOGV("Frame checker: frame %" PRIu32 " reordered", marker.number);
+        assert(stats->dropped);
+        --stats->dropped;
+        ++stats->reordered;
+        checker->received_mask |= bit;
+    }
+
+    return true;
+}
+
+void
+sc_frame_checker_init(struct sc_frame_checker *checker) {
+    checker->has_number = false;
+    checker->received_mask = 0;
+    checker->stats = (struct sc_frame_checker_stats) {
+        .latency_min = INT64_MAX,
+    };
+
+    atomic_init(&checker->received, 0);
+    for (unsigned i = 0; i < SC_FRAME_CHECKER_LATENCY_BUCKETS; ++i) {
+        atomic_init(&checker->latency_histogram[i], 0);
+    }
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_frame_checker_frame_sink_open,
+        .close = sc_frame_checker_frame_sink_close,
+        .push = sc_frame_checker_frame_sink_push,
+    };
+
+    checker->frame_sink.ops = &ops;
+}
+
+void
+sc_frame_checker_get_latency_histogram(struct sc_frame_checker *checker,
+                        uint64_t histogram[SC_FRAME_CHECKER_LATENCY_BUCKETS]) {
+    for (unsigned i = 0; i < SC_FRAME_CHECKER_LATENCY_BUCKETS; ++i) {
+        histogram[i] = atomic_load_explicit(&checker->latency_histogram[i],
+                                            memory_order_relaxed);
+    }
+}
+
+sc_tick
+sc_frame_checker_get_latency_percentile(
+        const uint64_t histogram[SC_FRAME_CHECKER_LATENCY_BUCKETS],
+        double percentile) {
+    uint64_t total = 0;
+    for (unsigned i = 0; i < SC_FRAME_CHECKER_LATENCY_BUCKETS; ++i) {
+        total += histogram[i];
+    }
+
+    if (!total) {
+        return -1;
+    }
+
+    // Rank of the requested value (at least 1)
+    uint64_t rank = (uint64_t) (total * percentile / 100);
+    rank = CLAMP(rank, 1, total);
+
+    uint64_t count = 0;
+    for (unsigned i = 0; i < SC_FRAME_CHECKER_LATENCY_BUCKETS; ++i) {
+        count += histogram[i];
+        if (count >= rank) {
+            // Upper bound of the bucket
+            return (i + 1) * SC_FRAME_CHECKER_LATENCY_BUCKET_SIZE;
+        }
+    }
+
+    assert(!"unreachable");
+    return -1;
+}
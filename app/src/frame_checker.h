@@ -0,0 +1,81 @@
+#ifndef SC_FRAME_CHECKER_H
+#define SC_FRAME_CHECKER_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "trait/frame_sink.h"
+#include "util/tick.h"
+
+/**
+ * Frame sink reading the marker (see frame_marker.h) embedded in each frame,
+ * to detect dropped, duplicated or reordered frames and measure the latency
+ * between the frame generation and its decoding.
+ */
+
+// Latency histogram, with buckets of 1 ms (the last one also counts the
+// larger latencies)
+#define SC_FRAME_CHECKER_LATENCY_BUCKETS 1000
+#define SC_FRAME_CHECKER_LATENCY_BUCKET_SIZE SC_TICK_FROM_MS(1)
+
+struct sc_frame_checker_stats {
+    uint64_t frames; // total number of frames received
+    uint64_t unreadable; // frames without a valid marker
+    uint64_t dropped; // never received (so far)
+    uint64_t duplicated;
+    uint64_t reordered; // received late (not counted as dropped)
+    // received too late to know whether it was missing or duplicated
+    uint64_t too_late;
+
+    // latency of frames with a valid marker
+    sc_tick latency_min;
+    sc_tick latency_max;
+    sc_tick latency_sum;
+};
+
+struct sc_frame_checker {
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    bool has_number;
+    // Highest frame number received
+    uint32_t last_number;
+    // Bit i is set if frame (last_number - i) has been received, to count a
+    // late frame (previously counted as dropped) once (the older frames are
+    // counted as too late)
+    uint64_t received_mask;
+
+    // Only accessed from the frame source thread while the sink is open, so
+    // it must not be read before the source is stopped
+    struct sc_frame_checker_stats stats;
+
+    // May be read from any thread at any time (e.g. to monitor a long run)
+    atomic_uint_least64_t received;
+    atomic_uint_least64_t latency_histogram[SC_FRAME_CHECKER_LATENCY_BUCKETS];
+};
+
+void
+sc_frame_checker_init(struct sc_frame_checker *checker);
+
+/**
+ * Copy the latency histogram (of the frames with a valid marker) received so
+ * far
+ *
+ * It may be called from any thread.
+ */
+void
+sc_frame_checker_get_latency_histogram(struct sc_frame_checker *checker,
+                        uint64_t histogram[SC_FRAME_CHECKER_LATENCY_BUCKETS]);
+
+/**
+ * Return the latency at the given percentile (in [0; 100]) of a histogram,
+ * or -1 if it is empty
+ */
+sc_tick
+sc_frame_checker_get_latency_percentile(
+        const uint64_t histogram[SC_FRAME_CHECKER_LATENCY_BUCKETS],
+        double percentile);
+
+#endif
@@ -0,0 +1,94 @@
+#include "frame_marker.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "util/binary.h"
+
+// 32 bits for the number, 64 bits for the timestamp, 32 bits for the bitwise
+// complement of the number (to detect corrupted markers)
+#define SC_FRAME_MARKER_BYTES 16
+static_assert(SC_FRAME_MARKER_BYTES * 8
+                    == SC_FRAME_MARKER_COLS * SC_FRAME_MARKER_ROWS,
+              "Marker grid size mismatch");
+
+#define SC_FRAME_MARKER_BLACK 16
+#define SC_FRAME_MARKER_WHITE 235
+#define SC_FRAME_MARKER_THRESHOLD 128
+
+// Only the center of each block is sampled on read, to ignore the ringing
+// artifacts near the block edges
+#define SC_FRAME_MARKER_SAMPLE_MARGIN (SC_FRAME_MARKER_BLOCK_SIZE / 4)
+
+static void
+sc_frame_marker_fill_block(uint8_t *luma, int linesize, unsigned col,
+                           unsigned row, uint8_t value) {
+    uint8_t *line = luma + row * SC_FRAME_MARKER_BLOCK_SIZE * linesize
+                         + col * SC_FRAME_MARKER_BLOCK_SIZE;
+    for (unsigned y = 0; y < SC_FRAME_MARKER_BLOCK_SIZE; ++y) {
+        memset(line, value, SC_FRAME_MARKER_BLOCK_SIZE);
+        line += linesize;
+    }
+}
+
+static bool
+sc_frame_marker_sample_block(const uint8_t *luma, int linesize, unsigned col,
+                             unsigned row) {
+    const unsigned margin = SC_FRAME_MARKER_SAMPLE_MARGIN;
+    const unsigned size = SC_FRAME_MARKER_BLOCK_SIZE - 2 * margin;
+
+    const uint8_t *line =
+        luma + (row * SC_FRAME_MARKER_BLOCK_SIZE + margin) * linesize
+             + col * SC_FRAME_MARKER_BLOCK_SIZE + margin;
+
+    unsigned sum = 0;
+    for (unsigned y = 0; y < size; ++y) {
+        for (unsigned x = 0; x < size; ++x) {
+            sum += line[x];
+        }
+        line += linesize;
+    }
+
+    return sum / (size * size) >= SC_FRAME_MARKER_THRESHOLD;
+}
+
+void
+sc_frame_marker_draw(uint8_t *luma, int linesize,
+                     const struct sc_frame_marker *marker) {
+    uint8_t data[SC_FRAME_MARKER_BYTES];
+    sc_write32be(data, marker->number);
+    sc_write64be(&data[4], (uint64_t) marker->timestamp);
+    sc_write32be(&data[12], ~marker->number);
+
+    for (unsigned i = 0; i < SC_FRAME_MARKER_BYTES * 8; ++i) {
+        bool bit = data[i / 8] & (0x80 >> (i % 8));
+        uint8_t value = bit ? SC_FRAME_MARKER_WHITE : SC_FRAME_MARKER_BLACK;
+        sc_frame_marker_fill_block(luma, linesize, i % SC_FRAME_MARKER_COLS,
+                                   i / SC_FRAME_MARKER_COLS, value);
+    }
+}
+
+bool
+sc_frame_marker_read(const uint8_t *luma, int linesize,
+                     struct sc_frame_marker *marker) {
+    uint8_t data[SC_FRAME_MARKER_BYTES] = {0};
+
+    for (unsigned i = 0; i < SC_FRAME_MARKER_BYTES * 8; ++i) {
+        bool bit = sc_frame_marker_sample_block(luma, linesize,
+                                                i % SC_FRAME_MARKER_COLS,
+                                                i / SC_FRAME_MARKER_COLS);
+        if (bit) {
+            data[i / 8] |= 0x80 >> (i % 8);
+        }
+    }
+
+    uint32_t number = sc_read32be(data);
+    uint32_t check = sc_read32be(&data[12]);
+    if (number != (uint32_t) ~check) {
+        return false;
+    }
+
+    marker->number = number;
+    marker->timestamp = (sc_tick) sc_read64be(&data[4]);
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef SC_FRAME_MARKER_H
+#define SC_FRAME_MARKER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "util/tick.h"
+
+/**
+ * Machine-readable marker drawn into the luma plane of a video frame.
+ *
+ * It encodes a frame number and a timestamp as a grid of black and white
+ * blocks in the top-left corner of the frame. The blocks are large and
+ * aligned on macroblocks so that the marker survives lossy encoding.
+ *
+ * It is used by the test stream generator (tools/teststream.c) and read back
+ * by the frame checker to detect dropped, duplicated or reordered frames and
+ * to measure the latency of the client pipeline.
+ */
+
+#define SC_FRAME_MARKER_BLOCK_SIZE 16
+#define SC_FRAME_MARKER_COLS 16
+#define SC_FRAME_MARKER_ROWS 8
+
+#define SC_FRAME_MARKER_WIDTH \
+    (SC_FRAME_MARKER_COLS * SC_FRAME_MARKER_BLOCK_SIZE)
+#define SC_FRAME_MARKER_HEIGHT \
+    (SC_FRAME_MARKER_ROWS * SC_FRAME_MARKER_BLOCK_SIZE)
+
+struct sc_frame_marker {
+    uint32_t number;
+    sc_tick timestamp;
+};
+
+/**
+ * Draw the marker into a 8-bit luma plane
+ *
+ * The plane must be at least SC_FRAME_MARKER_WIDTH x SC_FRAME_MARKER_HEIGHT.
+ */
+void
+sc_frame_marker_draw(uint8_t *luma, int linesize,
+                     const struct sc_frame_marker *marker);
+
+/**
+ * Read the marker from a 8-bit luma plane
+ *
+ * Return false if the plane does not contain a valid marker.
+ */
+bool
+sc_frame_marker_read(const uint8_t *luma, int linesize,
+                     struct sc_frame_marker *marker);
+
+#endif
@@ -3,18 +3,9 @@
 #include <assert.h>
 #include <string.h>
 
+#include "keymap.h"
 #include "util/log.h"
 
-#define SC_HID_MOD_NONE 0x00
-#define SC_HID_MOD_LEFT_CONTROL (1 << 0)
-#define SC_HID_MOD_LEFT_SHIFT (1 << 1)
-#define SC_HID_MOD_LEFT_ALT (1 << 2)
-#define SC_HID_MOD_LEFT_GUI (1 << 3)
-#define SC_HID_MOD_RIGHT_CONTROL (1 << 4)
-#define SC_HID_MOD_RIGHT_SHIFT (1 << 5)
-#define SC_HID_MOD_RIGHT_ALT (1 << 6)
-#define SC_HID_MOD_RIGHT_GUI (1 << 7)
-
 #define SC_HID_KEYBOARD_INDEX_MODS 0
 #define SC_HID_KEYBOARD_INDEX_KEYS 2
 
@@ -211,36 +202,6 @@ sc_hid_keyboard_input_init(struct sc_hid_input *hid_input) {
     memset(&data[SC_HID_KEYBOARD_INDEX_KEYS], 0, SC_HID_KEYBOARD_MAX_KEYS);
 }
 
-static uint16_t
-sc_hid_mod_from_sdl_keymod(uint16_t mod) {
-    uint16_t mods = SC_HID_MOD_NONE;
-    if (mod & SC_MOD_LCTRL) {
-        mods |= SC_HID_MOD_LEFT_CONTROL;
-    }
-    if (mod & SC_MOD_LSHIFT) {
-        mods |= SC_HID_MOD_LEFT_SHIFT;
-    }
-    if (mod & SC_MOD_LALT) {
-        mods |= SC_HID_MOD_LEFT_ALT;
-    }
-    if (mod & SC_MOD_LGUI) {
-        mods |= SC_HID_MOD_LEFT_GUI;
-    }
-    if (mod & SC_MOD_RCTRL) {
-        mods |= SC_HID_MOD_RIGHT_CONTROL;
-    }
-    if (mod & SC_MOD_RSHIFT) {
-        mods |= SC_HID_MOD_RIGHT_SHIFT;
-    }
-    if (mod & SC_MOD_RALT) {
-        mods |= SC_HID_MOD_RIGHT_ALT;
-    }
-    if (mod & SC_MOD_RGUI) {
-        mods |= SC_HID_MOD_RIGHT_GUI;
-    }
-    return mods;
-}
-
 void
 sc_hid_keyboard_init(struct sc_hid_keyboard *hid) {
     memset(hid->keys, false, SC_HID_KEYBOARD_KEYS);
@@ -268,7 +229,7 @@ sc_hid_keyboard_generate_input_from_key(struct sc_hid_keyboard *hid,
 
     sc_hid_keyboard_input_init(hid_input);
 
-    uint16_t mods = sc_hid_mod_from_sdl_keymod(event->mods_state);
+    uint8_t mods = sc_keymap_to_hid_mods(event->mods_state);
 
     if (scancode < SC_HID_KEYBOARD_KEYS) {
         // Pressed is true and released is false
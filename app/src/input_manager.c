@@ -406,6 +406,12 @@ sc_input_manager_process_key(struct sc_input_manager *im,
         }
     }
 
+    if (video && !down && sdl_keycode == SDLK_s) {
+        // Stop a screenshot burst even if the shortcut modifiers have been
+        // released first
+        sc_screen_set_screenshot_burst(im->screen, false);
+    }
+
     if (is_shortcut) {
         enum sc_action action = down ? SC_ACTION_DOWN : SC_ACTION_UP;
         switch (sdl_keycode) {
@@ -421,7 +427,16 @@ sc_input_manager_process_key(struct sc_input_manager *im,
                 }
                 return;
             case SDLK_s:
-                if (im->kp && !shift && !repeat && !paused) {
+                if (shift) {
+                    if (video && down) {
+                        if (!repeat) {
+                            sc_screen_take_screenshot(im->screen);
+                        } else {
+                            // Kept pressed: capture every new frame
+                            sc_screen_set_screenshot_burst(im->screen, true);
+                        }
+                    }
+                } else if (im->kp && !repeat && !paused) {
                     action_app_switch(im, action);
                 }
                 return;
@@ -446,6 +461,18 @@ sc_input_manager_process_key(struct sc_input_manager *im,
                     sc_screen_set_paused(im->screen, !shift);
                 }
                 return;
+            case SDLK_a:
+                if (control && video && down && !repeat && !paused) {
+                    if (shift) {
+                        sc_screen_reset_crop(im->screen);
+                    } else {
+                        int x;
+                        int y;
+                        SDL_GetMouseState(&x, &y);
+                        sc_screen_crop_to_region(im->screen, x, y);
+                    }
+                }
+                return;
             case SDLK_DOWN:
                 if (shift) {
                     if (video && !repeat && down) {
@@ -528,8 +555,12 @@ sc_input_manager_process_key(struct sc_input_manager *im,
                 }
                 return;
             case SDLK_i:
-                if (video && !shift && !repeat && down) {
-                    switch_fps_counter_state(im);
+                if (video && !repeat && down) {
+                    if (shift) {
+                        sc_screen_toggle_stats_overlay(im->screen);
+                    } else {
+                        switch_fps_counter_state(im);
+                    }
                 }
                 return;
             case SDLK_n:
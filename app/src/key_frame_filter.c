@@ -0,0 +1,49 @@
+#include "key_frame_filter.h"
+
+void
+sc_key_frame_filter_init(struct sc_key_frame_filter *filter) {
+    atomic_init(&filter->discard_non_key, false);
+    atomic_init(&filter->outdated, false);
+    filter->wait_key_frame = false;
+}
+
+void
+sc_key_frame_filter_set_discard(struct sc_key_frame_filter *filter,
+                                bool discard) {
+    atomic_store_explicit(&filter->discard_non_key, discard,
+                          memory_order_relaxed);
+}
+
+bool
+sc_key_frame_filter_must_discard(struct sc_key_frame_filter *filter,
+                                 bool key_frame) {
+    if (key_frame) {
+        // A key frame does not reference previous frames
+        filter->wait_key_frame = false;
+        return false;
+    }
+
+    bool discard = atomic_load_explicit(&filter->discard_non_key,
+                                        memory_order_relaxed);
+    if (discard) {
+        // The next packets may reference the frame discarded now
+        filter->wait_key_frame = true;
+    }
+
+    if (filter->wait_key_frame) {
+        atomic_store_explicit(&filter->outdated, true, memory_order_relaxed);
+        return true;
+    }
+
+    return false;
+}
+
+void
+sc_key_frame_filter_on_frame(struct sc_key_frame_filter *filter) {
+    atomic_store_explicit(&filter->outdated, false, memory_order_relaxed);
+}
+
+bool
+sc_key_frame_filter_is_current(struct sc_key_frame_filter *filter) {
+    return !atomic_load_explicit(&filter->outdated, memory_order_relaxed);
+}
@@ -0,0 +1,68 @@
+#ifndef SC_KEY_FRAME_FILTER_H
+#define SC_KEY_FRAME_FILTER_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/**
+ * Filter of the video packets to decode while the display is paused
+ *
+ * While enabled, all the packets except key frames are discarded, so only the
+ * key frames are decoded. Once disabled, the packets are still discarded until
+ * the next key frame, because they may reference discarded frames.
+ *
+ * The last decoded frame is "current" if no packet has been discarded since.
+ * On resume, a frame which is not current must not be displayed (the last key
+ * frame may be several seconds old): the caller should request a new key
+ * frame instead, which will be decoded as soon as it is received.
+ */
+struct sc_key_frame_filter {
+    // Set from another thread to discard the non-key packets
+    atomic_bool discard_non_key;
+    // Some packets have been discarded since the last decoded frame
+    atomic_bool outdated;
+    // Discard the packets until the next key frame (only accessed by the
+    // decoder thread)
+    bool wait_key_frame;
+};
+
+void
+sc_key_frame_filter_init(struct sc_key_frame_filter *filter);
+
+/**
+ * Discard (or stop discarding) all the packets except key frames
+ *
+ * This function may be called from any thread.
+ */
+void
+sc_key_frame_filter_set_discard(struct sc_key_frame_filter *filter,
+                                bool discard);
+
+/**
+ * Return true if the packet must not be decoded
+ *
+ * This function must be called by the decoder thread, for each packet.
+ */
+bool
+sc_key_frame_filter_must_discard(struct sc_key_frame_filter *filter,
+                                 bool key_frame);
+
+/**
+ * Notify that a frame has been decoded
+ *
+ * This function must be called by the decoder thread.
+ */
+void
+sc_key_frame_filter_on_frame(struct sc_key_frame_filter *filter);
+
+/**
+ * Return true if the last decoded frame is still the current one
+ *
+ * This function may be called from any thread.
+ */
+bool
+sc_key_frame_filter_is_current(struct sc_key_frame_filter *filter);
+
+#endif
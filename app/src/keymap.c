@@ -0,0 +1,276 @@
+#include "keymap.h"
+
+#include "hid/hid_keyboard.h"
+
+// The keycodes are either a character (lower than 128) or a scancode with the
+// flag SDLK_SCANCODE_MASK. Both ranges are packed in the lookup table.
+#define SC_KEYMAP_CHARS 128
+#define SC_KEYMAP_SIZE (SC_KEYMAP_CHARS + SDL_NUM_SCANCODES)
+#define SC_KEYMAP_INDEX(K) ((K) & SDLK_SCANCODE_MASK \
+        ? SC_KEYMAP_CHARS + ((K) & ~SDLK_SCANCODE_MASK) : (K))
+
+// Navigation keys and ENTER.
+// Used in all modes.
+#define SC_KEYMAP_SPECIAL_KEYS(X) \
+    X(SC_KEYCODE_RETURN,    AKEYCODE_ENTER) \
+    X(SC_KEYCODE_KP_ENTER,  AKEYCODE_NUMPAD_ENTER) \
+    X(SC_KEYCODE_ESCAPE,    AKEYCODE_ESCAPE) \
+    X(SC_KEYCODE_BACKSPACE, AKEYCODE_DEL) \
+    X(SC_KEYCODE_TAB,       AKEYCODE_TAB) \
+    X(SC_KEYCODE_PAGEUP,    AKEYCODE_PAGE_UP) \
+    X(SC_KEYCODE_DELETE,    AKEYCODE_FORWARD_DEL) \
+    X(SC_KEYCODE_HOME,      AKEYCODE_MOVE_HOME) \
+    X(SC_KEYCODE_END,       AKEYCODE_MOVE_END) \
+    X(SC_KEYCODE_PAGEDOWN,  AKEYCODE_PAGE_DOWN) \
+    X(SC_KEYCODE_RIGHT,     AKEYCODE_DPAD_RIGHT) \
+    X(SC_KEYCODE_LEFT,      AKEYCODE_DPAD_LEFT) \
+    X(SC_KEYCODE_DOWN,      AKEYCODE_DPAD_DOWN) \
+    X(SC_KEYCODE_UP,        AKEYCODE_DPAD_UP) \
+    X(SC_KEYCODE_LCTRL,     AKEYCODE_CTRL_LEFT) \
+    X(SC_KEYCODE_RCTRL,     AKEYCODE_CTRL_RIGHT) \
+    X(SC_KEYCODE_LSHIFT,    AKEYCODE_SHIFT_LEFT) \
+    X(SC_KEYCODE_RSHIFT,    AKEYCODE_SHIFT_RIGHT) \
+    X(SC_KEYCODE_LALT,      AKEYCODE_ALT_LEFT) \
+    X(SC_KEYCODE_RALT,      AKEYCODE_ALT_RIGHT) \
+    X(SC_KEYCODE_LGUI,      AKEYCODE_META_LEFT) \
+    X(SC_KEYCODE_RGUI,      AKEYCODE_META_RIGHT)
+
+// Numpad navigation keys.
+// Used in all modes, when NumLock and Shift are disabled.
+#define SC_KEYMAP_KP_NAV_KEYS(X) \
+    X(SC_KEYCODE_KP_0,      AKEYCODE_INSERT) \
+    X(SC_KEYCODE_KP_1,      AKEYCODE_MOVE_END) \
+    X(SC_KEYCODE_KP_2,      AKEYCODE_DPAD_DOWN) \
+    X(SC_KEYCODE_KP_3,      AKEYCODE_PAGE_DOWN) \
+    X(SC_KEYCODE_KP_4,      AKEYCODE_DPAD_LEFT) \
+    X(SC_KEYCODE_KP_6,      AKEYCODE_DPAD_RIGHT) \
+    X(SC_KEYCODE_KP_7,      AKEYCODE_MOVE_HOME) \
+    X(SC_KEYCODE_KP_8,      AKEYCODE_DPAD_UP) \
+    X(SC_KEYCODE_KP_9,      AKEYCODE_PAGE_UP) \
+    X(SC_KEYCODE_KP_PERIOD, AKEYCODE_FORWARD_DEL)
+
+// Letters and space.
+// Used in non-text mode.
+#define SC_KEYMAP_ALPHASPACE_KEYS(X) \
+    X(SC_KEYCODE_a,         AKEYCODE_A) \
+    X(SC_KEYCODE_b,         AKEYCODE_B) \
+    X(SC_KEYCODE_c,         AKEYCODE_C) \
+    X(SC_KEYCODE_d,         AKEYCODE_D) \
+    X(SC_KEYCODE_e,         AKEYCODE_E) \
+    X(SC_KEYCODE_f,         AKEYCODE_F) \
+    X(SC_KEYCODE_g,         AKEYCODE_G) \
+    X(SC_KEYCODE_h,         AKEYCODE_H) \
+    X(SC_KEYCODE_i,         AKEYCODE_I) \
+    X(SC_KEYCODE_j,         AKEYCODE_J) \
+    X(SC_KEYCODE_k,         AKEYCODE_K) \
+    X(SC_KEYCODE_l,         AKEYCODE_L) \
+    X(SC_KEYCODE_m,         AKEYCODE_M) \
+    X(SC_KEYCODE_n,         AKEYCODE_N) \
+    X(SC_KEYCODE_o,         AKEYCODE_O) \
+    X(SC_KEYCODE_p,         AKEYCODE_P) \
+    X(SC_KEYCODE_q,         AKEYCODE_Q) \
+    X(SC_KEYCODE_r,         AKEYCODE_R) \
+    X(SC_KEYCODE_s,         AKEYCODE_S) \
+    X(SC_KEYCODE_t,         AKEYCODE_T) \
+    X(SC_KEYCODE_u,         AKEYCODE_U) \
+    X(SC_KEYCODE_v,         AKEYCODE_V) \
+    X(SC_KEYCODE_w,         AKEYCODE_W) \
+    X(SC_KEYCODE_x,         AKEYCODE_X) \
+    X(SC_KEYCODE_y,         AKEYCODE_Y) \
+    X(SC_KEYCODE_z,         AKEYCODE_Z) \
+    X(SC_KEYCODE_SPACE,     AKEYCODE_SPACE)
+
+// Numbers and punctuation keys.
+// Used in raw mode only.
+#define SC_KEYMAP_NUMBERS_PUNCT_KEYS(X) \
+    X(SC_KEYCODE_HASH,          AKEYCODE_POUND) \
+    X(SC_KEYCODE_PERCENT,       AKEYCODE_PERIOD) \
+    X(SC_KEYCODE_QUOTE,         AKEYCODE_APOSTROPHE) \
+    X(SC_KEYCODE_ASTERISK,      AKEYCODE_STAR) \
+    X(SC_KEYCODE_PLUS,          AKEYCODE_PLUS) \
+    X(SC_KEYCODE_COMMA,         AKEYCODE_COMMA) \
+    X(SC_KEYCODE_MINUS,         AKEYCODE_MINUS) \
+    X(SC_KEYCODE_PERIOD,        AKEYCODE_PERIOD) \
+    X(SC_KEYCODE_SLASH,         AKEYCODE_SLASH) \
+    X(SC_KEYCODE_0,             AKEYCODE_0) \
+    X(SC_KEYCODE_1,             AKEYCODE_1) \
+    X(SC_KEYCODE_2,             AKEYCODE_2) \
+    X(SC_KEYCODE_3,             AKEYCODE_3) \
+    X(SC_KEYCODE_4,             AKEYCODE_4) \
+    X(SC_KEYCODE_5,             AKEYCODE_5) \
+    X(SC_KEYCODE_6,             AKEYCODE_6) \
+    X(SC_KEYCODE_7,             AKEYCODE_7) \
+    X(SC_KEYCODE_8,             AKEYCODE_8) \
+    X(SC_KEYCODE_9,             AKEYCODE_9) \
+    X(SC_KEYCODE_SEMICOLON,     AKEYCODE_SEMICOLON) \
+    X(SC_KEYCODE_EQUALS,        AKEYCODE_EQUALS) \
+    X(SC_KEYCODE_AT,            AKEYCODE_AT) \
+    X(SC_KEYCODE_LEFTBRACKET,   AKEYCODE_LEFT_BRACKET) \
+    X(SC_KEYCODE_BACKSLASH,     AKEYCODE_BACKSLASH) \
+    X(SC_KEYCODE_RIGHTBRACKET,  AKEYCODE_RIGHT_BRACKET) \
+    X(SC_KEYCODE_BACKQUOTE,     AKEYCODE_GRAVE) \
+    X(SC_KEYCODE_KP_1,          AKEYCODE_NUMPAD_1) \
+    X(SC_KEYCODE_KP_2,          AKEYCODE_NUMPAD_2) \
+    X(SC_KEYCODE_KP_3,          AKEYCODE_NUMPAD_3) \
+    X(SC_KEYCODE_KP_4,          AKEYCODE_NUMPAD_4) \
+    X(SC_KEYCODE_KP_5,          AKEYCODE_NUMPAD_5) \
+    X(SC_KEYCODE_KP_6,          AKEYCODE_NUMPAD_6) \
+    X(SC_KEYCODE_KP_7,          AKEYCODE_NUMPAD_7) \
+    X(SC_KEYCODE_KP_8,          AKEYCODE_NUMPAD_8) \
+    X(SC_KEYCODE_KP_9,          AKEYCODE_NUMPAD_9) \
+    X(SC_KEYCODE_KP_0,          AKEYCODE_NUMPAD_0) \
+    X(SC_KEYCODE_KP_DIVIDE,     AKEYCODE_NUMPAD_DIVIDE) \
+    X(SC_KEYCODE_KP_MULTIPLY,   AKEYCODE_NUMPAD_MULTIPLY) \
+    X(SC_KEYCODE_KP_MINUS,      AKEYCODE_NUMPAD_SUBTRACT) \
+    X(SC_KEYCODE_KP_PLUS,       AKEYCODE_NUMPAD_ADD) \
+    X(SC_KEYCODE_KP_PERIOD,     AKEYCODE_NUMPAD_DOT) \
+    X(SC_KEYCODE_KP_EQUALS,     AKEYCODE_NUMPAD_EQUALS) \
+    X(SC_KEYCODE_KP_LEFTPAREN,  AKEYCODE_NUMPAD_LEFT_PAREN) \
+    X(SC_KEYCODE_KP_RIGHTPAREN, AKEYCODE_NUMPAD_RIGHT_PAREN)
+
+// Modifiers: X(MODS_STATE, sc_mod, Android meta state, HID modifier)
+// The Android meta state includes the dependent flags.
+#define SC_KEYMAP_MODS(X, M) \
+    X(M, SC_MOD_LSHIFT, AMETA_SHIFT_LEFT_ON | AMETA_SHIFT_ON, \
+                        SC_HID_MOD_LEFT_SHIFT) \
+    X(M, SC_MOD_RSHIFT, AMETA_SHIFT_RIGHT_ON | AMETA_SHIFT_ON, \
+                        SC_HID_MOD_RIGHT_SHIFT) \
+    X(M, SC_MOD_LCTRL,  AMETA_CTRL_LEFT_ON | AMETA_CTRL_ON, \
+                        SC_HID_MOD_LEFT_CONTROL) \
+    X(M, SC_MOD_RCTRL,  AMETA_CTRL_RIGHT_ON | AMETA_CTRL_ON, \
+                        SC_HID_MOD_RIGHT_CONTROL) \
+    X(M, SC_MOD_LALT,   AMETA_ALT_LEFT_ON | AMETA_ALT_ON, \
+                        SC_HID_MOD_LEFT_ALT) \
+    X(M, SC_MOD_RALT,   AMETA_ALT_RIGHT_ON | AMETA_ALT_ON, \
+                        SC_HID_MOD_RIGHT_ALT) \
+    X(M, SC_MOD_LGUI,   AMETA_META_LEFT_ON | AMETA_META_ON, \
+                        SC_HID_MOD_LEFT_GUI) \
+    X(M, SC_MOD_RGUI,   AMETA_META_RIGHT_ON | AMETA_META_ON, \
+                        SC_HID_MOD_RIGHT_GUI) \
+    X(M, SC_MOD_NUM,    AMETA_NUM_LOCK_ON, 0) \
+    X(M, SC_MOD_CAPS,   AMETA_CAPS_LOCK_ON, 0)
+
+// Android keycodes of a key in each category (AKEYCODE_UNKNOWN if the key is
+// not mapped)
+struct sc_keymap_entry {
+    uint16_t special;
+    uint16_t kp_nav;
+    uint16_t alphaspace;
+    uint16_t numbers_punct;
+};
+
+#define SC_KEYMAP_SPECIAL(FROM, TO) [SC_KEYMAP_INDEX(FROM)].special = TO,
+#define SC_KEYMAP_KP_NAV(FROM, TO) [SC_KEYMAP_INDEX(FROM)].kp_nav = TO,
+#define SC_KEYMAP_ALPHASPACE(FROM, TO) [SC_KEYMAP_INDEX(FROM)].alphaspace = TO,
+#define SC_KEYMAP_NUMBERS_PUNCT(FROM, TO) \
+    [SC_KEYMAP_INDEX(FROM)].numbers_punct = TO,
+
+static const struct sc_keymap_entry sc_keymap[SC_KEYMAP_SIZE] = {
+    SC_KEYMAP_SPECIAL_KEYS(SC_KEYMAP_SPECIAL)
+    SC_KEYMAP_KP_NAV_KEYS(SC_KEYMAP_KP_NAV)
+    SC_KEYMAP_ALPHASPACE_KEYS(SC_KEYMAP_ALPHASPACE)
+    SC_KEYMAP_NUMBERS_PUNCT_KEYS(SC_KEYMAP_NUMBERS_PUNCT)
+};
+
+// Expand F(N), F(N + 1), ..., F(N + 255)
+#define SC_KEYMAP_REPEAT4(F, N) F(N), F(N + 1), F(N + 2), F(N + 3)
+#define SC_KEYMAP_REPEAT16(F, N) \
+    SC_KEYMAP_REPEAT4(F, N), SC_KEYMAP_REPEAT4(F, N + 4), \
+    SC_KEYMAP_REPEAT4(F, N + 8), SC_KEYMAP_REPEAT4(F, N + 12)
+#define SC_KEYMAP_REPEAT64(F, N) \
+    SC_KEYMAP_REPEAT16(F, N), SC_KEYMAP_REPEAT16(F, N + 16), \
+    SC_KEYMAP_REPEAT16(F, N + 32), SC_KEYMAP_REPEAT16(F, N + 48)
+#define SC_KEYMAP_REPEAT256(F, N) \
+    SC_KEYMAP_REPEAT64(F, N), SC_KEYMAP_REPEAT64(F, N + 64), \
+    SC_KEYMAP_REPEAT64(F, N + 128), SC_KEYMAP_REPEAT64(F, N + 192)
+
+// The modifiers state is 16-bit, so each conversion is the combination of the
+// conversions of its low and high bytes
+#define SC_KEYMAP_METASTATE_BIT(M, MOD, META, HID) ((M) & (MOD) ? (META) : 0) |
+#define SC_KEYMAP_HID_MOD_BIT(M, MOD, META, HID) ((M) & (MOD) ? (HID) : 0) |
+#define SC_KEYMAP_METASTATE(M) \
+    (SC_KEYMAP_MODS(SC_KEYMAP_METASTATE_BIT, M) 0)
+#define SC_KEYMAP_METASTATE_HIGH(M) SC_KEYMAP_METASTATE((M) << 8)
+#define SC_KEYMAP_HID_MODS(M) (SC_KEYMAP_MODS(SC_KEYMAP_HID_MOD_BIT, M) 0)
+#define SC_KEYMAP_HID_MODS_HIGH(M) SC_KEYMAP_HID_MODS((M) << 8)
+
+static const uint32_t sc_keymap_metastate[2][256] = {
+    {SC_KEYMAP_REPEAT256(SC_KEYMAP_METASTATE, 0)},
+    {SC_KEYMAP_REPEAT256(SC_KEYMAP_METASTATE_HIGH, 0)},
+};
+
+static const uint8_t sc_keymap_hid_mods[2][256] = {
+    {SC_KEYMAP_REPEAT256(SC_KEYMAP_HID_MODS, 0)},
+    {SC_KEYMAP_REPEAT256(SC_KEYMAP_HID_MODS_HIGH, 0)},
+};
+
+static inline const struct sc_keymap_entry *
+sc_keymap_get(enum sc_keycode keycode) {
+    int32_t k = keycode;
+    if (k >= 0 && k < SC_KEYMAP_CHARS) {
+        return &sc_keymap[k];
+    }
+
+    if (k & SDLK_SCANCODE_MASK) {
+        int32_t scancode = k & ~SDLK_SCANCODE_MASK;
+        if (scancode >= 0 && scancode < SDL_NUM_SCANCODES) {
+            return &sc_keymap[SC_KEYMAP_CHARS + scancode];
+        }
+    }
+
+    // Other characters (non-ASCII) are never mapped
+    return NULL;
+}
+
+bool
+sc_keymap_to_android_keycode(enum sc_keycode from, uint16_t mods_state,
+                             enum sc_key_inject_mode key_inject_mode,
+                             enum android_keycode *to) {
+    const struct sc_keymap_entry *entry = sc_keymap_get(from);
+    if (!entry) {
+        return false;
+    }
+
+    if (entry->special) {
+        *to = entry->special;
+        return true;
+    }
+
+    if (entry->kp_nav
+            && !(mods_state & (SC_MOD_NUM | SC_MOD_LSHIFT | SC_MOD_RSHIFT))) {
+        // Handle Numpad events when Num Lock is disabled
+        // If SHIFT is pressed, a text event will be sent instead
+        *to = entry->kp_nav;
+        return true;
+    }
+
+    if (key_inject_mode == SC_KEY_INJECT_MODE_TEXT &&
+            !(mods_state & (SC_MOD_LCTRL | SC_MOD_RCTRL))) {
+        // do not forward alpha and space key events (unless Ctrl is pressed)
+        return false;
+    }
+
+    if (entry->alphaspace) {
+        *to = entry->alphaspace;
+        return true;
+    }
+
+    if (entry->numbers_punct && key_inject_mode == SC_KEY_INJECT_MODE_RAW) {
+        *to = entry->numbers_punct;
+        return true;
+    }
+
+    return false;
+}
+
+enum android_metastate
+sc_keymap_to_android_metastate(uint16_t mods_state) {
+    return sc_keymap_metastate[0][mods_state & 0xFF]
+         | sc_keymap_metastate[1][mods_state >> 8];
+}
+
+uint8_t
+sc_keymap_to_hid_mods(uint16_t mods_state) {
+    return sc_keymap_hid_mods[0][mods_state & 0xFF]
+         | sc_keymap_hid_mods[1][mods_state >> 8];
+}
@@ -0,0 +1,50 @@
+#ifndef SC_KEYMAP_H
+#define SC_KEYMAP_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "android/input.h"
+#include "android/keycodes.h"
+#include "input_events.h"
+#include "options.h"
+
+/**
+ * Key and modifier translation tables
+ *
+ * The mappings are declared once (in keymap.c), and expanded at compile time
+ * into constant arrays indexed directly by the scrcpy keycode or modifiers
+ * state, so that each translation is a single lookup, whatever the number of
+ * mapped keys.
+ *
+ * The scancodes are not translated: the scrcpy (SDL) scancodes are the USB HID
+ * usage IDs.
+ */
+
+/**
+ * Convert a keycode to an Android keycode, for the SDK keyboard
+ *
+ * Return false if the key must not be injected as a key event in the given
+ * mode.
+ */
+bool
+sc_keymap_to_android_keycode(enum sc_keycode from, uint16_t mods_state,
+                             enum sc_key_inject_mode key_inject_mode,
+                             enum android_keycode *to);
+
+/**
+ * Convert a modifiers state to an Android meta state (including the dependent
+ * flags, like AMETA_SHIFT_ON for AMETA_SHIFT_LEFT_ON)
+ */
+enum android_metastate
+sc_keymap_to_android_metastate(uint16_t mods_state);
+
+/**
+ * Convert a modifiers state to the modifiers byte of an HID keyboard report
+ */
+uint8_t
+sc_keymap_to_hid_mods(uint16_t mods_state);
+
+#endif
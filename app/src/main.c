@@ -9,7 +9,9 @@
 #include <SDL2/SDL.h>
 
 #include "cli.h"
+#include "memory_budget.h"
 #include "options.h"
+#include "perf_counter.h"
 #include "scrcpy.h"
 #include "usb/scrcpy_otg.h"
 #include "util/log.h"
@@ -87,12 +89,24 @@ main_scrcpy(int argc, char *argv[]) {
 
     sc_log_configure();
 
+    if (args.opts.perf_counters && !sc_perf_counters_init()) {
+        ret = SCRCPY_EXIT_FAILURE;
+        goto end;
+    }
+
+    sc_memory_budget_init((uint64_t) args.opts.memory_budget * 1000000);
+
 #ifdef HAVE_USB
     ret = args.opts.otg ? scrcpy_otg(&args.opts) : scrcpy(&args.opts);
 #else
     ret = scrcpy(&args.opts);
 #endif
 
+    // All the threads have been joined
+    sc_perf_counters_report();
+    sc_perf_counters_destroy();
+    sc_memory_budget_report();
+
 end:
     if (args.pause_on_exit == SC_PAUSE_ON_EXIT_TRUE ||
             (args.pause_on_exit == SC_PAUSE_ON_EXIT_IF_ERROR &&
@@ -0,0 +1,148 @@
+#include "memory_budget.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+
+#include "util/log.h"
+
+// Share of the budget for each pool, in percents
+static const unsigned sc_memory_pool_shares[SC_MEMORY_POOL_COUNT] = {
+    [SC_MEMORY_POOL_RECORDER] = 50,
+    [SC_MEMORY_POOL_DELAY_BUFFER] = 40,
+    [SC_MEMORY_POOL_CONTROLLER] = 10,
+};
+
+static const char *const sc_memory_pool_names[SC_MEMORY_POOL_COUNT] = {
+    [SC_MEMORY_POOL_RECORDER] = "recorder",
+    [SC_MEMORY_POOL_DELAY_BUFFER] = "delay buffer",
+    [SC_MEMORY_POOL_CONTROLLER] = "controller",
+};
+
+struct sc_memory_pool_state {
+    uint64_t quota;
+    atomic_uint_least64_t used;
+    atomic_uint_least64_t peak;
+    atomic_uint_least64_t rejected;
+};
+
+static struct {
+    bool enabled;
+    struct sc_memory_pool_state pools[SC_MEMORY_POOL_COUNT];
+} sc_budget;
+
+void
+sc_memory_budget_init(uint64_t budget) {
+    sc_budget.enabled = budget != 0;
+    for (unsigned i = 0; i < SC_MEMORY_POOL_COUNT; ++i) {
+        struct sc_memory_pool_state *state = &sc_budget.pools[i];
+        state->quota = budget / 100 * sc_memory_pool_shares[i];
+        atomic_init(&state->used, 0);
+        atomic_init(&state->peak, 0);
+        atomic_init(&state->rejected, 0);
+    }
+}
+
+bool
+sc_memory_budget_is_enabled(void) {
+    return sc_budget.enabled;
+}
+
+uint64_t
+sc_memory_budget_get_quota(enum sc_memory_pool pool) {
+    assert(pool < SC_MEMORY_POOL_COUNT);
+    return sc_budget.pools[pool].quota;
+}
+
+uint64_t
+sc_memory_budget_get_used(enum sc_memory_pool pool) {
+    assert(pool < SC_MEMORY_POOL_COUNT);
+    return atomic_load_explicit(&sc_budget.pools[pool].used,
+                                memory_order_relaxed);
+}
+
+static void
+sc_memory_pool_update_peak(struct sc_memory_pool_state *state,
+                           uint64_t used) {
+    uint64_t peak = atomic_load_explicit(&state->peak, memory_order_relaxed);
+    while (used > peak && !atomic_compare_exchange_weak_explicit(
+                &state->peak, &peak, used, memory_order_relaxed,
+                memory_order_relaxed)) {
+        // peak has been reloaded, retry
+    }
+}
+
+bool
+sc_memory_budget_acquire(enum sc_memory_pool pool, size_t size) {
+    if (!sc_budget.enabled) {
+        return true;
+    }
+
+    assert(pool < SC_MEMORY_POOL_COUNT);
+    struct sc_memory_pool_state *state = &sc_budget.pools[pool];
+
+    uint64_t used = atomic_load_explicit(&state->used, memory_order_relaxed);
+    uint64_t new_used;
+    do {
+        new_used = used + size;
+        if (used && new_used > state->quota) {
+            atomic_fetch_add_explicit(&state->rejected, 1,
+                                      memory_order_relaxed);
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&state->used, &used,
+                                                    new_used,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed));
+
+    sc_memory_pool_update_peak(state, new_used);
+    return true;
+}
+
+void
+sc_memory_budget_force_acquire(enum sc_memory_pool pool, size_t size) {
+    if (!sc_budget.enabled) {
+        return;
+    }
+
+    assert(pool < SC_MEMORY_POOL_COUNT);
+    struct sc_memory_pool_state *state = &sc_budget.pools[pool];
+
+    uint64_t used = atomic_fetch_add_explicit(&state->used, size,
+                                              memory_order_relaxed);
+    sc_memory_pool_update_peak(state, used + size);
+}
+
+void
+sc_memory_budget_release(enum sc_memory_pool pool, size_t size) {
+    if (!sc_budget.enabled) {
+        return;
+    }
+
+    assert(pool < SC_MEMORY_POOL_COUNT);
+    struct sc_memory_pool_state *state = &sc_budget.pools[pool];
+
+    uint64_t used = atomic_fetch_sub_explicit(&state->used, size,
+                                              memory_order_relaxed);
+    assert(used >= size);
+    (void) used;
+}
+
+void
+sc_memory_budget_report(void) {
+    if (!sc_budget.enabled) {
+        return;
+    }
+
+    LOGI("Memory budget:");
+    for (unsigned i = 0; i < SC_MEMORY_POOL_COUNT; ++i) {
+        struct sc_memory_pool_state *state = &sc_budget.pools[i];
+        uint64_t peak = atomic_load_explicit(&state->peak,
+                                             memory_order_relaxed);
+        uint64_t rejected = atomic_load_explicit(&state->rejected,
+                                                 memory_order_relaxed);
+        LOGI("  %s: peak %" PRIu64 " KiB / %" PRIu64 " KiB, %" PRIu64
+             " rejected", sc_memory_pool_names[i], peak / 1024,
+             state->quota / 1024, rejected);
+    }
+}
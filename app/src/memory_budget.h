@@ -0,0 +1,73 @@
+#ifndef SC_MEMORY_BUDGET_H
+#define SC_MEMORY_BUDGET_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Memory budget, to bound the memory used by the queues which may grow under
+ * stress (if a consumer could not keep up with its producer).
+ *
+ * The budget is split into quotas, one per pool. Each subsystem accounts the
+ * memory of the items it stores, and applies its own degradation policy when
+ * its quota is exhausted:
+ *  - the recorder blocks the demuxer (backpressure), to never corrupt the
+ *    recording;
+ *  - the delay buffer drops the new frames;
+ *  - the controller drops the new droppable messages (the others are
+ *    accounted but never refused, and sc_controller_push_msg_wait() waits
+ *    instead of dropping).
+ *
+ * The fixed part of the memory (codec contexts, textures, preallocated
+ * buffers...) is not accounted.
+ *
+ * This is a process-wide facility (like logging): if it is not enabled, all
+ * the acquisitions succeed.
+ */
+
+enum sc_memory_pool {
+    SC_MEMORY_POOL_RECORDER,
+    SC_MEMORY_POOL_DELAY_BUFFER,
+    SC_MEMORY_POOL_CONTROLLER,
+    SC_MEMORY_POOL_COUNT,
+};
+
+// The budget is expressed in bytes (0 to disable)
+void
+sc_memory_budget_init(uint64_t budget);
+
+bool
+sc_memory_budget_is_enabled(void);
+
+uint64_t
+sc_memory_budget_get_quota(enum sc_memory_pool pool);
+
+// Return the memory currently accounted in the pool
+uint64_t
+sc_memory_budget_get_used(enum sc_memory_pool pool);
+
+/**
+ * Account size bytes in the pool
+ *
+ * Return false (and account nothing) if it would exceed the quota, unless the
+ * pool is empty (so that a single item larger than the quota may always be
+ * processed).
+ */
+bool
+sc_memory_budget_acquire(enum sc_memory_pool pool, size_t size);
+
+// Account size bytes in the pool, even if it exceeds the quota
+void
+sc_memory_budget_force_acquire(enum sc_memory_pool pool, size_t size);
+
+void
+sc_memory_budget_release(enum sc_memory_pool pool, size_t size);
+
+// Print the usage of each pool
+void
+sc_memory_budget_report(void);
+
+#endif
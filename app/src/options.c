@@ -12,6 +12,7 @@ const struct scrcpy_options scrcpy_options_default = {
     .video_codec_options = NULL,
     .audio_codec_options = NULL,
     .video_encoder = NULL,
+    .video_decoder = NULL,
     .audio_encoder = NULL,
     .camera_id = NULL,
     .camera_size = NULL,
@@ -64,6 +65,8 @@ const struct scrcpy_options scrcpy_options_default = {
     .display_id = 0,
     .video_buffer = 0,
     .audio_buffer = -1, // depends on the audio format,
+    .audio_buffer_min = SC_TICK_FROM_MS(20),
+    .audio_buffer_max = SC_TICK_FROM_MS(200),
     .audio_output_buffer = SC_TICK_FROM_MS(5),
     .time_limit = 0,
     .screen_off_timeout = -1,
@@ -71,6 +74,14 @@ const struct scrcpy_options scrcpy_options_default = {
     .v4l2_device = NULL,
     .v4l2_buffer = 0,
 #endif
+#ifdef HAVE_SWSCALE
+    .record_proxy_filename = NULL,
+    .record_proxy_format = SC_RECORD_FORMAT_AUTO,
+    .record_proxy_size = 720,
+    .record_proxy_bit_rate = 2000000,
+    .screenshot_dir = ".",
+    .screenshot_format = SC_SCREENSHOT_FORMAT_PNG,
+#endif
 #ifdef HAVE_USB
     .otg = false,
 #endif
@@ -98,10 +109,17 @@ const struct scrcpy_options scrcpy_options_default = {
     .select_usb = false,
     .cleanup = true,
     .start_fps_counter = false,
+    .perf_counters = false,
+    .memory_budget = 0,
+    .auto_reconnect = false,
+    .replay_filename = NULL,
+    .replay_pacing = true,
+    .automation_socket = NULL,
     .power_on = true,
     .video = true,
     .audio = true,
     .require_audio = false,
+    .audio_buffer_auto = false,
     .kill_adb_on_close = false,
     .camera_high_speed = false,
     .list = 0,
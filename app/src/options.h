@@ -20,6 +20,7 @@ enum sc_log_level {
 enum sc_record_format {
     SC_RECORD_FORMAT_AUTO,
     SC_RECORD_FORMAT_MP4,
+    SC_RECORD_FORMAT_FMP4, // fragmented MP4
     SC_RECORD_FORMAT_MKV,
     SC_RECORD_FORMAT_M4A,
     SC_RECORD_FORMAT_MKA,
@@ -29,6 +30,12 @@ enum sc_record_format {
     SC_RECORD_FORMAT_WAV,
 };
 
+enum sc_screenshot_format {
+    SC_SCREENSHOT_FORMAT_PNG,
+    SC_SCREENSHOT_FORMAT_JPEG,
+    SC_SCREENSHOT_FORMAT_WEBP,
+};
+
 static inline bool
 sc_record_format_is_audio_only(enum sc_record_format fmt) {
     return fmt == SC_RECORD_FORMAT_M4A
@@ -237,6 +244,7 @@ struct scrcpy_options {
     const char *video_codec_options;
     const char *audio_codec_options;
     const char *video_encoder;
+    const char *video_decoder; // FFmpeg decoder, "auto" or NULL (default)
     const char *audio_encoder;
     const char *camera_id;
     const char *camera_size;
@@ -274,6 +282,9 @@ struct scrcpy_options {
     uint32_t display_id;
     sc_tick video_buffer;
     sc_tick audio_buffer;
+    // Bounds of the audio buffer if audio_buffer_auto is set
+    sc_tick audio_buffer_min;
+    sc_tick audio_buffer_max;
     sc_tick audio_output_buffer;
     sc_tick time_limit;
     sc_tick screen_off_timeout;
@@ -281,6 +292,14 @@ struct scrcpy_options {
     const char *v4l2_device;
     sc_tick v4l2_buffer;
 #endif
+#ifdef HAVE_SWSCALE
+    const char *record_proxy_filename;
+    enum sc_record_format record_proxy_format;
+    uint16_t record_proxy_size;
+    uint32_t record_proxy_bit_rate;
+    const char *screenshot_dir;
+    enum sc_screenshot_format screenshot_format;
+#endif
 #ifdef HAVE_USB
     bool otg;
 #endif
@@ -308,10 +327,19 @@ struct scrcpy_options {
     bool select_tcpip;
     bool cleanup;
     bool start_fps_counter;
+    bool perf_counters;
+    uint32_t memory_budget; // in megabytes, 0 for unlimited
+    bool auto_reconnect;
+    // Read the streams from a local file instead of a device
+    const char *replay_filename;
+    bool replay_pacing; // push the packets in real time
+    // Path of the Unix socket to listen on for automation clients
+    const char *automation_socket;
     bool power_on;
     bool video;
     bool audio;
     bool require_audio;
+    bool audio_buffer_auto;
     bool kill_adb_on_close;
     bool camera_high_speed;
 #define SC_OPTION_LIST_ENCODERS 0x1
@@ -0,0 +1,522 @@
+#include "overlay.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "audio_tuner.h"
+#include "events.h"
+#include "util/log.h"
+
+#define SC_OVERLAY_SNAPSHOT_INTERVAL SC_TICK_FROM_SEC(1)
+// Refresh more often than the snapshot interval, so that a new snapshot is
+// taken approximately every second even if no frame is received
+#define SC_OVERLAY_REFRESH_INTERVAL_MS 250
+
+#define SC_OVERLAY_FIRST_CHAR 0x20
+#define SC_OVERLAY_LAST_CHAR 0x7E
+#define SC_OVERLAY_GLYPH_COUNT \
+    (SC_OVERLAY_LAST_CHAR - SC_OVERLAY_FIRST_CHAR + 1)
+// Each glyph is 5x7 pixels, stored in a 6x8 cell (including spacing)
+#define SC_OVERLAY_GLYPH_WIDTH 5
+#define SC_OVERLAY_GLYPH_HEIGHT 7
+#define SC_OVERLAY_CELL_WIDTH 6
+#define SC_OVERLAY_CELL_HEIGHT 8
+#define SC_OVERLAY_ATLAS_COLUMNS 16
+#define SC_OVERLAY_ATLAS_ROWS \
+    ((SC_OVERLAY_GLYPH_COUNT + SC_OVERLAY_ATLAS_COLUMNS - 1) \
+        / SC_OVERLAY_ATLAS_COLUMNS)
+#define SC_OVERLAY_ATLAS_WIDTH \
+    (SC_OVERLAY_ATLAS_COLUMNS * SC_OVERLAY_CELL_WIDTH)
+#define SC_OVERLAY_ATLAS_HEIGHT (SC_OVERLAY_ATLAS_ROWS * SC_OVERLAY_CELL_HEIGHT)
+
+// Layout, in unscaled pixels
+#define SC_OVERLAY_MARGIN 8
+#define SC_OVERLAY_PADDING 4
+#define SC_OVERLAY_LINE_HEIGHT 10
+#define SC_OVERLAY_GRAPH_LABEL_CHARS 5
+#define SC_OVERLAY_GRAPH_STEP 2
+#define SC_OVERLAY_GRAPH_WIDTH \
+    ((SC_OVERLAY_HISTORY_SIZE - 1) * SC_OVERLAY_GRAPH_STEP + 1)
+#define SC_OVERLAY_GRAPH_HEIGHT 20
+#define SC_OVERLAY_GRAPH_SPACING 4
+
+// Classic 5x7 font, one byte per column, least significant bit at the top
+static const uint8_t sc_overlay_font[SC_OVERLAY_GLYPH_COUNT][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x00, 0x00, 0x5F, 0x00, 0x00}, // '!'
+    {0x00, 0x07, 0x00, 0x07, 0x00}, // '"'
+    {0x14, 0x7F, 0x14, 0x7F, 0x14}, // '#'
+    {0x24, 0x2A, 0x7F, 0x2A, 0x12}, // '$'
+    {0x23, 0x13, 0x08, 0x64, 0x62}, // '%'
+    {0x36, 0x49, 0x55, 0x22, 0x50}, // '&'
+    {0x00, 0x05, 0x03, 0x00, 0x00}, // '''
+    {0x00, 0x1C, 0x22, 0x41, 0x00}, // '('
+    {0x00, 0x41, 0x22, 0x1C, 0x00}, // ')'
+    {0x14, 0x08, 0x3E, 0x08, 0x14}, // '*'
+    {0x08, 0x08, 0x3E, 0x08, 0x08}, // '+'
+    {0x00, 0x50, 0x30, 0x00, 0x00}, // ','
+    {0x08, 0x08, 0x08, 0x08, 0x08}, // '-'
+    {0x00, 0x60, 0x60, 0x00, 0x00}, // '.'
+    {0x20, 0x10, 0x08, 0x04, 0x02}, // '/'
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, // '0'
+    {0x00, 0x42, 0x7F, 0x40, 0x00}, // '1'
+    {0x42, 0x61, 0x51, 0x49, 0x46}, // '2'
+    {0x21, 0x41, 0x45, 0x4B, 0x31}, // '3'
+    {0x18, 0x14, 0x12, 0x7F, 0x10}, // '4'
+    {0x27, 0x45, 0x45, 0x45, 0x39}, // '5'
+    {0x3C, 0x4A, 0x49, 0x49, 0x30}, // '6'
+    {0x01, 0x71, 0x09, 0x05, 0x03}, // '7'
+    {0x36, 0x49, 0x49, 0x49, 0x36}, // '8'
+    {0x06, 0x49, 0x49, 0x29, 0x1E}, // '9'
+    {0x00, 0x36, 0x36, 0x00, 0x00}, // ':'
+    {0x00, 0x56, 0x36, 0x00, 0x00}, // ';'
+    {0x08, 0x14, 0x22, 0x41, 0x00}, // '<'
+    {0x14, 0x14, 0x14, 0x14, 0x14}, // '='
+    {0x00, 0x41, 0x22, 0x14, 0x08}, // '>'
+    {0x02, 0x01, 0x51, 0x09, 0x06}, // '?'
+    {0x32, 0x49, 0x79, 0x41, 0x3E}, // '@'
+    {0x7E, 0x11, 0x11, 0x11, 0x7E}, // 'A'
+    {0x7F, 0x49, 0x49, 0x49, 0x36}, // 'B'
+    {0x3E, 0x41, 0x41, 0x41, 0x22}, // 'C'
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, // 'D'
+    {0x7F, 0x49, 0x49, 0x49, 0x41}, // 'E'
+    {0x7F, 0x09, 0x09, 0x09, 0x01}, // 'F'
+    {0x3E, 0x41, 0x49, 0x49, 0x7A}, // 'G'
+    {0x7F, 0x08, 0x08, 0x08, 0x7F}, // 'H'
+    {0x00, 0x41, 0x7F, 0x41, 0x00}, // 'I'
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, // 'J'
+    {0x7F, 0x08, 0x14, 0x22, 0x41}, // 'K'
+    {0x7F, 0x40, 0x40, 0x40, 0x40}, // 'L'
+    {0x7F, 0x02, 0x0C, 0x02, 0x7F}, // 'M'
+    {0x7F, 0x04, 0x08, 0x10, 0x7F}, // 'N'
+    {0x3E, 0x41, 0x41, 0x41, 0x3E}, // 'O'
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, // 'P'
+    {0x3E, 0x41, 0x51, 0x21, 0x5E}, // 'Q'
+    {0x7F, 0x09, 0x19, 0x29, 0x46}, // 'R'
+    {0x46, 0x49, 0x49, 0x49, 0x31}, // 'S'
+    {0x01, 0x01, 0x7F, 0x01, 0x01}, // 'T'
+    {0x3F, 0x40, 0x40, 0x40, 0x3F}, // 'U'
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, // 'V'
+    {0x3F, 0x40, 0x38, 0x40, 0x3F}, // 'W'
+    {0x63, 0x14, 0x08, 0x14, 0x63}, // 'X'
+    {0x07, 0x08, 0x70, 0x08, 0x07}, // 'Y'
+    {0x61, 0x51, 0x49, 0x45, 0x43}, // 'Z'
+    {0x00, 0x7F, 0x41, 0x41, 0x00}, // '['
+    {0x02, 0x04, 0x08, 0x10, 0x20}, // '\'
+    {0x00, 0x41, 0x41, 0x7F, 0x00}, // ']'
+    {0x04, 0x02, 0x01, 0x02, 0x04}, // '^'
+    {0x40, 0x40, 0x40, 0x40, 0x40}, // '_'
+    {0x00, 0x01, 0x02, 0x04, 0x00}, // '`'
+    {0x20, 0x54, 0x54, 0x54, 0x78}, // 'a'
+    {0x7F, 0x48, 0x44, 0x44, 0x38}, // 'b'
+    {0x38, 0x44, 0x44, 0x44, 0x20}, // 'c'
+    {0x38, 0x44, 0x44, 0x48, 0x7F}, // 'd'
+    {0x38, 0x54, 0x54, 0x54, 0x18}, // 'e'
+    {0x08, 0x7E, 0x09, 0x01, 0x02}, // 'f'
+    {0x0C, 0x52, 0x52, 0x52, 0x3E}, // 'g'
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, // 'h'
+    {0x00, 0x44, 0x7D, 0x40, 0x00}, // 'i'
+    {0x20, 0x40, 0x44, 0x3D, 0x00}, // 'j'
+    {0x7F, 0x10, 0x28, 0x44, 0x00}, // 'k'
+    {0x00, 0x41, 0x7F, 0x40, 0x00}, // 'l'
+    {0x7C, 0x04, 0x18, 0x04, 0x78}, // 'm'
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, // 'n'
+    {0x38, 0x44, 0x44, 0x44, 0x38}, // 'o'
+    {0x7C, 0x14, 0x14, 0x14, 0x08}, // 'p'
+    {0x08, 0x14, 0x14, 0x18, 0x7C}, // 'q'
+    {0x7C, 0x08, 0x04, 0x04, 0x08}, // 'r'
+    {0x48, 0x54, 0x54, 0x54, 0x20}, // 's'
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, // 't'
+    {0x3C, 0x40, 0x40, 0x20, 0x7C}, // 'u'
+    {0x1C, 0x20, 0x40, 0x20, 0x1C}, // 'v'
+    {0x3C, 0x40, 0x30, 0x40, 0x3C}, // 'w'
+    {0x44, 0x28, 0x10, 0x28, 0x44}, // 'x'
+    {0x0C, 0x50, 0x50, 0x50, 0x3C}, // 'y'
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, // 'z'
+    {0x00, 0x08, 0x36, 0x41, 0x00}, // '{'
+    {0x00, 0x00, 0x7F, 0x00, 0x00}, // '|'
+    {0x00, 0x41, 0x36, 0x08, 0x00}, // '}'
+    {0x08, 0x04, 0x08, 0x10, 0x08}, // '~'
+};
+
+static const char *const sc_overlay_graph_labels[SC_OVERLAY_GRAPH_COUNT] = {
+    [SC_OVERLAY_GRAPH_FPS] = "fps",
+    [SC_OVERLAY_GRAPH_BITRATE] = "Mbps",
+    [SC_OVERLAY_GRAPH_LATENCY] = "ms",
+};
+
+static bool
+sc_overlay_create_atlas(struct sc_overlay *overlay) {
+    assert(!overlay->atlas);
+
+    // White glyphs on a transparent background, so that the color can be
+    // changed by SDL_SetTextureColorMod()
+    static uint32_t pixels[SC_OVERLAY_ATLAS_HEIGHT][SC_OVERLAY_ATLAS_WIDTH];
+    memset(pixels, 0, sizeof(pixels));
+
+    for (unsigned i = 0; i < SC_OVERLAY_GLYPH_COUNT; ++i) {
+        unsigned x0 = i % SC_OVERLAY_ATLAS_COLUMNS * SC_OVERLAY_CELL_WIDTH;
+        unsigned y0 = i / SC_OVERLAY_ATLAS_COLUMNS * SC_OVERLAY_CELL_HEIGHT;
+        for (unsigned x = 0; x < SC_OVERLAY_GLYPH_WIDTH; ++x) {
+            uint8_t column = sc_overlay_font[i][x];
+            for (unsigned y = 0; y < SC_OVERLAY_GLYPH_HEIGHT; ++y) {
+                if (column & (1 << y)) {
+                    pixels[y0 + y][x0 + x] = 0xFFFFFFFF;
+                }
+            }
+        }
+    }
+
+    SDL_Texture *atlas =
+        SDL_CreateTexture(overlay->renderer, SDL_PIXELFORMAT_ARGB8888,
+                          SDL_TEXTUREACCESS_STATIC, SC_OVERLAY_ATLAS_WIDTH,
+                          SC_OVERLAY_ATLAS_HEIGHT);
+    if (!atlas) {
+        LOGE("Could not create overlay texture: %s", SDL_GetError());
+        return false;
+    }
+
+    if (SDL_UpdateTexture(atlas, NULL, pixels, sizeof(pixels[0]))) {
+        LOGE("Could not update overlay texture: %s", SDL_GetError());
+        SDL_DestroyTexture(atlas);
+        return false;
+    }
+
+    SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
+#ifdef SCRCPY_SDL_HAS_TEXTURE_SCALE_MODE
+    // The glyphs are upscaled by an integer factor, keep them sharp
+    SDL_SetTextureScaleMode(atlas, SDL_ScaleModeNearest);
+#endif
+
+    overlay->atlas = atlas;
+    return true;
+}
+
+static Uint32 SDLCALL
+sc_overlay_on_timer(Uint32 interval, void *userdata) {
+    (void) userdata;
+
+    // Called from the SDL timer thread, let the main thread render
+    sc_push_event(SC_EVENT_OVERLAY_REFRESH);
+    return interval;
+}
+
+static void
+sc_overlay_read_counters(struct sc_stats *stats,
+                         struct sc_overlay_counters *counters) {
+    counters->video_bytes = sc_stats_get(&stats->video_bytes);
+    counters->decoded_frames = sc_stats_get(&stats->decoded_frames);
+    counters->decode_time = sc_stats_get(&stats->decode_time);
+    counters->receive_delay = sc_stats_get(&stats->receive_delay);
+    counters->receive_delay_count = sc_stats_get(&stats->receive_delay_count);
+    counters->input_frames = sc_stats_get(&stats->input_frames);
+    counters->skipped_frames = sc_stats_get(&stats->skipped_frames);
+    counters->presented_frames = sc_stats_get(&stats->presented_frames);
+    counters->present_delay = sc_stats_get(&stats->present_delay);
+    counters->audio_underflows = sc_stats_get(&stats->audio_underflows);
+}
+
+static inline double
+sc_overlay_avg_ms(uint64_t total, uint64_t count) {
+    return count ? (double) total / count / SC_TICK_FROM_MS(1) : 0;
+}
+
+static void
+sc_overlay_snapshot(struct sc_overlay *overlay, sc_tick now) {
+    struct sc_overlay_counters cur;
+    sc_overlay_read_counters(overlay->stats, &cur);
+    const struct sc_overlay_counters *last = &overlay->last;
+
+    double secs = (double) (now - overlay->last_snapshot) / SC_TICK_FREQ;
+    assert(secs > 0);
+
+    uint64_t presented = cur.presented_frames - last->presented_frames;
+    double input_fps = (cur.input_frames - last->input_frames) / secs;
+    double presented_fps = presented / secs;
+    double skipped_fps = (cur.skipped_frames - last->skipped_frames) / secs;
+    double mbps = (cur.video_bytes - last->video_bytes) * 8 / secs / 1000000;
+    double decode_ms =
+        sc_overlay_avg_ms(cur.decode_time - last->decode_time,
+                          cur.decoded_frames - last->decoded_frames);
+    double receive_ms =
+        sc_overlay_avg_ms(cur.receive_delay - last->receive_delay,
+                          cur.receive_delay_count - last->receive_delay_count);
+    double present_ms =
+        sc_overlay_avg_ms(cur.present_delay - last->present_delay, presented);
+    sc_tick video_buffer_ms = SC_TICK_TO_MS(overlay->stats->video_buffer);
+    uint32_t audio_buffering =
+        atomic_load_explicit(&overlay->stats->audio_buffering,
+                             memory_order_relaxed);
+    uint32_t audio_target =
+        atomic_load_explicit(&overlay->stats->audio_target,
+                             memory_order_relaxed);
+    enum sc_audio_tuner_reason audio_target_reason =
+        atomic_load_explicit(&overlay->stats->audio_target_reason,
+                             memory_order_relaxed);
+    uint64_t underflows = cur.audio_underflows - last->audio_underflows;
+
+    // The device clock is unknown, so only the latency from the packet
+    // reception to the presentation can be measured
+    double latency_ms = receive_ms + video_buffer_ms + present_ms;
+
+    char (*text)[SC_OVERLAY_LINE_SIZE] = overlay->text;
+    snprintf(text[0], sizeof(*text), "FPS: %.1f in, %.1f shown", input_fps,
+             presented_fps);
+    snprintf(text[1], sizeof(*text), "Skipped: %.1f/s  Decode: %.2f ms",
+             skipped_fps, decode_ms);
+    snprintf(text[2], sizeof(*text), "Bitrate: %.2f Mbps", mbps);
+    snprintf(text[3], sizeof(*text), "Buffer: video %" PRItick " ms, "
+             "audio %" PRIu32 " ms", video_buffer_ms,
+             (uint32_t) SC_TICK_TO_MS(audio_buffering));
+    if (audio_target) {
+        snprintf(text[4], sizeof(*text), "Audio target: %" PRIu32 " ms (%s)",
+                 (uint32_t) SC_TICK_TO_MS(audio_target),
+                 sc_audio_tuner_reason_name(audio_target_reason));
+    } else {
+        snprintf(text[4], sizeof(*text), "Audio target: -");
+    }
+    uint64_t reconnections = sc_stats_get(&overlay->stats->reconnections);
+    if (reconnections) {
+        sc_tick recovery_time = sc_stats_get(&overlay->stats->recovery_time);
+        snprintf(text[5], sizeof(*text), "Audio underflows: %" PRIu64 "  "
+                 "Resumed: %" PRIu64 " (%" PRItick " ms)", underflows,
+                 reconnections, SC_TICK_TO_MS(recovery_time));
+    } else {
+        snprintf(text[5], sizeof(*text), "Audio underflows: %" PRIu64,
+                 underflows);
+    }
+    snprintf(text[6], sizeof(*text), "Latency (client): ~%.1f ms", latency_ms);
+
+    unsigned head = overlay->history_head;
+    overlay->history[SC_OVERLAY_GRAPH_FPS][head] = presented_fps;
+    overlay->history[SC_OVERLAY_GRAPH_BITRATE][head] = mbps;
+    overlay->history[SC_OVERLAY_GRAPH_LATENCY][head] = latency_ms;
+    overlay->history_head = (head + 1) % SC_OVERLAY_HISTORY_SIZE;
+    if (overlay->history_count < SC_OVERLAY_HISTORY_SIZE) {
+        ++overlay->history_count;
+    }
+
+    overlay->last = cur;
+    overlay->last_snapshot = now;
+    overlay->has_values = true;
+}
+
+static void
+sc_overlay_draw_text(struct sc_overlay *overlay, int x, int y, int scale,
+                     const char *text) {
+    for (const char *c = text; *c; ++c) {
+        unsigned char ch = *c;
+        // Nothing to draw for spaces
+        if (ch > SC_OVERLAY_FIRST_CHAR && ch <= SC_OVERLAY_LAST_CHAR) {
+            unsigned index = ch - SC_OVERLAY_FIRST_CHAR;
+            SDL_Rect src = {
+                .x = index % SC_OVERLAY_ATLAS_COLUMNS * SC_OVERLAY_CELL_WIDTH,
+                .y = index / SC_OVERLAY_ATLAS_COLUMNS * SC_OVERLAY_CELL_HEIGHT,
+                .w = SC_OVERLAY_CELL_WIDTH,
+                .h = SC_OVERLAY_CELL_HEIGHT,
+            };
+            SDL_Rect dst = {
+                .x = x,
+                .y = y,
+                .w = SC_OVERLAY_CELL_WIDTH * scale,
+                .h = SC_OVERLAY_CELL_HEIGHT * scale,
+            };
+            SDL_RenderCopy(overlay->renderer, overlay->atlas, &src, &dst);
+        }
+        x += SC_OVERLAY_CELL_WIDTH * scale;
+    }
+}
+
+static void
+sc_overlay_draw_graph(struct sc_overlay *overlay, enum sc_overlay_graph graph,
+                      int x, int y, int scale) {
+    SDL_Renderer *renderer = overlay->renderer;
+    const float *values = overlay->history[graph];
+
+    SDL_Rect rect = {
+        .x = x,
+        .y = y,
+        .w = SC_OVERLAY_GRAPH_WIDTH * scale,
+        .h = SC_OVERLAY_GRAPH_HEIGHT * scale,
+    };
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0x30);
+    SDL_RenderFillRect(renderer, &rect);
+
+    unsigned count = overlay->history_count;
+    if (count < 2) {
+        return;
+    }
+
+    unsigned first = (overlay->history_head + SC_OVERLAY_HISTORY_SIZE - count)
+                   % SC_OVERLAY_HISTORY_SIZE;
+
+    float max = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        max = MAX(max, values[(first + i) % SC_OVERLAY_HISTORY_SIZE]);
+    }
+    if (max <= 0) {
+        max = 1;
+    }
+
+    // The most recent value is on the right
+    SDL_Point points[SC_OVERLAY_HISTORY_SIZE];
+    for (unsigned i = 0; i < count; ++i) {
+        float value = values[(first + i) % SC_OVERLAY_HISTORY_SIZE];
+        points[i].x = rect.x + rect.w - 1
+                    - (count - 1 - i) * SC_OVERLAY_GRAPH_STEP * scale;
+        points[i].y = rect.y + rect.h - 1 - (int) (value / max * (rect.h - 1));
+    }
+
+    SDL_SetRenderDrawColor(renderer, 0x40, 0xFF, 0x40, 0xFF);
+    SDL_RenderDrawLines(renderer, points, count);
+}
+
+void
+sc_overlay_render(struct sc_overlay *overlay) {
+    if (!overlay->enabled) {
+        return;
+    }
+
+    assert(overlay->atlas);
+
+    sc_tick now = sc_tick_now();
+    if (now - overlay->last_snapshot >= SC_OVERLAY_SNAPSHOT_INTERVAL) {
+        sc_overlay_snapshot(overlay, now);
+    }
+
+    SDL_Renderer *renderer = overlay->renderer;
+
+    int output_width;
+    if (SDL_GetRendererOutputSize(renderer, &output_width, NULL)) {
+        output_width = 0;
+    }
+    // Larger text on large (typically HiDPI) outputs
+    int scale = output_width >= 1280 ? 2 : 1;
+
+    unsigned lines = overlay->has_values ? SC_OVERLAY_LINES : 1;
+    size_t max_len = 0;
+    for (unsigned i = 0; i < lines; ++i) {
+        max_len = MAX(max_len, strlen(overlay->text[i]));
+    }
+
+    int text_width = max_len * SC_OVERLAY_CELL_WIDTH;
+    int graph_row_width = SC_OVERLAY_GRAPH_LABEL_CHARS * SC_OVERLAY_CELL_WIDTH
+                        + SC_OVERLAY_GRAPH_WIDTH;
+    int graphs_height = overlay->has_values
+                      ? SC_OVERLAY_GRAPH_COUNT
+                            * (SC_OVERLAY_GRAPH_HEIGHT
+                                + SC_OVERLAY_GRAPH_SPACING)
+                      : 0;
+
+    int x = SC_OVERLAY_MARGIN * scale;
+    int y = SC_OVERLAY_MARGIN * scale;
+    int padding = SC_OVERLAY_PADDING * scale;
+    SDL_Rect background = {
+        .x = x,
+        .y = y,
+        .w = (MAX(text_width, graph_row_width) + 2 * SC_OVERLAY_PADDING)
+                * scale,
+        .h = (lines * SC_OVERLAY_LINE_HEIGHT + graphs_height
+                + 2 * SC_OVERLAY_PADDING) * scale,
+    };
+
+    // The renderer state is shared with the display, restore it afterwards
+    uint8_t r, g, b, a;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_BlendMode blend_mode;
+    SDL_GetRenderDrawBlendMode(renderer, &blend_mode);
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xA0);
+    SDL_RenderFillRect(renderer, &background);
+
+    x += padding;
+    y += padding;
+    for (unsigned i = 0; i < lines; ++i) {
+        sc_overlay_draw_text(overlay, x, y, scale, overlay->text[i]);
+        y += SC_OVERLAY_LINE_HEIGHT * scale;
+    }
+
+    if (overlay->has_values) {
+        int graph_x =
+            x + SC_OVERLAY_GRAPH_LABEL_CHARS * SC_OVERLAY_CELL_WIDTH * scale;
+        for (unsigned i = 0; i < SC_OVERLAY_GRAPH_COUNT; ++i) {
+            // Vertically center the label
+            int label_y = y + (SC_OVERLAY_GRAPH_HEIGHT - SC_OVERLAY_CELL_HEIGHT)
+                                * scale / 2;
+            sc_overlay_draw_text(overlay, x, label_y, scale,
+                                 sc_overlay_graph_labels[i]);
+            sc_overlay_draw_graph(overlay, i, graph_x, y, scale);
+            y += (SC_OVERLAY_GRAPH_HEIGHT + SC_OVERLAY_GRAPH_SPACING) * scale;
+        }
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer, blend_mode);
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+}
+
+bool
+sc_overlay_set_enabled(struct sc_overlay *overlay, bool enabled) {
+    if (enabled == overlay->enabled) {
+        return true;
+    }
+
+    if (!enabled) {
+        if (overlay->timer) {
+            SDL_RemoveTimer(overlay->timer);
+            overlay->timer = 0;
+        }
+        overlay->enabled = false;
+        return true;
+    }
+
+    if (!overlay->atlas && !sc_overlay_create_atlas(overlay)) {
+        return false;
+    }
+
+    // Start from a new reference snapshot
+    sc_overlay_read_counters(overlay->stats, &overlay->last);
+    overlay->last_snapshot = sc_tick_now();
+    overlay->has_values = false;
+    overlay->history_head = 0;
+    overlay->history_count = 0;
+    snprintf(overlay->text[0], sizeof(overlay->text[0]), "Collecting stats...");
+
+    overlay->timer = SDL_AddTimer(SC_OVERLAY_REFRESH_INTERVAL_MS,
+                                  sc_overlay_on_timer, NULL);
+    if (!overlay->timer) {
+        // Not fatal, the overlay will be refreshed on new frames only
+        LOGW("Could not start overlay timer: %s", SDL_GetError());
+    }
+
+    overlay->enabled = true;
+    return true;
+}
+
+void
+sc_overlay_init(struct sc_overlay *overlay, SDL_Renderer *renderer,
+                struct sc_stats *stats) {
+    assert(renderer);
+    assert(stats);
+
+    overlay->renderer = renderer;
+    overlay->stats = stats;
+    overlay->atlas = NULL;
+    overlay->timer = 0;
+    overlay->enabled = false;
+    overlay->has_values = false;
+    overlay->history_head = 0;
+    overlay->history_count = 0;
+}
+
+void
+sc_overlay_destroy(struct sc_overlay *overlay) {
+    if (overlay->timer) {
+        SDL_RemoveTimer(overlay->timer);
+    }
+    if (overlay->atlas) {
+        SDL_DestroyTexture(overlay->atlas);
+    }
+}
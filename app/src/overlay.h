@@ -0,0 +1,88 @@
+#ifndef SC_OVERLAY_H
+#define SC_OVERLAY_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <SDL2/SDL.h>
+
+#include "stats.h"
+#include "util/tick.h"
+
+#define SC_OVERLAY_LINES 7
+#define SC_OVERLAY_LINE_SIZE 48
+#define SC_OVERLAY_HISTORY_SIZE 60
+
+enum sc_overlay_graph {
+    SC_OVERLAY_GRAPH_FPS,
+    SC_OVERLAY_GRAPH_BITRATE,
+    SC_OVERLAY_GRAPH_LATENCY,
+    SC_OVERLAY_GRAPH_COUNT,
+};
+
+// Values of the cumulative stats counters at a given time
+struct sc_overlay_counters {
+    uint64_t video_bytes;
+    uint64_t decoded_frames;
+    uint64_t decode_time;
+    uint64_t receive_delay;
+    uint64_t receive_delay_count;
+    uint64_t input_frames;
+    uint64_t skipped_frames;
+    uint64_t presented_frames;
+    uint64_t present_delay;
+    uint64_t audio_underflows;
+};
+
+/**
+ * Statistics overlay, drawn over the video content
+ *
+ * The text is rendered from a glyph atlas (a single small texture created
+ * once), so that drawing the overlay only submits textured quads and lines to
+ * the renderer, which batches them.
+ *
+ * All the functions must be called from the main thread.
+ */
+struct sc_overlay {
+    SDL_Renderer *renderer;
+    struct sc_stats *stats;
+
+    SDL_Texture *atlas; // created on first enable
+    SDL_TimerID timer;
+    bool enabled;
+
+    sc_tick last_snapshot;
+    struct sc_overlay_counters last;
+    bool has_values;
+
+    char text[SC_OVERLAY_LINES][SC_OVERLAY_LINE_SIZE];
+
+    // circular buffers of the values per second
+    float history[SC_OVERLAY_GRAPH_COUNT][SC_OVERLAY_HISTORY_SIZE];
+    unsigned history_head; // index of the next value
+    unsigned history_count;
+};
+
+void
+sc_overlay_init(struct sc_overlay *overlay, SDL_Renderer *renderer,
+                struct sc_stats *stats);
+
+void
+sc_overlay_destroy(struct sc_overlay *overlay);
+
+// While enabled, an SC_EVENT_OVERLAY_REFRESH event is posted periodically, so
+// that the values are refreshed even if no new frame is received
+bool
+sc_overlay_set_enabled(struct sc_overlay *overlay, bool enabled);
+
+static inline bool
+sc_overlay_is_enabled(const struct sc_overlay *overlay) {
+    return overlay->enabled;
+}
+
+// Draw the overlay (if enabled) on the current render target
+void
+sc_overlay_render(struct sc_overlay *overlay);
+
+#endif
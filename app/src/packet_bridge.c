@@ -0,0 +1,204 @@
+#include "packet_bridge.h"
+
+#include <assert.h>
+#include <inttypes.h>
+
+#include "util/log.h"
+
+/** Downcast packet_sink to sc_packet_bridge */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_packet_bridge, packet_sink)
+
+static AVCodecContext *
+sc_packet_bridge_copy_context(const AVCodecContext *ctx) {
+    const AVCodec *codec = ctx->codec;
+    assert(codec);
+
+    AVCodecContext *copy = avcodec_alloc_context3(codec);
+    if (!copy) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    AVCodecParameters *par = avcodec_parameters_alloc();
+    if (!par) {
+        LOG_OOM();
+        goto error_free_context;
+    }
+
+    int r = avcodec_parameters_from_context(par, ctx);
+    if (r >= 0) {
+        r = avcodec_parameters_to_context(copy, par);
+    }
+    avcodec_parameters_free(&par);
+    if (r < 0) {
+        LOGE("Could not copy codec parameters");
+        goto error_free_context;
+    }
+
+    copy->flags = ctx->flags;
+
+    if (avcodec_open2(copy, codec, NULL) < 0) {
+        LOGE("Could not open codec");
+        goto error_free_context;
+    }
+
+    return copy;
+
+error_free_context:
+    avcodec_free_context(&copy);
+    return NULL;
+}
+
+static bool
+sc_packet_bridge_packet_sink_open(struct sc_packet_sink *sink,
+                                  AVCodecContext *ctx) {
+    struct sc_packet_bridge *bridge = DOWNCAST(sink);
+
+    if (bridge->disabled) {
+        // The sinks must not be opened once disabled, ignore the new stream
+        return true;
+    }
+
+    if (bridge->ctx) {
+        // A new stream, after a reconnection
+        if (ctx->codec_id != bridge->ctx->codec_id) {
+            LOGE("Packet bridge '%s': the codec changed on reconnection",
+                 bridge->name);
+            return false;
+        }
+
+        // Drop the state of the previous stream (the new stream starts with a
+        // key frame)
+        avcodec_flush_buffers(bridge->ctx);
+        bridge->resync = true;
+        return true;
+    }
+
+    bridge->packet = av_packet_alloc();
+    if (!bridge->packet) {
+        LOG_OOM();
+        return false;
+    }
+
+    bridge->ctx = sc_packet_bridge_copy_context(ctx);
+    if (!bridge->ctx) {
+        goto error_free_packet;
+    }
+
+    if (!sc_packet_source_sinks_open(&bridge->packet_source, bridge->ctx)) {
+        goto error_free_context;
+    }
+
+    return true;
+
+error_free_context:
+    avcodec_free_context(&bridge->ctx);
+error_free_packet:
+    av_packet_free(&bridge->packet);
+
+    return false;
+}
+
+static void
+sc_packet_bridge_packet_sink_close(struct sc_packet_sink *sink) {
+    // The sinks remain open until the bridge is destroyed
+    (void) sink;
+}
+
+static bool
+sc_packet_bridge_packet_sink_push(struct sc_packet_sink *sink,
+                                  const AVPacket *packet) {
+    struct sc_packet_bridge *bridge = DOWNCAST(sink);
+
+    if (bridge->disabled) {
+        return true;
+    }
+
+    bool is_config = packet->pts == AV_NOPTS_VALUE;
+    if (is_config) {
+        return sc_packet_source_sinks_push(&bridge->packet_source, packet);
+    }
+
+    sc_tick now = sc_tick_now();
+
+    if (bridge->resync) {
+        bridge->resync = false;
+        if (bridge->last_pts != AV_NOPTS_VALUE) {
+            // Continue from the last PTS, plus the duration of the
+            // interruption
+            int64_t gap = SC_TICK_TO_US(now - bridge->last_pts_time);
+            bridge->pts_offset = bridge->last_pts + gap - packet->pts;
+            LOGD("Packet bridge '%s': PTS offset %" PRIi64 " us",
+                 bridge->name, bridge->pts_offset);
+        }
+    }
+
+    int64_t pts = packet->pts + bridge->pts_offset;
+    bridge->last_pts = pts;
+    bridge->last_pts_time = now;
+
+    if (!bridge->pts_offset) {
+        return sc_packet_source_sinks_push(&bridge->packet_source, packet);
+    }
+
+    if (av_packet_ref(bridge->packet, packet)) {
+        LOG_OOM();
+        return false;
+    }
+
+    bridge->packet->pts = pts;
+    bridge->packet->dts = pts;
+
+    bool ok = sc_packet_source_sinks_push(&bridge->packet_source,
+                                          bridge->packet);
+    av_packet_unref(bridge->packet);
+    return ok;
+}
+
+static void
+sc_packet_bridge_packet_sink_disable(struct sc_packet_sink *sink) {
+    struct sc_packet_bridge *bridge = DOWNCAST(sink);
+
+    if (bridge->ctx || bridge->disabled) {
+        // The sinks have already been opened or disabled: from their point of
+        // view, the stream is just paused
+        LOGW("Packet bridge '%s': stream disabled after reconnection",
+             bridge->name);
+        return;
+    }
+
+    bridge->disabled = true;
+    sc_packet_source_sinks_disable(&bridge->packet_source);
+}
+
+void
+sc_packet_bridge_init(struct sc_packet_bridge *bridge, const char *name) {
+    bridge->name = name; // statically allocated
+    bridge->ctx = NULL;
+    bridge->packet = NULL;
+    bridge->disabled = false;
+    bridge->resync = false;
+    bridge->pts_offset = 0;
+    bridge->last_pts = AV_NOPTS_VALUE;
+    bridge->last_pts_time = 0;
+
+    sc_packet_source_init(&bridge->packet_source);
+
+    static const struct sc_packet_sink_ops ops = {
+        .open = sc_packet_bridge_packet_sink_open,
+        .close = sc_packet_bridge_packet_sink_close,
+        .push = sc_packet_bridge_packet_sink_push,
+        .disable = sc_packet_bridge_packet_sink_disable,
+    };
+
+    bridge->packet_sink.ops = &ops;
+}
+
+void
+sc_packet_bridge_destroy(struct sc_packet_bridge *bridge) {
+    if (bridge->ctx) {
+        sc_packet_source_sinks_close(&bridge->packet_source);
+        avcodec_free_context(&bridge->ctx);
+        av_packet_free(&bridge->packet);
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef SC_PACKET_BRIDGE_H
+#define SC_PACKET_BRIDGE_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+
+#include "trait/packet_sink.h"
+#include "trait/packet_source.h"
+#include "util/tick.h"
+
+/**
+ * Packet bridge, to keep the packet sinks open across several successive
+ * streams (one per device connection, on automatic reconnection).
+ *
+ * On the first open(), it opens its sinks with its own copy of the codec
+ * context, which remains valid until the bridge is destroyed. Subsequent
+ * open() and close() from the demuxer are not forwarded: the sinks only see a
+ * single stream, with a pause between two connections.
+ *
+ * The PTS of each new stream are shifted so that they continue to increase
+ * monotonically, as if the stream had just been paused.
+ *
+ * Only one demuxer may use the bridge at a time (the previous one must be
+ * joined before the next one is started).
+ */
+struct sc_packet_bridge {
+    struct sc_packet_source packet_source; // packet source trait
+    struct sc_packet_sink packet_sink; // packet sink trait
+
+    const char *name; // must be statically allocated (e.g. a string literal)
+
+    AVCodecContext *ctx; // owned, non-NULL once the sinks are open
+    AVPacket *packet; // to forward the packets with shifted PTS
+
+    bool disabled;
+    bool resync; // a new stream is started
+    int64_t pts_offset;
+    int64_t last_pts; // last forwarded PTS (shifted)
+    sc_tick last_pts_time; // date of the last forwarded packet
+};
+
+// The name must be statically allocated (e.g. a string literal)
+void
+sc_packet_bridge_init(struct sc_packet_bridge *bridge, const char *name);
+
+// Close the sinks (if they have been opened) and release the resources
+void
+sc_packet_bridge_destroy(struct sc_packet_bridge *bridge);
+
+#endif
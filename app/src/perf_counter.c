@@ -0,0 +1,313 @@
+#include "perf_counter.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#ifdef HAVE_PERF_EVENT
+# include <string.h>
+# include <unistd.h>
+# include <linux/perf_event.h>
+# include <sys/syscall.h>
+#endif
+
+#include "util/log.h"
+#include "util/thread.h"
+
+#define SC_PERF_MAX_THREADS 16
+
+enum sc_perf_event {
+    SC_PERF_EVENT_CYCLES,
+    SC_PERF_EVENT_INSTRUCTIONS,
+    SC_PERF_EVENT_CACHE_MISSES,
+    SC_PERF_EVENT_CONTEXT_SWITCHES,
+    SC_PERF_EVENT_COUNT,
+};
+
+struct sc_perf_thread {
+    const char *stage;
+    const char *name;
+    const char *unit;
+    int fds[SC_PERF_EVENT_COUNT];
+    atomic_uint_least64_t items;
+    // false once the thread is unregistered, the slot may then be reused by
+    // a new thread of the same stage and name
+    bool active;
+    // Accumulated values of the previous threads of this slot
+    uint64_t totals[SC_PERF_EVENT_COUNT];
+    bool valid[SC_PERF_EVENT_COUNT];
+};
+
+static struct {
+    bool initialized;
+    sc_mutex mutex;
+    // protected by the mutex
+    struct sc_perf_thread threads[SC_PERF_MAX_THREADS];
+    unsigned count;
+} sc_perf;
+
+#ifdef HAVE_PERF_EVENT
+static int
+sc_perf_event_open(enum sc_perf_event event) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+
+    switch (event) {
+        case SC_PERF_EVENT_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case SC_PERF_EVENT_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case SC_PERF_EVENT_CACHE_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case SC_PERF_EVENT_CONTEXT_SWITCHES:
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+            break;
+        default:
+            assert(!"unexpected event");
+            return -1;
+    }
+
+    // Count user space only, allowed for unprivileged users by default
+    // (perf_event_paranoid <= 2)
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // pid = 0 and cpu = -1: the calling thread, on any CPU
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static bool
+sc_perf_event_read(int fd, uint64_t *value) {
+    if (fd == -1) {
+        return false;
+    }
+
+    ssize_t r = read(fd, value, sizeof(*value));
+    return r == sizeof(*value);
+}
+#endif
+
+bool
+sc_perf_counters_init(void) {
+#ifdef HAVE_PERF_EVENT
+    assert(!sc_perf.initialized);
+
+    bool ok = sc_mutex_init(&sc_perf.mutex);
+    if (!ok) {
+        return false;
+    }
+
+    sc_perf.count = 0;
+    sc_perf.initialized = true;
+    return true;
+#else
+    LOGE("Performance counters are not supported on this platform");
+    return false;
+#endif
+}
+
+void
+sc_perf_counters_destroy(void) {
+    if (!sc_perf.initialized) {
+        return;
+    }
+
+#ifdef HAVE_PERF_EVENT
+    for (unsigned i = 0; i < sc_perf.count; ++i) {
+        struct sc_perf_thread *thread = &sc_perf.threads[i];
+        for (unsigned j = 0; j < SC_PERF_EVENT_COUNT; ++j) {
+            if (thread->fds[j] != -1) {
+                close(thread->fds[j]);
+                thread->fds[j] = -1;
+            }
+        }
+    }
+#endif
+
+    sc_mutex_destroy(&sc_perf.mutex);
+    sc_perf.initialized = false;
+}
+
+struct sc_perf_thread *
+sc_perf_thread_register(const char *stage, const char *name,
+                        const char *unit) {
+    if (!sc_perf.initialized) {
+        return NULL;
+    }
+
+#ifdef HAVE_PERF_EVENT
+    int fds[SC_PERF_EVENT_COUNT];
+    bool any = false;
+    for (unsigned i = 0; i < SC_PERF_EVENT_COUNT; ++i) {
+        // Some events may not be available (e.g. hardware events in a VM)
+        fds[i] = sc_perf_event_open(i);
+        any |= fds[i] != -1;
+    }
+
+    if (!any) {
+        LOGW("Perf counters: could not open counters for %s (check "
+             "/proc/sys/kernel/perf_event_paranoid)", stage);
+        return NULL;
+    }
+
+    sc_mutex_lock(&sc_perf.mutex);
+
+    // A new thread of the same stage and name (e.g. on reconnection) reuses
+    // the slot of the previous one, so that its counts are accumulated
+    struct sc_perf_thread *thread = NULL;
+    for (unsigned i = 0; i < sc_perf.count; ++i) {
+        struct sc_perf_thread *t = &sc_perf.threads[i];
+        if (!t->active && !strcmp(t->stage, stage)
+                && (t->name == name
+                    || (t->name && name && !strcmp(t->name, name)))) {
+            thread = t;
+            break;
+        }
+    }
+
+    if (!thread) {
+        if (sc_perf.count == SC_PERF_MAX_THREADS) {
+            sc_mutex_unlock(&sc_perf.mutex);
+            LOGW("Perf counters: too many threads, %s not registered", stage);
+            for (unsigned i = 0; i < SC_PERF_EVENT_COUNT; ++i) {
+                if (fds[i] != -1) {
+                    close(fds[i]);
+                }
+            }
+            return NULL;
+        }
+
+        thread = &sc_perf.threads[sc_perf.count++];
+        thread->stage = stage;
+        thread->name = name;
+        thread->unit = unit;
+        atomic_init(&thread->items, 0);
+        for (unsigned i = 0; i < SC_PERF_EVENT_COUNT; ++i) {
+            thread->totals[i] = 0;
+            thread->valid[i] = false;
+        }
+    }
+
+    for (unsigned i = 0; i < SC_PERF_EVENT_COUNT; ++i) {
+        thread->fds[i] = fds[i];
+    }
+    thread->active = true;
+
+    sc_mutex_unlock(&sc_perf.mutex);
+
+    LOGD("Perf counters: registered %s%s%s", stage, name ? " " : "",
+         name ? name : "");
+    return thread;
+#else
+    (void) stage;
+    (void) name;
+    (void) unit;
+    return NULL;
+#endif
+}
+
+void
+sc_perf_thread_unregister(struct sc_perf_thread *thread) {
+    if (!thread) {
+        return;
+    }
+
+#ifdef HAVE_PERF_EVENT
+    sc_mutex_lock(&sc_perf.mutex);
+    assert(thread->active);
+    for (unsigned i = 0; i < SC_PERF_EVENT_COUNT; ++i) {
+        uint64_t value;
+        if (sc_perf_event_read(thread->fds[i], &value)) {
+            thread->totals[i] += value;
+            thread->valid[i] = true;
+        }
+        if (thread->fds[i] != -1) {
+            close(thread->fds[i]);
+            thread->fds[i] = -1;
+        }
+    }
+    thread->active = false;
+    sc_mutex_unlock(&sc_perf.mutex);
+#else
+    assert(!"unexpected perf thread");
+#endif
+}
+
+void
+sc_perf_thread_add_item(struct sc_perf_thread *thread) {
+    if (thread) {
+        atomic_fetch_add_explicit(&thread->items, 1, memory_order_relaxed);
+    }
+}
+
+#ifdef HAVE_PERF_EVENT
+static void
+sc_perf_thread_report(struct sc_perf_thread *thread) {
+    static const char *const labels[] = {
+        [SC_PERF_EVENT_CYCLES] = "cycles",
+        [SC_PERF_EVENT_INSTRUCTIONS] = "instructions",
+        [SC_PERF_EVENT_CACHE_MISSES] = "cache-misses",
+        [SC_PERF_EVENT_CONTEXT_SWITCHES] = "context-switches",
+    };
+
+    uint64_t items = atomic_load_explicit(&thread->items,
+                                          memory_order_relaxed);
+
+    LOGI("  %s%s%s: %" PRIu64 " %ss", thread->stage, thread->name ? " " : "",
+         thread->name ? thread->name : "", items, thread->unit);
+
+    uint64_t values[SC_PERF_EVENT_COUNT];
+    bool valid[SC_PERF_EVENT_COUNT];
+    for (unsigned i = 0; i < SC_PERF_EVENT_COUNT; ++i) {
+        // The counts of the previous threads of this slot, plus the live
+        // counts of the current one (if any)
+        values[i] = thread->totals[i];
+        valid[i] = thread->valid[i];
+        uint64_t value;
+        if (sc_perf_event_read(thread->fds[i], &value)) {
+            values[i] += value;
+            valid[i] = true;
+        }
+
+        if (!valid[i]) {
+            LOGI("    %16s: n/a", labels[i]);
+        } else if (items) {
+            LOGI("    %16s: %" PRIu64 " (%.1f per %s)", labels[i], values[i],
+                 (double) values[i] / items, thread->unit);
+        } else {
+            LOGI("    %16s: %" PRIu64, labels[i], values[i]);
+        }
+    }
+
+    if (valid[SC_PERF_EVENT_CYCLES] && valid[SC_PERF_EVENT_INSTRUCTIONS]
+            && values[SC_PERF_EVENT_CYCLES]) {
+        LOGI("    %16s: %.2f", "IPC",
+             (double) values[SC_PERF_EVENT_INSTRUCTIONS]
+                    / values[SC_PERF_EVENT_CYCLES]);
+    }
+}
+#endif
+
+void
+sc_perf_counters_report(void) {
+    if (!sc_perf.initialized) {
+        return;
+    }
+
+#ifdef HAVE_PERF_EVENT
+    sc_mutex_lock(&sc_perf.mutex);
+    LOGI("Perf counters (user space):");
+    for (unsigned i = 0; i < sc_perf.count; ++i) {
+        sc_perf_thread_report(&sc_perf.threads[i]);
+    }
+    sc_mutex_unlock(&sc_perf.mutex);
+#endif
+}
@@ -0,0 +1,65 @@
+#ifndef SC_PERF_COUNTER_H
+#define SC_PERF_COUNTER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+
+/**
+ * Per-thread hardware and software performance counters (cycles,
+ * instructions, cache misses and context switches), based on
+ * perf_event_open() on Linux.
+ *
+ * Each pipeline thread registers itself once it is running, then increments
+ * its item counter for every unit of work (packet, frame, message...), so that
+ * the costs can be reported per item at exit. It unregisters itself before
+ * exiting: the counts are kept, and a later thread of the same stage and name
+ * (e.g. after a reconnection) accumulates into the same entry.
+ *
+ * This is a process-wide facility (like logging): if it is not enabled, all
+ * the functions do nothing.
+ */
+
+struct sc_perf_thread;
+
+// Return false if performance counters are not supported
+bool
+sc_perf_counters_init(void);
+
+void
+sc_perf_counters_destroy(void);
+
+// Print the counters of all the registered threads
+void
+sc_perf_counters_report(void);
+
+/**
+ * Open the counters for the calling thread
+ *
+ * The stage, name and unit must be statically allocated (e.g. string
+ * literals). The name may be NULL. The unit is the singular name of the items
+ * (e.g. "packet").
+ *
+ * Return NULL if the counters are disabled or could not be opened.
+ */
+struct sc_perf_thread *
+sc_perf_thread_register(const char *stage, const char *name,
+                        const char *unit);
+
+/**
+ * Close the counters of a registered thread
+ *
+ * It is typically called by the registered thread itself before exiting, but
+ * it may be called from another thread once the registered thread has stopped
+ * (e.g. the SDL audio thread, stopped by SDL_CloseAudioDevice()).
+ *
+ * Its counts are kept for the report. The thread may be NULL.
+ */
+void
+sc_perf_thread_unregister(struct sc_perf_thread *thread);
+
+// Count one processed item (the thread may be NULL)
+void
+sc_perf_thread_add_item(struct sc_perf_thread *thread);
+
+#endif
@@ -0,0 +1,598 @@
+#include "proxy_recorder.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libswscale/swscale.h>
+#include <SDL2/SDL_cpuinfo.h>
+
+#include "memory_budget.h"
+#include "scaler.h"
+#include "util/log.h"
+#include "util/str.h"
+
+/** Downcast frame_sink to sc_proxy_recorder */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_proxy_recorder, frame_sink)
+
+static const AVRational SCRCPY_TIME_BASE = {1, 1000000}; // timestamps in us
+
+// The MPEG-4 part 2 encoder does not support a time base denominator greater
+// than 65535
+static const AVRational SC_PROXY_RECORDER_TIME_BASE = {1, 1000};
+
+#define SC_PROXY_RECORDER_GOP_SIZE 60
+
+static const char *
+sc_proxy_recorder_get_format_name(enum sc_record_format format) {
+    switch (format) {
+        case SC_RECORD_FORMAT_MP4:
+            return "mp4";
+        case SC_RECORD_FORMAT_MKV:
+            return "matroska";
+        default:
+            return NULL;
+    }
+}
+
+static const AVCodec *
+sc_proxy_recorder_find_encoder(void) {
+    // Use an H.264 encoder if available (e.g. libx264), otherwise fallback to
+    // the native MPEG-4 part 2 encoder
+    const AVCodec *encoder = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (!encoder) {
+        encoder = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+    }
+    return encoder;
+}
+
+static bool
+sc_proxy_recorder_open_encoder(struct sc_proxy_recorder *pr) {
+    const AVCodec *encoder = sc_proxy_recorder_find_encoder();
+    if (!encoder) {
+        LOGE("Proxy recorder: no H.264 or MPEG-4 encoder available");
+        return false;
+    }
+
+    pr->encoder_ctx = avcodec_alloc_context3(encoder);
+    if (!pr->encoder_ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    AVCodecContext *ctx = pr->encoder_ctx;
+    ctx->width = pr->width;
+    ctx->height = pr->height;
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    ctx->time_base = SC_PROXY_RECORDER_TIME_BASE;
+    ctx->bit_rate = pr->bit_rate;
+    ctx->gop_size = SC_PROXY_RECORDER_GOP_SIZE;
+    // B-frames would delay the output and require to reorder the packets
+    ctx->max_b_frames = 0;
+    ctx->thread_count = pr->worker_count;
+    if (pr->format_ctx->oformat->flags & AVFMT_GLOBALHEADER) {
+        ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    // Options not supported by the encoder are ignored
+    AVDictionary *opts = NULL;
+    av_dict_set(&opts, "preset", "veryfast", 0);
+
+    int r = avcodec_open2(ctx, encoder, &opts);
+    av_dict_free(&opts);
+    if (r < 0) {
+        LOGE("Proxy recorder: could not open encoder %s", encoder->name);
+        avcodec_free_context(&pr->encoder_ctx);
+        return false;
+    }
+
+    LOGD("Proxy recorder: using encoder %s", encoder->name);
+    return true;
+}
+
+static bool
+sc_proxy_recorder_open_output(struct sc_proxy_recorder *pr) {
+    const char *format_name = sc_proxy_recorder_get_format_name(pr->format);
+    assert(format_name);
+
+    int r = avformat_alloc_output_context2(&pr->format_ctx, NULL, format_name,
+                                           NULL);
+    if (r < 0) {
+        LOGE("Proxy recorder: could not find muxer %s", format_name);
+        return false;
+    }
+
+    char *file_url = sc_str_concat("file:", pr->filename);
+    if (!file_url) {
+        goto error_avformat_free_context;
+    }
+
+    r = avio_open(&pr->format_ctx->pb, file_url, AVIO_FLAG_WRITE);
+    free(file_url);
+    if (r < 0) {
+        LOGE("Failed to open proxy output file: %s", pr->filename);
+        goto error_avformat_free_context;
+    }
+
+    av_dict_set(&pr->format_ctx->metadata, "comment",
+                "Recorded by scrcpy " SCRCPY_VERSION " (proxy)", 0);
+
+    if (!sc_proxy_recorder_open_encoder(pr)) {
+        goto error_avio_close;
+    }
+
+    AVStream *stream = avformat_new_stream(pr->format_ctx, NULL);
+    if (!stream) {
+        LOG_OOM();
+        goto error_avcodec_free_context;
+    }
+
+    r = avcodec_parameters_from_context(stream->codecpar, pr->encoder_ctx);
+    if (r < 0) {
+        goto error_avcodec_free_context;
+    }
+    stream->time_base = pr->encoder_ctx->time_base;
+
+    r = avformat_write_header(pr->format_ctx, NULL);
+    if (r < 0) {
+        LOGE("Failed to write header to %s", pr->filename);
+        goto error_avcodec_free_context;
+    }
+
+    return true;
+
+error_avcodec_free_context:
+    avcodec_free_context(&pr->encoder_ctx);
+error_avio_close:
+    avio_close(pr->format_ctx->pb);
+error_avformat_free_context:
+    // the stream, if any, is freed with the context
+    avformat_free_context(pr->format_ctx);
+
+    return false;
+}
+
+static void
+sc_proxy_recorder_close_output(struct sc_proxy_recorder *pr) {
+    avcodec_free_context(&pr->encoder_ctx);
+    avio_close(pr->format_ctx->pb);
+    avformat_free_context(pr->format_ctx);
+}
+
+static bool
+sc_proxy_recorder_encode(struct sc_proxy_recorder *pr, const AVFrame *frame) {
+    int r = avcodec_send_frame(pr->encoder_ctx, frame);
+    if (r < 0) {
+        LOGE("Proxy recorder: could not send frame to the encoder: %d", r);
+        return false;
+    }
+
+    AVStream *stream = pr->format_ctx->streams[0];
+    AVPacket *packet = pr->packet;
+    for (;;) {
+        r = avcodec_receive_packet(pr->encoder_ctx, packet);
+        if (r == AVERROR(EAGAIN) || r == AVERROR_EOF) {
+            return true;
+        }
+        if (r < 0) {
+            LOGE("Proxy recorder: could not receive packet: %d", r);
+            return false;
+        }
+
+        av_packet_rescale_ts(packet, pr->encoder_ctx->time_base,
+                             stream->time_base);
+        packet->stream_index = 0;
+
+        // the packet is unreferenced by the muxer
+        r = av_interleaved_write_frame(pr->format_ctx, packet);
+        if (r < 0) {
+            LOGE("Proxy recorder: could not write packet: %d", r);
+            return false;
+        }
+    }
+}
+
+static void
+sc_proxy_recorder_fill_black(AVFrame *frame) {
+    assert(frame->format == AV_PIX_FMT_YUV420P);
+    memset(frame->data[0], 0x10, frame->linesize[0] * frame->height);
+    int chroma_height = (frame->height + 1) / 2;
+    memset(frame->data[1], 0x80, frame->linesize[1] * chroma_height);
+    memset(frame->data[2], 0x80, frame->linesize[2] * chroma_height);
+}
+
+// Return the frame to encode, or NULL on error
+static AVFrame *
+sc_proxy_recorder_scale(struct sc_proxy_recorder *pr,
+                        struct sc_proxy_recorder_worker *worker,
+                        AVFrame *frame) {
+    if (frame->width == pr->width && frame->height == pr->height
+            && frame->format == AV_PIX_FMT_YUV420P) {
+        // Nothing to do, encode the decoded frame directly
+        return frame;
+    }
+
+    // The frame is scaled to fit the recorded video size, preserving its
+    // aspect ratio (on rotation, the video is letterboxed)
+    int w = pr->width;
+    int h = pr->height;
+    if ((int64_t) frame->width * pr->height
+            > (int64_t) frame->height * pr->width) {
+        h = (int64_t) frame->height * pr->width / frame->width;
+    } else {
+        w = (int64_t) frame->width * pr->height / frame->height;
+    }
+    w = MAX(w & ~1, 2);
+    h = MAX(h & ~1, 2);
+    int x = ((pr->width - w) / 2) & ~1;
+    int y = ((pr->height - h) / 2) & ~1;
+
+    worker->sws_ctx = sws_getCachedContext(worker->sws_ctx,
+                                           frame->width, frame->height,
+                                           frame->format, w, h,
+                                           AV_PIX_FMT_YUV420P, SWS_BILINEAR,
+                                           NULL, NULL, NULL);
+    if (!worker->sws_ctx) {
+        LOGE("Proxy recorder: could not initialize the scaler");
+        return NULL;
+    }
+
+    AVFrame *scaled = worker->scaled;
+
+    // The encoder may still reference the previous frame
+    int r = av_frame_make_writable(scaled);
+    if (r < 0) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    if (w != pr->width || h != pr->height) {
+        sc_proxy_recorder_fill_black(scaled);
+    }
+
+    uint8_t *data[4] = {
+        scaled->data[0] + y * scaled->linesize[0] + x,
+        scaled->data[1] + y / 2 * scaled->linesize[1] + x / 2,
+        scaled->data[2] + y / 2 * scaled->linesize[2] + x / 2,
+        NULL,
+    };
+
+    sws_scale(worker->sws_ctx, (const uint8_t *const *) frame->data,
+              frame->linesize, 0, frame->height, data, scaled->linesize);
+
+    scaled->pts = frame->pts;
+    return scaled;
+}
+
+static bool
+sc_proxy_recorder_process(struct sc_proxy_recorder *pr,
+                          struct sc_proxy_recorder_worker *worker,
+                          AVFrame *frame, uint64_t seq) {
+    AVFrame *output = sc_proxy_recorder_scale(pr, worker, frame);
+
+    // The frames are encoded in order, wait for the previous ones
+    sc_mutex_lock(&pr->mutex);
+    while (pr->encode_seq != seq) {
+        sc_cond_wait(&pr->encode_cond, &pr->mutex);
+    }
+    bool failed = pr->failed;
+    sc_mutex_unlock(&pr->mutex);
+
+    bool ok = !failed && output;
+    if (ok) {
+        int64_t pts = av_rescale_q(output->pts, SCRCPY_TIME_BASE,
+                                   SC_PROXY_RECORDER_TIME_BASE);
+        if (pr->last_pts != AV_NOPTS_VALUE && pts <= pr->last_pts) {
+            // Several frames in the same millisecond
+            pts = pr->last_pts + 1;
+        }
+        pr->last_pts = pts;
+        output->pts = pts;
+
+        ok = sc_proxy_recorder_encode(pr, output);
+    }
+
+    sc_mutex_lock(&pr->mutex);
+    if (!ok && !pr->failed) {
+        LOGE("Proxy recording failed, the next frames are dropped");
+        pr->failed = true;
+    }
+    ++pr->encode_seq;
+    sc_cond_broadcast(&pr->encode_cond);
+    sc_mutex_unlock(&pr->mutex);
+
+    return ok;
+}
+
+static int
+run_proxy_recorder_worker(void *data) {
+    struct sc_proxy_recorder_worker *worker = data;
+    struct sc_proxy_recorder *pr = worker->pr;
+
+    for (;;) {
+        sc_mutex_lock(&pr->mutex);
+
+        while (!pr->stopped && sc_vecdeque_is_empty(&pr->queue)) {
+            sc_cond_wait(&pr->queue_cond, &pr->mutex);
+        }
+
+        // Process the pending frames before stopping
+        if (sc_vecdeque_is_empty(&pr->queue)) {
+            assert(pr->stopped);
+            sc_mutex_unlock(&pr->mutex);
+            break;
+        }
+
+        AVFrame *frame = sc_vecdeque_pop(&pr->queue);
+        uint64_t seq = pr->next_seq++;
+        sc_mutex_unlock(&pr->mutex);
+
+        sc_proxy_recorder_process(pr, worker, frame, seq);
+        av_frame_free(&frame);
+    }
+
+    LOGD("Proxy recorder worker ended");
+
+    return 0;
+}
+
+static bool
+sc_proxy_recorder_worker_init(struct sc_proxy_recorder_worker *worker,
+                              struct sc_proxy_recorder *pr) {
+    worker->pr = pr;
+    worker->sws_ctx = NULL;
+
+    worker->scaled = av_frame_alloc();
+    if (!worker->scaled) {
+        LOG_OOM();
+        return false;
+    }
+
+    worker->scaled->format = AV_PIX_FMT_YUV420P;
+    worker->scaled->width = pr->width;
+    worker->scaled->height = pr->height;
+    if (av_frame_get_buffer(worker->scaled, 0) < 0) {
+        LOG_OOM();
+        av_frame_free(&worker->scaled);
+        return false;
+    }
+
+    return true;
+}
+
+static void
+sc_proxy_recorder_worker_destroy(struct sc_proxy_recorder_worker *worker) {
+    sws_freeContext(worker->sws_ctx);
+    av_frame_free(&worker->scaled);
+}
+
+static void
+sc_proxy_recorder_stop_workers(struct sc_proxy_recorder *pr, unsigned count) {
+    sc_mutex_lock(&pr->mutex);
+    pr->stopped = true;
+    sc_cond_broadcast(&pr->queue_cond);
+    sc_mutex_unlock(&pr->mutex);
+
+    for (unsigned i = 0; i < count; ++i) {
+        sc_thread_join(&pr->workers[i].thread, NULL);
+    }
+}
+
+static bool
+sc_proxy_recorder_open(struct sc_proxy_recorder *pr,
+                       const AVCodecContext *ctx) {
+    sc_scaler_compute_size(pr->max_size, ctx->width, ctx->height, &pr->width,
+                           &pr->height);
+
+    // Keep some CPU for the decoder and the rendering
+    int cpu_count = SDL_GetCPUCount();
+    pr->worker_count = CLAMP(cpu_count / 2, 1, SC_PROXY_RECORDER_MAX_WORKERS);
+    if (sc_memory_budget_is_enabled()) {
+        // Each worker (and encoder thread) holds its own frames
+        pr->worker_count = 1;
+    }
+
+    bool ok = sc_mutex_init(&pr->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&pr->queue_cond);
+    if (!ok) {
+        goto error_mutex_destroy;
+    }
+
+    ok = sc_cond_init(&pr->encode_cond);
+    if (!ok) {
+        goto error_queue_cond_destroy;
+    }
+
+    sc_vecdeque_init(&pr->queue);
+    // Never reallocate on push
+    ok = sc_vecdeque_reserve(&pr->queue, pr->worker_count);
+    if (!ok) {
+        LOG_OOM();
+        goto error_encode_cond_destroy;
+    }
+
+    pr->packet = av_packet_alloc();
+    if (!pr->packet) {
+        LOG_OOM();
+        goto error_queue_destroy;
+    }
+
+    ok = sc_proxy_recorder_open_output(pr);
+    if (!ok) {
+        goto error_packet_free;
+    }
+
+    pr->next_seq = 0;
+    pr->encode_seq = 0;
+    pr->stopped = false;
+    pr->failed = false;
+    pr->first_pts = AV_NOPTS_VALUE;
+    pr->dropped = 0;
+    pr->last_pts = AV_NOPTS_VALUE;
+
+    unsigned initialized = 0;
+    for (; initialized < pr->worker_count; ++initialized) {
+        struct sc_proxy_recorder_worker *worker = &pr->workers[initialized];
+        if (!sc_proxy_recorder_worker_init(worker, pr)) {
+            goto error_workers_destroy;
+        }
+    }
+
+    unsigned started = 0;
+    for (; started < pr->worker_count; ++started) {
+        struct sc_proxy_recorder_worker *worker = &pr->workers[started];
+        ok = sc_thread_create(&worker->thread, run_proxy_recorder_worker,
+                              "scrcpy-proxy", worker);
+        if (!ok) {
+            LOGE("Could not start proxy recorder worker");
+            sc_proxy_recorder_stop_workers(pr, started);
+            goto error_workers_destroy;
+        }
+    }
+
+    LOGI("Proxy recording started to file: %s (%dx%d, %u workers)",
+         pr->filename, pr->width, pr->height, pr->worker_count);
+
+    return true;
+
+error_workers_destroy:
+    for (unsigned i = 0; i < initialized; ++i) {
+        sc_proxy_recorder_worker_destroy(&pr->workers[i]);
+    }
+    sc_proxy_recorder_close_output(pr);
+error_packet_free:
+    av_packet_free(&pr->packet);
+error_queue_destroy:
+    sc_vecdeque_destroy(&pr->queue);
+error_encode_cond_destroy:
+    sc_cond_destroy(&pr->encode_cond);
+error_queue_cond_destroy:
+    sc_cond_destroy(&pr->queue_cond);
+error_mutex_destroy:
+    sc_mutex_destroy(&pr->mutex);
+
+    return false;
+}
+
+static void
+sc_proxy_recorder_close(struct sc_proxy_recorder *pr) {
+    sc_proxy_recorder_stop_workers(pr, pr->worker_count);
+    assert(sc_vecdeque_is_empty(&pr->queue));
+
+    if (!pr->failed) {
+        // Flush the encoder
+        bool ok = sc_proxy_recorder_encode(pr, NULL);
+        if (ok) {
+            ok = av_write_trailer(pr->format_ctx) >= 0;
+        }
+        if (ok) {
+            LOGI("Proxy recording complete: %s", pr->filename);
+        } else {
+            LOGE("Failed to complete the proxy recording: %s", pr->filename);
+        }
+    }
+
+    if (pr->dropped) {
+        LOGW("Proxy recorder: %" PRIu64 " frames dropped", pr->dropped);
+    }
+
+    for (unsigned i = 0; i < pr->worker_count; ++i) {
+        sc_proxy_recorder_worker_destroy(&pr->workers[i]);
+    }
+    sc_proxy_recorder_close_output(pr);
+    av_packet_free(&pr->packet);
+    sc_vecdeque_destroy(&pr->queue);
+    sc_cond_destroy(&pr->encode_cond);
+    sc_cond_destroy(&pr->queue_cond);
+    sc_mutex_destroy(&pr->mutex);
+}
+
+static bool
+sc_proxy_recorder_push(struct sc_proxy_recorder *pr, const AVFrame *frame) {
+    sc_mutex_lock(&pr->mutex);
+    bool drop = pr->failed || sc_vecdeque_size(&pr->queue) == pr->worker_count;
+    sc_mutex_unlock(&pr->mutex);
+
+    if (drop) {
+        // The workers could not keep up (or the recording failed): never
+        // block the decoder, drop the frame
+        ++pr->dropped;
+        return true;
+    }
+
+    AVFrame *copy = av_frame_clone(frame);
+    if (!copy) {
+        LOG_OOM();
+        return false;
+    }
+
+    // The proxy recording starts at 0
+    if (pr->first_pts == AV_NOPTS_VALUE) {
+        pr->first_pts = frame->pts;
+    }
+    copy->pts -= pr->first_pts;
+
+    sc_mutex_lock(&pr->mutex);
+    // Only this thread pushes, the queue could not be full
+    sc_vecdeque_push_noresize(&pr->queue, copy);
+    sc_cond_signal(&pr->queue_cond);
+    sc_mutex_unlock(&pr->mutex);
+
+    return true;
+}
+
+static bool
+sc_proxy_recorder_frame_sink_open(struct sc_frame_sink *sink,
+                                  const AVCodecContext *ctx) {
+    struct sc_proxy_recorder *pr = DOWNCAST(sink);
+    return sc_proxy_recorder_open(pr, ctx);
+}
+
+static void
+sc_proxy_recorder_frame_sink_close(struct sc_frame_sink *sink) {
+    struct sc_proxy_recorder *pr = DOWNCAST(sink);
+    sc_proxy_recorder_close(pr);
+}
+
+static bool
+sc_proxy_recorder_frame_sink_push(struct sc_frame_sink *sink,
+                                  const AVFrame *frame) {
+    struct sc_proxy_recorder *pr = DOWNCAST(sink);
+    return sc_proxy_recorder_push(pr, frame);
+}
+
+bool
+sc_proxy_recorder_init(struct sc_proxy_recorder *pr, const char *filename,
+                       enum sc_record_format format, uint16_t max_size,
+                       uint32_t bit_rate) {
+    assert(sc_proxy_recorder_get_format_name(format));
+
+    pr->filename = strdup(filename);
+    if (!pr->filename) {
+        LOG_OOM();
+        return false;
+    }
+
+    pr->format = format;
+    pr->max_size = max_size;
+    pr->bit_rate = bit_rate;
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_proxy_recorder_frame_sink_open,
+        .close = sc_proxy_recorder_frame_sink_close,
+        .push = sc_proxy_recorder_frame_sink_push,
+    };
+
+    pr->frame_sink.ops = &ops;
+
+    return true;
+}
+
+void
+sc_proxy_recorder_destroy(struct sc_proxy_recorder *pr) {
+    free(pr->filename);
+}
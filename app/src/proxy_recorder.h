@@ -0,0 +1,89 @@
+#ifndef SC_PROXY_RECORDER_H
+#define SC_PROXY_RECORDER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+
+#include "options.h"
+#include "trait/frame_sink.h"
+#include "util/thread.h"
+#include "util/vecdeque.h"
+
+#define SC_PROXY_RECORDER_MAX_WORKERS 4
+
+struct sc_proxy_recorder;
+
+struct sc_proxy_recorder_worker {
+    struct sc_proxy_recorder *pr;
+    sc_thread thread;
+
+    // owned by the worker thread
+    struct SwsContext *sws_ctx;
+    AVFrame *scaled;
+};
+
+struct sc_proxy_recorder_queue SC_VECDEQUE(AVFrame *);
+
+/**
+ * Proxy recorder, to record a downscaled, low bit-rate copy of the video
+ * stream, re-encoded from the decoded frames.
+ *
+ * The frames are processed on a pool of worker threads, each one processing
+ * a different frame, then encoded and muxed in order. The encoder uses its
+ * own internal threads.
+ *
+ * The frames are expected to be already downscaled (typically by a variant
+ * of the shared scaler); they are only converted by the workers if their size
+ * or format does not match (e.g. letterboxed after a device rotation).
+ *
+ * It never blocks the decoder: if the workers could not keep up, the new
+ * frames are dropped.
+ */
+struct sc_proxy_recorder {
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    char *filename;
+    enum sc_record_format format;
+    uint16_t max_size;
+    uint32_t bit_rate;
+
+    AVFormatContext *format_ctx;
+    AVCodecContext *encoder_ctx;
+    AVPacket *packet;
+    // size of the recorded video
+    int width;
+    int height;
+
+    struct sc_proxy_recorder_worker workers[SC_PROXY_RECORDER_MAX_WORKERS];
+    unsigned worker_count;
+
+    sc_mutex mutex;
+    sc_cond queue_cond;
+    sc_cond encode_cond;
+    struct sc_proxy_recorder_queue queue; // at most worker_count frames
+    uint64_t next_seq; // sequence number of the next frame popped
+    uint64_t encode_seq; // sequence number of the next frame to encode
+    bool stopped;
+    bool failed;
+
+    // accessed only from the decoder thread
+    int64_t first_pts;
+    uint64_t dropped;
+
+    // accessed only by the worker encoding the current frame
+    int64_t last_pts;
+};
+
+bool
+sc_proxy_recorder_init(struct sc_proxy_recorder *pr, const char *filename,
+                       enum sc_record_format format, uint16_t max_size,
+                       uint32_t bit_rate);
+
+void
+sc_proxy_recorder_destroy(struct sc_proxy_recorder *pr);
+
+#endif
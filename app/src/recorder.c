@@ -9,8 +9,10 @@
 #include <libavutil/time.h>
 #include <libavutil/display.h>
 
+#include "memory_budget.h"
 #include "util/log.h"
 #include "util/str.h"
+#include "util/tick.h"
 
 /** Downcast packet sinks to recorder */
 #define DOWNCAST_VIDEO(SINK) \
@@ -20,6 +22,12 @@
 
 static const AVRational SCRCPY_TIME_BASE = {1, 1000000}; // timestamps in us
 
+// Maximum duration of a fragment, for fragmented MP4
+#define SC_RECORDER_FRAGMENT_DURATION SC_TICK_FROM_SEC(1)
+
+// Initial capacity of the packet queues (they grow if necessary)
+#define SC_RECORDER_QUEUE_CAPACITY 128
+
 static const AVOutputFormat *
 find_muxer(const char *name) {
 #ifdef SCRCPY_LAVF_HAS_NEW_MUXER_ITERATOR_API
@@ -53,18 +61,145 @@ sc_recorder_packet_ref(const AVPacket *packet) {
     return p;
 }
 
+static size_t
+sc_recorder_packet_memory_size(const AVPacket *packet) {
+    return sizeof(*packet) + packet->size;
+}
+
+// Indicate that the calling thread is about to wait on a condition for a state
+// changed without locking (the recorder mutex must be locked)
+static inline void
+sc_recorder_wait_begin(atomic_bool *waiting) {
+    atomic_store_explicit(waiting, true, memory_order_relaxed);
+    // Pairs with the fence in sc_recorder_wake_up(): either the waiting thread
+    // sees the new state, or the other thread sees that it is waiting
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+// The recorder mutex must be locked
+static inline void
+sc_recorder_wait_end(atomic_bool *waiting) {
+    atomic_store_explicit(waiting, false, memory_order_relaxed);
+}
+
+// Wake up the thread waiting on cond, if any (the recorder mutex must not be
+// locked)
+static void
+sc_recorder_wake_up(struct sc_recorder *recorder, atomic_bool *waiting,
+                    sc_cond *cond) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(waiting, memory_order_relaxed)) {
+        sc_mutex_lock(&recorder->mutex);
+        sc_cond_broadcast(cond);
+        sc_mutex_unlock(&recorder->mutex);
+    }
+}
+
+static inline bool
+sc_recorder_is_stopped(struct sc_recorder *recorder) {
+    return atomic_load_explicit(&recorder->stopped, memory_order_acquire);
+}
+
+// The recorder mutex must be locked
+static inline void
+sc_recorder_set_stopped(struct sc_recorder *recorder) {
+    atomic_store_explicit(&recorder->stopped, true, memory_order_release);
+}
+
+// Called from the recorder thread (the consumer)
+static AVPacket *
+sc_recorder_queue_pop(struct sc_recorder *recorder,
+                      struct sc_spsc_queue *queue) {
+    AVPacket *p = sc_spsc_queue_pop(queue);
+    if (p) {
+        sc_memory_budget_release(SC_MEMORY_POOL_RECORDER,
+                                 sc_recorder_packet_memory_size(p));
+        sc_recorder_wake_up(recorder, &recorder->producer_waiting,
+                            &recorder->space_cond);
+    }
+    return p;
+}
+
+// Called from the recorder thread (or on destroy)
 static void
-sc_recorder_queue_clear(struct sc_recorder_queue *queue) {
-    while (!sc_vecdeque_is_empty(queue)) {
-        AVPacket *p = sc_vecdeque_pop(queue);
+sc_recorder_queue_clear(struct sc_recorder *recorder,
+                        struct sc_spsc_queue *queue) {
+    AVPacket *p;
+    while ((p = sc_recorder_queue_pop(recorder, queue))) {
         av_packet_free(&p);
     }
 }
 
+// Called from the demuxer thread (the producer) if the quota is exhausted
+static bool
+sc_recorder_wait_for_space(struct sc_recorder *recorder,
+                           struct sc_spsc_queue *queue, size_t size) {
+    sc_mutex_lock(&recorder->mutex);
+    sc_recorder_wait_begin(&recorder->producer_waiting);
+
+    // Backpressure: wait for the recorder thread to consume packets if the
+    // quota is exhausted (but never wait on an empty queue, the recorder
+    // thread may be waiting for it to record the packets of the other
+    // stream)
+    bool acquired = false;
+    while (!sc_recorder_is_stopped(recorder)
+            && !sc_spsc_queue_is_empty(queue)) {
+        acquired = sc_memory_budget_acquire(SC_MEMORY_POOL_RECORDER, size);
+        if (acquired) {
+            break;
+        }
+        sc_cond_wait(&recorder->space_cond, &recorder->mutex);
+    }
+
+    sc_recorder_wait_end(&recorder->producer_waiting);
+
+    // The stopped flag is only written with the mutex locked
+    bool stopped = sc_recorder_is_stopped(recorder);
+    sc_mutex_unlock(&recorder->mutex);
+
+    if (stopped) {
+        assert(!acquired);
+        return false;
+    }
+
+    if (!acquired) {
+        // The queue is empty
+        sc_memory_budget_force_acquire(SC_MEMORY_POOL_RECORDER, size);
+    }
+
+    return true;
+}
+
+// Called from the demuxer thread (the producer)
+static bool
+sc_recorder_queue_push(struct sc_recorder *recorder,
+                       struct sc_spsc_queue *queue, AVPacket *packet,
+                       bool wait) {
+    size_t size = sc_recorder_packet_memory_size(packet);
+    if (!wait) {
+        sc_memory_budget_force_acquire(SC_MEMORY_POOL_RECORDER, size);
+    } else if (!sc_memory_budget_acquire(SC_MEMORY_POOL_RECORDER, size)) {
+        if (!sc_recorder_wait_for_space(recorder, queue, size)) {
+            return false;
+        }
+    }
+
+    bool ok = sc_spsc_queue_push(queue, packet);
+    if (!ok) {
+        sc_memory_budget_release(SC_MEMORY_POOL_RECORDER, size);
+        return false;
+    }
+
+    sc_recorder_wake_up(recorder, &recorder->recorder_waiting,
+                        &recorder->cond);
+    return true;
+}
+
 static const char *
 sc_recorder_get_format_name(enum sc_record_format format) {
     switch (format) {
         case SC_RECORD_FORMAT_MP4:
+        case SC_RECORD_FORMAT_FMP4:
         case SC_RECORD_FORMAT_M4A:
         case SC_RECORD_FORMAT_AAC:
             return "mp4";
@@ -117,6 +252,7 @@ sc_recorder_write_stream(struct sc_recorder *recorder,
     } else {
         st->last_pts = packet->pts;
     }
+    sc_perf_thread_add_item(recorder->perf);
     return av_interleaved_write_frame(recorder->ctx, packet) >= 0;
 }
 
@@ -179,15 +315,32 @@ sc_recorder_close_output_file(struct sc_recorder *recorder) {
     avformat_free_context(recorder->ctx);
 }
 
+static void
+sc_recorder_set_fragmented_options(struct sc_recorder *recorder,
+                                   AVDictionary **options) {
+    // Write a fragment (its own index followed by its samples) on every video
+    // key frame, and at least every SC_RECORDER_FRAGMENT_DURATION. The muxer
+    // only keeps the index of the current fragment in memory, writing the
+    // trailer is immediate, and if scrcpy is killed, only the last fragment
+    // is lost.
+    av_dict_set(options, "movflags",
+                "frag_keyframe+empty_moov+default_base_moof", 0);
+    av_dict_set_int(options, "frag_duration",
+                    SC_TICK_TO_US(SC_RECORDER_FRAGMENT_DURATION), 0);
+
+    // Write each fragment to the file as soon as it is complete
+    recorder->ctx->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+}
+
 static inline bool
 sc_recorder_must_wait_for_config_packets(struct sc_recorder *recorder) {
-    if (recorder->video && sc_vecdeque_is_empty(&recorder->video_queue)) {
+    if (recorder->video && sc_spsc_queue_is_empty(&recorder->video_queue)) {
         // The video queue is empty
         return true;
     }
 
     if (recorder->audio && recorder->audio_expects_config_packet
-            && sc_vecdeque_is_empty(&recorder->audio_queue)) {
+            && sc_spsc_queue_is_empty(&recorder->audio_queue)) {
         // The audio queue is empty (when audio is enabled)
         return true;
     }
@@ -199,37 +352,42 @@ sc_recorder_must_wait_for_config_packets(struct sc_recorder *recorder) {
 static bool
 sc_recorder_process_header(struct sc_recorder *recorder) {
     sc_mutex_lock(&recorder->mutex);
+    sc_recorder_wait_begin(&recorder->recorder_waiting);
 
-    while (!recorder->stopped &&
+    while (!sc_recorder_is_stopped(recorder) &&
               ((recorder->video && !recorder->video_init)
             || (recorder->audio && !recorder->audio_init)
             || sc_recorder_must_wait_for_config_packets(recorder))) {
         sc_cond_wait(&recorder->cond, &recorder->mutex);
     }
 
-    if (recorder->video && sc_vecdeque_is_empty(&recorder->video_queue)) {
-        assert(recorder->stopped);
+    sc_recorder_wait_end(&recorder->recorder_waiting);
+
+    if (recorder->video && sc_spsc_queue_is_empty(&recorder->video_queue)) {
+        assert(sc_recorder_is_stopped(recorder));
         // If the recorder is stopped, don't process anything if there are not
         // at least video packets
         sc_mutex_unlock(&recorder->mutex);
         return false;
     }
 
+    bool expects_audio_config_packet = recorder->audio_expects_config_packet;
+
+    sc_mutex_unlock(&recorder->mutex);
+
+    // The first packets are config packets
     AVPacket *video_pkt = NULL;
-    if (!sc_vecdeque_is_empty(&recorder->video_queue)) {
-        assert(recorder->video);
-        video_pkt = sc_vecdeque_pop(&recorder->video_queue);
+    if (recorder->video) {
+        video_pkt = sc_recorder_queue_pop(recorder, &recorder->video_queue);
+        assert(video_pkt);
     }
 
     AVPacket *audio_pkt = NULL;
-    if (recorder->audio_expects_config_packet &&
-            !sc_vecdeque_is_empty(&recorder->audio_queue)) {
+    if (expects_audio_config_packet) {
         assert(recorder->audio);
-        audio_pkt = sc_vecdeque_pop(&recorder->audio_queue);
+        audio_pkt = sc_recorder_queue_pop(recorder, &recorder->audio_queue);
     }
 
-    sc_mutex_unlock(&recorder->mutex);
-
     int ret = false;
 
     if (video_pkt) {
@@ -262,7 +420,13 @@ sc_recorder_process_header(struct sc_recorder *recorder) {
         }
     }
 
-    bool ok = avformat_write_header(recorder->ctx, NULL) >= 0;
+    AVDictionary *muxer_options = NULL;
+    if (recorder->format == SC_RECORD_FORMAT_FMP4) {
+        sc_recorder_set_fragmented_options(recorder, &muxer_options);
+    }
+
+    bool ok = avformat_write_header(recorder->ctx, &muxer_options) >= 0;
+    av_dict_free(&muxer_options);
     if (!ok) {
         LOGE("Failed to write header to %s", recorder->filename);
         goto end;
@@ -281,6 +445,34 @@ end:
     return ret;
 }
 
+static inline bool
+sc_recorder_can_pop(struct sc_recorder *recorder, bool video, bool audio) {
+    return (video && !sc_spsc_queue_is_empty(&recorder->video_queue))
+        || (audio && !sc_spsc_queue_is_empty(&recorder->audio_queue));
+}
+
+// Wait until a new packet may be assigned to a free slot (video or audio), or
+// until the recorder is stopped
+static void
+sc_recorder_wait_packets(struct sc_recorder *recorder, bool video,
+                         bool audio) {
+    if (sc_recorder_can_pop(recorder, video, audio)) {
+        // Do not lock if a packet is already available
+        return;
+    }
+
+    sc_mutex_lock(&recorder->mutex);
+    sc_recorder_wait_begin(&recorder->recorder_waiting);
+
+    while (!sc_recorder_is_stopped(recorder)
+            && !sc_recorder_can_pop(recorder, video, audio)) {
+        sc_cond_wait(&recorder->cond, &recorder->mutex);
+    }
+
+    sc_recorder_wait_end(&recorder->recorder_waiting);
+    sc_mutex_unlock(&recorder->mutex);
+}
+
 static bool
 sc_recorder_process_packets(struct sc_recorder *recorder) {
     int64_t pts_origin = AV_NOPTS_VALUE;
@@ -300,21 +492,12 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
     bool error = false;
 
     for (;;) {
-        sc_mutex_lock(&recorder->mutex);
+        sc_recorder_wait_packets(recorder, !video_pkt, !audio_pkt);
 
-        while (!recorder->stopped) {
-            if (recorder->video && !video_pkt &&
-                    !sc_vecdeque_is_empty(&recorder->video_queue)) {
-                // A new packet may be assigned to video_pkt and be processed
-                break;
-            }
-            if (recorder->audio && !audio_pkt
-                    && !sc_vecdeque_is_empty(&recorder->audio_queue)) {
-                // A new packet may be assigned to audio_pkt and be processed
-                break;
-            }
-            sc_cond_wait(&recorder->cond, &recorder->mutex);
-        }
+        // Read the flag before popping. A producer which read the flag just
+        // before it was set may still push a late packet, which is not
+        // recorded: it is released when the recorder is destroyed.
+        bool stopped = sc_recorder_is_stopped(recorder);
 
         // If stopped is set, continue to process the remaining events (to
         // finish the recording) before actually stopping.
@@ -322,32 +505,27 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
         // If there is no video, then the video_queue will remain empty forever
         // and video_pkt will always be NULL.
         assert(recorder->video || (!video_pkt
-                && sc_vecdeque_is_empty(&recorder->video_queue)));
+                && sc_spsc_queue_is_empty(&recorder->video_queue)));
 
         // If there is no audio, then the audio_queue will remain empty forever
         // and audio_pkt will always be NULL.
         assert(recorder->audio || (!audio_pkt
-                && sc_vecdeque_is_empty(&recorder->audio_queue)));
+                && sc_spsc_queue_is_empty(&recorder->audio_queue)));
 
-        if (!video_pkt && !sc_vecdeque_is_empty(&recorder->video_queue)) {
-            video_pkt = sc_vecdeque_pop(&recorder->video_queue);
+        if (!video_pkt) {
+            video_pkt = sc_recorder_queue_pop(recorder, &recorder->video_queue);
         }
 
-        if (!audio_pkt && !sc_vecdeque_is_empty(&recorder->audio_queue)) {
-            audio_pkt = sc_vecdeque_pop(&recorder->audio_queue);
+        if (!audio_pkt) {
+            audio_pkt = sc_recorder_queue_pop(recorder, &recorder->audio_queue);
         }
 
-        if (recorder->stopped && !video_pkt && !audio_pkt) {
-            assert(sc_vecdeque_is_empty(&recorder->video_queue));
-            assert(sc_vecdeque_is_empty(&recorder->audio_queue));
-            sc_mutex_unlock(&recorder->mutex);
+        if (stopped && !video_pkt && !audio_pkt) {
             break;
         }
 
         assert(video_pkt || audio_pkt); // at least one
 
-        sc_mutex_unlock(&recorder->mutex);
-
         // Ignore further config packets (e.g. on device orientation
         // change). The next non-config packet will have the config packet
         // data prepended.
@@ -370,7 +548,7 @@ sc_recorder_process_packets(struct sc_recorder *recorder) {
                 pts_origin = audio_pkt->pts;
             } else if (video_pkt && audio_pkt) {
                 pts_origin = MIN(video_pkt->pts, audio_pkt->pts);
-            } else if (recorder->stopped) {
+            } else if (stopped) {
                 if (video_pkt) {
                     // The recorder is stopped without audio, record the video
                     // packets
@@ -478,16 +656,21 @@ run_recorder(void *data) {
     bool ok = sc_thread_set_priority(SC_THREAD_PRIORITY_LOW);
     (void) ok; // We don't care if it worked
 
+    recorder->perf = sc_perf_thread_register("recorder", NULL, "packet");
+
     bool success = sc_recorder_record(recorder);
 
     sc_mutex_lock(&recorder->mutex);
     // Prevent the producer to push any new packet
-    recorder->stopped = true;
-    // Discard pending packets
-    sc_recorder_queue_clear(&recorder->video_queue);
-    sc_recorder_queue_clear(&recorder->audio_queue);
+    sc_recorder_set_stopped(recorder);
+    sc_cond_broadcast(&recorder->space_cond);
     sc_mutex_unlock(&recorder->mutex);
 
+    // Discard pending packets (a packet pushed concurrently is discarded on
+    // destroy)
+    sc_recorder_queue_clear(recorder, &recorder->video_queue);
+    sc_recorder_queue_clear(recorder, &recorder->audio_queue);
+
     if (success) {
         const char *format_name = sc_recorder_get_format_name(recorder->format);
         LOGI("Recording complete to %s file: %s", format_name,
@@ -498,6 +681,9 @@ run_recorder(void *data) {
 
     LOGD("Recorder thread ended");
 
+    sc_perf_thread_unregister(recorder->perf);
+    recorder->perf = NULL;
+
     recorder->cbs->on_ended(recorder, success, recorder->cbs_userdata);
 
     return 0;
@@ -539,6 +725,56 @@ sc_recorder_set_orientation(AVStream *stream, enum sc_orientation orientation) {
     return true;
 }
 
+static inline void
+sc_recorder_push_stats_add(struct sc_recorder_push_stats *stats,
+                           sc_tick duration) {
+    ++stats->count;
+    stats->total += duration;
+    stats->max = MAX(stats->max, duration);
+}
+
+static void
+sc_recorder_push_stats_log(const struct sc_recorder_push_stats *stats,
+                           const char *name) {
+    if (!stats->count) {
+        return;
+    }
+
+    sc_tick avg = stats->total / (sc_tick) stats->count;
+    LOGD("Recorder %s push time: avg=%" PRItick "us max=%" PRItick "us"
+         " (%" PRIu64 " packets)", name, SC_TICK_TO_US(avg),
+         SC_TICK_TO_US(stats->max), stats->count);
+}
+
+// Called from the demuxer thread (the producer)
+static bool
+sc_recorder_push(struct sc_recorder *recorder, struct sc_spsc_queue *queue,
+                 int stream_index, const AVPacket *packet, bool wait) {
+    if (sc_recorder_is_stopped(recorder)) {
+        // reject any new packet
+        return false;
+    }
+
+    AVPacket *rec = sc_recorder_packet_ref(packet);
+    if (!rec) {
+        LOG_OOM();
+        return false;
+    }
+
+    rec->stream_index = stream_index;
+
+    bool ok = sc_recorder_queue_push(recorder, queue, rec, wait);
+    if (!ok) {
+        if (!sc_recorder_is_stopped(recorder)) {
+            LOG_OOM();
+        }
+        av_packet_free(&rec);
+        return false;
+    }
+
+    return true;
+}
+
 static bool
 sc_recorder_video_packet_sink_open(struct sc_packet_sink *sink,
                                    AVCodecContext *ctx) {
@@ -547,7 +783,7 @@ sc_recorder_video_packet_sink_open(struct sc_packet_sink *sink,
     assert(!recorder->video_init);
 
     sc_mutex_lock(&recorder->mutex);
-    if (recorder->stopped) {
+    if (sc_recorder_is_stopped(recorder)) {
         sc_mutex_unlock(&recorder->mutex);
         return false;
     }
@@ -591,8 +827,9 @@ sc_recorder_video_packet_sink_close(struct sc_packet_sink *sink) {
 
     sc_mutex_lock(&recorder->mutex);
     // EOS also stops the recorder
-    recorder->stopped = true;
+    sc_recorder_set_stopped(recorder);
     sc_cond_signal(&recorder->cond);
+    sc_cond_broadcast(&recorder->space_cond);
     sc_mutex_unlock(&recorder->mutex);
 }
 
@@ -603,34 +840,12 @@ sc_recorder_video_packet_sink_push(struct sc_packet_sink *sink,
     // only written from this thread, no need to lock
     assert(recorder->video_init);
 
-    sc_mutex_lock(&recorder->mutex);
-
-    if (recorder->stopped) {
-        // reject any new packet
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
-
-    AVPacket *rec = sc_recorder_packet_ref(packet);
-    if (!rec) {
-        LOG_OOM();
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
-
-    rec->stream_index = recorder->video_stream.index;
-
-    bool ok = sc_vecdeque_push(&recorder->video_queue, rec);
-    if (!ok) {
-        LOG_OOM();
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
-
-    sc_cond_signal(&recorder->cond);
-
-    sc_mutex_unlock(&recorder->mutex);
-    return true;
+    sc_tick start = sc_tick_now();
+    bool ok = sc_recorder_push(recorder, &recorder->video_queue,
+                               recorder->video_stream.index, packet, true);
+    sc_recorder_push_stats_add(&recorder->video_push_stats,
+                               sc_tick_now() - start);
+    return ok;
 }
 
 static bool
@@ -677,8 +892,9 @@ sc_recorder_audio_packet_sink_close(struct sc_packet_sink *sink) {
 
     sc_mutex_lock(&recorder->mutex);
     // EOS also stops the recorder
-    recorder->stopped = true;
+    sc_recorder_set_stopped(recorder);
     sc_cond_signal(&recorder->cond);
+    sc_cond_broadcast(&recorder->space_cond);
     sc_mutex_unlock(&recorder->mutex);
 }
 
@@ -690,34 +906,13 @@ sc_recorder_audio_packet_sink_push(struct sc_packet_sink *sink,
     // only written from this thread, no need to lock
     assert(recorder->audio_init);
 
-    sc_mutex_lock(&recorder->mutex);
-
-    if (recorder->stopped) {
-        // reject any new packet
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
-
-    AVPacket *rec = sc_recorder_packet_ref(packet);
-    if (!rec) {
-        LOG_OOM();
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
-
-    rec->stream_index = recorder->audio_stream.index;
-
-    bool ok = sc_vecdeque_push(&recorder->audio_queue, rec);
-    if (!ok) {
-        LOG_OOM();
-        sc_mutex_unlock(&recorder->mutex);
-        return false;
-    }
-
-    sc_cond_signal(&recorder->cond);
-
-    sc_mutex_unlock(&recorder->mutex);
-    return true;
+    sc_tick start = sc_tick_now();
+    // Audio packets are small, never block the audio demuxer
+    bool ok = sc_recorder_push(recorder, &recorder->audio_queue,
+                               recorder->audio_stream.index, packet, false);
+    sc_recorder_push_stats_add(&recorder->audio_push_stats,
+                               sc_tick_now() - start);
+    return ok;
 }
 
 static void
@@ -765,15 +960,35 @@ sc_recorder_init(struct sc_recorder *recorder, const char *filename,
         goto error_mutex_destroy;
     }
 
+    ok = sc_cond_init(&recorder->space_cond);
+    if (!ok) {
+        goto error_cond_destroy;
+    }
+
     assert(video || audio);
     recorder->video = video;
     recorder->audio = audio;
 
     recorder->orientation = orientation;
 
-    sc_vecdeque_init(&recorder->video_queue);
-    sc_vecdeque_init(&recorder->audio_queue);
-    recorder->stopped = false;
+    ok = sc_spsc_queue_init(&recorder->video_queue,
+                            SC_RECORDER_QUEUE_CAPACITY);
+    if (!ok) {
+        goto error_space_cond_destroy;
+    }
+
+    ok = sc_spsc_queue_init(&recorder->audio_queue,
+                            SC_RECORDER_QUEUE_CAPACITY);
+    if (!ok) {
+        goto error_video_queue_destroy;
+    }
+
+    atomic_init(&recorder->stopped, false);
+    atomic_init(&recorder->recorder_waiting, false);
+    atomic_init(&recorder->producer_waiting, false);
+
+    memset(&recorder->video_push_stats, 0, sizeof(recorder->video_push_stats));
+    memset(&recorder->audio_push_stats, 0, sizeof(recorder->audio_push_stats));
 
     recorder->video_init = false;
     recorder->audio_init = false;
@@ -784,6 +999,7 @@ sc_recorder_init(struct sc_recorder *recorder, const char *filename,
     sc_recorder_stream_init(&recorder->audio_stream);
 
     recorder->format = format;
+    recorder->perf = NULL;
 
     assert(cbs && cbs->on_ended);
     recorder->cbs = cbs;
@@ -812,6 +1028,12 @@ sc_recorder_init(struct sc_recorder *recorder, const char *filename,
 
     return true;
 
+error_video_queue_destroy:
+    sc_spsc_queue_destroy(&recorder->video_queue);
+error_space_cond_destroy:
+    sc_cond_destroy(&recorder->space_cond);
+error_cond_destroy:
+    sc_cond_destroy(&recorder->cond);
 error_mutex_destroy:
     sc_mutex_destroy(&recorder->mutex);
 error_free_filename:
@@ -835,8 +1057,9 @@ sc_recorder_start(struct sc_recorder *recorder) {
 void
 sc_recorder_stop(struct sc_recorder *recorder) {
     sc_mutex_lock(&recorder->mutex);
-    recorder->stopped = true;
+    sc_recorder_set_stopped(recorder);
     sc_cond_signal(&recorder->cond);
+    sc_cond_broadcast(&recorder->space_cond);
     sc_mutex_unlock(&recorder->mutex);
 }
 
@@ -847,6 +1070,17 @@ sc_recorder_join(struct sc_recorder *recorder) {
 
 void
 sc_recorder_destroy(struct sc_recorder *recorder) {
+    sc_recorder_push_stats_log(&recorder->video_push_stats, "video");
+    sc_recorder_push_stats_log(&recorder->audio_push_stats, "audio");
+
+    // A packet may have been pushed after the recorder thread cleared the
+    // queues
+    sc_recorder_queue_clear(recorder, &recorder->video_queue);
+    sc_recorder_queue_clear(recorder, &recorder->audio_queue);
+    sc_spsc_queue_destroy(&recorder->video_queue);
+    sc_spsc_queue_destroy(&recorder->audio_queue);
+
+    sc_cond_destroy(&recorder->space_cond);
     sc_cond_destroy(&recorder->cond);
     sc_mutex_destroy(&recorder->mutex);
     free(recorder->filename);
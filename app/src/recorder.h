@@ -3,23 +3,31 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <libavcodec/packet.h>
 #include <libavformat/avformat.h>
 
 #include "options.h"
+#include "perf_counter.h"
 #include "trait/packet_sink.h"
+#include "util/spsc_queue.h"
 #include "util/thread.h"
-#include "util/vecdeque.h"
-
-struct sc_recorder_queue SC_VECDEQUE(AVPacket *);
+#include "util/tick.h"
 
 struct sc_recorder_stream {
     int index;
     int64_t last_pts;
 };
 
+// Time spent in the packet sink push (on the demuxer thread)
+struct sc_recorder_push_stats {
+    uint64_t count;
+    sc_tick total;
+    sc_tick max;
+};
+
 struct sc_recorder {
     struct sc_packet_sink video_packet_sink;
     struct sc_packet_sink audio_packet_sink;
@@ -44,10 +52,20 @@ struct sc_recorder {
     sc_thread thread;
     sc_mutex mutex;
     sc_cond cond;
+    // signaled when packets are removed from the queues (or on stop), to
+    // wake up the producers waiting for memory (see memory_budget.h)
+    sc_cond space_cond;
     // set on sc_recorder_stop(), packet_sink close or recording failure
-    bool stopped;
-    struct sc_recorder_queue video_queue;
-    struct sc_recorder_queue audio_queue;
+    // (written with the mutex locked, read without)
+    atomic_bool stopped;
+
+    // The packets are pushed by the demuxer threads and popped by the
+    // recorder thread without locking. The mutex is only locked to wake up a
+    // thread which is waiting (as indicated by these flags).
+    struct sc_spsc_queue video_queue;
+    struct sc_spsc_queue audio_queue;
+    atomic_bool recorder_waiting; // for cond
+    atomic_bool producer_waiting; // for space_cond
 
     // wake up the recorder thread once the video or audio codec is known
     bool video_init;
@@ -58,6 +76,13 @@ struct sc_recorder {
     struct sc_recorder_stream video_stream;
     struct sc_recorder_stream audio_stream;
 
+    // each one only accessed from its demuxer thread (until destroy)
+    struct sc_recorder_push_stats video_push_stats;
+    struct sc_recorder_push_stats audio_push_stats;
+
+    // only accessed from the recorder thread
+    struct sc_perf_thread *perf;
+
     const struct sc_recorder_callbacks *cbs;
     void *cbs_userdata;
 };
@@ -0,0 +1,456 @@
+#include "scaler.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+#include <SDL2/SDL_cpuinfo.h>
+
+#include "util/log.h"
+
+/** Downcast frame_sink to sc_scaler */
+#define DOWNCAST(SINK) container_of(SINK, struct sc_scaler, frame_sink)
+
+#define SC_SCALER_MAX_THREADS 4
+
+void
+sc_scaler_compute_size(uint16_t max_size, int width, int height,
+                       int *out_width, int *out_height) {
+    int w = width;
+    int h = height;
+    if (max_size && (w > max_size || h > max_size)) {
+        if (w > h) {
+            h = (int64_t) h * max_size / w;
+            w = max_size;
+        } else {
+            w = (int64_t) w * max_size / h;
+            h = max_size;
+        }
+    }
+
+    // YUV 4:2:0 requires even dimensions
+    *out_width = MAX(w & ~1, 2);
+    *out_height = MAX(h & ~1, 2);
+}
+
+static bool
+sc_scaler_variant_configure(struct sc_scaler_variant *variant,
+                            const AVFrame *src, int dst_width, int dst_height,
+                            unsigned thread_count) {
+    if (variant->sws_ctx
+            && variant->src_width == src->width
+            && variant->src_height == src->height
+            && variant->src_format == src->format
+            && variant->dst_width == dst_width
+            && variant->dst_height == dst_height) {
+        // Nothing changed
+        return true;
+    }
+
+    sws_freeContext(variant->sws_ctx);
+
+    struct SwsContext *ctx = sws_alloc_context();
+    if (!ctx) {
+        LOG_OOM();
+        variant->sws_ctx = NULL;
+        return false;
+    }
+
+    av_opt_set_int(ctx, "srcw", src->width, 0);
+    av_opt_set_int(ctx, "srch", src->height, 0);
+    av_opt_set_int(ctx, "src_format", src->format, 0);
+    av_opt_set_int(ctx, "dstw", dst_width, 0);
+    av_opt_set_int(ctx, "dsth", dst_height, 0);
+    av_opt_set_int(ctx, "dst_format", variant->format, 0);
+    av_opt_set_int(ctx, "sws_flags", SWS_BILINEAR, 0);
+#ifdef SCRCPY_LSWS_HAS_SLICE_THREADS
+    av_opt_set_int(ctx, "threads", thread_count, 0);
+#else
+    (void) thread_count;
+#endif
+
+    if (sws_init_context(ctx, NULL, NULL) < 0) {
+        LOGE("Scaler '%s': could not initialize %dx%d -> %dx%d",
+             variant->name, src->width, src->height, dst_width, dst_height);
+        sws_freeContext(ctx);
+        variant->sws_ctx = NULL;
+        return false;
+    }
+
+    variant->sws_ctx = ctx;
+    variant->src_width = src->width;
+    variant->src_height = src->height;
+    variant->src_format = src->format;
+    variant->dst_width = dst_width;
+    variant->dst_height = dst_height;
+
+    LOGD("Scaler '%s': %dx%d -> %dx%d", variant->name, src->width,
+         src->height, dst_width, dst_height);
+    return true;
+}
+
+static bool
+sc_scaler_variant_process(struct sc_scaler_variant *variant,
+                          const AVFrame *src, unsigned thread_count) {
+    int width;
+    int height;
+    sc_scaler_compute_size(variant->max_size, src->width, src->height,
+                           &width, &height);
+
+    if (width == src->width && height == src->height
+            && src->format == variant->format) {
+        // Nothing to do, forward the frame as is
+        return sc_frame_source_sinks_push(&variant->frame_source, src);
+    }
+
+    if (!sc_scaler_variant_configure(variant, src, width, height,
+                                     thread_count)) {
+        return false;
+    }
+
+    // The sinks may still reference the previous frame, always use a new
+    // buffer
+    AVFrame *dst = variant->frame;
+    av_frame_unref(dst);
+    dst->format = variant->format;
+    dst->width = width;
+    dst->height = height;
+
+    int r = av_frame_get_buffer(dst, 0);
+    if (r < 0) {
+        LOG_OOM();
+        return false;
+    }
+
+    r = av_frame_copy_props(dst, src);
+    if (r < 0) {
+        LOG_OOM();
+        return false;
+    }
+
+#ifdef SCRCPY_LSWS_HAS_SLICE_THREADS
+    r = sws_scale_frame(variant->sws_ctx, dst, src);
+#else
+    r = sws_scale(variant->sws_ctx, (const uint8_t *const *) src->data,
+                  src->linesize, 0, src->height, dst->data, dst->linesize);
+#endif
+    if (r < 0) {
+        LOGE("Scaler '%s': could not scale frame", variant->name);
+        return false;
+    }
+
+    bool ok = sc_frame_source_sinks_push(&variant->frame_source, dst);
+    av_frame_unref(dst);
+    return ok;
+}
+
+static int
+run_scaler(void *data) {
+    struct sc_scaler *scaler = data;
+
+    for (;;) {
+        sc_mutex_lock(&scaler->mutex);
+
+        while (!scaler->stopped && sc_vecdeque_is_empty(&scaler->queue)) {
+            sc_cond_wait(&scaler->cond, &scaler->mutex);
+        }
+
+        if (scaler->stopped) {
+            // The pending frames are counted as skipped on close
+            sc_mutex_unlock(&scaler->mutex);
+            break;
+        }
+
+        AVFrame *frame = sc_vecdeque_pop(&scaler->queue);
+        sc_mutex_unlock(&scaler->mutex);
+
+        for (unsigned i = 0; i < scaler->variant_count; ++i) {
+            struct sc_scaler_variant *variant = &scaler->variants[i];
+            if (!variant->active || variant->failed) {
+                continue;
+            }
+
+            bool ok = sc_scaler_variant_process(variant, frame,
+                                                scaler->thread_count);
+            if (!ok) {
+                LOGE("Scaler '%s': could not process frame, closing its "
+                     "sinks", variant->name);
+                // The sinks must not receive any frame anymore
+                sc_frame_source_sinks_close(&variant->frame_source);
+                variant->failed = true;
+            }
+        }
+
+        av_frame_free(&frame);
+    }
+
+    LOGD("Scaler thread ended");
+
+    return 0;
+}
+
+static void
+sc_scaler_variant_close(struct sc_scaler_variant *variant) {
+    if (variant->skipped) {
+        LOGW("Scaler '%s': %" PRIu64 " frames skipped", variant->name,
+             variant->skipped);
+    }
+
+    if (!variant->failed) {
+        sc_frame_source_sinks_close(&variant->frame_source);
+    }
+    sws_freeContext(variant->sws_ctx);
+    av_frame_free(&variant->frame);
+    avcodec_free_context(&variant->ctx);
+    variant->active = false;
+}
+
+static bool
+sc_scaler_variant_open(struct sc_scaler_variant *variant,
+                       const AVCodecContext *ctx) {
+    variant->ctx = avcodec_alloc_context3(NULL);
+    if (!variant->ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    // Describe the frames produced by this variant
+    variant->ctx->codec_type = AVMEDIA_TYPE_VIDEO;
+    variant->ctx->pix_fmt = variant->format;
+    sc_scaler_compute_size(variant->max_size, ctx->width, ctx->height,
+                           &variant->ctx->width, &variant->ctx->height);
+
+    variant->frame = av_frame_alloc();
+    if (!variant->frame) {
+        LOG_OOM();
+        goto error_free_context;
+    }
+
+    variant->sws_ctx = NULL;
+    variant->failed = false;
+    variant->skipped = 0;
+
+    if (!sc_frame_source_sinks_open(&variant->frame_source, variant->ctx)) {
+        goto error_free_frame;
+    }
+
+    variant->active = true;
+    return true;
+
+error_free_frame:
+    av_frame_free(&variant->frame);
+error_free_context:
+    avcodec_free_context(&variant->ctx);
+
+    return false;
+}
+
+static void
+sc_scaler_close_variants(struct sc_scaler *scaler) {
+    for (unsigned i = 0; i < scaler->variant_count; ++i) {
+        struct sc_scaler_variant *variant = &scaler->variants[i];
+        if (variant->active) {
+            sc_scaler_variant_close(variant);
+        }
+    }
+}
+
+static bool
+sc_scaler_open(struct sc_scaler *scaler, const AVCodecContext *ctx) {
+    // Only the variants having sinks are computed
+    scaler->active_count = 0;
+    for (unsigned i = 0; i < scaler->variant_count; ++i) {
+        struct sc_scaler_variant *variant = &scaler->variants[i];
+        if (!variant->frame_source.sink_count) {
+            LOGD("Scaler '%s': no sink, disabled", variant->name);
+            continue;
+        }
+
+        if (!sc_scaler_variant_open(variant, ctx)) {
+            sc_scaler_close_variants(scaler);
+            return false;
+        }
+
+        ++scaler->active_count;
+    }
+
+    if (!scaler->active_count) {
+        // Nothing to do, do not even start the thread
+        return true;
+    }
+
+    int cpu_count = SDL_GetCPUCount();
+    scaler->thread_count = CLAMP(cpu_count / 2, 1, SC_SCALER_MAX_THREADS);
+
+    bool ok = sc_mutex_init(&scaler->mutex);
+    if (!ok) {
+        goto error_close_variants;
+    }
+
+    ok = sc_cond_init(&scaler->cond);
+    if (!ok) {
+        goto error_mutex_destroy;
+    }
+
+    sc_vecdeque_init(&scaler->queue);
+    // Never reallocate on push
+    ok = sc_vecdeque_reserve(&scaler->queue, SC_SCALER_MAX_PENDING);
+    if (!ok) {
+        LOG_OOM();
+        goto error_cond_destroy;
+    }
+
+    scaler->stopped = false;
+
+    LOGD("Starting scaler thread");
+    ok = sc_thread_create(&scaler->thread, run_scaler, "scrcpy-scaler",
+                          scaler);
+    if (!ok) {
+        LOGE("Could not start scaler thread");
+        goto error_queue_destroy;
+    }
+
+    return true;
+
+error_queue_destroy:
+    sc_vecdeque_destroy(&scaler->queue);
+error_cond_destroy:
+    sc_cond_destroy(&scaler->cond);
+error_mutex_destroy:
+    sc_mutex_destroy(&scaler->mutex);
+error_close_variants:
+    sc_scaler_close_variants(scaler);
+
+    return false;
+}
+
+static void
+sc_scaler_close(struct sc_scaler *scaler) {
+    if (!scaler->active_count) {
+        return;
+    }
+
+    sc_mutex_lock(&scaler->mutex);
+    scaler->stopped = true;
+    sc_cond_signal(&scaler->cond);
+    sc_mutex_unlock(&scaler->mutex);
+
+    sc_thread_join(&scaler->thread, NULL);
+
+    // The frames still pending have never been scaled
+    size_t pending = sc_vecdeque_size(&scaler->queue);
+    while (!sc_vecdeque_is_empty(&scaler->queue)) {
+        AVFrame *frame = sc_vecdeque_pop(&scaler->queue);
+        av_frame_free(&frame);
+    }
+
+    for (unsigned i = 0; i < scaler->variant_count; ++i) {
+        scaler->variants[i].skipped += pending;
+    }
+
+    // Close the sinks once the thread does not push frames anymore
+    sc_scaler_close_variants(scaler);
+
+    sc_vecdeque_destroy(&scaler->queue);
+    sc_cond_destroy(&scaler->cond);
+    sc_mutex_destroy(&scaler->mutex);
+}
+
+static bool
+sc_scaler_push(struct sc_scaler *scaler, const AVFrame *frame) {
+    if (!scaler->active_count) {
+        return true;
+    }
+
+    sc_mutex_lock(&scaler->mutex);
+    bool full = sc_vecdeque_size(&scaler->queue) == SC_SCALER_MAX_PENDING;
+    sc_mutex_unlock(&scaler->mutex);
+
+    if (full) {
+        // The scaler could not keep up: never block the decoder, skip the
+        // frame for all the variants
+        for (unsigned i = 0; i < scaler->variant_count; ++i) {
+            ++scaler->variants[i].skipped;
+        }
+        return true;
+    }
+
+    AVFrame *copy = av_frame_clone(frame);
+    if (!copy) {
+        LOG_OOM();
+        return false;
+    }
+
+    sc_mutex_lock(&scaler->mutex);
+    // Only this thread pushes, the queue could not be full
+    sc_vecdeque_push_noresize(&scaler->queue, copy);
+    sc_cond_signal(&scaler->cond);
+    sc_mutex_unlock(&scaler->mutex);
+
+    return true;
+}
+
+static bool
+sc_scaler_frame_sink_open(struct sc_frame_sink *sink,
+                          const AVCodecContext *ctx) {
+    struct sc_scaler *scaler = DOWNCAST(sink);
+    return sc_scaler_open(scaler, ctx);
+}
+
+static void
+sc_scaler_frame_sink_close(struct sc_frame_sink *sink) {
+    struct sc_scaler *scaler = DOWNCAST(sink);
+    sc_scaler_close(scaler);
+}
+
+static bool
+sc_scaler_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
+    struct sc_scaler *scaler = DOWNCAST(sink);
+    return sc_scaler_push(scaler, frame);
+}
+
+void
+sc_scaler_init(struct sc_scaler *scaler) {
+    scaler->variant_count = 0;
+    scaler->active_count = 0;
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = sc_scaler_frame_sink_open,
+        .close = sc_scaler_frame_sink_close,
+        .push = sc_scaler_frame_sink_push,
+    };
+
+    scaler->frame_sink.ops = &ops;
+}
+
+struct sc_scaler_variant *
+sc_scaler_get_variant(struct sc_scaler *scaler, const char *name,
+                      uint16_t max_size, enum AVPixelFormat format) {
+    for (unsigned i = 0; i < scaler->variant_count; ++i) {
+        struct sc_scaler_variant *variant = &scaler->variants[i];
+        if (!strcmp(variant->name, name)) {
+            // The same name must always be requested with the same parameters
+            assert(variant->max_size == max_size);
+            assert(variant->format == format);
+            return variant;
+        }
+    }
+
+    assert(scaler->variant_count < SC_SCALER_MAX_VARIANTS);
+    struct sc_scaler_variant *variant =
+        &scaler->variants[scaler->variant_count++];
+
+    sc_frame_source_init(&variant->frame_source);
+    variant->name = name;
+    variant->max_size = max_size;
+    variant->format = format;
+    variant->active = false;
+    variant->ctx = NULL;
+    variant->sws_ctx = NULL;
+    variant->frame = NULL;
+    variant->failed = false;
+    variant->skipped = 0;
+
+    return variant;
+}
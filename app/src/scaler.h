@@ -0,0 +1,101 @@
+#ifndef SC_SCALER_H
+#define SC_SCALER_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixfmt.h>
+
+#include "trait/frame_sink.h"
+#include "trait/frame_source.h"
+#include "util/thread.h"
+#include "util/vecdeque.h"
+
+#define SC_SCALER_MAX_VARIANTS 4
+#define SC_SCALER_MAX_PENDING 4
+
+struct sc_scaler_variant {
+    struct sc_frame_source frame_source; // frame source trait
+
+    const char *name; // must be statically allocated (e.g. a string literal)
+    uint16_t max_size; // 0 to keep the original size
+    enum AVPixelFormat format;
+
+    // Only initialized if the variant has sinks
+    bool active;
+    AVCodecContext *ctx; // describes the output frames, to open the sinks
+    struct SwsContext *sws_ctx;
+    AVFrame *frame;
+
+    // accessed only from the scaler thread (then on close)
+    bool failed; // the sinks have been closed on error
+
+    // accessed only from the decoder thread
+    uint64_t skipped; // frames never delivered to the sinks
+
+    // parameters of sws_ctx
+    int src_width;
+    int src_height;
+    int src_format;
+    int dst_width;
+    int dst_height;
+};
+
+/**
+ * Scaler, to derive variants of the decoded frames (with a different size or
+ * pixel format), shared between all the components which need them.
+ *
+ * Each variant is a frame source, to which any number of sinks may be
+ * added (up to SC_FRAME_SOURCE_MAX_SINKS). A variant is computed once per
+ * frame, only if it has at least one sink.
+ *
+ * The frames are scaled on a separate thread (with slice threading if
+ * supported by libswscale), so the decoder is never blocked. Up to
+ * SC_SCALER_MAX_PENDING frames are queued; if the scaler could not keep up,
+ * the new frames are skipped, and counted for each variant.
+ *
+ * If a variant could not be computed, its sinks are closed, and the other
+ * variants are not affected.
+ */
+struct sc_scaler_queue SC_VECDEQUE(AVFrame *);
+
+struct sc_scaler {
+    struct sc_frame_sink frame_sink; // frame sink trait
+
+    struct sc_scaler_variant variants[SC_SCALER_MAX_VARIANTS];
+    unsigned variant_count;
+    unsigned active_count;
+    unsigned thread_count;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    struct sc_scaler_queue queue; // at most SC_SCALER_MAX_PENDING frames
+    bool stopped;
+};
+
+void
+sc_scaler_init(struct sc_scaler *scaler);
+
+/**
+ * Return the variant named `name`, created with the given parameters if it
+ * does not exist yet
+ *
+ * The name must be statically allocated (e.g. a string literal). All the
+ * variants must be requested before the scaler is opened.
+ */
+struct sc_scaler_variant *
+sc_scaler_get_variant(struct sc_scaler *scaler, const char *name,
+                      uint16_t max_size, enum AVPixelFormat format);
+
+/**
+ * Compute the size of a frame of size (width, height) scaled to fit in
+ * max_size, preserving the aspect ratio (rounded to even values)
+ */
+void
+sc_scaler_compute_size(uint16_t max_size, int width, int height,
+                       int *out_width, int *out_height);
+
+#endif
@@ -15,17 +15,24 @@
 #endif
 
 #include "audio_player.h"
+#ifdef HAVE_AUTOMATION
+# include "automation.h"
+#endif
 #include "controller.h"
 #include "decoder.h"
+#include "decoder_bench.h"
 #include "delay_buffer.h"
 #include "demuxer.h"
 #include "events.h"
+#include "file_demuxer.h"
 #include "file_pusher.h"
 #include "keyboard_sdk.h"
 #include "mouse_sdk.h"
+#include "packet_bridge.h"
 #include "recorder.h"
 #include "screen.h"
 #include "server.h"
+#include "stats.h"
 #include "uhid/gamepad_uhid.h"
 #include "uhid/keyboard_uhid.h"
 #include "uhid/mouse_uhid.h"
@@ -44,6 +51,27 @@
 #ifdef HAVE_V4L2
 # include "v4l2_sink.h"
 #endif
+#ifdef HAVE_SWSCALE
+# include "proxy_recorder.h"
+# include "scaler.h"
+# include "screenshot.h"
+#endif
+
+// Minimal and maximal delays between two reconnection attempts
+#define SC_RECONNECT_MIN_DELAY SC_TICK_FROM_MS(500)
+#define SC_RECONNECT_MAX_DELAY SC_TICK_FROM_SEC(5)
+
+// Automatic reconnection state (--auto-reconnect)
+struct sc_reconnect {
+    const struct scrcpy_options *options;
+    struct sc_server_params params; // for the next connections
+    const struct sc_server_callbacks *server_cbs;
+    char *serial; // the device selected by the first connection
+    SDL_TimerID timer; // next attempt
+    sc_tick delay; // delay before the next attempt
+    sc_tick disconnected_at;
+    bool interrupted; // disconnected, not reconnected yet
+};
 
 struct scrcpy {
     struct sc_server server;
@@ -51,15 +79,30 @@ struct scrcpy {
     struct sc_audio_player audio_player;
     struct sc_demuxer video_demuxer;
     struct sc_demuxer audio_demuxer;
+    // Replace the demuxers on --replay
+    struct sc_file_demuxer video_file_demuxer;
+    struct sc_file_demuxer audio_file_demuxer;
     struct sc_decoder video_decoder;
     struct sc_decoder audio_decoder;
+    struct sc_decoder_bench video_decoder_bench;
+    struct sc_packet_bridge video_bridge;
+    struct sc_packet_bridge audio_bridge;
     struct sc_recorder recorder;
     struct sc_delay_buffer video_buffer;
+    struct sc_stats stats;
 #ifdef HAVE_V4L2
     struct sc_v4l2_sink v4l2_sink;
     struct sc_delay_buffer v4l2_buffer;
+#endif
+#ifdef HAVE_SWSCALE
+    struct sc_scaler scaler;
+    struct sc_proxy_recorder proxy_recorder;
+    struct sc_screenshot screenshot;
 #endif
     struct sc_controller controller;
+#ifdef HAVE_AUTOMATION
+    struct sc_automation automation;
+#endif
     struct sc_file_pusher file_pusher;
 #ifdef HAVE_USB
     struct sc_usb usb;
@@ -89,6 +132,17 @@ struct scrcpy {
 #endif
     };
     struct sc_timeout timeout;
+    struct sc_reconnect reconnect;
+
+    // The components depending on the connection (restarted on reconnection)
+    bool server_initialized;
+    bool server_started;
+    bool video_demuxer_started;
+    bool audio_demuxer_started;
+    bool controller_started;
+
+    // Number of replayed streams not ended yet
+    unsigned replay_streams;
 };
 
 #ifdef _WIN32
@@ -175,17 +229,271 @@ sdl_configure(bool video_playback, bool disable_screensaver) {
     }
 }
 
+// Generate a scrcpy id to differentiate multiple running scrcpy instances
+static uint32_t
+scrcpy_generate_scid(void) {
+    struct sc_rand rand;
+    sc_rand_init(&rand);
+    // Only use 31 bits to avoid issues with signed values on the Java-side
+    return sc_rand_u32(&rand) & 0x7FFFFFFF;
+}
+
+static bool
+sc_reconnect_init(struct sc_reconnect *r, const struct scrcpy_options *options,
+                  const struct sc_server_params *params,
+                  const struct sc_server_callbacks *server_cbs,
+                  const char *serial) {
+    r->serial = strdup(serial);
+    if (!r->serial) {
+        LOG_OOM();
+        return false;
+    }
+
+    r->options = options;
+    r->server_cbs = server_cbs;
+
+    // Always reconnect to the device selected by the first connection
+    r->params = *params;
+    r->params.select_usb = false;
+    r->params.select_tcpip = false;
+    if (params->tcpip) {
+        // The serial is the device address, "adb connect" again if necessary
+        r->params.req_serial = NULL;
+        r->params.tcpip_dst = r->serial;
+    } else {
+        r->params.req_serial = r->serial;
+    }
+
+    r->timer = 0;
+    r->delay = 0;
+    r->disconnected_at = 0;
+    r->interrupted = false;
+
+    return true;
+}
+
+static void
+sc_reconnect_destroy(struct sc_reconnect *r) {
+    if (r->timer) {
+        SDL_RemoveTimer(r->timer);
+    }
+    free(r->serial);
+}
+
+static Uint32 SDLCALL
+sc_reconnect_on_timer(Uint32 interval, void *userdata) {
+    (void) interval;
+    (void) userdata;
+
+    sc_push_event(SC_EVENT_RECONNECT);
+    return 0; // do not repeat
+}
+
+// Stop and release the components depending on the connection
+static void
+sc_session_stop(struct scrcpy *s) {
+    // Same order as on exit
+    if (s->controller_started) {
+        sc_controller_stop(&s->controller);
+    }
+    if (s->server_started) {
+        sc_server_stop(&s->server);
+    }
+
+    if (s->video_demuxer_started) {
+        sc_demuxer_join(&s->video_demuxer);
+        s->video_demuxer_started = false;
+    }
+    if (s->audio_demuxer_started) {
+        sc_demuxer_join(&s->audio_demuxer);
+        s->audio_demuxer_started = false;
+    }
+    if (s->controller_started) {
+        // Only joined: it is reset on reconnection, because the input
+        // processors keep a reference to it
+        sc_controller_join(&s->controller);
+        s->controller_started = false;
+    }
+    if (s->server_started) {
+        sc_server_join(&s->server);
+        s->server_started = false;
+    }
+    if (s->server_initialized) {
+        sc_server_destroy(&s->server);
+        s->server_initialized = false;
+    }
+}
+
+static bool
+sc_reconnect_start_server(struct scrcpy *s) {
+    struct sc_reconnect *r = &s->reconnect;
+    assert(!s->server_initialized);
+
+    r->timer = 0;
+    r->params.scid = scrcpy_generate_scid();
+
+    if (!sc_server_init(&s->server, &r->params, r->server_cbs, NULL)) {
+        return false;
+    }
+    s->server_initialized = true;
+
+    if (!sc_server_start(&s->server)) {
+        return false;
+    }
+    s->server_started = true;
+
+    return true;
+}
+
+static bool
+sc_reconnect_on_disconnected(struct scrcpy *s) {
+    struct sc_reconnect *r = &s->reconnect;
+
+    if (r->interrupted) {
+        // Also reported by another component of the previous connection
+        return true;
+    }
+
+    LOGW("Device disconnected, reconnecting...");
+    r->interrupted = true;
+    r->disconnected_at = sc_tick_now();
+    r->delay = 0;
+
+    sc_session_stop(s);
+
+    // The first attempt is immediate (the device may have been disconnected
+    // only briefly)
+    return sc_reconnect_start_server(s);
+}
+
+static bool
+sc_reconnect_on_connection_failed(struct scrcpy *s) {
+    struct sc_reconnect *r = &s->reconnect;
+    assert(r->interrupted);
+
+    sc_session_stop(s);
+
+    r->delay = r->delay ? MIN(r->delay * 2, SC_RECONNECT_MAX_DELAY)
+                        : SC_RECONNECT_MIN_DELAY;
+    LOGI("Reconnection failed, retrying in %" PRItick " ms",
+         SC_TICK_TO_MS(r->delay));
+
+    r->timer = SDL_AddTimer(SC_TICK_TO_MS(r->delay), sc_reconnect_on_timer,
+                            NULL);
+    if (!r->timer) {
+        LOGE("Could not add reconnection timer: %s", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+sc_reconnect_restart_demuxer(struct sc_demuxer *demuxer, sc_socket socket,
+                             struct sc_packet_bridge *bridge) {
+    // The packet source is reset, so the bridge must be added again
+    sc_demuxer_init(demuxer, demuxer->name, socket, demuxer->decoder_name,
+                    demuxer->cbs, demuxer->cbs_userdata);
+    sc_packet_source_add_sink(&demuxer->packet_source, &bridge->packet_sink);
+    return sc_demuxer_start(demuxer);
+}
+
+static bool
+sc_reconnect_on_connected(struct scrcpy *s) {
+    struct sc_reconnect *r = &s->reconnect;
+    const struct scrcpy_options *options = r->options;
+    assert(r->interrupted);
+
+    if (options->control) {
+        sc_controller_reset(&s->controller, s->server.control_socket);
+        if (!sc_controller_start(&s->controller)) {
+            return false;
+        }
+        s->controller_started = true;
+    }
+
+    if (options->video) {
+        if (!sc_reconnect_restart_demuxer(&s->video_demuxer,
+                                          s->server.video_socket,
+                                          &s->video_bridge)) {
+            return false;
+        }
+        s->video_demuxer_started = true;
+    }
+
+    if (options->audio) {
+        if (!sc_reconnect_restart_demuxer(&s->audio_demuxer,
+                                          s->server.audio_socket,
+                                          &s->audio_bridge)) {
+            return false;
+        }
+        s->audio_demuxer_started = true;
+    }
+
+    if (options->control && options->turn_screen_off) {
+        struct sc_control_msg msg;
+        msg.type = SC_CONTROL_MSG_TYPE_SET_DISPLAY_POWER;
+        msg.set_display_power.on = false;
+
+        if (!sc_controller_push_msg(&s->controller, &msg)) {
+            LOGW("Could not request 'set display power'");
+        }
+    }
+
+    sc_tick recovery_time = sc_tick_now() - r->disconnected_at;
+    sc_stats_add(&s->stats.reconnections, 1);
+    atomic_store_explicit(&s->stats.recovery_time, recovery_time,
+                          memory_order_relaxed);
+    LOGI("Reconnected in %" PRItick " ms", SC_TICK_TO_MS(recovery_time));
+
+    r->interrupted = false;
+    return true;
+}
+
 static enum scrcpy_exit_code
-event_loop(struct scrcpy *s, bool has_screen) {
+event_loop(struct scrcpy *s, bool has_screen, bool reconnect) {
     SDL_Event event;
     while (SDL_WaitEvent(&event)) {
         switch (event.type) {
             case SC_EVENT_DEVICE_DISCONNECTED:
+                if (reconnect) {
+                    if (!sc_reconnect_on_disconnected(s)) {
+                        return SCRCPY_EXIT_FAILURE;
+                    }
+                    break;
+                }
                 LOGW("Device disconnected");
                 return SCRCPY_EXIT_DISCONNECTED;
+            // The following events are only received on reconnection (the
+            // first connection is awaited before the event loop)
+            case SC_EVENT_SERVER_CONNECTION_FAILED:
+                assert(reconnect);
+                if (!sc_reconnect_on_connection_failed(s)) {
+                    return SCRCPY_EXIT_FAILURE;
+                }
+                break;
+            case SC_EVENT_SERVER_CONNECTED:
+                assert(reconnect);
+                if (!sc_reconnect_on_connected(s)) {
+                    return SCRCPY_EXIT_FAILURE;
+                }
+                break;
+            case SC_EVENT_RECONNECT:
+                assert(reconnect);
+                if (!sc_reconnect_start_server(s)) {
+                    return SCRCPY_EXIT_FAILURE;
+                }
+                break;
             case SC_EVENT_DEMUXER_ERROR:
                 LOGE("Demuxer error");
                 return SCRCPY_EXIT_FAILURE;
+            case SC_EVENT_REPLAY_ENDED:
+                assert(s->replay_streams);
+                if (!--s->replay_streams) {
+                    LOGI("Replay complete");
+                    return SCRCPY_EXIT_SUCCESS;
+                }
+                break;
             case SC_EVENT_CONTROLLER_ERROR:
                 LOGE("Controller error");
                 return SCRCPY_EXIT_FAILURE;
@@ -286,6 +594,18 @@ sc_video_demuxer_on_ended(struct sc_demuxer *demuxer,
     }
 }
 
+static void
+sc_video_demuxer_on_video_size(struct sc_demuxer *demuxer,
+                               struct sc_size size, void *userdata) {
+    (void) demuxer;
+
+    struct sc_screen *screen = userdata;
+    if (screen) {
+        // Prepare the texture on the UI thread
+        sc_screen_announce_frame_size(screen, size);
+    }
+}
+
 static void
 sc_audio_demuxer_on_ended(struct sc_demuxer *demuxer,
                           enum sc_demuxer_status status, void *userdata) {
@@ -304,6 +624,23 @@ sc_audio_demuxer_on_ended(struct sc_demuxer *demuxer,
     }
 }
 
+static void
+sc_file_demuxer_on_ended(struct sc_file_demuxer *demuxer,
+                         enum sc_demuxer_status status, void *userdata) {
+    const struct scrcpy_options *options = userdata;
+
+    // A missing audio stream is handled like audio disabled by the device
+    bool error = status == SC_DEMUXER_STATUS_ERROR
+              || (status == SC_DEMUXER_STATUS_DISABLED
+                  && (demuxer->type == AVMEDIA_TYPE_VIDEO
+                      || options->require_audio));
+    if (error) {
+        sc_push_event(SC_EVENT_DEMUXER_ERROR);
+    } else {
+        sc_push_event(SC_EVENT_REPLAY_ENDED);
+    }
+}
+
 static void
 sc_controller_on_ended(struct sc_controller *controller, bool error,
                        void *userdata) {
@@ -353,15 +690,6 @@ sc_timeout_on_timeout(struct sc_timeout *timeout, void *userdata) {
     sc_push_event(SC_EVENT_TIME_LIMIT_REACHED);
 }
 
-// Generate a scrcpy id to differentiate multiple running scrcpy instances
-static uint32_t
-scrcpy_generate_scid(void) {
-    struct sc_rand rand;
-    sc_rand_init(&rand);
-    // Only use 31 bits to avoid issues with signed values on the Java-side
-    return sc_rand_u32(&rand) & 0x7FFFFFFF;
-}
-
 static void
 init_sdl_gamepads(void) {
     // Trigger a SDL_CONTROLLERDEVICEADDED event for all gamepads already
@@ -396,15 +724,31 @@ scrcpy(struct scrcpy_options *options) {
 
     enum scrcpy_exit_code ret = SCRCPY_EXIT_FAILURE;
 
-    bool server_started = false;
+    s->server_initialized = false;
+    s->server_started = false;
+    s->video_demuxer_started = false;
+    s->audio_demuxer_started = false;
+    s->controller_started = false;
+    s->replay_streams = 0;
+    bool video_file_demuxer_initialized = false;
+    bool video_file_demuxer_started = false;
+    bool audio_file_demuxer_initialized = false;
+    bool audio_file_demuxer_started = false;
     bool file_pusher_initialized = false;
     bool recorder_initialized = false;
     bool recorder_started = false;
 #ifdef HAVE_V4L2
     bool v4l2_sink_initialized = false;
 #endif
-    bool video_demuxer_started = false;
-    bool audio_demuxer_started = false;
+#ifdef HAVE_SWSCALE
+    bool proxy_recorder_initialized = false;
+    bool screenshot_initialized = false;
+    bool screenshot_started = false;
+#endif
+    bool video_bridge_initialized = false;
+    bool audio_bridge_initialized = false;
+    bool video_decoder_bench_initialized = false;
+    bool reconnect_initialized = false;
 #ifdef HAVE_USB
     bool aoa_hid_initialized = false;
     bool keyboard_aoa_initialized = false;
@@ -412,7 +756,10 @@ scrcpy(struct scrcpy_options *options) {
     bool gamepad_aoa_initialized = false;
 #endif
     bool controller_initialized = false;
-    bool controller_started = false;
+#ifdef HAVE_AUTOMATION
+    bool automation_initialized = false;
+    bool automation_started = false;
+#endif
     bool screen_initialized = false;
     bool timeout_initialized = false;
     bool timeout_started = false;
@@ -482,8 +829,15 @@ scrcpy(struct scrcpy_options *options) {
         .on_connected = sc_server_on_connected,
         .on_disconnected = sc_server_on_disconnected,
     };
-    if (!sc_server_init(&s->server, &params, &cbs, NULL)) {
-        return SCRCPY_EXIT_FAILURE;
+    // On --replay, the streams are read from a file, there is no device
+    bool replay = !!options->replay_filename;
+
+    if (!replay) {
+        if (!sc_server_init(&s->server, &params, &cbs, NULL)) {
+            return SCRCPY_EXIT_FAILURE;
+        }
+
+        s->server_initialized = true;
     }
 
     if (options->window) {
@@ -492,11 +846,13 @@ scrcpy(struct scrcpy_options *options) {
         sdl_set_hints(options->render_driver);
     }
 
-    if (!sc_server_start(&s->server)) {
-        goto end;
-    }
+    if (!replay) {
+        if (!sc_server_start(&s->server)) {
+            goto end;
+        }
 
-    server_started = true;
+        s->server_started = true;
+    }
 
     if (options->list) {
         bool ok = await_for_server(NULL);
@@ -541,27 +897,33 @@ scrcpy(struct scrcpy_options *options) {
 
     sdl_configure(options->video_playback, options->disable_screensaver);
 
-    // Await for server without blocking Ctrl+C handling
-    bool connected;
-    if (!await_for_server(&connected)) {
-        LOGE("Server connection failed");
-        goto end;
-    }
+    const char *device_name;
+    const char *serial = NULL;
 
-    if (!connected) {
-        // This is not an error, user requested to quit
-        LOGD("User requested to quit");
-        ret = SCRCPY_EXIT_SUCCESS;
-        goto end;
-    }
+    if (replay) {
+        device_name = options->replay_filename;
+    } else {
+        // Await for server without blocking Ctrl+C handling
+        bool connected;
+        if (!await_for_server(&connected)) {
+            LOGE("Server connection failed");
+            goto end;
+        }
 
-    LOGD("Server connected");
+        if (!connected) {
+            // This is not an error, user requested to quit
+            LOGD("User requested to quit");
+            ret = SCRCPY_EXIT_SUCCESS;
+            goto end;
+        }
 
-    // It is necessarily initialized here, since the device is connected
-    struct sc_server_info *info = &s->server.info;
+        LOGD("Server connected");
 
-    const char *serial = s->server.serial;
-    assert(serial);
+        // It is necessarily initialized here, since the device is connected
+        device_name = s->server.info.device_name;
+        serial = s->server.serial;
+        assert(serial);
+    }
 
     struct sc_file_pusher *fp = NULL;
 
@@ -574,36 +936,124 @@ scrcpy(struct scrcpy_options *options) {
         file_pusher_initialized = true;
     }
 
-    if (options->video) {
-        static const struct sc_demuxer_callbacks video_demuxer_cbs = {
-            .on_ended = sc_video_demuxer_on_ended,
-        };
-        sc_demuxer_init(&s->video_demuxer, "video", s->server.video_socket,
-                        &video_demuxer_cbs, NULL);
+    const char *video_decoder = options->video_decoder;
+    bool video_decoder_bench = false;
+    if (video_decoder && !strcmp(video_decoder, "auto")) {
+        video_decoder = sc_decoder_bench_select(options->video_codec,
+                                                &video_decoder_bench);
     }
 
-    if (options->audio) {
-        static const struct sc_demuxer_callbacks audio_demuxer_cbs = {
-            .on_ended = sc_audio_demuxer_on_ended,
+    struct sc_packet_source *video_src;
+    struct sc_packet_source *audio_src;
+
+    if (replay) {
+        static const struct sc_file_demuxer_callbacks file_demuxer_cbs = {
+            .on_ended = sc_file_demuxer_on_ended,
         };
-        sc_demuxer_init(&s->audio_demuxer, "audio", s->server.audio_socket,
-                        &audio_demuxer_cbs, options);
+
+        if (options->video) {
+            if (!sc_file_demuxer_init(&s->video_file_demuxer, "video",
+                                      options->replay_filename,
+                                      AVMEDIA_TYPE_VIDEO, video_decoder,
+                                      options->replay_pacing,
+                                      &file_demuxer_cbs, options)) {
+                goto end;
+            }
+            video_file_demuxer_initialized = true;
+        }
+
+        if (options->audio) {
+            if (!sc_file_demuxer_init(&s->audio_file_demuxer, "audio",
+                                      options->replay_filename,
+                                      AVMEDIA_TYPE_AUDIO, NULL,
+                                      options->replay_pacing,
+                                      &file_demuxer_cbs, options)) {
+                goto end;
+            }
+            audio_file_demuxer_initialized = true;
+        }
+
+        video_src = &s->video_file_demuxer.packet_source;
+        audio_src = &s->audio_file_demuxer.packet_source;
+    } else {
+        if (options->video) {
+            static const struct sc_demuxer_callbacks video_demuxer_cbs = {
+                .on_ended = sc_video_demuxer_on_ended,
+                .on_video_size = sc_video_demuxer_on_video_size,
+            };
+            // Announce the video size changes to the screen, if any
+            struct sc_screen *screen =
+                options->window && options->video_playback ? &s->screen : NULL;
+            sc_demuxer_init(&s->video_demuxer, "video", s->server.video_socket,
+                            video_decoder, &video_demuxer_cbs, screen);
+        }
+
+        if (options->audio) {
+            static const struct sc_demuxer_callbacks audio_demuxer_cbs = {
+                .on_ended = sc_audio_demuxer_on_ended,
+            };
+            sc_demuxer_init(&s->audio_demuxer, "audio", s->server.audio_socket,
+                            NULL, &audio_demuxer_cbs, options);
+        }
+
+        video_src = &s->video_demuxer.packet_source;
+        audio_src = &s->audio_demuxer.packet_source;
+    }
+
+    if (options->auto_reconnect) {
+        if (!sc_reconnect_init(&s->reconnect, options, &params, &cbs,
+                               serial)) {
+            goto end;
+        }
+        reconnect_initialized = true;
+
+        // Keep the packet sinks open across reconnections
+        if (options->video) {
+            sc_packet_bridge_init(&s->video_bridge, "video");
+            sc_packet_source_add_sink(video_src,
+                                      &s->video_bridge.packet_sink);
+            video_src = &s->video_bridge.packet_source;
+            video_bridge_initialized = true;
+        }
+
+        if (options->audio) {
+            sc_packet_bridge_init(&s->audio_bridge, "audio");
+            sc_packet_source_add_sink(audio_src,
+                                      &s->audio_bridge.packet_sink);
+            audio_src = &s->audio_bridge.packet_source;
+            audio_bridge_initialized = true;
+        }
     }
 
+    // Always collected, it is cheap (relaxed atomic counters)
+    sc_stats_init(&s->stats, options->video_buffer);
+
     bool needs_video_decoder = options->video_playback;
     bool needs_audio_decoder = options->audio_playback;
 #ifdef HAVE_V4L2
     needs_video_decoder |= !!options->v4l2_device;
+#endif
+#ifdef HAVE_SWSCALE
+    needs_video_decoder |= !!options->record_proxy_filename;
+#endif
+#ifdef HAVE_AUTOMATION
+    // To notify the decoded frames to the automation client
+    needs_video_decoder |= options->video && options->automation_socket;
 #endif
     if (needs_video_decoder) {
-        sc_decoder_init(&s->video_decoder, "video");
-        sc_packet_source_add_sink(&s->video_demuxer.packet_source,
-                                  &s->video_decoder.packet_sink);
+        sc_decoder_init(&s->video_decoder, "video", &s->stats);
+        sc_packet_source_add_sink(video_src, &s->video_decoder.packet_sink);
+
+        if (video_decoder_bench) {
+            sc_decoder_bench_init(&s->video_decoder_bench);
+            sc_packet_source_add_sink(video_src,
+                                      &s->video_decoder_bench.packet_sink);
+            video_decoder_bench_initialized = true;
+        }
     }
     if (needs_audio_decoder) {
-        sc_decoder_init(&s->audio_decoder, "audio");
-        sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
-                                  &s->audio_decoder.packet_sink);
+        sc_decoder_init(&s->audio_decoder, "audio", NULL);
+        sc_packet_source_add_sink(audio_src, &s->audio_decoder.packet_sink);
     }
 
     if (options->record_filename) {
@@ -624,11 +1074,11 @@ scrcpy(struct scrcpy_options *options) {
         recorder_started = true;
 
         if (options->video) {
-            sc_packet_source_add_sink(&s->video_demuxer.packet_source,
+            sc_packet_source_add_sink(video_src,
                                       &s->recorder.video_packet_sink);
         }
         if (options->audio) {
-            sc_packet_source_add_sink(&s->audio_demuxer.packet_source,
+            sc_packet_source_add_sink(audio_src,
                                       &s->recorder.audio_packet_sink);
         }
     }
@@ -793,15 +1243,73 @@ aoa_complete:
         if (!sc_controller_start(&s->controller)) {
             goto end;
         }
-        controller_started = true;
+        s->controller_started = true;
     }
 
     // There is a controller if and only if control is enabled
     assert(options->control == !!controller);
 
+#ifdef HAVE_AUTOMATION
+    if (options->automation_socket) {
+        struct sc_screen *screen =
+            options->video_playback ? &s->screen : NULL;
+        if (!sc_automation_init(&s->automation, options->automation_socket,
+                                controller, screen, &s->stats)) {
+            goto end;
+        }
+        automation_initialized = true;
+
+        if (needs_video_decoder) {
+            sc_frame_source_add_sink(&s->video_decoder.frame_source,
+                                     &s->automation.frame_sink);
+        }
+
+        if (!sc_automation_start(&s->automation)) {
+            goto end;
+        }
+        automation_started = true;
+    }
+#endif
+
     if (options->window) {
         const char *window_title =
-            options->window_title ? options->window_title : info->device_name;
+            options->window_title ? options->window_title : device_name;
+
+        // The decoder may discard packets while the display is paused only if
+        // the screen is its only consumer, and if a sync frame can be
+        // requested on resume
+        struct sc_decoder *decoder = NULL;
+        bool discard_on_pause = options->video_playback && controller;
+#ifdef HAVE_V4L2
+        discard_on_pause &= !options->v4l2_device;
+#endif
+#ifdef HAVE_SWSCALE
+        discard_on_pause &= !options->record_proxy_filename;
+#endif
+#ifdef HAVE_AUTOMATION
+        discard_on_pause &= !options->automation_socket;
+#endif
+        if (discard_on_pause) {
+            decoder = &s->video_decoder;
+        }
+
+        struct sc_screenshot *screenshot = NULL;
+#ifdef HAVE_SWSCALE
+        if (options->video_playback) {
+            if (!sc_screenshot_init(&s->screenshot, options->screenshot_dir,
+                                    options->screenshot_format)) {
+                goto end;
+            }
+            screenshot_initialized = true;
+
+            if (!sc_screenshot_start(&s->screenshot)) {
+                goto end;
+            }
+            screenshot_started = true;
+
+            screenshot = &s->screenshot;
+        }
+#endif
 
         struct sc_screen_params screen_params = {
             .video = options->video_playback,
@@ -825,6 +1333,9 @@ aoa_complete:
             .mipmaps = options->mipmaps,
             .fullscreen = options->fullscreen,
             .start_fps_counter = options->start_fps_counter,
+            .stats = &s->stats,
+            .decoder = decoder,
+            .screenshot = screenshot,
         };
 
         if (!sc_screen_init(&s->screen, &screen_params)) {
@@ -846,8 +1357,15 @@ aoa_complete:
     }
 
     if (options->audio_playback) {
+        sc_tick min_buffer = options->audio_buffer;
+        sc_tick max_buffer = options->audio_buffer;
+        if (options->audio_buffer_auto) {
+            min_buffer = options->audio_buffer_min;
+            max_buffer = options->audio_buffer_max;
+        }
         sc_audio_player_init(&s->audio_player, options->audio_buffer,
-                             options->audio_output_buffer);
+                             min_buffer, max_buffer,
+                             options->audio_output_buffer, &s->stats);
         sc_frame_source_add_sink(&s->audio_decoder.frame_source,
                                  &s->audio_player.frame_sink);
     }
@@ -871,21 +1389,74 @@ aoa_complete:
     }
 #endif
 
-    // Now that the header values have been consumed, the socket(s) will
-    // receive the stream(s). Start the demuxer(s).
-
-    if (options->video) {
-        if (!sc_demuxer_start(&s->video_demuxer)) {
+#ifdef HAVE_SWSCALE
+    if (options->record_proxy_filename) {
+        if (!sc_proxy_recorder_init(&s->proxy_recorder,
+                                    options->record_proxy_filename,
+                                    options->record_proxy_format,
+                                    options->record_proxy_size,
+                                    options->record_proxy_bit_rate)) {
             goto end;
         }
-        video_demuxer_started = true;
+
+        proxy_recorder_initialized = true;
     }
 
-    if (options->audio) {
-        if (!sc_demuxer_start(&s->audio_demuxer)) {
-            goto end;
+    // Frames derived from the decoded frames (scaled or converted) are
+    // computed once on the scaler thread, and shared between their consumers
+    bool needs_scaler = !!options->record_proxy_filename;
+    if (needs_scaler) {
+        sc_scaler_init(&s->scaler);
+        sc_frame_source_add_sink(&s->video_decoder.frame_source,
+                                 &s->scaler.frame_sink);
+    }
+
+    if (options->record_proxy_filename) {
+        struct sc_scaler_variant *proxy =
+            sc_scaler_get_variant(&s->scaler, "proxy",
+                                  options->record_proxy_size,
+                                  AV_PIX_FMT_YUV420P);
+        sc_frame_source_add_sink(&proxy->frame_source,
+                                 &s->proxy_recorder.frame_sink);
+    }
+#endif
+
+    if (replay) {
+        // The same epoch for all the streams keeps them synchronized
+        sc_tick epoch = sc_tick_now();
+
+        if (options->video) {
+            if (!sc_file_demuxer_start(&s->video_file_demuxer, epoch)) {
+                goto end;
+            }
+            video_file_demuxer_started = true;
+            ++s->replay_streams;
+        }
+
+        if (options->audio) {
+            if (!sc_file_demuxer_start(&s->audio_file_demuxer, epoch)) {
+                goto end;
+            }
+            audio_file_demuxer_started = true;
+            ++s->replay_streams;
+        }
+    } else {
+        // Now that the header values have been consumed, the socket(s) will
+        // receive the stream(s). Start the demuxer(s).
+
+        if (options->video) {
+            if (!sc_demuxer_start(&s->video_demuxer)) {
+                goto end;
+            }
+            s->video_demuxer_started = true;
+        }
+
+        if (options->audio) {
+            if (!sc_demuxer_start(&s->audio_demuxer)) {
+                goto end;
+            }
+            s->audio_demuxer_started = true;
         }
-        audio_demuxer_started = true;
     }
 
     // If the device screen is to be turned off, send the control message after
@@ -945,7 +1516,7 @@ aoa_complete:
         }
     }
 
-    ret = event_loop(s, options->window);
+    ret = event_loop(s, options->window, options->auto_reconnect);
     terminate_event_loop();
     LOGD("quit...");
 
@@ -981,7 +1552,12 @@ end:
         sc_acksync_destroy(acksync);
     }
 #endif
-    if (controller_started) {
+#ifdef HAVE_AUTOMATION
+    if (automation_started) {
+        sc_automation_stop(&s->automation);
+    }
+#endif
+    if (s->controller_started) {
         sc_controller_stop(&s->controller);
     }
     if (file_pusher_initialized) {
@@ -990,14 +1566,26 @@ end:
     if (recorder_initialized) {
         sc_recorder_stop(&s->recorder);
     }
+#ifdef HAVE_SWSCALE
+    if (screenshot_started) {
+        // The pending screenshots are written before the thread terminates
+        sc_screenshot_stop(&s->screenshot);
+    }
+#endif
     if (screen_initialized) {
         sc_screen_interrupt(&s->screen);
     }
 
-    if (server_started) {
+    if (s->server_started) {
         // shutdown the sockets and kill the server
         sc_server_stop(&s->server);
     }
+    if (video_file_demuxer_started) {
+        sc_file_demuxer_stop(&s->video_file_demuxer);
+    }
+    if (audio_file_demuxer_started) {
+        sc_file_demuxer_stop(&s->audio_file_demuxer);
+    }
 
     if (timeout_started) {
         sc_timeout_join(&s->timeout);
@@ -1008,20 +1596,53 @@ end:
 
     // now that the sockets are shutdown, the demuxer and controller are
     // interrupted, we can join them
-    if (video_demuxer_started) {
+    if (s->video_demuxer_started) {
         sc_demuxer_join(&s->video_demuxer);
     }
 
-    if (audio_demuxer_started) {
+    if (s->audio_demuxer_started) {
         sc_demuxer_join(&s->audio_demuxer);
     }
 
+    if (video_file_demuxer_started) {
+        sc_file_demuxer_join(&s->video_file_demuxer);
+    }
+    if (video_file_demuxer_initialized) {
+        sc_file_demuxer_destroy(&s->video_file_demuxer);
+    }
+    if (audio_file_demuxer_started) {
+        sc_file_demuxer_join(&s->audio_file_demuxer);
+    }
+    if (audio_file_demuxer_initialized) {
+        sc_file_demuxer_destroy(&s->audio_file_demuxer);
+    }
+
+    // The bridges close their sinks, so they must be destroyed once the
+    // demuxers are joined
+    if (video_bridge_initialized) {
+        sc_packet_bridge_destroy(&s->video_bridge);
+    }
+    if (audio_bridge_initialized) {
+        sc_packet_bridge_destroy(&s->audio_bridge);
+    }
+
+    // The benchmark is interrupted once its packet sink is closed
+    if (video_decoder_bench_initialized) {
+        sc_decoder_bench_destroy(&s->video_decoder_bench);
+    }
+
 #ifdef HAVE_V4L2
     if (v4l2_sink_initialized) {
         sc_v4l2_sink_destroy(&s->v4l2_sink);
     }
 #endif
 
+#ifdef HAVE_SWSCALE
+    if (proxy_recorder_initialized) {
+        sc_proxy_recorder_destroy(&s->proxy_recorder);
+    }
+#endif
+
 #ifdef HAVE_USB
     if (aoa_hid_initialized) {
         sc_aoa_join(&s->aoa);
@@ -1040,12 +1661,34 @@ end:
         sc_screen_destroy(&s->screen);
     }
 
-    if (controller_started) {
+#ifdef HAVE_SWSCALE
+    // The screen does not capture screenshots anymore
+    if (screenshot_started) {
+        sc_screenshot_join(&s->screenshot);
+    }
+    if (screenshot_initialized) {
+        sc_screenshot_destroy(&s->screenshot);
+    }
+#endif
+
+    if (s->controller_started) {
         sc_controller_join(&s->controller);
     }
+#ifdef HAVE_AUTOMATION
+    // The automation thread may wait for the controller, which is now stopped
+    if (automation_started) {
+        sc_automation_join(&s->automation);
+    }
+#endif
     if (controller_initialized) {
         sc_controller_destroy(&s->controller);
     }
+#ifdef HAVE_AUTOMATION
+    // The UHID devices data must outlive the controller messages
+    if (automation_initialized) {
+        sc_automation_destroy(&s->automation);
+    }
+#endif
 
     if (recorder_started) {
         sc_recorder_join(&s->recorder);
@@ -1059,11 +1702,17 @@ end:
         sc_file_pusher_destroy(&s->file_pusher);
     }
 
-    if (server_started) {
+    if (s->server_started) {
         sc_server_join(&s->server);
     }
 
-    sc_server_destroy(&s->server);
+    if (s->server_initialized) {
+        sc_server_destroy(&s->server);
+    }
+
+    if (reconnect_initialized) {
+        sc_reconnect_destroy(&s->reconnect);
+    }
 
     return ret;
 }
@@ -7,6 +7,9 @@
 #include "events.h"
 #include "icon.h"
 #include "options.h"
+#ifdef HAVE_SWSCALE
+# include "screenshot.h"
+#endif
 #include "util/log.h"
 
 #define DISPLAY_MARGINS 96
@@ -213,15 +216,17 @@ sc_screen_render(struct sc_screen *screen, bool update_content_rect) {
         sc_screen_update_content_rect(screen);
     }
 
+    struct sc_overlay *overlay = screen->stats ? &screen->overlay : NULL;
     enum sc_display_result res =
-        sc_display_render(&screen->display, &screen->rect, screen->orientation);
+        sc_display_render(&screen->display, &screen->rect, screen->orientation,
+                          overlay);
     (void) res; // any error already logged
 }
 
 static void
 sc_screen_render_novideo(struct sc_screen *screen) {
     enum sc_display_result res =
-        sc_display_render(&screen->display, NULL, SC_ORIENTATION_0);
+        sc_display_render(&screen->display, NULL, SC_ORIENTATION_0, NULL);
     (void) res; // any error already logged
 }
 
@@ -301,6 +306,20 @@ sc_screen_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
     struct sc_screen *screen = DOWNCAST(sink);
     assert(screen->video);
 
+    if (screen->stats) {
+        atomic_store_explicit(&screen->push_time, sc_tick_now(),
+                              memory_order_relaxed);
+        sc_stats_add(&screen->stats->input_frames, 1);
+    }
+
+#ifdef HAVE_SWSCALE
+    if (atomic_load_explicit(&screen->screenshot_burst,
+                             memory_order_relaxed)) {
+        // Only referenced, never blocks
+        sc_screenshot_capture(screen->screenshot, frame);
+    }
+#endif
+
     bool previous_skipped;
     bool ok = sc_frame_buffer_push(&screen->fb, frame, &previous_skipped);
     if (!ok) {
@@ -309,6 +328,9 @@ sc_screen_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
 
     if (previous_skipped) {
         sc_fps_counter_add_skipped_frame(&screen->fps_counter);
+        if (screen->stats) {
+            sc_stats_add(&screen->stats->skipped_frames, 1);
+        }
         // The SC_EVENT_NEW_FRAME triggered for the previous frame will consume
         // this new frame instead
     } else {
@@ -332,6 +354,7 @@ sc_screen_init(struct sc_screen *screen,
     screen->minimized = false;
     screen->paused = false;
     screen->resume_frame = NULL;
+    screen->refresh_pending = false;
     screen->orientation = SC_ORIENTATION_0;
 
     screen->video = params->video;
@@ -343,6 +366,17 @@ sc_screen_init(struct sc_screen *screen,
     screen->req.fullscreen = params->fullscreen;
     screen->req.start_fps_counter = params->start_fps_counter;
 
+    // The overlay is only available with video
+    screen->stats = params->video ? params->stats : NULL;
+
+    // A sync frame must be requested to resume after discarding packets
+    assert(!params->decoder || params->controller);
+    screen->decoder = params->decoder;
+    screen->screenshot = params->screenshot;
+    atomic_init(&screen->screenshot_burst, false);
+    atomic_init(&screen->push_time, 0);
+    atomic_init(&screen->announced_frame_size, 0);
+
     bool ok = sc_frame_buffer_init(&screen->fb);
     if (!ok) {
         return false;
@@ -352,6 +386,9 @@ sc_screen_init(struct sc_screen *screen,
         goto error_destroy_frame_buffer;
     }
 
+    // The screen is initialized, rendered and destroyed on the main thread
+    screen->perf = sc_perf_thread_register("screen", NULL, "frame");
+
     if (screen->video) {
         screen->orientation = params->orientation;
         if (screen->orientation != SC_ORIENTATION_0) {
@@ -429,6 +466,11 @@ sc_screen_init(struct sc_screen *screen,
         goto error_destroy_display;
     }
 
+    if (screen->stats) {
+        sc_overlay_init(&screen->overlay, screen->display.renderer,
+                        screen->stats);
+    }
+
     struct sc_input_manager_params im_params = {
         .controller = params->controller,
         .fp = params->fp,
@@ -477,6 +519,7 @@ error_destroy_display:
 error_destroy_window:
     SDL_DestroyWindow(screen->window);
 error_destroy_fps_counter:
+    sc_perf_thread_unregister(screen->perf);
     sc_fps_counter_destroy(&screen->fps_counter);
 error_destroy_frame_buffer:
     sc_frame_buffer_destroy(&screen->fb);
@@ -530,11 +573,15 @@ sc_screen_destroy(struct sc_screen *screen) {
 #ifndef NDEBUG
     assert(!screen->open);
 #endif
+    if (screen->stats) {
+        sc_overlay_destroy(&screen->overlay);
+    }
     sc_display_destroy(&screen->display);
     av_frame_free(&screen->frame);
     SDL_DestroyWindow(screen->window);
     sc_fps_counter_destroy(&screen->fps_counter);
     sc_frame_buffer_destroy(&screen->fb);
+    sc_perf_thread_unregister(screen->perf);
 }
 
 static void
@@ -619,6 +666,39 @@ sc_screen_init_size(struct sc_screen *screen) {
     return res != SC_DISPLAY_RESULT_ERROR;
 }
 
+void
+sc_screen_announce_frame_size(struct sc_screen *screen, struct sc_size size) {
+    assert(screen->video);
+
+    uint32_t packed = (uint32_t) size.width << 16 | size.height;
+    // The event acts as a memory barrier
+    atomic_store_explicit(&screen->announced_frame_size, packed,
+                          memory_order_relaxed);
+
+    // Post the event on the UI thread (the texture must be created from there)
+    sc_push_event(SC_EVENT_SCREEN_PREPARE_SIZE);
+}
+
+static void
+sc_screen_prepare_size(struct sc_screen *screen) {
+    assert(screen->video);
+
+    uint32_t packed = atomic_load_explicit(&screen->announced_frame_size,
+                                           memory_order_relaxed);
+    struct sc_size size = {
+        .width = packed >> 16,
+        .height = packed & 0xFFFF,
+    };
+
+    if (size.width == screen->frame_size.width
+            && size.height == screen->frame_size.height) {
+        // The current texture already has this size
+        return;
+    }
+
+    sc_display_prepare_texture(&screen->display, size);
+}
+
 // recreate the texture and resize the window if the frame size has changed
 static enum sc_display_result
 prepare_for_frame(struct sc_screen *screen, struct sc_size new_frame_size) {
@@ -646,6 +726,7 @@ sc_screen_apply_frame(struct sc_screen *screen) {
     assert(screen->video);
 
     sc_fps_counter_add_rendered_frame(&screen->fps_counter);
+    sc_perf_thread_add_item(screen->perf);
 
     AVFrame *frame = screen->frame;
     struct sc_size new_frame_size = {frame->width, frame->height};
@@ -679,6 +760,14 @@ sc_screen_apply_frame(struct sc_screen *screen) {
     }
 
     sc_screen_render(screen, false);
+
+    if (screen->stats) {
+        sc_tick push_time = atomic_load_explicit(&screen->push_time,
+                                                 memory_order_relaxed);
+        sc_stats_add(&screen->stats->presented_frames, 1);
+        sc_stats_add(&screen->stats->present_delay, sc_tick_now() - push_time);
+    }
+
     return true;
 }
 
@@ -686,7 +775,7 @@ static bool
 sc_screen_update_frame(struct sc_screen *screen) {
     assert(screen->video);
 
-    if (screen->paused) {
+    if (screen->paused && !screen->refresh_pending) {
         if (!screen->resume_frame) {
             screen->resume_frame = av_frame_alloc();
             if (!screen->resume_frame) {
@@ -700,11 +789,84 @@ sc_screen_update_frame(struct sc_screen *screen) {
         return true;
     }
 
+    screen->refresh_pending = false;
+
     av_frame_unref(screen->frame);
     sc_frame_buffer_consume(&screen->fb, screen->frame);
+
     return sc_screen_apply_frame(screen);
 }
 
+static void
+sc_screen_request_sync_frame(struct sc_screen *screen) {
+    assert(screen->im.controller);
+
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_REQUEST_SYNC_FRAME;
+
+    if (!sc_controller_push_msg(screen->im.controller, &msg)) {
+        LOGW("Could not request sync frame");
+    }
+}
+
+static void
+sc_screen_send_crop(struct sc_screen *screen, struct sc_point point,
+                    struct sc_size size) {
+    assert(screen->im.controller);
+
+    struct sc_control_msg msg;
+    msg.type = SC_CONTROL_MSG_TYPE_SET_CROP;
+    msg.set_crop.position.point = point;
+    msg.set_crop.position.screen_size = screen->frame_size;
+    msg.set_crop.size = size;
+
+    if (!sc_controller_push_msg(screen->im.controller, &msg)) {
+        LOGW("Could not request video crop");
+    }
+}
+
+void
+sc_screen_crop_to_region(struct sc_screen *screen, int32_t x, int32_t y) {
+    assert(screen->video);
+
+    if (!screen->has_frame) {
+        return;
+    }
+
+    struct sc_size frame_size = screen->frame_size;
+    struct sc_size size = {
+        .width = MAX(frame_size.width / 2, 1),
+        .height = MAX(frame_size.height / 2, 1),
+    };
+
+    // Center the region on the pointer, within the frame. The device streams
+    // the region at its native resolution (within --max-size), so the details
+    // are not downscaled anymore.
+    struct sc_point center =
+        sc_screen_convert_window_to_frame_coords(screen, x, y);
+    struct sc_point point = {
+        .x = CLAMP(center.x - size.width / 2, 0,
+                   frame_size.width - size.width),
+        .y = CLAMP(center.y - size.height / 2, 0,
+                   frame_size.height - size.height),
+    };
+
+    sc_screen_send_crop(screen, point, size);
+}
+
+void
+sc_screen_reset_crop(struct sc_screen *screen) {
+    assert(screen->video);
+
+    if (!screen->has_frame) {
+        return;
+    }
+
+    struct sc_point point = {0, 0};
+    struct sc_size size = {0, 0};
+    sc_screen_send_crop(screen, point, size);
+}
+
 void
 sc_screen_set_paused(struct sc_screen *screen, bool paused) {
     assert(screen->video);
@@ -714,7 +876,18 @@ sc_screen_set_paused(struct sc_screen *screen, bool paused) {
         return;
     }
 
-    if (screen->paused && screen->resume_frame) {
+    if (screen->decoder) {
+        // While paused, only decode the key frames (to update the resume
+        // frame), the other frames would not be displayed anyway
+        sc_decoder_set_discard_non_key(screen->decoder, paused);
+    }
+
+    // If packets have been discarded since the resume frame, then it is the
+    // last key frame, which may be several seconds old: never display it
+    bool outdated = screen->decoder
+                 && !sc_decoder_has_current_frame(screen->decoder);
+
+    if (screen->paused && screen->resume_frame && !outdated) {
         // If display screen was paused, refresh the frame immediately, even if
         // the new state is also paused.
         av_frame_free(&screen->frame);
@@ -723,6 +896,16 @@ sc_screen_set_paused(struct sc_screen *screen, bool paused) {
         sc_screen_apply_frame(screen);
     }
 
+    if (screen->paused && outdated) {
+        // Keep the paused frame until a new key frame is received: request
+        // it now, it comes with the next captured frame. On resume, the
+        // decoder waits for it, and on re-pause, it is displayed as the new
+        // paused frame.
+        av_frame_free(&screen->resume_frame);
+        sc_screen_request_sync_frame(screen);
+        screen->refresh_pending = paused;
+    }
+
     if (!paused) {
         LOGI("Display screen unpaused");
     } else if (!screen->paused) {
@@ -753,6 +936,66 @@ sc_screen_toggle_fullscreen(struct sc_screen *screen) {
     sc_screen_render(screen, true);
 }
 
+void
+sc_screen_toggle_stats_overlay(struct sc_screen *screen) {
+    assert(screen->video);
+
+    if (!screen->stats) {
+        LOGW("Stats overlay not available");
+        return;
+    }
+
+    bool enabled = !sc_overlay_is_enabled(&screen->overlay);
+    if (!sc_overlay_set_enabled(&screen->overlay, enabled)) {
+        LOGE("Could not enable stats overlay");
+        return;
+    }
+
+    LOGI("Stats overlay %s", enabled ? "enabled" : "disabled");
+    if (screen->has_frame) {
+        sc_screen_render(screen, false);
+    }
+}
+
+void
+sc_screen_take_screenshot(struct sc_screen *screen) {
+    assert(screen->video);
+
+    if (!screen->screenshot) {
+        LOGW("Screenshots not available");
+        return;
+    }
+
+    // The frame is still referenced while paused: the screenshot is what is
+    // displayed
+    if (screen->frame->data[0]) {
+#ifdef HAVE_SWSCALE
+        sc_screenshot_capture(screen->screenshot, screen->frame);
+#endif
+    }
+}
+
+void
+sc_screen_set_screenshot_burst(struct sc_screen *screen, bool burst) {
+    assert(screen->video);
+
+    // Only written from the UI thread
+    bool current = atomic_load_explicit(&screen->screenshot_burst,
+                                        memory_order_relaxed);
+    if (burst == current) {
+        return;
+    }
+
+    if (burst && !screen->screenshot) {
+        // sc_screen_take_screenshot() already warned
+        return;
+    }
+
+    atomic_store_explicit(&screen->screenshot_burst, burst,
+                          memory_order_relaxed);
+    LOGD("Screenshot burst %s", burst ? "started" : "stopped");
+}
+
 void
 sc_screen_resize_to_fit(struct sc_screen *screen) {
     assert(screen->video);
@@ -810,6 +1053,9 @@ sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
             }
             return true;
         }
+        case SC_EVENT_SCREEN_PREPARE_SIZE:
+            sc_screen_prepare_size(screen);
+            return true;
         case SC_EVENT_NEW_FRAME: {
             bool ok = sc_screen_update_frame(screen);
             if (!ok) {
@@ -818,6 +1064,12 @@ sc_screen_handle_event(struct sc_screen *screen, const SDL_Event *event) {
             }
             return true;
         }
+        case SC_EVENT_OVERLAY_REFRESH:
+            if (screen->stats && screen->has_frame
+                    && sc_overlay_is_enabled(&screen->overlay)) {
+                sc_screen_render(screen, false);
+            }
+            return true;
         case SDL_WINDOWEVENT:
             if (!screen->video
                     && event->window.event == SDL_WINDOWEVENT_EXPOSED) {
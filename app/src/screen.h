@@ -3,6 +3,7 @@
 
 #include "common.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <SDL2/SDL.h>
@@ -12,16 +13,23 @@
 
 #include "controller.h"
 #include "coords.h"
+#include "decoder.h"
 #include "display.h"
 #include "fps_counter.h"
 #include "frame_buffer.h"
 #include "input_manager.h"
 #include "mouse_capture.h"
 #include "options.h"
+#include "overlay.h"
+#include "perf_counter.h"
+#include "stats.h"
 #include "trait/key_processor.h"
 #include "trait/frame_sink.h"
 #include "trait/mouse_processor.h"
 
+// forward declarations
+struct sc_screenshot;
+
 struct sc_screen {
     struct sc_frame_sink frame_sink; // frame sink trait
 
@@ -36,6 +44,11 @@ struct sc_screen {
     struct sc_mouse_capture mc; // only used in mouse relative mode
     struct sc_frame_buffer fb;
     struct sc_fps_counter fps_counter;
+    struct sc_perf_thread *perf; // main thread performance counters
+    struct sc_overlay overlay; // only initialized if video and stats
+    struct sc_stats *stats; // may be NULL
+    // Time when the last frame has been pushed (only used if stats)
+    atomic_int_least64_t push_time;
 
     // The initial requested window properties
     struct {
@@ -50,6 +63,9 @@ struct sc_screen {
     SDL_Window *window;
     struct sc_size frame_size;
     struct sc_size content_size; // rotated frame_size
+    // Frame size announced by the stream, before the frames of that size are
+    // decoded (width in the 16 most significant bits)
+    atomic_uint_least32_t announced_frame_size;
 
     bool resize_pending; // resize requested while fullscreen or maximized
     // The content size the last time the window was not maximized or
@@ -69,6 +85,18 @@ struct sc_screen {
 
     bool paused;
     AVFrame *resume_frame;
+    // Display the next frame even if paused (to refresh the paused frame)
+    bool refresh_pending;
+
+    // The decoder (if the screen is its only consumer), to skip decoding
+    // while paused (may be NULL)
+    struct sc_decoder *decoder;
+
+    struct sc_screenshot *screenshot; // may be NULL
+    // Capture every decoded frame (while the screenshot shortcut is kept
+    // pressed), from the frame sink, so that the frames skipped for display
+    // are also captured
+    atomic_bool screenshot_burst;
 };
 
 struct sc_screen_params {
@@ -100,6 +128,14 @@ struct sc_screen_params {
 
     bool fullscreen;
     bool start_fps_counter;
+
+    struct sc_stats *stats; // may be NULL
+
+    // If set, the non-key packets are discarded while paused, and a sync
+    // frame is requested on resume (requires a controller)
+    struct sc_decoder *decoder; // may be NULL
+
+    struct sc_screenshot *screenshot; // may be NULL
 };
 
 // initialize screen, create window, renderer and texture (window is hidden)
@@ -147,6 +183,34 @@ sc_screen_set_orientation(struct sc_screen *screen,
 void
 sc_screen_set_paused(struct sc_screen *screen, bool paused);
 
+// request the device to stream only the region of the current video around
+// the given position (in window coordinates), half its size in each dimension
+// (requires a controller)
+void
+sc_screen_crop_to_region(struct sc_screen *screen, int32_t x, int32_t y);
+
+// request the device to stream the full video again (the initial crop)
+// (requires a controller)
+void
+sc_screen_reset_crop(struct sc_screen *screen);
+
+// show or hide the stats overlay
+void
+sc_screen_toggle_stats_overlay(struct sc_screen *screen);
+
+// take a screenshot of the current frame (asynchronously)
+void
+sc_screen_take_screenshot(struct sc_screen *screen);
+
+// start or stop capturing a screenshot of every decoded frame
+void
+sc_screen_set_screenshot_burst(struct sc_screen *screen, bool burst);
+
+// announce the size of the next frames, to prepare the texture before they are
+// decoded (may be called from any thread)
+void
+sc_screen_announce_frame_size(struct sc_screen *screen, struct sc_size size);
+
 // react to SDL events
 // If this function returns false, scrcpy must exit with an error.
 bool
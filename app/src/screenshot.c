@@ -0,0 +1,530 @@
+#include "screenshot.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/crc.h>
+#include <libswscale/swscale.h>
+
+#include "util/binary.h"
+#include "util/log.h"
+
+static const char *
+sc_screenshot_get_extension(enum sc_screenshot_format format) {
+    switch (format) {
+        case SC_SCREENSHOT_FORMAT_PNG:
+            return "png";
+        case SC_SCREENSHOT_FORMAT_JPEG:
+            return "jpg";
+        case SC_SCREENSHOT_FORMAT_WEBP:
+            return "webp";
+        default:
+            assert(!"unexpected screenshot format");
+            return NULL;
+    }
+}
+
+static enum AVCodecID
+sc_screenshot_get_codec_id(enum sc_screenshot_format format) {
+    switch (format) {
+        case SC_SCREENSHOT_FORMAT_PNG:
+            return AV_CODEC_ID_PNG;
+        case SC_SCREENSHOT_FORMAT_JPEG:
+            return AV_CODEC_ID_MJPEG;
+        case SC_SCREENSHOT_FORMAT_WEBP:
+            return AV_CODEC_ID_WEBP;
+        default:
+            assert(!"unexpected screenshot format");
+            return AV_CODEC_ID_NONE;
+    }
+}
+
+static enum AVPixelFormat
+sc_screenshot_get_pix_fmt(enum sc_screenshot_format format) {
+    switch (format) {
+        case SC_SCREENSHOT_FORMAT_PNG:
+            return AV_PIX_FMT_RGB24;
+        case SC_SCREENSHOT_FORMAT_JPEG:
+            // full range, supported by all the versions of the MJPEG encoder
+            return AV_PIX_FMT_YUVJ420P;
+        case SC_SCREENSHOT_FORMAT_WEBP:
+            return AV_PIX_FMT_YUV420P;
+        default:
+            assert(!"unexpected screenshot format");
+            return AV_PIX_FMT_NONE;
+    }
+}
+
+static AVFrame *
+sc_screenshot_convert(struct sc_screenshot *ss, const AVFrame *frame,
+                      enum AVPixelFormat pix_fmt) {
+    AVFrame *converted = av_frame_alloc();
+    if (!converted) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    if (frame->format == pix_fmt) {
+        if (av_frame_ref(converted, frame)) {
+            LOG_OOM();
+            av_frame_free(&converted);
+            return NULL;
+        }
+        return converted;
+    }
+
+    converted->format = pix_fmt;
+    converted->width = frame->width;
+    converted->height = frame->height;
+    if (av_frame_get_buffer(converted, 0) < 0) {
+        LOG_OOM();
+        av_frame_free(&converted);
+        return NULL;
+    }
+
+    ss->sws_ctx = sws_getCachedContext(ss->sws_ctx, frame->width,
+                                       frame->height, frame->format,
+                                       frame->width, frame->height, pix_fmt,
+                                       SWS_BICUBIC, NULL, NULL, NULL);
+    if (!ss->sws_ctx) {
+        LOGE("Screenshot: could not initialize the conversion");
+        av_frame_free(&converted);
+        return NULL;
+    }
+
+    sws_scale(ss->sws_ctx, (const uint8_t *const *) frame->data,
+              frame->linesize, 0, frame->height, converted->data,
+              converted->linesize);
+
+    return converted;
+}
+
+static AVPacket *
+sc_screenshot_encode(struct sc_screenshot *ss, const AVFrame *frame) {
+    enum AVCodecID codec_id = sc_screenshot_get_codec_id(ss->format);
+    const AVCodec *encoder = avcodec_find_encoder(codec_id);
+    if (!encoder) {
+        LOGE("Screenshot: no %s encoder available",
+             sc_screenshot_get_extension(ss->format));
+        return NULL;
+    }
+
+    enum AVPixelFormat pix_fmt = sc_screenshot_get_pix_fmt(ss->format);
+
+    AVCodecContext *ctx = avcodec_alloc_context3(encoder);
+    if (!ctx) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    ctx->width = frame->width;
+    ctx->height = frame->height;
+    ctx->pix_fmt = pix_fmt;
+    ctx->time_base = (AVRational) {1, 1};
+    if (ss->format == SC_SCREENSHOT_FORMAT_JPEG) {
+        // High quality
+        ctx->flags |= AV_CODEC_FLAG_QSCALE;
+        ctx->global_quality = FF_QP2LAMBDA * 2;
+    }
+
+    AVFrame *converted = NULL;
+    AVPacket *packet = NULL;
+
+    if (avcodec_open2(ctx, encoder, NULL) < 0) {
+        LOGE("Screenshot: could not open encoder %s", encoder->name);
+        goto end;
+    }
+
+    converted = sc_screenshot_convert(ss, frame, pix_fmt);
+    if (!converted) {
+        goto end;
+    }
+
+    packet = av_packet_alloc();
+    if (!packet) {
+        LOG_OOM();
+        goto end;
+    }
+
+    int r = avcodec_send_frame(ctx, converted);
+    if (r >= 0) {
+        r = avcodec_receive_packet(ctx, packet);
+    }
+    if (r < 0) {
+        LOGE("Screenshot: could not encode frame: %d", r);
+        av_packet_free(&packet);
+    }
+
+end:
+    av_frame_free(&converted);
+    avcodec_free_context(&ctx);
+
+    return packet;
+}
+
+static bool
+sc_screenshot_write_data(FILE *file, const void *data, size_t len) {
+    return fwrite(data, 1, len, file) == len;
+}
+
+// Insert a tEXt chunk after the IHDR chunk
+static bool
+sc_screenshot_write_png(FILE *file, const uint8_t *data, size_t size,
+                        const char *keyword, const char *text) {
+    // signature (8) + IHDR chunk (4 + 4 + 13 + 4)
+    const size_t ihdr_end = 33;
+    if (size < ihdr_end || memcmp(&data[12], "IHDR", 4)) {
+        LOGE("Screenshot: unexpected PNG data");
+        return false;
+    }
+
+    size_t keyword_len = strlen(keyword);
+    size_t text_len = strlen(text);
+    size_t len = keyword_len + 1 + text_len;
+
+    uint8_t *chunk = malloc(4 + 4 + len + 4);
+    if (!chunk) {
+        LOG_OOM();
+        return false;
+    }
+
+    sc_write32be(chunk, len);
+    memcpy(&chunk[4], "tEXt", 4);
+    memcpy(&chunk[8], keyword, keyword_len + 1); // including '\0'
+    memcpy(&chunk[8 + keyword_len + 1], text, text_len);
+
+    // The CRC covers the chunk type and data
+    const AVCRC *table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    uint32_t crc = av_crc(table, 0xFFFFFFFF, &chunk[4], 4 + len) ^ 0xFFFFFFFF;
+    sc_write32be(&chunk[8 + len], crc);
+
+    bool ok = sc_screenshot_write_data(file, data, ihdr_end)
+           && sc_screenshot_write_data(file, chunk, 4 + 4 + len + 4)
+           && sc_screenshot_write_data(file, &data[ihdr_end],
+                                       size - ihdr_end);
+    free(chunk);
+    return ok;
+}
+
+// Insert a COM segment after the SOI marker
+static bool
+sc_screenshot_write_jpeg(FILE *file, const uint8_t *data, size_t size,
+                         const char *comment) {
+    if (size < 2 || data[0] != 0xFF || data[1] != 0xD8) {
+        LOGE("Screenshot: unexpected JPEG data");
+        return false;
+    }
+
+    size_t len = strlen(comment);
+    assert(len + 2 <= 0xFFFF);
+
+    uint8_t header[4] = {0xFF, 0xFE};
+    sc_write16be(&header[2], len + 2); // the length includes itself
+
+    return sc_screenshot_write_data(file, data, 2)
+        && sc_screenshot_write_data(file, header, sizeof(header))
+        && sc_screenshot_write_data(file, comment, len)
+        && sc_screenshot_write_data(file, &data[2], size - 2);
+}
+
+// Add an XMP chunk (converting to the extended file format if necessary)
+static bool
+sc_screenshot_write_webp(FILE *file, const uint8_t *data, size_t size,
+                         int width, int height, const char *xmp) {
+    // RIFF header (12) + first chunk header (8)
+    if (size < 20 || memcmp(data, "RIFF", 4) || memcmp(&data[8], "WEBP", 4)) {
+        LOGE("Screenshot: unexpected WebP data");
+        return false;
+    }
+
+    size_t xmp_len = strlen(xmp);
+    bool xmp_padding = xmp_len & 1; // chunks are padded to an even size
+    uint8_t xmp_header[8];
+    memcpy(xmp_header, "XMP ", 4);
+    sc_write32le(&xmp_header[4], xmp_len);
+
+    // RIFF header (12) + VP8X chunk (8 + 10)
+    uint8_t header[30];
+    memcpy(header, "RIFFxxxxWEBPVP8X", 16);
+    size_t header_len;
+    const uint8_t *chunks;
+    size_t chunks_len;
+    if (!memcmp(&data[12], "VP8X", 4)) {
+        // Already in the extended format
+        if (size < 30) {
+            LOGE("Screenshot: unexpected WebP data");
+            return false;
+        }
+        memcpy(header, data, 30);
+        header_len = 30;
+        chunks = &data[30];
+        chunks_len = size - 30;
+    } else {
+        // Simple format, add a VP8X chunk
+        sc_write32le(&header[16], 10);
+        memset(&header[20], 0, 4);
+        // The canvas size minus one, on 24 bits
+        uint8_t size_buf[4];
+        sc_write32le(size_buf, width - 1);
+        memcpy(&header[24], size_buf, 3);
+        sc_write32le(size_buf, height - 1);
+        memcpy(&header[27], size_buf, 3);
+        header_len = 30;
+        chunks = &data[12];
+        chunks_len = size - 12;
+    }
+
+    header[20] |= 0x04; // XMP metadata flag
+
+    size_t riff_len = header_len - 8 + chunks_len + sizeof(xmp_header)
+                    + xmp_len + xmp_padding;
+    sc_write32le(&header[4], riff_len);
+
+    static const uint8_t padding = 0;
+    return sc_screenshot_write_data(file, header, header_len)
+        && sc_screenshot_write_data(file, chunks, chunks_len)
+        && sc_screenshot_write_data(file, xmp_header, sizeof(xmp_header))
+        && sc_screenshot_write_data(file, xmp, xmp_len)
+        && (!xmp_padding || sc_screenshot_write_data(file, &padding, 1));
+}
+
+static bool
+sc_screenshot_write(struct sc_screenshot *ss, const char *filename,
+                    const AVPacket *packet, const AVFrame *frame) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        LOGE("Could not open screenshot file: %s", filename);
+        return false;
+    }
+
+    // The device PTS, in microseconds
+    char pts[32];
+    snprintf(pts, sizeof(pts), "%" PRIi64, frame->pts);
+
+    bool ok;
+    switch (ss->format) {
+        case SC_SCREENSHOT_FORMAT_PNG:
+            ok = sc_screenshot_write_png(file, packet->data, packet->size,
+                                         "scrcpy-pts", pts);
+            break;
+        case SC_SCREENSHOT_FORMAT_JPEG: {
+            char comment[48];
+            snprintf(comment, sizeof(comment), "scrcpy-pts=%s", pts);
+            ok = sc_screenshot_write_jpeg(file, packet->data, packet->size,
+                                          comment);
+            break;
+        }
+        case SC_SCREENSHOT_FORMAT_WEBP: {
+            char xmp[256];
+            snprintf(xmp, sizeof(xmp),
+                     "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\">"
+                     "<rdf:RDF xmlns:rdf="
+                     "\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+                     "<rdf:Description xmlns:scrcpy=\"scrcpy\" "
+                     "scrcpy:pts=\"%s\"/>"
+                     "</rdf:RDF></x:xmpmeta>", pts);
+            ok = sc_screenshot_write_webp(file, packet->data, packet->size,
+                                          frame->width, frame->height, xmp);
+            break;
+        }
+        default:
+            assert(!"unexpected screenshot format");
+            ok = false;
+    }
+
+    ok &= !fclose(file);
+    if (!ok) {
+        LOGE("Could not write screenshot file: %s", filename);
+        remove(filename);
+    }
+
+    return ok;
+}
+
+static void
+sc_screenshot_process(struct sc_screenshot *ss, struct sc_screenshot_job *job) {
+    const AVFrame *frame = job->frame;
+
+    char *filename;
+    int r = asprintf(&filename, "%s/scrcpy_%s_%" PRIi64 ".%s", ss->dir,
+                     job->date, frame->pts,
+                     sc_screenshot_get_extension(ss->format));
+    if (r == -1) {
+        LOG_OOM();
+        return;
+    }
+
+    AVPacket *packet = sc_screenshot_encode(ss, frame);
+    if (packet) {
+        if (sc_screenshot_write(ss, filename, packet, frame)) {
+            LOGI("Screenshot saved: %s", filename);
+            ++ss->count;
+        }
+        av_packet_free(&packet);
+    }
+
+    free(filename);
+}
+
+static int
+run_screenshot(void *data) {
+    struct sc_screenshot *ss = data;
+
+    for (;;) {
+        sc_mutex_lock(&ss->mutex);
+
+        while (!ss->stopped && sc_vecdeque_is_empty(&ss->queue)) {
+            sc_cond_wait(&ss->cond, &ss->mutex);
+        }
+
+        // Write the pending screenshots before stopping
+        if (sc_vecdeque_is_empty(&ss->queue)) {
+            assert(ss->stopped);
+            sc_mutex_unlock(&ss->mutex);
+            break;
+        }
+
+        struct sc_screenshot_job job = sc_vecdeque_pop(&ss->queue);
+        sc_mutex_unlock(&ss->mutex);
+
+        sc_screenshot_process(ss, &job);
+        av_frame_free(&job.frame);
+    }
+
+    LOGD("Screenshot thread ended");
+
+    return 0;
+}
+
+bool
+sc_screenshot_init(struct sc_screenshot *ss, const char *dir,
+                   enum sc_screenshot_format format) {
+    ss->dir = strdup(dir);
+    if (!ss->dir) {
+        LOG_OOM();
+        return false;
+    }
+
+    bool ok = sc_mutex_init(&ss->mutex);
+    if (!ok) {
+        goto error_free_dir;
+    }
+
+    ok = sc_cond_init(&ss->cond);
+    if (!ok) {
+        goto error_mutex_destroy;
+    }
+
+    sc_vecdeque_init(&ss->queue);
+    // Never reallocate on capture
+    ok = sc_vecdeque_reserve(&ss->queue, SC_SCREENSHOT_QUEUE_SIZE);
+    if (!ok) {
+        LOG_OOM();
+        goto error_cond_destroy;
+    }
+
+    ss->format = format;
+    ss->stopped = false;
+    ss->dropped = 0;
+    ss->sws_ctx = NULL;
+    ss->count = 0;
+
+    return true;
+
+error_cond_destroy:
+    sc_cond_destroy(&ss->cond);
+error_mutex_destroy:
+    sc_mutex_destroy(&ss->mutex);
+error_free_dir:
+    free(ss->dir);
+
+    return false;
+}
+
+bool
+sc_screenshot_start(struct sc_screenshot *ss) {
+    LOGD("Starting screenshot thread");
+    bool ok = sc_thread_create(&ss->thread, run_screenshot, "scrcpy-shot",
+                               ss);
+    if (!ok) {
+        LOGE("Could not start screenshot thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_screenshot_stop(struct sc_screenshot *ss) {
+    sc_mutex_lock(&ss->mutex);
+    ss->stopped = true;
+    sc_cond_signal(&ss->cond);
+    sc_mutex_unlock(&ss->mutex);
+}
+
+void
+sc_screenshot_join(struct sc_screenshot *ss) {
+    sc_thread_join(&ss->thread, NULL);
+}
+
+void
+sc_screenshot_destroy(struct sc_screenshot *ss) {
+    while (!sc_vecdeque_is_empty(&ss->queue)) {
+        struct sc_screenshot_job job = sc_vecdeque_pop(&ss->queue);
+        av_frame_free(&job.frame);
+    }
+    sc_vecdeque_destroy(&ss->queue);
+
+    if (ss->dropped) {
+        LOGW("%" PRIu64 " screenshots dropped", ss->dropped);
+    }
+
+    sws_freeContext(ss->sws_ctx);
+    sc_cond_destroy(&ss->cond);
+    sc_mutex_destroy(&ss->mutex);
+    free(ss->dir);
+}
+
+bool
+sc_screenshot_capture(struct sc_screenshot *ss, const AVFrame *frame) {
+    struct sc_screenshot_job job;
+
+    // Only a reference, the frame data is not copied
+    job.frame = av_frame_clone(frame);
+    if (!job.frame) {
+        LOG_OOM();
+        return false;
+    }
+
+    // Several threads may capture (the UI thread for a single screenshot, the
+    // decoder thread during a burst): the mutex also protects the static
+    // buffer returned by localtime()
+    sc_mutex_lock(&ss->mutex);
+    bool full = sc_vecdeque_size(&ss->queue) == SC_SCREENSHOT_QUEUE_SIZE;
+    if (full) {
+        bool first_drop = !ss->dropped++;
+        sc_mutex_unlock(&ss->mutex);
+
+        if (first_drop) {
+            LOGW("Too many pending screenshots, dropped");
+        }
+        av_frame_free(&job.frame);
+        return false;
+    }
+
+    time_t now = time(NULL);
+    struct tm *tm = localtime(&now);
+    if (!tm || !strftime(job.date, sizeof(job.date), "%Y%m%d-%H%M%S", tm)) {
+        strcpy(job.date, "unknown");
+    }
+
+    sc_vecdeque_push_noresize(&ss->queue, job);
+    sc_cond_signal(&ss->cond);
+    sc_mutex_unlock(&ss->mutex);
+
+    return true;
+}
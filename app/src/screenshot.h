@@ -0,0 +1,78 @@
+#ifndef SC_SCREENSHOT_H
+#define SC_SCREENSHOT_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libavutil/frame.h>
+
+#include "options.h"
+#include "util/thread.h"
+#include "util/vecdeque.h"
+
+// Maximum number of screenshots waiting to be encoded (during a burst)
+#define SC_SCREENSHOT_QUEUE_SIZE 16
+
+struct sc_screenshot_job {
+    AVFrame *frame; // a reference to the captured frame
+    char date[32]; // local date of the capture, formatted for a filename
+};
+
+struct sc_screenshot_queue SC_VECDEQUE(struct sc_screenshot_job);
+
+/**
+ * Screenshot writer
+ *
+ * The captured frames are only referenced (not copied) by
+ * sc_screenshot_capture(), which never blocks. They are converted, encoded
+ * and written to files on a separate thread.
+ *
+ * The device PTS of the frame is written in the file metadata.
+ */
+struct sc_screenshot {
+    char *dir;
+    enum sc_screenshot_format format;
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool stopped;
+    struct sc_screenshot_queue queue;
+    uint64_t dropped;
+
+    // accessed only from the screenshot thread
+    struct SwsContext *sws_ctx;
+    unsigned count;
+};
+
+bool
+sc_screenshot_init(struct sc_screenshot *ss, const char *dir,
+                   enum sc_screenshot_format format);
+
+bool
+sc_screenshot_start(struct sc_screenshot *ss);
+
+// The pending screenshots are written before the thread terminates
+void
+sc_screenshot_stop(struct sc_screenshot *ss);
+
+void
+sc_screenshot_join(struct sc_screenshot *ss);
+
+void
+sc_screenshot_destroy(struct sc_screenshot *ss);
+
+/**
+ * Request a screenshot of the frame
+ *
+ * It may be called from several threads.
+ *
+ * The frame is referenced, it may be unreferenced by the caller as soon as
+ * this function returns. Return false if the screenshot is dropped (the queue
+ * is full).
+ */
+bool
+sc_screenshot_capture(struct sc_screenshot *ss, const AVFrame *frame);
+
+#endif
@@ -0,0 +1,21 @@
+#include "stats.h"
+
+void
+sc_stats_init(struct sc_stats *stats, sc_tick video_buffer) {
+    atomic_init(&stats->video_bytes, 0);
+    atomic_init(&stats->decoded_frames, 0);
+    atomic_init(&stats->decode_time, 0);
+    atomic_init(&stats->receive_delay, 0);
+    atomic_init(&stats->receive_delay_count, 0);
+    atomic_init(&stats->input_frames, 0);
+    atomic_init(&stats->skipped_frames, 0);
+    atomic_init(&stats->presented_frames, 0);
+    atomic_init(&stats->present_delay, 0);
+    atomic_init(&stats->audio_buffering, 0);
+    atomic_init(&stats->audio_underflows, 0);
+    atomic_init(&stats->audio_target, 0);
+    atomic_init(&stats->audio_target_reason, 0);
+    atomic_init(&stats->reconnections, 0);
+    atomic_init(&stats->recovery_time, 0);
+    stats->video_buffer = video_buffer;
+}
@@ -0,0 +1,62 @@
+#ifndef SC_STATS_H
+#define SC_STATS_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "util/tick.h"
+
+/**
+ * Stream statistics
+ *
+ * The counters are updated by the pipeline components from their own threads,
+ * and read periodically by the overlay. They are cumulative: the reader
+ * computes the rates from the difference between two snapshots.
+ */
+struct sc_stats {
+    // Updated by the video decoder
+    atomic_uint_least64_t video_bytes;
+    atomic_uint_least64_t decoded_frames;
+    atomic_uint_least64_t decode_time; // in ticks
+    // Delay between the packet reception (socket) and the decoded frame
+    atomic_uint_least64_t receive_delay; // in ticks
+    atomic_uint_least64_t receive_delay_count;
+
+    // Updated by the screen
+    atomic_uint_least64_t input_frames;
+    atomic_uint_least64_t skipped_frames;
+    atomic_uint_least64_t presented_frames;
+    // Delay between the frame submitted to the screen and its presentation
+    atomic_uint_least64_t present_delay; // in ticks
+
+    // Updated by the audio regulator
+    atomic_uint_least32_t audio_buffering; // current value, in ticks
+    atomic_uint_least64_t audio_underflows;
+    atomic_uint_least32_t audio_target; // current value, in ticks
+    atomic_int audio_target_reason; // enum sc_audio_tuner_reason
+
+    // Updated on automatic reconnection
+    atomic_uint_least64_t reconnections;
+    // Time between the last disconnection and the reconnection
+    atomic_uint_least64_t recovery_time; // in ticks
+
+    // Constant
+    sc_tick video_buffer;
+};
+
+void
+sc_stats_init(struct sc_stats *stats, sc_tick video_buffer);
+
+static inline void
+sc_stats_add(atomic_uint_least64_t *counter, uint64_t value) {
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+static inline uint64_t
+sc_stats_get(atomic_uint_least64_t *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "util/file.h"
 
+#include <errno.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -94,3 +95,11 @@ sc_file_is_regular(const char *path) {
     return S_ISREG(path_stat.st_mode);
 }
 
+bool
+sc_file_mkdir(const char *path) {
+    if (mkdir(path, 0755) && errno != EEXIST) {
+        LOGE("Could not create directory \"%s\": %s", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
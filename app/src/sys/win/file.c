@@ -2,6 +2,8 @@
 
 #include <windows.h>
 
+#include <direct.h>
+#include <errno.h>
 #include <sys/stat.h>
 
 #include "util/log.h"
@@ -41,3 +43,20 @@ sc_file_is_regular(const char *path) {
     return S_ISREG(path_stat.st_mode);
 }
 
+bool
+sc_file_mkdir(const char *path) {
+    wchar_t *wide_path = sc_str_to_wchars(path);
+    if (!wide_path) {
+        LOG_OOM();
+        return false;
+    }
+
+    int r = _wmkdir(wide_path);
+    free(wide_path);
+
+    if (r && errno != EEXIST) {
+        LOGE("Could not create directory \"%s\"", path);
+        return false;
+    }
+    return true;
+}
@@ -3,8 +3,29 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "util/env.h"
 #include "util/log.h"
 
+static char *
+sc_file_join(const char *dir, const char *name) {
+    size_t dirlen = strlen(dir);
+    size_t namelen = strlen(name);
+
+    size_t len = dirlen + namelen + 2; // +2: '/' and '\0'
+    char *file_path = malloc(len);
+    if (!file_path) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    memcpy(file_path, dir, dirlen);
+    file_path[dirlen] = SC_PATH_SEPARATOR;
+    // namelen + 1 to copy the final '\0'
+    memcpy(&file_path[dirlen + 1], name, namelen + 1);
+
+    return file_path;
+}
+
 char *
 sc_file_get_local_path(const char *name) {
     char *executable_path = sc_file_get_executable_path();
@@ -24,25 +45,62 @@ sc_file_get_local_path(const char *name) {
     }
 
     *p = '\0'; // modify executable_path in place
-    char *dir = executable_path;
-    size_t dirlen = strlen(dir);
-    size_t namelen = strlen(name);
+    char *file_path = sc_file_join(executable_path, name);
+    free(executable_path);
 
-    size_t len = dirlen + namelen + 2; // +2: '/' and '\0'
-    char *file_path = malloc(len);
-    if (!file_path) {
-        LOG_OOM();
-        free(executable_path);
+    return file_path;
+}
+
+char *
+sc_file_get_cache_path(const char *name) {
+#ifdef _WIN32
+    char *base = sc_get_env("LOCALAPPDATA");
+    const char *suffix = NULL;
+#elif defined(__APPLE__)
+    char *base = sc_get_env("HOME");
+    const char *suffix = "Library/Caches";
+#else
+    const char *suffix = NULL;
+    char *base = sc_get_env("XDG_CACHE_HOME");
+    if (!base || !*base) {
+        free(base);
+        base = sc_get_env("HOME");
+        suffix = ".cache";
+    }
+#endif
+    if (!base || !*base) {
+        LOGW("Could not determine the cache directory");
+        free(base);
         return NULL;
     }
 
-    memcpy(file_path, dir, dirlen);
-    file_path[dirlen] = SC_PATH_SEPARATOR;
-    // namelen + 1 to copy the final '\0'
-    memcpy(&file_path[dirlen + 1], name, namelen + 1);
+    if (suffix) {
+        char *dir = sc_file_join(base, suffix);
+        free(base);
+        if (!dir) {
+            return NULL;
+        }
+        base = dir;
+        // The parent directory may not exist yet
+        if (!sc_file_mkdir(base)) {
+            free(base);
+            return NULL;
+        }
+    }
 
-    free(executable_path);
+    char *dir = sc_file_join(base, "scrcpy");
+    free(base);
+    if (!dir) {
+        return NULL;
+    }
+
+    if (!sc_file_mkdir(dir)) {
+        free(dir);
+        return NULL;
+    }
+
+    char *file_path = sc_file_join(dir, name);
+    free(dir);
 
     return file_path;
 }
-
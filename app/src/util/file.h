@@ -40,10 +40,29 @@ sc_file_get_executable_path(void);
 char *
 sc_file_get_local_path(const char *name);
 
+/**
+ * Return the absolute path of a file in the scrcpy cache directory, which is
+ * created if necessary:
+ *  - $XDG_CACHE_HOME/scrcpy (or ~/.cache/scrcpy) on Linux
+ *  - ~/Library/Caches/scrcpy on macOS
+ *  - %LOCALAPPDATA%\scrcpy on Windows
+ *
+ * The result must be freed by the caller using free(). It may return NULL on
+ * error.
+ */
+char *
+sc_file_get_cache_path(const char *name);
+
 /**
  * Indicate if the file exists and is not a directory
  */
 bool
 sc_file_is_regular(const char *path);
 
+/**
+ * Create a directory (succeed if it already exists)
+ */
+bool
+sc_file_mkdir(const char *path);
+
 #endif
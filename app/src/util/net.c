@@ -1,6 +1,7 @@
 #include "net.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -12,17 +13,40 @@
 # include <fcntl.h>
 # include <netinet/in.h>
 # include <netinet/tcp.h>
+# include <string.h>
 # include <unistd.h>
 # include <sys/socket.h>
+# include <sys/stat.h>
+# include <sys/time.h>
 # include <sys/types.h>
+# include <sys/uio.h>
+# include <sys/un.h>
 # define SOCKET_ERROR -1
   typedef struct sockaddr_in SOCKADDR_IN;
   typedef struct sockaddr SOCKADDR;
   typedef struct in_addr IN_ADDR;
+# ifdef SO_TIMESTAMPNS
+   // Linux: nanosecond precision
+#  define SC_SO_TIMESTAMP SO_TIMESTAMPNS
+#  define SC_SCM_TIMESTAMP SCM_TIMESTAMPNS
+#  define SC_HAS_RECV_TIMESTAMPS
+# elif defined(SO_TIMESTAMP)
+   // BSD/macOS: microsecond precision
+#  define SC_SO_TIMESTAMP SO_TIMESTAMP
+#  define SC_SCM_TIMESTAMP SCM_TIMESTAMP
+#  define SC_HAS_RECV_TIMESTAMPS
+# endif
 #endif
 
 #include "util/log.h"
 
+#ifdef MSG_NOSIGNAL
+// Do not raise SIGPIPE if the peer has closed the connection
+# define SC_SEND_FLAGS MSG_NOSIGNAL
+#else
+# define SC_SEND_FLAGS 0
+#endif
+
 bool
 net_init(void) {
 #ifdef _WIN32
@@ -54,6 +78,15 @@ sc_raw_socket_close(sc_raw_socket raw_sock) {
 
 static inline sc_socket
 wrap(sc_raw_socket sock) {
+#ifdef SO_NOSIGPIPE
+    // MSG_NOSIGNAL is not available on macOS, SIGPIPE must be disabled for
+    // the socket
+    if (sock != SC_RAW_SOCKET_NONE) {
+        int value = 1;
+        setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &value, sizeof(value));
+    }
+#endif
+
 #ifdef SC_SOCKET_CLOSE_ON_INTERRUPT
     if (sock == SC_RAW_SOCKET_NONE) {
         return SC_SOCKET_NONE;
@@ -203,6 +236,88 @@ net_accept(sc_socket server_socket) {
     return wrap(raw_sock);
 }
 
+#ifdef SC_NET_HAS_UNIX_SOCKETS
+sc_socket
+net_socket_unix(void) {
+# ifdef HAVE_SOCK_CLOEXEC
+    sc_raw_socket raw_sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+# else
+    sc_raw_socket raw_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (raw_sock != SC_RAW_SOCKET_NONE && !set_cloexec_flag(raw_sock)) {
+        sc_raw_socket_close(raw_sock);
+        return SC_SOCKET_NONE;
+    }
+# endif
+
+    sc_socket sock = wrap(raw_sock);
+    if (sock == SC_SOCKET_NONE) {
+        net_perror("socket");
+    }
+    return sock;
+}
+
+static bool
+net_init_sockaddr_un(struct sockaddr_un *addr, const char *path) {
+    size_t len = strlen(path);
+    if (len >= sizeof(addr->sun_path)) {
+        LOGE("Unix socket path too long (max %u): %s",
+             (unsigned) sizeof(addr->sun_path) - 1, path);
+        return false;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, len + 1);
+    return true;
+}
+
+bool
+net_connect_unix(sc_socket socket, const char *path) {
+    sc_raw_socket raw_sock = unwrap(socket);
+
+    struct sockaddr_un addr;
+    if (!net_init_sockaddr_un(&addr, path)) {
+        return false;
+    }
+
+    if (connect(raw_sock, (SOCKADDR *) &addr, sizeof(addr)) == SOCKET_ERROR) {
+        net_perror("connect");
+        return false;
+    }
+
+    return true;
+}
+
+bool
+net_listen_unix(sc_socket server_socket, const char *path, int backlog) {
+    sc_raw_socket raw_sock = unwrap(server_socket);
+
+    struct sockaddr_un addr;
+    if (!net_init_sockaddr_un(&addr, path)) {
+        return false;
+    }
+
+    // The socket file is created by bind(): restrict its permissions from the
+    // start, so that no other user may connect before it could be changed
+    mode_t old_mask = umask(S_IRWXG | S_IRWXO);
+    int r = bind(raw_sock, (SOCKADDR *) &addr, sizeof(addr));
+    umask(old_mask);
+    if (r == SOCKET_ERROR) {
+        net_perror("bind");
+        return false;
+    }
+
+    if (listen(raw_sock, backlog) == SOCKET_ERROR) {
+        net_perror("listen");
+        // The socket file has been created by bind()
+        unlink(path);
+        return false;
+    }
+
+    return true;
+}
+#endif
+
 ssize_t
 net_recv(sc_socket socket, void *buf, size_t len) {
     sc_raw_socket raw_sock = unwrap(socket);
@@ -215,11 +330,80 @@ net_recv_all(sc_socket socket, void *buf, size_t len) {
     return recv(raw_sock, buf, len, MSG_WAITALL);
 }
 
+#ifdef SC_HAS_RECV_TIMESTAMPS
+static int64_t
+net_read_recv_timestamp(struct msghdr *msg) {
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg;
+            cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET
+                || cmsg->cmsg_type != SC_SCM_TIMESTAMP) {
+            continue;
+        }
+
+# ifdef SO_TIMESTAMPNS
+        struct timespec ts;
+        memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+        return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+# else
+        struct timeval tv;
+        memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+        return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+# endif
+    }
+
+    return -1;
+}
+#endif
+
+ssize_t
+net_recv_all_timestamped(sc_socket socket, void *buf, size_t len,
+                         int64_t *timestamp) {
+#ifdef SC_HAS_RECV_TIMESTAMPS
+    sc_raw_socket raw_sock = unwrap(socket);
+
+    struct iovec iov = {
+        .iov_base = buf,
+        .iov_len = len,
+    };
+
+    union {
+        char buf[CMSG_SPACE(sizeof(struct timespec))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+
+    ssize_t r = recvmsg(raw_sock, &msg, MSG_WAITALL);
+    *timestamp = r > 0 ? net_read_recv_timestamp(&msg) : -1;
+    return r;
+#else
+    *timestamp = -1;
+    return net_recv_all(socket, buf, len);
+#endif
+}
+
 ssize_t
 net_send(sc_socket socket, const void *buf, size_t len) {
     sc_raw_socket raw_sock = unwrap(socket);
-    return send(raw_sock, buf, len, 0);
+    return send(raw_sock, buf, len, SC_SEND_FLAGS);
+}
+
+#ifdef SC_NET_HAS_SEND_NONBLOCKING
+ssize_t
+net_send_nonblocking(sc_socket socket, const void *buf, size_t len) {
+    sc_raw_socket raw_sock = unwrap(socket);
+    ssize_t w = send(raw_sock, buf, len, MSG_DONTWAIT | SC_SEND_FLAGS);
+    if (w == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+    }
+    return w;
 }
+#endif
 
 ssize_t
 net_send_all(sc_socket socket, const void *buf, size_t len) {
@@ -284,6 +468,28 @@ net_set_tcp_nodelay(sc_socket socket, bool tcp_nodelay) {
     return true;
 }
 
+bool
+net_set_recv_timestamps(sc_socket socket, bool enable) {
+#ifdef SC_HAS_RECV_TIMESTAMPS
+    sc_raw_socket raw_sock = unwrap(socket);
+
+    int value = enable ? 1 : 0;
+    int ret = setsockopt(raw_sock, SOL_SOCKET, SC_SO_TIMESTAMP,
+                         (const void *) &value, sizeof(value));
+    if (ret == -1) {
+        net_perror("setsockopt(SO_TIMESTAMP)");
+        return false;
+    }
+
+    assert(ret == 0);
+    return true;
+#else
+    (void) socket;
+    (void) enable;
+    return false;
+#endif
+}
+
 bool
 net_parse_ipv4(const char *s, uint32_t *ipv4) {
     struct in_addr addr;
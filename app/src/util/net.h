@@ -60,6 +60,21 @@ net_listen(sc_socket server_socket, uint32_t addr, uint16_t port, int backlog);
 sc_socket
 net_accept(sc_socket server_socket);
 
+#ifndef _WIN32
+# define SC_NET_HAS_UNIX_SOCKETS
+// Create a Unix domain stream socket (to be used with the _unix functions)
+sc_socket
+net_socket_unix(void);
+
+bool
+net_connect_unix(sc_socket socket, const char *path);
+
+// The socket file must not exist (it is not removed on close, but it is
+// removed on error). It is only accessible by the current user.
+bool
+net_listen_unix(sc_socket server_socket, const char *path, int backlog);
+#endif
+
 // the _all versions wait/retry until len bytes have been written/read
 ssize_t
 net_recv(sc_socket socket, void *buf, size_t len);
@@ -73,6 +88,27 @@ net_send(sc_socket socket, const void *buf, size_t len);
 ssize_t
 net_send_all(sc_socket socket, const void *buf, size_t len);
 
+#ifndef _WIN32
+# define SC_NET_HAS_SEND_NONBLOCKING
+// Send without blocking (even if the socket is in blocking mode)
+//
+// Return the number of bytes written (possibly less than len), 0 if the
+// socket send buffer is full, or -1 on error.
+ssize_t
+net_send_nonblocking(sc_socket socket, const void *buf, size_t len);
+#endif
+
+// Like net_recv_all(), but also retrieve the kernel receive timestamp (the
+// wall clock time, in microseconds since the Unix epoch), or -1 if it is not
+// available.
+//
+// The timestamps must have been enabled by net_set_recv_timestamps(). For a
+// stream socket, the timestamp is the arrival time of the last segment read,
+// so it is the arrival time of the first byte if len is small (e.g. a header).
+ssize_t
+net_recv_all_timestamped(sc_socket socket, void *buf, size_t len,
+                         int64_t *timestamp);
+
 // Shutdown the socket (or close on Windows) so that any blocking send() or
 // recv() are interrupted.
 bool
@@ -87,6 +123,11 @@ net_close(sc_socket socket);
 bool
 net_set_tcp_nodelay(sc_socket socket, bool tcp_nodelay);
 
+// Enable kernel receive timestamps (SO_TIMESTAMPNS or SO_TIMESTAMP)
+// Return false if they are not supported
+bool
+net_set_recv_timestamps(sc_socket socket, bool enable);
+
 /**
  * Parse `ip` "xxx.xxx.xxx.xxx" to an IPv4 host representation
  */
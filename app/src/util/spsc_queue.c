@@ -0,0 +1,168 @@
+#include "spsc_queue.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "util/log.h"
+
+static struct sc_spsc_segment *
+sc_spsc_segment_new(uint32_t capacity, uint32_t start) {
+    assert(capacity && !(capacity & (capacity - 1)));
+
+    struct sc_spsc_segment *segment =
+        malloc(sizeof(*segment) + capacity * sizeof(segment->items[0]));
+    if (!segment) {
+        LOG_OOM();
+        return NULL;
+    }
+
+    atomic_init(&segment->next, NULL);
+    segment->start = start;
+    segment->mask = capacity - 1;
+    return segment;
+}
+
+bool
+sc_spsc_queue_init(struct sc_spsc_queue *queue, uint32_t capacity) {
+    struct sc_spsc_segment *segment = sc_spsc_segment_new(capacity, 0);
+    if (!segment) {
+        return false;
+    }
+
+    queue->write_segment = segment;
+    queue->read_segment = segment;
+    atomic_init(&queue->spare, NULL);
+    atomic_init(&queue->pushed, 0);
+    atomic_init(&queue->popped, 0);
+
+    return true;
+}
+
+void
+sc_spsc_queue_destroy(struct sc_spsc_queue *queue) {
+    struct sc_spsc_segment *segment = queue->read_segment;
+    while (segment) {
+        struct sc_spsc_segment *next =
+            atomic_load_explicit(&segment->next, memory_order_relaxed);
+        free(segment);
+        segment = next;
+    }
+
+    free(atomic_load_explicit(&queue->spare, memory_order_relaxed));
+}
+
+bool
+sc_spsc_queue_push(struct sc_spsc_queue *queue, void *item) {
+    assert(item);
+
+    struct sc_spsc_segment *segment = queue->write_segment;
+
+    // Only the producer writes pushed
+    uint32_t pushed =
+        atomic_load_explicit(&queue->pushed, memory_order_relaxed);
+    // The consumer releases a slot after reading its item
+    uint32_t popped =
+        atomic_load_explicit(&queue->popped, memory_order_acquire);
+
+    // If the consumer is still reading a previous segment, the whole current
+    // segment is available from its start
+    uint32_t first = (int32_t) (popped - segment->start) > 0 ? popped
+                                                             : segment->start;
+    uint32_t capacity = segment->mask + 1;
+    if (pushed - first == capacity) {
+        // The segment is full, continue in a new one (the consumer will
+        // release this one once it has read all its items)
+        struct sc_spsc_segment *next =
+            atomic_exchange_explicit(&queue->spare, NULL,
+                                     memory_order_acquire);
+        if (next && next->mask < capacity) {
+            // Allocated for a previous segment
+            free(next);
+            next = NULL;
+        }
+
+        if (next) {
+            next->start = pushed;
+        } else {
+            // The consumer did not allocate it in advance
+            next = sc_spsc_segment_new(capacity * 2, pushed);
+            if (!next) {
+                return false;
+            }
+        }
+
+        atomic_store_explicit(&segment->next, next, memory_order_release);
+        queue->write_segment = next;
+        segment = next;
+    }
+
+    segment->items[(pushed - segment->start) & segment->mask] = item;
+
+    // Publish the item
+    atomic_store_explicit(&queue->pushed, pushed + 1, memory_order_release);
+    return true;
+}
+
+// Allocate the next segment in advance (from the consumer thread) if the
+// queue is filled beyond its high-water mark
+static void
+sc_spsc_queue_prepare_growth(struct sc_spsc_queue *queue, uint32_t size) {
+    if (atomic_load_explicit(&queue->spare, memory_order_relaxed)) {
+        // Already allocated (only the consumer sets it)
+        return;
+    }
+
+    // The capacity of a segment never changes once linked, so the last one
+    // (the one written by the producer) may be read from here
+    struct sc_spsc_segment *last = queue->read_segment;
+    struct sc_spsc_segment *next;
+    while ((next = atomic_load_explicit(&last->next, memory_order_acquire))) {
+        last = next;
+    }
+
+    uint32_t capacity = last->mask + 1;
+    if (size < capacity / 4 * 3) {
+        return;
+    }
+
+    // The start is set by the producer once it uses it
+    struct sc_spsc_segment *spare = sc_spsc_segment_new(capacity * 2, 0);
+    if (spare) {
+        atomic_store_explicit(&queue->spare, spare, memory_order_release);
+    }
+    // else the producer will try to allocate it if necessary
+}
+
+void *
+sc_spsc_queue_pop(struct sc_spsc_queue *queue) {
+    // Only the consumer writes popped
+    uint32_t popped =
+        atomic_load_explicit(&queue->popped, memory_order_relaxed);
+    uint32_t pushed =
+        atomic_load_explicit(&queue->pushed, memory_order_acquire);
+    if (popped == pushed) {
+        return NULL;
+    }
+
+    struct sc_spsc_segment *segment = queue->read_segment;
+    // The next segment is linked before its first item is published
+    struct sc_spsc_segment *next =
+        atomic_load_explicit(&segment->next, memory_order_acquire);
+    while (next && popped == next->start) {
+        // All the items of the segment have been read, and the producer only
+        // writes to the next ones
+        free(segment);
+        segment = next;
+        next = atomic_load_explicit(&segment->next, memory_order_acquire);
+    }
+    queue->read_segment = segment;
+
+    void *item = segment->items[(popped - segment->start) & segment->mask];
+
+    // Release the slot
+    atomic_store_explicit(&queue->popped, popped + 1, memory_order_release);
+
+    sc_spsc_queue_prepare_growth(queue, pushed - popped - 1);
+
+    return item;
+}
@@ -0,0 +1,88 @@
+#ifndef SC_SPSC_QUEUE_H
+#define SC_SPSC_QUEUE_H
+
+#include "common.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Lock-free single-producer single-consumer queue of pointers
+ *
+ * The items are stored in a ring of preallocated capacity. If it is full, the
+ * producer links a new ring (twice larger) and continues in it, while the
+ * consumer finishes reading the previous one and then releases it. Therefore,
+ * the queue is unbounded, and the allocations only happen when it grows beyond
+ * its largest size so far.
+ *
+ * To keep the allocations off the producer thread, the consumer allocates the
+ * next ring in advance, once the queue is filled beyond a high-water mark
+ * (3/4 of the capacity). The producer only allocates it itself if the consumer
+ * did not pop any item since the queue passed that mark.
+ *
+ * The items must not be NULL.
+ */
+struct sc_spsc_segment {
+    _Atomic(struct sc_spsc_segment *) next;
+    uint32_t start; // index (in the whole queue) of the first item written
+    uint32_t mask; // capacity - 1
+    void *items[];
+};
+
+struct sc_spsc_queue {
+    // Only accessed by the producer
+    struct sc_spsc_segment *write_segment;
+    // Only accessed by the consumer
+    struct sc_spsc_segment *read_segment;
+
+    // Next segment allocated in advance by the consumer, taken by the
+    // producer when its segment is full
+    _Atomic(struct sc_spsc_segment *) spare;
+
+    // Number of items pushed and popped since the beginning (wrapping), each
+    // one written by a single side
+    atomic_uint_least32_t pushed;
+    atomic_uint_least32_t popped;
+};
+
+// The initial capacity must be a power of 2
+bool
+sc_spsc_queue_init(struct sc_spsc_queue *queue, uint32_t capacity);
+
+// The remaining items (if any) are not freed
+void
+sc_spsc_queue_destroy(struct sc_spsc_queue *queue);
+
+/**
+ * Push an item (from the producer thread)
+ *
+ * Return false on allocation failure (only if the queue must grow).
+ */
+bool
+sc_spsc_queue_push(struct sc_spsc_queue *queue, void *item);
+
+/**
+ * Pop an item (from the consumer thread)
+ *
+ * Return NULL if the queue is empty.
+ */
+void *
+sc_spsc_queue_pop(struct sc_spsc_queue *queue);
+
+// May be called from the producer or the consumer thread
+static inline uint32_t
+sc_spsc_queue_size(struct sc_spsc_queue *queue) {
+    uint32_t pushed =
+        atomic_load_explicit(&queue->pushed, memory_order_acquire);
+    uint32_t popped =
+        atomic_load_explicit(&queue->popped, memory_order_acquire);
+    return pushed - popped;
+}
+
+static inline bool
+sc_spsc_queue_is_empty(struct sc_spsc_queue *queue) {
+    return !sc_spsc_queue_size(queue);
+}
+
+#endif
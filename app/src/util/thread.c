@@ -167,9 +167,25 @@ sc_cond_wait(sc_cond *cond, sc_mutex *mutex) {
 #endif
 }
 
-bool
-sc_cond_timedwait(sc_cond *cond, sc_mutex *mutex, sc_tick deadline) {
-    sc_tick now = sc_tick_now();
+#ifdef SC_TEST
+static sc_cond_timedwait_fn *sc_cond_timedwait_impl;
+static void *sc_cond_timedwait_userdata;
+
+void
+sc_cond_set_timedwait(sc_cond_timedwait_fn *fn, void *userdata) {
+    sc_cond_timedwait_impl = fn;
+    sc_cond_timedwait_userdata = userdata;
+}
+
+// The default implementation always waits on the system clock
+# define sc_cond_now sc_tick_now_system
+#else
+# define sc_cond_now sc_tick_now
+#endif
+
+static bool
+sc_cond_timedwait_default(sc_cond *cond, sc_mutex *mutex, sc_tick deadline) {
+    sc_tick now = sc_cond_now();
     if (deadline <= now) {
         return false; // timeout
     }
@@ -189,10 +205,29 @@ sc_cond_timedwait(sc_cond *cond, sc_mutex *mutex, sc_tick deadline) {
 #endif
     assert(r == 0 || r == SDL_MUTEX_TIMEDOUT);
     // The deadline is reached on timeout
-    assert(r != SDL_MUTEX_TIMEDOUT || sc_tick_now() >= deadline);
+    assert(r != SDL_MUTEX_TIMEDOUT || sc_cond_now() >= deadline);
     return r == 0;
 }
 
+#ifdef SC_TEST
+bool
+sc_cond_timedwait_system(sc_cond *cond, sc_mutex *mutex, sc_tick deadline) {
+    return sc_cond_timedwait_default(cond, mutex, deadline);
+}
+#endif
+
+bool
+sc_cond_timedwait(sc_cond *cond, sc_mutex *mutex, sc_tick deadline) {
+#ifdef SC_TEST
+    if (sc_cond_timedwait_impl) {
+        return sc_cond_timedwait_impl(cond, mutex, deadline,
+                                      sc_cond_timedwait_userdata);
+    }
+#endif
+
+    return sc_cond_timedwait_default(cond, mutex, deadline);
+}
+
 void
 sc_cond_signal(sc_cond *cond) {
     int r = SDL_CondSignal(cond->cond);
@@ -87,6 +87,23 @@ sc_cond_wait(sc_cond *cond, sc_mutex *mutex);
 bool
 sc_cond_timedwait(sc_cond *cond, sc_mutex *mutex, sc_tick deadline);
 
+#ifdef SC_TEST
+typedef bool sc_cond_timedwait_fn(sc_cond *cond, sc_mutex *mutex,
+                                  sc_tick deadline, void *userdata);
+
+// Replace the implementation of sc_cond_timedwait() (typically by a virtual
+// clock, see util/vclock.h), or restore the default one if fn is NULL
+//
+// It must not be called while other threads may wait on a condition.
+void
+sc_cond_set_timedwait(sc_cond_timedwait_fn *fn, void *userdata);
+
+// Wait with a deadline expressed on the system clock (see
+// sc_tick_now_system()), even if another implementation is installed
+bool
+sc_cond_timedwait_system(sc_cond *cond, sc_mutex *mutex, sc_tick deadline);
+#endif
+
 void
 sc_cond_signal(sc_cond *cond);
 
@@ -7,8 +7,13 @@
 # include <windows.h>
 #endif
 
-sc_tick
-sc_tick_now(void) {
+#ifdef SC_TEST
+static sc_tick (*sc_tick_source_now)(void *userdata);
+static void *sc_tick_source_userdata;
+#endif
+
+static sc_tick
+sc_tick_get_system(void) {
 #ifndef _WIN32
     // Maximum sc_tick precision (microsecond)
     struct timespec ts;
@@ -54,3 +59,27 @@ sc_tick_now(void) {
     return secs + subsec;
 #endif
 }
+
+sc_tick
+sc_tick_now(void) {
+#ifdef SC_TEST
+    if (sc_tick_source_now) {
+        return sc_tick_source_now(sc_tick_source_userdata);
+    }
+#endif
+
+    return sc_tick_get_system();
+}
+
+#ifdef SC_TEST
+sc_tick
+sc_tick_now_system(void) {
+    return sc_tick_get_system();
+}
+
+void
+sc_tick_set_source(sc_tick (*now)(void *userdata), void *userdata) {
+    sc_tick_source_now = now;
+    sc_tick_source_userdata = userdata;
+}
+#endif
@@ -22,4 +22,18 @@ typedef int64_t sc_tick;
 sc_tick
 sc_tick_now(void);
 
+#ifdef SC_TEST
+// Return the time of the system monotonic clock, even if another clock source
+// is installed
+sc_tick
+sc_tick_now_system(void);
+
+// Replace the clock source of sc_tick_now() (typically by a virtual clock, see
+// util/vclock.h), or restore the system clock if now is NULL
+//
+// It must not be called while other threads may call sc_tick_now().
+void
+sc_tick_set_source(sc_tick (*now)(void *userdata), void *userdata);
+#endif
+
 #endif
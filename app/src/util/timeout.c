@@ -43,6 +43,13 @@ run_timeout(void *data) {
 bool
 sc_timeout_start(struct sc_timeout *timeout, sc_tick deadline,
                  const struct sc_timeout_callbacks *cbs, void *cbs_userdata) {
+    // Initialize the fields before starting the thread which reads them
+    timeout->deadline = deadline;
+
+    assert(cbs && cbs->on_timeout);
+    timeout->cbs = cbs;
+    timeout->cbs_userdata = cbs_userdata;
+
     bool ok = sc_thread_create(&timeout->thread, run_timeout, "scrcpy-timeout",
                                timeout);
     if (!ok) {
@@ -50,12 +57,6 @@ sc_timeout_start(struct sc_timeout *timeout, sc_tick deadline,
         return false;
     }
 
-    timeout->deadline = deadline;
-
-    assert(cbs && cbs->on_timeout);
-    timeout->cbs = cbs;
-    timeout->cbs_userdata = cbs_userdata;
-
     return true;
 }
 
@@ -0,0 +1,101 @@
+#include "vclock.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+// In manual mode, a timed wait must notice that the virtual time has reached
+// its deadline, so it waits on the real condition for a short period at most
+#define SC_VCLOCK_POLL_PERIOD SC_TICK_FROM_MS(1)
+
+bool
+sc_vclock_init(struct sc_vclock *vclock, sc_tick start, bool auto_advance) {
+    bool ok = sc_mutex_init(&vclock->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    vclock->now = start;
+    vclock->auto_advance = auto_advance;
+
+    return true;
+}
+
+void
+sc_vclock_destroy(struct sc_vclock *vclock) {
+    sc_mutex_destroy(&vclock->mutex);
+}
+
+sc_tick
+sc_vclock_now(struct sc_vclock *vclock) {
+    sc_mutex_lock(&vclock->mutex);
+    sc_tick now = vclock->now;
+    sc_mutex_unlock(&vclock->mutex);
+    return now;
+}
+
+static void
+sc_vclock_advance_to(struct sc_vclock *vclock, sc_tick target) {
+    sc_mutex_lock(&vclock->mutex);
+    // The clock is monotonic
+    if (target > vclock->now) {
+        vclock->now = target;
+    }
+    sc_mutex_unlock(&vclock->mutex);
+}
+
+void
+sc_vclock_advance(struct sc_vclock *vclock, sc_tick duration) {
+    assert(duration >= 0);
+    sc_mutex_lock(&vclock->mutex);
+    vclock->now += duration;
+    sc_mutex_unlock(&vclock->mutex);
+}
+
+static sc_tick
+sc_vclock_source_now(void *userdata) {
+    struct sc_vclock *vclock = userdata;
+    return sc_vclock_now(vclock);
+}
+
+static bool
+sc_vclock_timedwait(sc_cond *cond, sc_mutex *mutex, sc_tick deadline,
+                    void *userdata) {
+    struct sc_vclock *vclock = userdata;
+
+    if (vclock->auto_advance) {
+        // The caller checked its predicate before waiting, so nothing could
+        // have signaled the condition: nobody else can make progress before
+        // the deadline (in virtual time), so jump directly to it.
+        //
+        // Like a real wait, release the caller mutex meanwhile, so that the
+        // other threads are not blocked on it while the time jumps.
+        sc_mutex_unlock(mutex);
+        sc_vclock_advance_to(vclock, deadline);
+        sc_mutex_lock(mutex);
+        return false; // timeout
+    }
+
+    for (;;) {
+        if (sc_vclock_now(vclock) >= deadline) {
+            return false; // timeout
+        }
+
+        sc_tick poll_deadline = sc_tick_now_system() + SC_VCLOCK_POLL_PERIOD;
+        if (sc_cond_timedwait_system(cond, mutex, poll_deadline)) {
+            return true; // signaled
+        }
+    }
+}
+
+void
+sc_vclock_install(struct sc_vclock *vclock) {
+    sc_tick_set_source(sc_vclock_source_now, vclock);
+    sc_cond_set_timedwait(sc_vclock_timedwait, vclock);
+}
+
+void
+sc_vclock_uninstall(struct sc_vclock *vclock) {
+    (void) vclock;
+    sc_tick_set_source(NULL, NULL);
+    sc_cond_set_timedwait(NULL, NULL);
+}
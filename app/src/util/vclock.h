@@ -0,0 +1,66 @@
+#ifndef SC_VCLOCK_H
+#define SC_VCLOCK_H
+
+#include "common.h"
+
+#include <stdbool.h>
+
+#include "util/thread.h"
+#include "util/tick.h"
+
+/**
+ * Virtual clock, for tests only (SC_TEST)
+ *
+ * Once installed, it replaces the clock used by sc_tick_now() and
+ * sc_cond_timedwait(), so that timing-dependent components (timeouts, delay
+ * buffer, FPS counter, audio regulation...) run on simulated time:
+ *  - in manual mode, the time only changes on sc_vclock_advance(), and timed
+ *    waits return on timeout once the virtual time reaches their deadline;
+ *  - in auto mode, a timed wait which is not signaled immediately advances
+ *    the virtual time to its deadline, so that long scenarios run without
+ *    actually waiting.
+ *
+ * The auto mode assumes that a single thread performs timed waits: the
+ * deadline of a thread is never ordered with the timed waits of the others
+ * (each one would jump to its own deadline, possibly beyond the deadline of
+ * another). Scenarios involving several timed threads (e.g. a producer
+ * pushing at a given rate to a delay buffer) must use the manual mode, the
+ * test driving the time itself.
+ *
+ * It must be installed and uninstalled while no other thread uses the clock.
+ */
+struct sc_vclock {
+    sc_mutex mutex;
+    sc_tick now;
+    bool auto_advance;
+};
+
+bool
+sc_vclock_init(struct sc_vclock *vclock, sc_tick start, bool auto_advance);
+
+void
+sc_vclock_destroy(struct sc_vclock *vclock);
+
+/**
+ * Replace the system clock by the virtual clock
+ */
+void
+sc_vclock_install(struct sc_vclock *vclock);
+
+/**
+ * Restore the system clock
+ */
+void
+sc_vclock_uninstall(struct sc_vclock *vclock);
+
+sc_tick
+sc_vclock_now(struct sc_vclock *vclock);
+
+/**
+ * Advance the virtual time (the timed waits reaching their deadline return
+ * on timeout)
+ */
+void
+sc_vclock_advance(struct sc_vclock *vclock, sc_tick duration);
+
+#endif
@@ -0,0 +1,261 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_plc.h"
+
+#define SAMPLE_RATE 48000
+#define CHANNELS 2
+
+static float
+abs_f(float x) {
+    return x < 0 ? -x : x;
+}
+
+// Generate a stereo sine wave (period ~199 samples) without libm, using the
+// recurrence s[n+1] = 2*cos(w)*s[n] - s[n-1]
+static float *
+generate_sine(uint32_t count) {
+    float *samples = malloc(count * CHANNELS * sizeof(float));
+    assert(samples);
+
+    double prev = 0;
+    double cur = 0.0316; // ~sin(w), so that the amplitude is ~1
+    for (uint32_t i = 0; i < count; ++i) {
+        samples[i * CHANNELS] = prev;
+        samples[i * CHANNELS + 1] = prev / 2;
+        double next = 1.999 * cur - prev;
+        prev = cur;
+        cur = next;
+    }
+
+    return samples;
+}
+
+static void test_conceal_without_history(void) {
+    struct sc_audio_plc plc;
+    bool ok = sc_audio_plc_init(&plc, SC_AUDIO_PLC_FORMAT_FLT, CHANNELS,
+                                SAMPLE_RATE);
+    assert(ok);
+
+    float out[64 * CHANNELS];
+    memset(out, 0x42, sizeof(out));
+    sc_audio_plc_conceal(&plc, out, 64);
+    for (unsigned i = 0; i < 64 * CHANNELS; ++i) {
+        assert(out[i] == 0);
+    }
+
+    sc_audio_plc_destroy(&plc);
+}
+
+static void test_conceal_extends_waveform(void) {
+    struct sc_audio_plc plc;
+    bool ok = sc_audio_plc_init(&plc, SC_AUDIO_PLC_FORMAT_FLT, CHANNELS,
+                                SAMPLE_RATE);
+    assert(ok);
+
+    uint32_t played = 960; // 20 ms
+    uint32_t missing = 240; // 5 ms
+    float *signal = generate_sine(played + missing);
+
+    float *buf = malloc((played + missing) * CHANNELS * sizeof(float));
+    assert(buf);
+    memcpy(buf, signal, (played + missing) * CHANNELS * sizeof(float));
+
+    // Play by blocks, as the audio callback does
+    for (uint32_t i = 0; i < played; i += 120) {
+        sc_audio_plc_play(&plc, &buf[i * CHANNELS], 120);
+    }
+    // Nothing to crossfade, the real samples must be unchanged
+    assert(!memcmp(buf, signal, played * CHANNELS * sizeof(float)));
+
+    float *out = &buf[played * CHANNELS];
+    sc_audio_plc_conceal(&plc, out, missing);
+
+    // The concealment must be close to the real continuation
+    const float *expected = &signal[played * CHANNELS];
+    for (uint32_t i = 0; i < missing * CHANNELS; ++i) {
+        assert(abs_f(out[i] - expected[i]) < 0.1f);
+    }
+
+    free(buf);
+    free(signal);
+    sc_audio_plc_destroy(&plc);
+}
+
+static void test_conceal_s16(void) {
+    struct sc_audio_plc plc;
+    bool ok = sc_audio_plc_init(&plc, SC_AUDIO_PLC_FORMAT_S16, CHANNELS,
+                                SAMPLE_RATE);
+    assert(ok);
+
+    uint32_t played = 960; // 20 ms
+    uint32_t missing = 240; // 5 ms
+    uint32_t count = played + missing;
+    float *signal = generate_sine(count);
+
+    int16_t *buf = malloc(count * CHANNELS * sizeof(int16_t));
+    assert(buf);
+    for (uint32_t i = 0; i < count * CHANNELS; ++i) {
+        // The amplitude is ~1, keep some headroom
+        buf[i] = signal[i] * 16384;
+    }
+
+    sc_audio_plc_play(&plc, buf, played);
+
+    int16_t *out = &buf[played * CHANNELS];
+    sc_audio_plc_conceal(&plc, out, missing);
+
+    for (uint32_t i = 0; i < missing * CHANNELS; ++i) {
+        float expected = signal[played * CHANNELS + i] * 16384;
+        assert(abs_f(out[i] - expected) < 0.1f * 16384);
+    }
+
+    free(buf);
+    free(signal);
+    sc_audio_plc_destroy(&plc);
+}
+
+static void test_conceal_fades_out(void) {
+    struct sc_audio_plc plc;
+    bool ok = sc_audio_plc_init(&plc, SC_AUDIO_PLC_FORMAT_FLT, CHANNELS,
+                                SAMPLE_RATE);
+    assert(ok);
+
+    float *signal = generate_sine(960);
+    sc_audio_plc_play(&plc, signal, 960);
+
+    // 50 ms, in several calls
+    uint32_t count = 2400;
+    float *out = malloc(count * CHANNELS * sizeof(float));
+    assert(out);
+    for (uint32_t i = 0; i < count; i += 240) {
+        sc_audio_plc_conceal(&plc, &out[i * CHANNELS], 240);
+    }
+
+    // Not silent at the beginning
+    float max = 0;
+    for (uint32_t i = 0; i < 480 * CHANNELS; ++i) {
+        max = MAX(max, abs_f(out[i]));
+    }
+    assert(max > 0.5f);
+
+    // Silent after 40 ms
+    for (uint32_t i = 1920 * CHANNELS; i < count * CHANNELS; ++i) {
+        assert(out[i] == 0);
+    }
+
+    free(out);
+    free(signal);
+    sc_audio_plc_destroy(&plc);
+}
+
+static void test_resume_crossfade(void) {
+    struct sc_audio_plc plc;
+    bool ok = sc_audio_plc_init(&plc, SC_AUDIO_PLC_FORMAT_FLT, CHANNELS,
+                                SAMPLE_RATE);
+    assert(ok);
+
+    float *signal = generate_sine(960);
+    sc_audio_plc_play(&plc, signal, 960);
+
+    float concealed[48 * CHANNELS];
+    sc_audio_plc_conceal(&plc, concealed, 48);
+
+    // Resume with an opposite signal, to make the crossfade visible
+    uint32_t count = 480;
+    float *real = malloc(count * CHANNELS * sizeof(float));
+    assert(real);
+    for (uint32_t i = 0; i < count * CHANNELS; ++i) {
+        real[i] = -signal[i];
+    }
+
+    float *out = malloc(count * CHANNELS * sizeof(float));
+    assert(out);
+    memcpy(out, real, count * CHANNELS * sizeof(float));
+    // In 2 calls, the crossfade (5 ms) spans both
+    sc_audio_plc_play(&plc, out, 120);
+    sc_audio_plc_play(&plc, &out[120 * CHANNELS], count - 120);
+
+    // No jump between the concealment and the first played sample
+    const float *last = &concealed[47 * CHANNELS];
+    assert(abs_f(out[0] - last[0]) < 0.1f);
+    assert(abs_f(out[1] - last[1]) < 0.1f);
+
+    // Smooth transition
+    for (uint32_t i = 1; i < count; ++i) {
+        assert(abs_f(out[i * CHANNELS] - out[(i - 1) * CHANNELS]) < 0.1f);
+    }
+
+    // Real samples after the crossfade
+    assert(!memcmp(&out[240 * CHANNELS], &real[240 * CHANNELS],
+                   (count - 240) * CHANNELS * sizeof(float)));
+
+    free(out);
+    free(real);
+    free(signal);
+    sc_audio_plc_destroy(&plc);
+}
+
+// Replay a trace of underflows (number of missing samples for each 5 ms
+// block), and compare the error with silence insertion
+static void test_replay_trace(void) {
+    static const uint32_t trace[] = {
+        0, 0, 0, 0, 48, 0, 0, 240, 0, 0, 0, 120, 240, 0, 0, 0, 0, 16, 0, 0,
+    };
+
+    struct sc_audio_plc plc;
+    bool ok = sc_audio_plc_init(&plc, SC_AUDIO_PLC_FORMAT_FLT, CHANNELS,
+                                SAMPLE_RATE);
+    assert(ok);
+
+    uint32_t block = 240;
+    uint32_t count = ARRAY_LEN(trace) * block;
+    float *signal = generate_sine(count);
+    float *out = malloc(count * CHANNELS * sizeof(float));
+    assert(out);
+    memcpy(out, signal, count * CHANNELS * sizeof(float));
+
+    double plc_error = 0;
+    double silence_error = 0;
+    for (unsigned i = 0; i < ARRAY_LEN(trace); ++i) {
+        float *b = &out[i * block * CHANNELS];
+        uint32_t read = block - trace[i];
+        sc_audio_plc_play(&plc, b, read);
+        if (trace[i]) {
+            sc_audio_plc_conceal(&plc, &b[read * CHANNELS], trace[i]);
+        }
+
+        const float *expected = &signal[i * block * CHANNELS];
+        for (uint32_t j = 0; j < block * CHANNELS; ++j) {
+            float e = b[j] - expected[j];
+            plc_error += e * e;
+            if (j >= read * CHANNELS) {
+                silence_error += expected[j] * expected[j];
+            }
+        }
+    }
+
+    assert(silence_error > 0);
+    assert(plc_error < silence_error / 10);
+
+    free(out);
+    free(signal);
+    sc_audio_plc_destroy(&plc);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_conceal_without_history();
+    test_conceal_extends_waveform();
+    test_conceal_s16();
+    test_conceal_fades_out();
+    test_resume_crossfade();
+    test_replay_trace();
+
+    return 0;
+}
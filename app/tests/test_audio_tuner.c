@@ -0,0 +1,139 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "audio_tuner.h"
+
+#define SAMPLE_RATE 48000
+#define PACKET_SAMPLES 960 // 20 ms
+#define MS(x) (SAMPLE_RATE * (x) / 1000)
+
+// Push packets for the given duration, with a transit delay provided by the
+// callback, and return the number of target changes
+static unsigned
+push_packets(struct sc_audio_tuner *tuner, sc_tick *now, int64_t *pts,
+             unsigned seconds, sc_tick (*get_delay)(unsigned i)) {
+    unsigned changes = 0;
+    unsigned count = seconds * 50;
+    for (unsigned i = 0; i < count; ++i) {
+        *pts += 20000;
+        *now = SC_TICK_FROM_SEC(1000) + *pts + get_delay(i);
+        if (sc_audio_tuner_push(tuner, *now, *pts, PACKET_SAMPLES, false)) {
+            ++changes;
+        }
+    }
+    return changes;
+}
+
+static sc_tick
+constant_delay(unsigned i) {
+    (void) i;
+    return SC_TICK_FROM_MS(5);
+}
+
+static sc_tick
+jittery_delay(unsigned i) {
+    // Every 5 packets, a packet is 60 ms late
+    return i % 5 ? SC_TICK_FROM_MS(5) : SC_TICK_FROM_MS(65);
+}
+
+static void test_audio_tuner_lower_when_stable(void) {
+    struct sc_audio_tuner tuner;
+    sc_audio_tuner_init(&tuner, SAMPLE_RATE, MS(50), MS(20), MS(200));
+    assert(tuner.target == MS(50));
+    assert(tuner.reason == SC_AUDIO_TUNER_REASON_INITIAL);
+
+    sc_tick now = 0;
+    int64_t pts = 0;
+    unsigned changes = push_packets(&tuner, &now, &pts, 60, constant_delay);
+    assert(changes > 1); // lowered progressively
+
+    // One packet plus the margin
+    assert(tuner.target == PACKET_SAMPLES + MS(10));
+    assert(tuner.reason == SC_AUDIO_TUNER_REASON_STABLE);
+}
+
+static void test_audio_tuner_raise_on_jitter(void) {
+    struct sc_audio_tuner tuner;
+    sc_audio_tuner_init(&tuner, SAMPLE_RATE, MS(50), MS(20), MS(200));
+
+    sc_tick now = 0;
+    int64_t pts = 0;
+    push_packets(&tuner, &now, &pts, 4, jittery_delay);
+
+    assert(tuner.target == MS(60) + PACKET_SAMPLES + MS(10));
+    assert(tuner.reason == SC_AUDIO_TUNER_REASON_JITTER);
+}
+
+static void test_audio_tuner_raise_on_underflow(void) {
+    struct sc_audio_tuner tuner;
+    sc_audio_tuner_init(&tuner, SAMPLE_RATE, MS(40), MS(20), MS(200));
+
+    sc_tick now = 0;
+    int64_t pts = 0;
+    push_packets(&tuner, &now, &pts, 1, constant_delay);
+
+    // Report an underflow, the target is raised at the end of the period
+    pts += 20000;
+    now = SC_TICK_FROM_SEC(1000) + pts + SC_TICK_FROM_MS(5);
+    bool changed = sc_audio_tuner_push(&tuner, now, pts, PACKET_SAMPLES, true);
+    assert(!changed);
+    push_packets(&tuner, &now, &pts, 2, constant_delay);
+
+    assert(tuner.target == MS(50)); // +25%, at least 10 ms
+    assert(tuner.reason == SC_AUDIO_TUNER_REASON_UNDERFLOW);
+
+    // Not lowered while the underflow is in the window
+    push_packets(&tuner, &now, &pts, 7, constant_delay);
+    assert(tuner.target == MS(50));
+
+    // Lowered once stable for the whole window
+    push_packets(&tuner, &now, &pts, 4, constant_delay);
+    assert(tuner.target < MS(50));
+    assert(tuner.reason == SC_AUDIO_TUNER_REASON_STABLE);
+}
+
+static void test_audio_tuner_bounds(void) {
+    struct sc_audio_tuner tuner;
+    sc_audio_tuner_init(&tuner, SAMPLE_RATE, MS(10), MS(40), MS(60));
+    // The initial target is clamped
+    assert(tuner.target == MS(40));
+
+    sc_tick now = 0;
+    int64_t pts = 0;
+    push_packets(&tuner, &now, &pts, 4, jittery_delay);
+    assert(tuner.target == MS(60));
+
+    sc_audio_tuner_init(&tuner, SAMPLE_RATE, MS(50), MS(40), MS(60));
+    push_packets(&tuner, &now, &pts, 60, constant_delay);
+    assert(tuner.target == MS(40));
+}
+
+static void test_audio_tuner_reset(void) {
+    struct sc_audio_tuner tuner;
+    sc_audio_tuner_init(&tuner, SAMPLE_RATE, MS(50), MS(20), MS(200));
+
+    sc_tick now = 0;
+    int64_t pts = 0;
+    push_packets(&tuner, &now, &pts, 1, jittery_delay);
+    sc_audio_tuner_reset(&tuner);
+
+    // Not enough packets since the reset to estimate the jitter
+    pts += SC_TICK_FROM_SEC(10); // discontinuity
+    push_packets(&tuner, &now, &pts, 1, constant_delay);
+    assert(tuner.target == MS(50));
+    assert(tuner.reason == SC_AUDIO_TUNER_REASON_INITIAL);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_audio_tuner_lower_when_stable();
+    test_audio_tuner_raise_on_jitter();
+    test_audio_tuner_raise_on_underflow();
+    test_audio_tuner_bounds();
+    test_audio_tuner_reset();
+
+    return 0;
+}
@@ -0,0 +1,388 @@
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "automation_msg.h"
+
+// Parse the serialized control message (with every truncated prefix first),
+// and check that it serializes back to the same bytes
+static void check_binary_round_trip(const struct sc_control_msg *msg) {
+    static uint8_t buf[SC_CONTROL_MSG_MAX_SIZE];
+    static uint8_t out[SC_CONTROL_MSG_MAX_SIZE];
+    size_t size = sc_control_msg_serialize(msg, buf);
+    assert(size);
+
+    struct sc_automation_request req;
+    for (size_t i = 0; i < size; ++i) {
+        ssize_t r = sc_automation_request_parse_binary(buf, i, &req);
+        assert(r == 0);
+    }
+
+    ssize_t r = sc_automation_request_parse_binary(buf, size, &req);
+    assert(r == (ssize_t) size);
+    assert(req.type == SC_AUTOMATION_REQUEST_TYPE_CONTROL);
+    assert(req.control.msg.type == msg->type);
+
+    size_t out_size = sc_control_msg_serialize(&req.control.msg, out);
+    assert(out_size == size);
+    assert(!memcmp(buf, out, size));
+
+    sc_automation_request_destroy(&req);
+}
+
+static void test_parse_binary_control(void) {
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_KEYCODE,
+        .inject_keycode = {
+            .action = AKEY_EVENT_ACTION_UP,
+            .keycode = AKEYCODE_ENTER,
+            .repeat = 5,
+            .metastate = AMETA_SHIFT_ON | AMETA_SHIFT_LEFT_ON,
+        },
+    };
+    check_binary_round_trip(&msg);
+
+    msg = (struct sc_control_msg) {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_TEXT,
+        .inject_text = {
+            .text = "hello, world!",
+        },
+    };
+    check_binary_round_trip(&msg);
+
+    msg = (struct sc_control_msg) {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
+        .inject_touch_event = {
+            .action = AMOTION_EVENT_ACTION_MOVE,
+            .pointer_id = UINT64_C(0x1234567887654321),
+            .position = {
+                .point = {
+                    .x = 100,
+                    .y = 200,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .pressure = 1.0f,
+            .action_button = AMOTION_EVENT_BUTTON_PRIMARY,
+            .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+        },
+    };
+    check_binary_round_trip(&msg);
+
+    msg = (struct sc_control_msg) {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_SCROLL_EVENT,
+        .inject_scroll_event = {
+            .position = {
+                .point = {
+                    .x = 260,
+                    .y = 1026,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .hscroll = 16,
+            .vscroll = -2.5f,
+        },
+    };
+    check_binary_round_trip(&msg);
+
+    const uint8_t report_desc[] = {1, 2, 3, 4};
+    msg = (struct sc_control_msg) {
+        .type = SC_CONTROL_MSG_TYPE_UHID_CREATE,
+        .uhid_create = {
+            .id = 42,
+            .vendor_id = 0x1234,
+            .product_id = 0x5678,
+            .name = "ABC",
+            .report_desc_size = sizeof(report_desc),
+            .report_desc = report_desc,
+        },
+    };
+    check_binary_round_trip(&msg);
+
+    msg = (struct sc_control_msg) {
+        .type = SC_CONTROL_MSG_TYPE_UHID_INPUT,
+        .uhid_input = {
+            .id = 42,
+            .size = 5,
+            .data = {1, 2, 3, 4, 5},
+        },
+    };
+    check_binary_round_trip(&msg);
+
+    msg = (struct sc_control_msg) {
+        .type = SC_CONTROL_MSG_TYPE_UHID_DESTROY,
+        .uhid_destroy = {
+            .id = 42,
+        },
+    };
+    check_binary_round_trip(&msg);
+}
+
+static void test_parse_binary_automation(void) {
+    const uint8_t input[] = {
+        SC_AUTOMATION_MSG_TYPE_PING, 0x12, 0x34, 0x56, 0x78,
+        SC_AUTOMATION_MSG_TYPE_GET_STATE,
+        SC_AUTOMATION_MSG_TYPE_SUBSCRIBE_FRAMES, 0x01,
+        SC_AUTOMATION_MSG_TYPE_SCREENSHOT,
+    };
+
+    struct sc_automation_request req;
+    ssize_t r = sc_automation_request_parse_binary(input, 4, &req);
+    assert(r == 0);
+
+    r = sc_automation_request_parse_binary(input, sizeof(input), &req);
+    assert(r == 5);
+    assert(req.type == SC_AUTOMATION_REQUEST_TYPE_PING);
+    assert(req.ping.token == 0x12345678);
+
+    r = sc_automation_request_parse_binary(&input[5], 3, &req);
+    assert(r == 1);
+    assert(req.type == SC_AUTOMATION_REQUEST_TYPE_GET_STATE);
+
+    r = sc_automation_request_parse_binary(&input[6], 3, &req);
+    assert(r == 2);
+    assert(req.type == SC_AUTOMATION_REQUEST_TYPE_SUBSCRIBE_FRAMES);
+    assert(req.subscribe_frames.enable);
+
+    r = sc_automation_request_parse_binary(&input[8], 1, &req);
+    assert(r == 1);
+    assert(req.type == SC_AUTOMATION_REQUEST_TYPE_SCREENSHOT);
+}
+
+static void test_parse_binary_invalid(void) {
+    struct sc_automation_request req;
+
+    // Control messages which are not input events are not accepted
+    const uint8_t rotate[] = {SC_CONTROL_MSG_TYPE_ROTATE_DEVICE};
+    ssize_t r = sc_automation_request_parse_binary(rotate, sizeof(rotate),
+                                                   &req);
+    assert(r == -1);
+
+    // Text too long
+    const uint8_t text[] = {
+        SC_CONTROL_MSG_TYPE_INJECT_TEXT, 0x00, 0x00, 0x01, 0x2D,
+    };
+    r = sc_automation_request_parse_binary(text, sizeof(text), &req);
+    assert(r == -1);
+
+    // UHID input too large
+    const uint8_t uhid_input[] = {
+        SC_CONTROL_MSG_TYPE_UHID_INPUT, 0x00, 0x2A, 0x00, 0x10,
+    };
+    r = sc_automation_request_parse_binary(uhid_input, sizeof(uhid_input),
+                                           &req);
+    assert(r == -1);
+}
+
+static void test_parse_json_key(void) {
+    char line[] = "{\"type\": \"key\", \"action\": \"down\", \"keycode\": 66,"
+                  " \"metastate\": 1}";
+
+    struct sc_automation_request req;
+    bool ok = sc_automation_request_parse_json(line, &req);
+    assert(ok);
+    assert(req.type == SC_AUTOMATION_REQUEST_TYPE_CONTROL);
+    assert(req.control.msg.type == SC_CONTROL_MSG_TYPE_INJECT_KEYCODE);
+    assert(req.control.msg.inject_keycode.action == AKEY_EVENT_ACTION_DOWN);
+    assert(req.control.msg.inject_keycode.keycode == AKEYCODE_ENTER);
+    assert(req.control.msg.inject_keycode.repeat == 0);
+    assert(req.control.msg.inject_keycode.metastate == AMETA_SHIFT_ON);
+    sc_automation_request_destroy(&req);
+}
+
+static void test_parse_json_text(void) {
+    // "\u00e9" is 'é', "\ud83d\ude00" is an emoji (outside the BMP)
+    char line[] = "{\"type\":\"text\","
+                  "\"text\":\"a\\\"b\\\\c\\n\\u00e9\\ud83d\\ude00\"}";
+
+    struct sc_automation_request req;
+    bool ok = sc_automation_request_parse_json(line, &req);
+    assert(ok);
+    assert(req.control.msg.type == SC_CONTROL_MSG_TYPE_INJECT_TEXT);
+    assert(!strcmp(req.control.msg.inject_text.text,
+                   "a\"b\\c\n\xc3\xa9\xf0\x9f\x98\x80"));
+    sc_automation_request_destroy(&req);
+}
+
+static void test_parse_json_touch(void) {
+    char line[] = "{\"type\":\"touch\",\"action\":\"up\",\"pointer_id\":-1,"
+                  "\"x\":100,\"y\":200,\"width\":1080,\"height\":1920}";
+
+    struct sc_automation_request req;
+    bool ok = sc_automation_request_parse_json(line, &req);
+    assert(ok);
+    assert(req.control.msg.type == SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT);
+    assert(req.control.msg.inject_touch_event.action
+                == AMOTION_EVENT_ACTION_UP);
+    assert(req.control.msg.inject_touch_event.pointer_id
+                == SC_POINTER_ID_MOUSE);
+    assert(req.control.msg.inject_touch_event.position.point.x == 100);
+    assert(req.control.msg.inject_touch_event.position.point.y == 200);
+    assert(req.control.msg.inject_touch_event.position.screen_size.width
+                == 1080);
+    assert(req.control.msg.inject_touch_event.position.screen_size.height
+                == 1920);
+    // Default pressure for ACTION_UP
+    assert(req.control.msg.inject_touch_event.pressure == 0.0f);
+    sc_automation_request_destroy(&req);
+}
+
+static void test_parse_json_uhid(void) {
+    char create[] = "{\"type\":\"uhid_create\",\"id\":2,\"name\":\"Pad\","
+                    "\"report_desc\":\"05010905A1\"}";
+
+    struct sc_automation_request req;
+    bool ok = sc_automation_request_parse_json(create, &req);
+    assert(ok);
+    assert(req.control.msg.type == SC_CONTROL_MSG_TYPE_UHID_CREATE);
+    assert(req.control.msg.uhid_create.id == 2);
+    assert(!strcmp(req.control.msg.uhid_create.name, "Pad"));
+    assert(req.control.msg.uhid_create.report_desc_size == 5);
+    assert(!memcmp(req.control.msg.uhid_create.report_desc,
+                   "\x05\x01\x09\x05\xA1", 5));
+    sc_automation_request_destroy(&req);
+
+    char input[] = "{\"type\":\"uhid_input\",\"id\":2,\"data\":\"00ff7f\"}";
+    ok = sc_automation_request_parse_json(input, &req);
+    assert(ok);
+    assert(req.control.msg.type == SC_CONTROL_MSG_TYPE_UHID_INPUT);
+    assert(req.control.msg.uhid_input.size == 3);
+    assert(!memcmp(req.control.msg.uhid_input.data, "\x00\xff\x7f", 3));
+    sc_automation_request_destroy(&req);
+}
+
+static void test_parse_json_automation(void) {
+    char ping[] = "{\"type\":\"ping\",\"token\":42}";
+
+    struct sc_automation_request req;
+    bool ok = sc_automation_request_parse_json(ping, &req);
+    assert(ok);
+    assert(req.type == SC_AUTOMATION_REQUEST_TYPE_PING);
+    assert(req.ping.token == 42);
+
+    char subscribe[] = "{\"type\":\"subscribe_frames\",\"enable\":false}";
+    ok = sc_automation_request_parse_json(subscribe, &req);
+    assert(ok);
+    assert(req.type == SC_AUTOMATION_REQUEST_TYPE_SUBSCRIBE_FRAMES);
+    assert(!req.subscribe_frames.enable);
+
+    char screenshot[] = "{\"type\":\"screenshot\"}";
+    ok = sc_automation_request_parse_json(screenshot, &req);
+    assert(ok);
+    assert(req.type == SC_AUTOMATION_REQUEST_TYPE_SCREENSHOT);
+}
+
+static void test_parse_json_invalid(void) {
+    struct sc_automation_request req;
+
+    char syntax[] = "{\"type\":\"ping\",}";
+    assert(!sc_automation_request_parse_json(syntax, &req));
+
+    char trailing[] = "{\"type\":\"get_state\"} x";
+    assert(!sc_automation_request_parse_json(trailing, &req));
+
+    char nested[] = "{\"type\":\"ping\",\"token\":[1]}";
+    assert(!sc_automation_request_parse_json(nested, &req));
+
+    char unknown[] = "{\"type\":\"rotate\"}";
+    assert(!sc_automation_request_parse_json(unknown, &req));
+
+    char missing[] = "{\"type\":\"key\",\"action\":\"down\"}";
+    assert(!sc_automation_request_parse_json(missing, &req));
+
+    char range[] = "{\"type\":\"uhid_destroy\",\"id\":65536}";
+    assert(!sc_automation_request_parse_json(range, &req));
+
+    char fraction[] = "{\"type\":\"key\",\"action\":0,\"keycode\":6.5}";
+    assert(!sc_automation_request_parse_json(fraction, &req));
+
+    char action[] = "{\"type\":\"key\",\"action\":\"move\",\"keycode\":66}";
+    assert(!sc_automation_request_parse_json(action, &req));
+
+    char hex[] = "{\"type\":\"uhid_input\",\"id\":2,\"data\":\"0ff\"}";
+    assert(!sc_automation_request_parse_json(hex, &req));
+
+    char surrogate[] = "{\"type\":\"text\",\"text\":\"\\ud83d\"}";
+    assert(!sc_automation_request_parse_json(surrogate, &req));
+}
+
+static void test_serialize_events(void) {
+    struct sc_automation_event event = {
+        .type = SC_AUTOMATION_EVENT_TYPE_FRAME,
+        .frame = {
+            .pts = 0x0102030405,
+            .size = {
+                .width = 1920,
+                .height = 1080,
+            },
+        },
+    };
+
+    uint8_t buf[SC_AUTOMATION_EVENT_MAX_SIZE];
+    size_t size = sc_automation_event_serialize_binary(&event, buf);
+    const uint8_t expected[] = {
+        SC_AUTOMATION_MSG_TYPE_FRAME,
+        0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, // pts
+        0x07, 0x80, // width
+        0x04, 0x38, // height
+    };
+    assert(size == sizeof(expected));
+    assert(!memcmp(buf, expected, sizeof(expected)));
+
+    char json[SC_AUTOMATION_EVENT_MAX_SIZE];
+    size = sc_automation_event_serialize_json(&event, json);
+    const char *expected_json =
+        "{\"type\":\"frame\",\"pts\":4328719365,\"width\":1920,"
+        "\"height\":1080}\n";
+    assert(size == strlen(expected_json));
+    assert(!memcmp(json, expected_json, size));
+
+    event = (struct sc_automation_event) {
+        .type = SC_AUTOMATION_EVENT_TYPE_PONG,
+        .pong = {
+            .token = 7,
+        },
+    };
+    size = sc_automation_event_serialize_binary(&event, buf);
+    assert(size == 5);
+    assert(buf[0] == SC_AUTOMATION_MSG_TYPE_PONG);
+    assert(buf[4] == 7);
+
+    event = (struct sc_automation_event) {
+        .type = SC_AUTOMATION_EVENT_TYPE_STATE,
+        .state = {
+            .decoded_frames = 1,
+            .dropped_frame_events = 2,
+        },
+    };
+    size = sc_automation_event_serialize_binary(&event, buf);
+    assert(size == 61);
+    assert(buf[0] == SC_AUTOMATION_MSG_TYPE_STATE);
+    assert(buf[12] == 1);
+    assert(buf[60] == 2);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_parse_binary_control();
+    test_parse_binary_automation();
+    test_parse_binary_invalid();
+    test_parse_json_key();
+    test_parse_json_text();
+    test_parse_json_touch();
+    test_parse_json_uhid();
+    test_parse_json_automation();
+    test_parse_json_invalid();
+    test_serialize_events();
+
+    return 0;
+}
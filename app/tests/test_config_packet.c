@@ -0,0 +1,125 @@
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "config_packet.h"
+
+// SPS (with emulation prevention bytes and 8 cropped lines) and PPS of a
+// 1920x1080 H.264 stream (High profile)
+static const uint8_t h264_1080p[] = {
+    0x00, 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x28, 0xAC, 0xD9, 0x40, 0x78,
+    0x02, 0x27, 0xE5, 0xC0, 0x44, 0x00, 0x00, 0x03, 0x00, 0x04, 0x00, 0x00,
+    0x03, 0x00, 0xF0, 0x3C, 0x60, 0xC6, 0x58,
+    0x00, 0x00, 0x00, 0x01, 0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0,
+};
+
+// SPS of a 1280x720 H.265 stream (Main profile)
+static const uint8_t h265_720p[] = {
+    0x00, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03,
+    0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x5D, 0xA0, 0x02,
+    0x80, 0x80, 0x2D, 0x16, 0x59, 0x59, 0xA4, 0x93, 0x2B, 0xC0, 0x5A, 0x02,
+    0x00, 0x00, 0x03, 0x00, 0x02, 0x00, 0x00, 0x03, 0x00, 0x3C, 0x10,
+};
+
+static void test_h264(void) {
+    struct sc_size size;
+    bool ok = sc_config_packet_parse_video_size(AV_CODEC_ID_H264, h264_1080p,
+                                                sizeof(h264_1080p), &size);
+    assert(ok);
+    assert(size.width == 1920);
+    assert(size.height == 1080);
+
+    // 3-byte start code, PPS first
+    uint8_t data[sizeof(h264_1080p)];
+    memcpy(data, &h264_1080p[31 + 1], 9);
+    memcpy(&data[9], &h264_1080p[1], 30);
+    ok = sc_config_packet_parse_video_size(AV_CODEC_ID_H264, data, 39, &size);
+    assert(ok);
+    assert(size.width == 1920);
+    assert(size.height == 1080);
+}
+
+static void test_h265(void) {
+    struct sc_size size;
+    bool ok = sc_config_packet_parse_video_size(AV_CODEC_ID_HEVC, h265_720p,
+                                                sizeof(h265_720p), &size);
+    assert(ok);
+    assert(size.width == 1280);
+    assert(size.height == 720);
+}
+
+#ifdef SCRCPY_LAVC_HAS_AV1
+static void test_av1(void) {
+    // AV1CodecConfigurationRecord, followed by a sequence header OBU for
+    // 1920x1080 (level 4.0, 11 bits for each dimension)
+    const uint8_t av1c[] = {
+        0x81, 0x08, 0x0C, 0x00,
+        0x0A, 0x08, 0x00, 0x00, 0x00, 0x42, 0xAB, 0xBF, 0xC3, 0x78,
+    };
+
+    struct sc_size size;
+    bool ok = sc_config_packet_parse_video_size(AV_CODEC_ID_AV1, av1c,
+                                                sizeof(av1c), &size);
+    assert(ok);
+    assert(size.width == 1920);
+    assert(size.height == 1080);
+
+    // Raw OBUs: a temporal delimiter, then the sequence header
+    const uint8_t obus[] = {
+        0x12, 0x00,
+        0x0A, 0x08, 0x00, 0x00, 0x00, 0x42, 0xAB, 0xBF, 0xC3, 0x78,
+    };
+    ok = sc_config_packet_parse_video_size(AV_CODEC_ID_AV1, obus,
+                                           sizeof(obus), &size);
+    assert(ok);
+    assert(size.width == 1920);
+    assert(size.height == 1080);
+
+    // OBU size larger than the data
+    const uint8_t truncated[] = {
+        0x0A, 0x10, 0x00, 0x00, 0x00, 0x42, 0xAB, 0xBF, 0xC3, 0x78,
+    };
+    ok = sc_config_packet_parse_video_size(AV_CODEC_ID_AV1, truncated,
+                                           sizeof(truncated), &size);
+    assert(!ok);
+}
+#endif
+
+static void test_invalid(void) {
+    struct sc_size size;
+
+    // Truncated SPS
+    bool ok = sc_config_packet_parse_video_size(AV_CODEC_ID_H264, h264_1080p,
+                                                12, &size);
+    assert(!ok);
+
+    // No SPS (only the PPS)
+    ok = sc_config_packet_parse_video_size(AV_CODEC_ID_H264, &h264_1080p[31],
+                                           sizeof(h264_1080p) - 31, &size);
+    assert(!ok);
+
+    // H.264 SPS parsed as H.265
+    ok = sc_config_packet_parse_video_size(AV_CODEC_ID_HEVC, h264_1080p,
+                                           sizeof(h264_1080p), &size);
+    assert(!ok);
+
+    // Not a video codec supported by the parser
+    ok = sc_config_packet_parse_video_size(AV_CODEC_ID_OPUS, h264_1080p,
+                                           sizeof(h264_1080p), &size);
+    assert(!ok);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_h264();
+    test_h265();
+#ifdef SCRCPY_LAVC_HAS_AV1
+    test_av1();
+#endif
+    test_invalid();
+
+    return 0;
+}
@@ -0,0 +1,289 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+# include <unistd.h>
+#endif
+#include <libavcodec/avcodec.h>
+
+#include "file_demuxer.h"
+#include "trait/packet_sink.h"
+
+#ifndef _WIN32
+/*
+ * 6 frames of 16x16 gray H.264 at 10 fps in MKV, generated by:
+ *
+ *     ffmpeg -f lavfi -i color=c=gray:s=16x16:r=10:d=0.6 -c:v libx264 \
+ *         -preset ultrafast -x264-params <PARAMS>:keyint=6:scenecut=0 \
+ *         -bsf:v filter_units=remove_types=6 -fflags +bitexact \
+ *         -map_metadata -1 sample.mkv
+ */
+
+// With bframes=2:b-adapt=0:b-pyramid=0 (decoding order: I P B B P B)
+static const uint8_t sample_bframes[] = {
+    0x1a, 0x45, 0xdf, 0xa3, 0xa3, 0x42, 0x86, 0x81, 0x01, 0x42, 0xf7, 0x81,
+    0x01, 0x42, 0xf2, 0x81, 0x04, 0x42, 0xf3, 0x81, 0x08, 0x42, 0x82, 0x88,
+    0x6d, 0x61, 0x74, 0x72, 0x6f, 0x73, 0x6b, 0x61, 0x42, 0x87, 0x81, 0x04,
+    0x42, 0x85, 0x81, 0x02, 0x18, 0x53, 0x80, 0x67, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x02, 0x42, 0x11, 0x4d, 0x9b, 0x74, 0xc0, 0xbf, 0x84, 0x31,
+    0x25, 0x8b, 0xb8, 0x4d, 0xbb, 0x8b, 0x53, 0xab, 0x84, 0x15, 0x49, 0xa9,
+    0x66, 0x53, 0xac, 0x81, 0xa1, 0x4d, 0xbb, 0x8b, 0x53, 0xab, 0x84, 0x16,
+    0x54, 0xae, 0x6b, 0x53, 0xac, 0x81, 0xcc, 0x4d, 0xbb, 0x8c, 0x53, 0xab,
+    0x84, 0x12, 0x54, 0xc3, 0x67, 0x53, 0xac, 0x82, 0x01, 0x5a, 0x4d, 0xbb,
+    0x8c, 0x53, 0xab, 0x84, 0x1c, 0x53, 0xbb, 0x6b, 0x53, 0xac, 0x82, 0x02,
+    0x26, 0xec, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x53, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x15, 0x49, 0xa9,
+    0x66, 0xa6, 0xbf, 0x84, 0x42, 0xff, 0x03, 0x4a, 0x2a, 0xd7, 0xb1, 0x83,
+    0x0f, 0x42, 0x40, 0x4d, 0x80, 0x84, 0x4c, 0x61, 0x76, 0x66, 0x57, 0x41,
+    0x84, 0x4c, 0x61, 0x76, 0x66, 0x44, 0x89, 0x88, 0x40, 0x82, 0xc0, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x16, 0x54, 0xae, 0x6b, 0x40, 0x88, 0xbf, 0x84,
+    0xff, 0x74, 0x42, 0x5c, 0xae, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x79, 0xd7, 0x81, 0x01, 0x73, 0xc5, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x01, 0x9c, 0x81, 0x00, 0x22, 0xb5, 0x9c, 0x83, 0x75, 0x6e,
+    0x64, 0x88, 0x81, 0x00, 0x86, 0x8f, 0x56, 0x5f, 0x4d, 0x50, 0x45, 0x47,
+    0x34, 0x2f, 0x49, 0x53, 0x4f, 0x2f, 0x41, 0x56, 0x43, 0x83, 0x81, 0x01,
+    0x23, 0xe3, 0x83, 0x84, 0x05, 0xf5, 0xe1, 0x00, 0xe0, 0x89, 0xb0, 0x81,
+    0x10, 0xba, 0x81, 0x10, 0x9a, 0x81, 0x02, 0x55, 0xee, 0x81, 0x00, 0xec,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x63, 0xa2,
+    0xa5, 0x01, 0x4d, 0x40, 0x0a, 0xff, 0xe1, 0x00, 0x16, 0x67, 0x4d, 0x40,
+    0x0a, 0xe9, 0xbd, 0x80, 0x88, 0x00, 0x00, 0x03, 0x00, 0x08, 0x00, 0x00,
+    0x03, 0x00, 0xa0, 0x78, 0x91, 0x29, 0xc0, 0x01, 0x00, 0x04, 0x68, 0xce,
+    0x0f, 0xc8, 0x12, 0x54, 0xc3, 0x67, 0xd7, 0xbf, 0x84, 0xd2, 0x66, 0xd7,
+    0x3f, 0x73, 0x73, 0xce, 0x63, 0xc0, 0x8b, 0x63, 0xc5, 0x88, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x67, 0xc8, 0x99, 0x45, 0xa3, 0x87,
+    0x45, 0x4e, 0x43, 0x4f, 0x44, 0x45, 0x52, 0x44, 0x87, 0x8c, 0x4c, 0x61,
+    0x76, 0x63, 0x20, 0x6c, 0x69, 0x62, 0x78, 0x32, 0x36, 0x34, 0x67, 0xc8,
+    0xa1, 0x45, 0xa3, 0x88, 0x44, 0x55, 0x52, 0x41, 0x54, 0x49, 0x4f, 0x4e,
+    0x44, 0x87, 0x93, 0x30, 0x30, 0x3a, 0x30, 0x30, 0x3a, 0x30, 0x30, 0x2e,
+    0x36, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x00, 0x1f, 0x43,
+    0xb6, 0x75, 0xeb, 0xbf, 0x84, 0xee, 0xd4, 0xba, 0x7f, 0xe7, 0x81, 0x00,
+    0xa3, 0x90, 0x81, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x08, 0x65, 0x88,
+    0x84, 0x01, 0xd1, 0x31, 0x40, 0x70, 0xa3, 0x8e, 0x81, 0x01, 0x2c, 0x00,
+    0x00, 0x00, 0x00, 0x06, 0x41, 0x9a, 0x26, 0x01, 0xd4, 0xa0, 0xa3, 0x8e,
+    0x81, 0x00, 0x64, 0x00, 0x00, 0x00, 0x00, 0x06, 0x01, 0x9e, 0x42, 0x80,
+    0xba, 0x50, 0xa3, 0x8e, 0x81, 0x00, 0xc8, 0x00, 0x00, 0x00, 0x00, 0x06,
+    0x01, 0x9e, 0x44, 0x80, 0xba, 0x50, 0xa3, 0x8e, 0x81, 0x01, 0xf4, 0x00,
+    0x00, 0x00, 0x00, 0x06, 0x41, 0x9a, 0x4a, 0x01, 0xd4, 0xa0, 0xa3, 0x8e,
+    0x81, 0x01, 0x90, 0x00, 0x00, 0x00, 0x00, 0x06, 0x01, 0x9e, 0x68, 0x80,
+    0xca, 0x50, 0x1c, 0x53, 0xbb, 0x6b, 0x97, 0xbf, 0x84, 0xb5, 0xba, 0x89,
+    0x00, 0xbb, 0x8f, 0xb3, 0x81, 0x00, 0xb7, 0x8a, 0xf7, 0x81, 0x01, 0xf1,
+    0x82, 0x01, 0xb6, 0xf0, 0x81, 0x09,
+};
+
+// With bframes=0
+static const uint8_t sample_no_bframes[] = {
+    0x1a, 0x45, 0xdf, 0xa3, 0xa3, 0x42, 0x86, 0x81, 0x01, 0x42, 0xf7, 0x81,
+    0x01, 0x42, 0xf2, 0x81, 0x04, 0x42, 0xf3, 0x81, 0x08, 0x42, 0x82, 0x88,
+    0x6d, 0x61, 0x74, 0x72, 0x6f, 0x73, 0x6b, 0x61, 0x42, 0x87, 0x81, 0x04,
+    0x42, 0x85, 0x81, 0x02, 0x18, 0x53, 0x80, 0x67, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x02, 0x3b, 0x11, 0x4d, 0x9b, 0x74, 0xc0, 0xbf, 0x84, 0xcb,
+    0x19, 0x46, 0xce, 0x4d, 0xbb, 0x8b, 0x53, 0xab, 0x84, 0x15, 0x49, 0xa9,
+    0x66, 0x53, 0xac, 0x81, 0xa1, 0x4d, 0xbb, 0x8b, 0x53, 0xab, 0x84, 0x16,
+    0x54, 0xae, 0x6b, 0x53, 0xac, 0x81, 0xcc, 0x4d, 0xbb, 0x8c, 0x53, 0xab,
+    0x84, 0x12, 0x54, 0xc3, 0x67, 0x53, 0xac, 0x82, 0x01, 0x59, 0x4d, 0xbb,
+    0x8c, 0x53, 0xab, 0x84, 0x1c, 0x53, 0xbb, 0x6b, 0x53, 0xac, 0x82, 0x02,
+    0x1f, 0xec, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x53, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x15, 0x49, 0xa9,
+    0x66, 0xa6, 0xbf, 0x84, 0x42, 0xff, 0x03, 0x4a, 0x2a, 0xd7, 0xb1, 0x83,
+    0x0f, 0x42, 0x40, 0x4d, 0x80, 0x84, 0x4c, 0x61, 0x76, 0x66, 0x57, 0x41,
+    0x84, 0x4c, 0x61, 0x76, 0x66, 0x44, 0x89, 0x88, 0x40, 0x82, 0xc0, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x16, 0x54, 0xae, 0x6b, 0x40, 0x87, 0xbf, 0x84,
+    0xda, 0xea, 0x6b, 0xbe, 0xae, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x78, 0xd7, 0x81, 0x01, 0x73, 0xc5, 0x88, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x01, 0x9c, 0x81, 0x00, 0x22, 0xb5, 0x9c, 0x83, 0x75, 0x6e,
+    0x64, 0x88, 0x81, 0x00, 0x86, 0x8f, 0x56, 0x5f, 0x4d, 0x50, 0x45, 0x47,
+    0x34, 0x2f, 0x49, 0x53, 0x4f, 0x2f, 0x41, 0x56, 0x43, 0x83, 0x81, 0x01,
+    0x23, 0xe3, 0x83, 0x84, 0x05, 0xf5, 0xe1, 0x00, 0xe0, 0x89, 0xb0, 0x81,
+    0x10, 0xba, 0x81, 0x10, 0x9a, 0x81, 0x02, 0x55, 0xee, 0x81, 0x00, 0xec,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x63, 0xa2,
+    0xa4, 0x01, 0x42, 0xc0, 0x0a, 0xff, 0xe1, 0x00, 0x15, 0x67, 0x42, 0xc0,
+    0x0a, 0xda, 0x7b, 0x01, 0x10, 0x00, 0x00, 0x03, 0x00, 0x10, 0x00, 0x00,
+    0x03, 0x01, 0x40, 0xf1, 0x22, 0x6a, 0x01, 0x00, 0x04, 0x68, 0xce, 0x0f,
+    0xc8, 0x12, 0x54, 0xc3, 0x67, 0xd7, 0xbf, 0x84, 0xd2, 0x66, 0xd7, 0x3f,
+    0x73, 0x73, 0xce, 0x63, 0xc0, 0x8b, 0x63, 0xc5, 0x88, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x67, 0xc8, 0x99, 0x45, 0xa3, 0x87, 0x45,
+    0x4e, 0x43, 0x4f, 0x44, 0x45, 0x52, 0x44, 0x87, 0x8c, 0x4c, 0x61, 0x76,
+    0x63, 0x20, 0x6c, 0x69, 0x62, 0x78, 0x32, 0x36, 0x34, 0x67, 0xc8, 0xa1,
+    0x45, 0xa3, 0x88, 0x44, 0x55, 0x52, 0x41, 0x54, 0x49, 0x4f, 0x4e, 0x44,
+    0x87, 0x93, 0x30, 0x30, 0x3a, 0x30, 0x30, 0x3a, 0x30, 0x30, 0x2e, 0x36,
+    0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x00, 0x1f, 0x43, 0xb6,
+    0x75, 0xe5, 0xbf, 0x84, 0x99, 0xbc, 0x42, 0xe3, 0xe7, 0x81, 0x00, 0xa3,
+    0x8f, 0x81, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x07, 0x65, 0x88, 0x84,
+    0x3a, 0x26, 0x28, 0x0e, 0xa3, 0x8d, 0x81, 0x00, 0x64, 0x00, 0x00, 0x00,
+    0x00, 0x05, 0x41, 0x9a, 0x20, 0x32, 0x94, 0xa3, 0x8d, 0x81, 0x00, 0xc8,
+    0x00, 0x00, 0x00, 0x00, 0x05, 0x41, 0x9a, 0x40, 0x36, 0x94, 0xa3, 0x8d,
+    0x81, 0x01, 0x2c, 0x00, 0x00, 0x00, 0x00, 0x05, 0x41, 0x9a, 0x60, 0x36,
+    0x94, 0xa3, 0x8d, 0x81, 0x01, 0x90, 0x00, 0x00, 0x00, 0x00, 0x05, 0x41,
+    0x9a, 0x80, 0x36, 0x94, 0xa3, 0x8d, 0x81, 0x01, 0xf4, 0x00, 0x00, 0x00,
+    0x00, 0x05, 0x41, 0x9a, 0xa0, 0x36, 0x94, 0x1c, 0x53, 0xbb, 0x6b, 0x97,
+    0xbf, 0x84, 0x5b, 0x15, 0x3c, 0x12, 0xbb, 0x8f, 0xb3, 0x81, 0x00, 0xb7,
+    0x8a, 0xf7, 0x81, 0x01, 0xf1, 0x82, 0x01, 0xb5, 0xf0, 0x81, 0x09,
+};
+
+#define MEDIA_PACKET_COUNT 6
+
+struct packet_recorder {
+    struct sc_packet_sink packet_sink;
+    bool opened;
+    bool closed;
+    unsigned config_count;
+    unsigned media_count;
+    int64_t last_dts;
+    bool in_order; // dts == pts, strictly increasing
+};
+
+#define DOWNCAST(SINK) container_of(SINK, struct packet_recorder, packet_sink)
+
+static bool
+packet_recorder_open(struct sc_packet_sink *sink, AVCodecContext *ctx) {
+    struct packet_recorder *pr = DOWNCAST(sink);
+    assert(ctx->codec_id == AV_CODEC_ID_H264);
+    pr->opened = true;
+    return true;
+}
+
+static void
+packet_recorder_close(struct sc_packet_sink *sink) {
+    struct packet_recorder *pr = DOWNCAST(sink);
+    pr->closed = true;
+}
+
+static bool
+packet_recorder_push(struct sc_packet_sink *sink, const AVPacket *packet) {
+    struct packet_recorder *pr = DOWNCAST(sink);
+
+    if (packet->pts == AV_NOPTS_VALUE) {
+        ++pr->config_count;
+        return true;
+    }
+
+    if (packet->dts != packet->pts || (pr->media_count
+                                       && packet->dts <= pr->last_dts)) {
+        pr->in_order = false;
+    }
+    pr->last_dts = packet->dts;
+    ++pr->media_count;
+    return true;
+}
+
+static void
+packet_recorder_init(struct packet_recorder *pr) {
+    static const struct sc_packet_sink_ops ops = {
+        .open = packet_recorder_open,
+        .close = packet_recorder_close,
+        .push = packet_recorder_push,
+    };
+
+    pr->packet_sink.ops = &ops;
+    pr->opened = false;
+    pr->closed = false;
+    pr->config_count = 0;
+    pr->media_count = 0;
+    pr->last_dts = 0;
+    pr->in_order = true;
+}
+
+static void
+on_demuxer_ended(struct sc_file_demuxer *demuxer,
+                 enum sc_demuxer_status status, void *userdata) {
+    (void) demuxer;
+    enum sc_demuxer_status *result = userdata;
+    *result = status;
+}
+
+// Demux the sample (unpaced) and return the end status
+static enum sc_demuxer_status
+demux_sample(const uint8_t *data, size_t size, struct packet_recorder *pr) {
+    char filename[] = "/tmp/scrcpy_test_file_demuxer_XXXXXX";
+    int fd = mkstemp(filename);
+    assert(fd != -1);
+    ssize_t w = write(fd, data, size);
+    assert(w == (ssize_t) size);
+    (void) w;
+    close(fd);
+
+    static const struct sc_file_demuxer_callbacks cbs = {
+        .on_ended = on_demuxer_ended,
+    };
+
+    // Overwritten by the callback
+    enum sc_demuxer_status result = (enum sc_demuxer_status) -1;
+
+    struct sc_file_demuxer demuxer;
+    bool ok = sc_file_demuxer_init(&demuxer, "video", filename,
+                                   AVMEDIA_TYPE_VIDEO, NULL, false, &cbs,
+                                   &result);
+    assert(ok);
+
+    packet_recorder_init(pr);
+    sc_packet_source_add_sink(&demuxer.packet_source, &pr->packet_sink);
+
+    ok = sc_file_demuxer_start(&demuxer, 0);
+    assert(ok);
+    (void) ok;
+
+    sc_file_demuxer_join(&demuxer);
+    sc_file_demuxer_destroy(&demuxer);
+
+    unlink(filename);
+
+    assert(result != (enum sc_demuxer_status) -1);
+    return result;
+}
+
+static void
+test_no_bframes(void) {
+    struct packet_recorder pr;
+    enum sc_demuxer_status status =
+        demux_sample(sample_no_bframes, sizeof(sample_no_bframes), &pr);
+
+    assert(status == SC_DEMUXER_STATUS_EOS);
+    assert(pr.opened);
+    assert(pr.closed);
+    // Like sc_demuxer, a config packet is sent first
+    assert(pr.config_count == 1);
+    assert(pr.media_count == MEDIA_PACKET_COUNT);
+    assert(pr.in_order);
+    (void) status;
+}
+
+static void
+test_bframes_rejected(void) {
+    struct packet_recorder pr;
+    enum sc_demuxer_status status =
+        demux_sample(sample_bframes, sizeof(sample_bframes), &pr);
+
+    // The frames would reach the sinks out of presentation order
+    assert(status == SC_DEMUXER_STATUS_ERROR);
+    assert(!pr.opened);
+    assert(!pr.media_count);
+    (void) status;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+#ifndef _WIN32
+    test_no_bframes();
+    test_bframes_rejected();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "common.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "frame_marker.h"
+
+#define LINESIZE (SC_FRAME_MARKER_WIDTH + 32)
+#define HEIGHT (SC_FRAME_MARKER_HEIGHT + 8)
+
+static uint8_t plane[LINESIZE * HEIGHT];
+
+static void test_frame_marker_roundtrip(void) {
+    memset(plane, 0x42, sizeof(plane));
+
+    struct sc_frame_marker marker = {
+        .number = 0x12345678,
+        .timestamp = INT64_C(0x0123456789ABCDEF),
+    };
+    sc_frame_marker_draw(plane, LINESIZE, &marker);
+
+    struct sc_frame_marker read;
+    bool ok = sc_frame_marker_read(plane, LINESIZE, &read);
+    assert(ok);
+    assert(read.number == marker.number);
+    assert(read.timestamp == marker.timestamp);
+
+    // The pixels outside the marker must not be modified
+    for (unsigned y = 0; y < HEIGHT; ++y) {
+        for (unsigned x = 0; x < LINESIZE; ++x) {
+            if (x >= SC_FRAME_MARKER_WIDTH || y >= SC_FRAME_MARKER_HEIGHT) {
+                assert(plane[y * LINESIZE + x] == 0x42);
+            }
+        }
+    }
+}
+
+static void test_frame_marker_noise(void) {
+    struct sc_frame_marker marker = {
+        .number = 42,
+        .timestamp = 1000000,
+    };
+    sc_frame_marker_draw(plane, LINESIZE, &marker);
+
+    // Simulate compression artifacts
+    for (unsigned i = 0; i < sizeof(plane); ++i) {
+        int delta = (int) (i * 7 % 61) - 30;
+        plane[i] = CLAMP(plane[i] + delta, 0, 255);
+    }
+
+    struct sc_frame_marker read;
+    bool ok = sc_frame_marker_read(plane, LINESIZE, &read);
+    assert(ok);
+    assert(read.number == 42);
+    assert(read.timestamp == 1000000);
+}
+
+static void test_frame_marker_invalid(void) {
+    // A uniform image does not contain a valid marker
+    memset(plane, 0, sizeof(plane));
+
+    struct sc_frame_marker read;
+    bool ok = sc_frame_marker_read(plane, LINESIZE, &read);
+    assert(!ok);
+
+    memset(plane, 255, sizeof(plane));
+    ok = sc_frame_marker_read(plane, LINESIZE, &read);
+    assert(!ok);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_frame_marker_roundtrip();
+    test_frame_marker_noise();
+    test_frame_marker_invalid();
+
+    return 0;
+}
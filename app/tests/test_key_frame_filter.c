@@ -0,0 +1,222 @@
+#include "common.h"
+
+#include <assert.h>
+
+#include "key_frame_filter.h"
+#include "util/tick.h"
+#include "util/vclock.h"
+
+#define START SC_TICK_FROM_SEC(1000)
+
+#define FRAME_INTERVAL SC_TICK_FROM_MS(16)
+// Default I-frame interval of the device encoder
+#define KEY_FRAME_INTERVAL SC_TICK_FROM_SEC(10)
+
+// Simulate a device stream decoded for a screen which may be paused (the
+// decisions on pause/resume are the same as sc_screen_set_paused())
+struct player {
+    struct sc_key_frame_filter filter;
+    bool paused;
+    bool sync_requested;
+
+    // capture date of the last decoded frame while paused (if any)
+    bool has_resume_frame;
+    sc_tick resume_frame_date;
+
+    // capture date of the displayed frame, and the date it was displayed
+    sc_tick displayed_date;
+    sc_tick displayed_at;
+
+    unsigned decoded;
+};
+
+static void
+player_init(struct player *p) {
+    sc_key_frame_filter_init(&p->filter);
+    p->paused = false;
+    p->sync_requested = false;
+    p->has_resume_frame = false;
+    p->displayed_date = -1;
+    p->displayed_at = -1;
+    p->decoded = 0;
+}
+
+static void
+player_display(struct player *p, sc_tick date) {
+    sc_tick now = sc_tick_now();
+    // Never display a frame older than one frame interval
+    assert(now - date <= FRAME_INTERVAL);
+    p->displayed_date = date;
+    p->displayed_at = now;
+}
+
+// Capture, transmit and decode the next frame
+static void
+player_step(struct player *p, struct sc_vclock *vclock) {
+    sc_vclock_advance(vclock, FRAME_INTERVAL);
+    sc_tick now = sc_tick_now();
+
+    // On request, the key frame comes with the next captured frame
+    bool key_frame = p->sync_requested
+                  || !((now - START) % KEY_FRAME_INTERVAL);
+    p->sync_requested = false;
+
+    if (sc_key_frame_filter_must_discard(&p->filter, key_frame)) {
+        return;
+    }
+
+    ++p->decoded;
+    sc_key_frame_filter_on_frame(&p->filter);
+
+    if (p->paused) {
+        p->has_resume_frame = true;
+        p->resume_frame_date = now;
+    } else {
+        player_display(p, now);
+    }
+}
+
+static void
+player_run_until(struct player *p, struct sc_vclock *vclock, sc_tick date) {
+    while (sc_tick_now() < date) {
+        player_step(p, vclock);
+    }
+}
+
+static void
+player_set_paused(struct player *p, bool paused) {
+    sc_key_frame_filter_set_discard(&p->filter, paused);
+
+    bool outdated = !sc_key_frame_filter_is_current(&p->filter);
+
+    if (p->paused && p->has_resume_frame && !outdated) {
+        player_display(p, p->resume_frame_date);
+    }
+
+    if (p->paused && outdated) {
+        p->sync_requested = true;
+    }
+
+    p->has_resume_frame = false;
+    p->paused = paused;
+}
+
+static void test_resume_latency(void) {
+    struct sc_vclock vclock;
+    bool ok = sc_vclock_init(&vclock, START, false);
+    assert(ok);
+    sc_vclock_install(&vclock);
+
+    struct player p;
+    player_init(&p);
+
+    // Pause across a periodic key frame (at START + 10s)
+    player_run_until(&p, &vclock, START + SC_TICK_FROM_SEC(8));
+    player_set_paused(&p, true);
+
+    unsigned decoded_before_pause = p.decoded;
+    player_run_until(&p, &vclock, START + SC_TICK_FROM_MS(12500));
+
+    // Only the key frame has been decoded while paused
+    assert(p.decoded == decoded_before_pause + 1);
+    assert(p.has_resume_frame);
+    assert(p.resume_frame_date == START + KEY_FRAME_INTERVAL);
+
+    sc_tick paused_date = p.displayed_date;
+    sc_tick resume_date = sc_tick_now();
+    player_set_paused(&p, false);
+
+    // The 2.5 seconds old key frame is not displayed, a new one is requested
+    assert(p.displayed_date == paused_date);
+    assert(p.sync_requested);
+
+    player_step(&p, &vclock);
+    // The requested key frame is displayed immediately
+    assert(p.displayed_date == resume_date + FRAME_INTERVAL);
+    assert(p.displayed_at - resume_date <= FRAME_INTERVAL);
+
+    // Then every frame is decoded again
+    unsigned decoded = p.decoded;
+    for (unsigned i = 0; i < 60; ++i) {
+        player_step(&p, &vclock);
+    }
+    assert(p.decoded == decoded + 60);
+
+    sc_vclock_uninstall(&vclock);
+    sc_vclock_destroy(&vclock);
+}
+
+static void test_resume_on_key_frame(void) {
+    struct sc_vclock vclock;
+    bool ok = sc_vclock_init(&vclock, START, false);
+    assert(ok);
+    sc_vclock_install(&vclock);
+
+    struct player p;
+    player_init(&p);
+
+    player_run_until(&p, &vclock, START + SC_TICK_FROM_SEC(9));
+    player_set_paused(&p, true);
+
+    // Resume just after the periodic key frame
+    player_run_until(&p, &vclock, START + KEY_FRAME_INTERVAL);
+    assert(p.has_resume_frame);
+
+    player_set_paused(&p, false);
+
+    // The key frame is current, it is displayed at once
+    assert(!p.sync_requested);
+    assert(p.displayed_date == START + KEY_FRAME_INTERVAL);
+    assert(p.displayed_at == START + KEY_FRAME_INTERVAL);
+
+    // The next frames reference it, they are decoded
+    unsigned decoded = p.decoded;
+    player_step(&p, &vclock);
+    assert(p.decoded == decoded + 1);
+
+    sc_vclock_uninstall(&vclock);
+    sc_vclock_destroy(&vclock);
+}
+
+static void test_repause(void) {
+    struct sc_vclock vclock;
+    bool ok = sc_vclock_init(&vclock, START, false);
+    assert(ok);
+    sc_vclock_install(&vclock);
+
+    struct player p;
+    player_init(&p);
+
+    player_run_until(&p, &vclock, START + SC_TICK_FROM_SEC(1));
+    player_set_paused(&p, true);
+    player_run_until(&p, &vclock, START + SC_TICK_FROM_SEC(3));
+
+    // Re-pause: no key frame has been decoded since the pause, the requested
+    // one will become the new resume frame
+    player_set_paused(&p, true);
+    assert(p.sync_requested);
+
+    sc_tick repause_date = sc_tick_now();
+    player_step(&p, &vclock);
+    assert(p.has_resume_frame);
+    assert(p.resume_frame_date == repause_date + FRAME_INTERVAL);
+
+    // The non-key frames are still discarded
+    unsigned decoded = p.decoded;
+    player_run_until(&p, &vclock, START + SC_TICK_FROM_SEC(5));
+    assert(p.decoded == decoded);
+
+    sc_vclock_uninstall(&vclock);
+    sc_vclock_destroy(&vclock);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_resume_latency();
+    test_resume_on_key_frame();
+    test_repause();
+
+    return 0;
+}
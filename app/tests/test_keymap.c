@@ -0,0 +1,350 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "hid/hid_keyboard.h"
+#include "keymap.h"
+
+// Reference implementations: the linear lookups which were replaced by the
+// keymap tables
+
+struct ref_entry {
+    int32_t key;
+    int32_t value;
+};
+
+static const struct ref_entry *
+ref_find_entry(const struct ref_entry entries[], size_t len, int32_t key) {
+    for (size_t i = 0; i < len; ++i) {
+        if (entries[i].key == key) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+#define REF_FIND_ENTRY(MAP, KEY) ref_find_entry(MAP, ARRAY_LEN(MAP), KEY)
+
+static bool
+ref_convert_keycode(enum sc_keycode from, enum android_keycode *to,
+                    uint16_t mod, enum sc_key_inject_mode key_inject_mode) {
+    // Navigation keys and ENTER.
+    // Used in all modes.
+    static const struct ref_entry special_keys[] = {
+        {SC_KEYCODE_RETURN,    AKEYCODE_ENTER},
+        {SC_KEYCODE_KP_ENTER,  AKEYCODE_NUMPAD_ENTER},
+        {SC_KEYCODE_ESCAPE,    AKEYCODE_ESCAPE},
+        {SC_KEYCODE_BACKSPACE, AKEYCODE_DEL},
+        {SC_KEYCODE_TAB,       AKEYCODE_TAB},
+        {SC_KEYCODE_PAGEUP,    AKEYCODE_PAGE_UP},
+        {SC_KEYCODE_DELETE,    AKEYCODE_FORWARD_DEL},
+        {SC_KEYCODE_HOME,      AKEYCODE_MOVE_HOME},
+        {SC_KEYCODE_END,       AKEYCODE_MOVE_END},
+        {SC_KEYCODE_PAGEDOWN,  AKEYCODE_PAGE_DOWN},
+        {SC_KEYCODE_RIGHT,     AKEYCODE_DPAD_RIGHT},
+        {SC_KEYCODE_LEFT,      AKEYCODE_DPAD_LEFT},
+        {SC_KEYCODE_DOWN,      AKEYCODE_DPAD_DOWN},
+        {SC_KEYCODE_UP,        AKEYCODE_DPAD_UP},
+        {SC_KEYCODE_LCTRL,     AKEYCODE_CTRL_LEFT},
+        {SC_KEYCODE_RCTRL,     AKEYCODE_CTRL_RIGHT},
+        {SC_KEYCODE_LSHIFT,    AKEYCODE_SHIFT_LEFT},
+        {SC_KEYCODE_RSHIFT,    AKEYCODE_SHIFT_RIGHT},
+        {SC_KEYCODE_LALT,      AKEYCODE_ALT_LEFT},
+        {SC_KEYCODE_RALT,      AKEYCODE_ALT_RIGHT},
+        {SC_KEYCODE_LGUI,      AKEYCODE_META_LEFT},
+        {SC_KEYCODE_RGUI,      AKEYCODE_META_RIGHT},
+    };
+
+    // Numpad navigation keys.
+    // Used in all modes, when NumLock and Shift are disabled.
+    static const struct ref_entry kp_nav_keys[] = {
+        {SC_KEYCODE_KP_0,      AKEYCODE_INSERT},
+        {SC_KEYCODE_KP_1,      AKEYCODE_MOVE_END},
+        {SC_KEYCODE_KP_2,      AKEYCODE_DPAD_DOWN},
+        {SC_KEYCODE_KP_3,      AKEYCODE_PAGE_DOWN},
+        {SC_KEYCODE_KP_4,      AKEYCODE_DPAD_LEFT},
+        {SC_KEYCODE_KP_6,      AKEYCODE_DPAD_RIGHT},
+        {SC_KEYCODE_KP_7,      AKEYCODE_MOVE_HOME},
+        {SC_KEYCODE_KP_8,      AKEYCODE_DPAD_UP},
+        {SC_KEYCODE_KP_9,      AKEYCODE_PAGE_UP},
+        {SC_KEYCODE_KP_PERIOD, AKEYCODE_FORWARD_DEL},
+    };
+
+    // Letters and space.
+    // Used in non-text mode.
+    static const struct ref_entry alphaspace_keys[] = {
+        {SC_KEYCODE_a,         AKEYCODE_A},
+        {SC_KEYCODE_b,         AKEYCODE_B},
+        {SC_KEYCODE_c,         AKEYCODE_C},
+        {SC_KEYCODE_d,         AKEYCODE_D},
+        {SC_KEYCODE_e,         AKEYCODE_E},
+        {SC_KEYCODE_f,         AKEYCODE_F},
+        {SC_KEYCODE_g,         AKEYCODE_G},
+        {SC_KEYCODE_h,         AKEYCODE_H},
+        {SC_KEYCODE_i,         AKEYCODE_I},
+        {SC_KEYCODE_j,         AKEYCODE_J},
+        {SC_KEYCODE_k,         AKEYCODE_K},
+        {SC_KEYCODE_l,         AKEYCODE_L},
+        {SC_KEYCODE_m,         AKEYCODE_M},
+        {SC_KEYCODE_n,         AKEYCODE_N},
+        {SC_KEYCODE_o,         AKEYCODE_O},
+        {SC_KEYCODE_p,         AKEYCODE_P},
+        {SC_KEYCODE_q,         AKEYCODE_Q},
+        {SC_KEYCODE_r,         AKEYCODE_R},
+        {SC_KEYCODE_s,         AKEYCODE_S},
+        {SC_KEYCODE_t,         AKEYCODE_T},
+        {SC_KEYCODE_u,         AKEYCODE_U},
+        {SC_KEYCODE_v,         AKEYCODE_V},
+        {SC_KEYCODE_w,         AKEYCODE_W},
+        {SC_KEYCODE_x,         AKEYCODE_X},
+        {SC_KEYCODE_y,         AKEYCODE_Y},
+        {SC_KEYCODE_z,         AKEYCODE_Z},
+        {SC_KEYCODE_SPACE,     AKEYCODE_SPACE},
+    };
+
+    // Numbers and punctuation keys.
+    // Used in raw mode only.
+    static const struct ref_entry numbers_punct_keys[] = {
+        {SC_KEYCODE_HASH,          AKEYCODE_POUND},
+        {SC_KEYCODE_PERCENT,       AKEYCODE_PERIOD},
+        {SC_KEYCODE_QUOTE,         AKEYCODE_APOSTROPHE},
+        {SC_KEYCODE_ASTERISK,      AKEYCODE_STAR},
+        {SC_KEYCODE_PLUS,          AKEYCODE_PLUS},
+        {SC_KEYCODE_COMMA,         AKEYCODE_COMMA},
+        {SC_KEYCODE_MINUS,         AKEYCODE_MINUS},
+        {SC_KEYCODE_PERIOD,        AKEYCODE_PERIOD},
+        {SC_KEYCODE_SLASH,         AKEYCODE_SLASH},
+        {SC_KEYCODE_0,             AKEYCODE_0},
+        {SC_KEYCODE_1,             AKEYCODE_1},
+        {SC_KEYCODE_2,             AKEYCODE_2},
+        {SC_KEYCODE_3,             AKEYCODE_3},
+        {SC_KEYCODE_4,             AKEYCODE_4},
+        {SC_KEYCODE_5,             AKEYCODE_5},
+        {SC_KEYCODE_6,             AKEYCODE_6},
+        {SC_KEYCODE_7,             AKEYCODE_7},
+        {SC_KEYCODE_8,             AKEYCODE_8},
+        {SC_KEYCODE_9,             AKEYCODE_9},
+        {SC_KEYCODE_SEMICOLON,     AKEYCODE_SEMICOLON},
+        {SC_KEYCODE_EQUALS,        AKEYCODE_EQUALS},
+        {SC_KEYCODE_AT,            AKEYCODE_AT},
+        {SC_KEYCODE_LEFTBRACKET,   AKEYCODE_LEFT_BRACKET},
+        {SC_KEYCODE_BACKSLASH,     AKEYCODE_BACKSLASH},
+        {SC_KEYCODE_RIGHTBRACKET,  AKEYCODE_RIGHT_BRACKET},
+        {SC_KEYCODE_BACKQUOTE,     AKEYCODE_GRAVE},
+        {SC_KEYCODE_KP_1,          AKEYCODE_NUMPAD_1},
+        {SC_KEYCODE_KP_2,          AKEYCODE_NUMPAD_2},
+        {SC_KEYCODE_KP_3,          AKEYCODE_NUMPAD_3},
+        {SC_KEYCODE_KP_4,          AKEYCODE_NUMPAD_4},
+        {SC_KEYCODE_KP_5,          AKEYCODE_NUMPAD_5},
+        {SC_KEYCODE_KP_6,          AKEYCODE_NUMPAD_6},
+        {SC_KEYCODE_KP_7,          AKEYCODE_NUMPAD_7},
+        {SC_KEYCODE_KP_8,          AKEYCODE_NUMPAD_8},
+        {SC_KEYCODE_KP_9,          AKEYCODE_NUMPAD_9},
+        {SC_KEYCODE_KP_0,          AKEYCODE_NUMPAD_0},
+        {SC_KEYCODE_KP_DIVIDE,     AKEYCODE_NUMPAD_DIVIDE},
+        {SC_KEYCODE_KP_MULTIPLY,   AKEYCODE_NUMPAD_MULTIPLY},
+        {SC_KEYCODE_KP_MINUS,      AKEYCODE_NUMPAD_SUBTRACT},
+        {SC_KEYCODE_KP_PLUS,       AKEYCODE_NUMPAD_ADD},
+        {SC_KEYCODE_KP_PERIOD,     AKEYCODE_NUMPAD_DOT},
+        {SC_KEYCODE_KP_EQUALS,     AKEYCODE_NUMPAD_EQUALS},
+        {SC_KEYCODE_KP_LEFTPAREN,  AKEYCODE_NUMPAD_LEFT_PAREN},
+        {SC_KEYCODE_KP_RIGHTPAREN, AKEYCODE_NUMPAD_RIGHT_PAREN},
+    };
+
+    const struct ref_entry *entry =
+        REF_FIND_ENTRY(special_keys, from);
+    if (entry) {
+        *to = entry->value;
+        return true;
+    }
+
+    if (!(mod & (SC_MOD_NUM | SC_MOD_LSHIFT | SC_MOD_RSHIFT))) {
+        // Handle Numpad events when Num Lock is disabled
+        // If SHIFT is pressed, a text event will be sent instead
+        entry = REF_FIND_ENTRY(kp_nav_keys, from);
+        if (entry) {
+            *to = entry->value;
+            return true;
+        }
+    }
+
+    if (key_inject_mode == SC_KEY_INJECT_MODE_TEXT &&
+            !(mod & (SC_MOD_LCTRL | SC_MOD_RCTRL))) {
+        // do not forward alpha and space key events (unless Ctrl is pressed)
+        return false;
+    }
+
+    // Handle letters and space
+    entry = REF_FIND_ENTRY(alphaspace_keys, from);
+    if (entry) {
+        *to = entry->value;
+        return true;
+    }
+
+    if (key_inject_mode == SC_KEY_INJECT_MODE_RAW) {
+        entry = REF_FIND_ENTRY(numbers_punct_keys, from);
+        if (entry) {
+            *to = entry->value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static enum android_metastate
+ref_convert_meta_state(uint16_t mod) {
+    enum android_metastate metastate = 0;
+    if (mod & SC_MOD_LSHIFT) {
+        metastate |= AMETA_SHIFT_LEFT_ON;
+    }
+    if (mod & SC_MOD_RSHIFT) {
+        metastate |= AMETA_SHIFT_RIGHT_ON;
+    }
+    if (mod & SC_MOD_LCTRL) {
+        metastate |= AMETA_CTRL_LEFT_ON;
+    }
+    if (mod & SC_MOD_RCTRL) {
+        metastate |= AMETA_CTRL_RIGHT_ON;
+    }
+    if (mod & SC_MOD_LALT) {
+        metastate |= AMETA_ALT_LEFT_ON;
+    }
+    if (mod & SC_MOD_RALT) {
+        metastate |= AMETA_ALT_RIGHT_ON;
+    }
+    if (mod & SC_MOD_LGUI) {
+        metastate |= AMETA_META_LEFT_ON;
+    }
+    if (mod & SC_MOD_RGUI) {
+        metastate |= AMETA_META_RIGHT_ON;
+    }
+    if (mod & SC_MOD_NUM) {
+        metastate |= AMETA_NUM_LOCK_ON;
+    }
+    if (mod & SC_MOD_CAPS) {
+        metastate |= AMETA_CAPS_LOCK_ON;
+    }
+
+    if (metastate & (AMETA_SHIFT_LEFT_ON | AMETA_SHIFT_RIGHT_ON)) {
+        metastate |= AMETA_SHIFT_ON;
+    }
+    if (metastate & (AMETA_CTRL_LEFT_ON | AMETA_CTRL_RIGHT_ON)) {
+        metastate |= AMETA_CTRL_ON;
+    }
+    if (metastate & (AMETA_ALT_LEFT_ON | AMETA_ALT_RIGHT_ON)) {
+        metastate |= AMETA_ALT_ON;
+    }
+    if (metastate & (AMETA_META_LEFT_ON | AMETA_META_RIGHT_ON)) {
+        metastate |= AMETA_META_ON;
+    }
+
+    return metastate;
+}
+
+static uint8_t
+ref_hid_mods(uint16_t mod) {
+    uint8_t mods = SC_HID_MOD_NONE;
+    if (mod & SC_MOD_LCTRL) {
+        mods |= SC_HID_MOD_LEFT_CONTROL;
+    }
+    if (mod & SC_MOD_LSHIFT) {
+        mods |= SC_HID_MOD_LEFT_SHIFT;
+    }
+    if (mod & SC_MOD_LALT) {
+        mods |= SC_HID_MOD_LEFT_ALT;
+    }
+    if (mod & SC_MOD_LGUI) {
+        mods |= SC_HID_MOD_LEFT_GUI;
+    }
+    if (mod & SC_MOD_RCTRL) {
+        mods |= SC_HID_MOD_RIGHT_CONTROL;
+    }
+    if (mod & SC_MOD_RSHIFT) {
+        mods |= SC_HID_MOD_RIGHT_SHIFT;
+    }
+    if (mod & SC_MOD_RALT) {
+        mods |= SC_HID_MOD_RIGHT_ALT;
+    }
+    if (mod & SC_MOD_RGUI) {
+        mods |= SC_HID_MOD_RIGHT_GUI;
+    }
+    return mods;
+}
+
+static void
+check_keycode(int32_t keycode, uint16_t mods_state) {
+    static const enum sc_key_inject_mode modes[] = {
+        SC_KEY_INJECT_MODE_MIXED,
+        SC_KEY_INJECT_MODE_TEXT,
+        SC_KEY_INJECT_MODE_RAW,
+    };
+
+    for (size_t i = 0; i < ARRAY_LEN(modes); ++i) {
+        enum android_keycode expected = AKEYCODE_UNKNOWN;
+        enum android_keycode actual = AKEYCODE_UNKNOWN;
+        bool expected_ok = ref_convert_keycode(keycode, &expected, mods_state,
+                                               modes[i]);
+        bool ok = sc_keymap_to_android_keycode(keycode, mods_state, modes[i],
+                                               &actual);
+        assert(ok == expected_ok);
+        assert(actual == expected);
+    }
+}
+
+static void test_keycodes(void) {
+    // The modifiers which impact the keycode conversion (and some others)
+    static const uint16_t mods[] = {
+        SC_MOD_NUM, SC_MOD_LSHIFT, SC_MOD_RSHIFT, SC_MOD_LCTRL, SC_MOD_RCTRL,
+        SC_MOD_CAPS, SC_MOD_LALT,
+    };
+
+    for (unsigned m = 0; m < (1u << ARRAY_LEN(mods)); ++m) {
+        uint16_t mods_state = 0;
+        for (size_t i = 0; i < ARRAY_LEN(mods); ++i) {
+            if (m & (1u << i)) {
+                mods_state |= mods[i];
+            }
+        }
+
+        // All the characters of the Basic Multilingual Plane, including
+        // non-ASCII characters (produced by some keyboard layouts)
+        for (int32_t keycode = -8; keycode < 0x10000; ++keycode) {
+            check_keycode(keycode, mods_state);
+        }
+
+        // All the keycodes derived from a scancode, and beyond
+        for (int32_t scancode = 0; scancode < 2 * SDL_NUM_SCANCODES;
+                ++scancode) {
+            check_keycode(scancode | SDLK_SCANCODE_MASK, mods_state);
+        }
+
+        check_keycode(INT32_MAX, mods_state);
+        check_keycode(INT32_MIN, mods_state);
+    }
+}
+
+static void test_metastate(void) {
+    for (uint32_t mods_state = 0; mods_state <= UINT16_MAX; ++mods_state) {
+        assert(sc_keymap_to_android_metastate(mods_state)
+                == ref_convert_meta_state(mods_state));
+    }
+}
+
+static void test_hid_mods(void) {
+    for (uint32_t mods_state = 0; mods_state <= UINT16_MAX; ++mods_state) {
+        assert(sc_keymap_to_hid_mods(mods_state) == ref_hid_mods(mods_state));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_keycodes();
+    test_metastate();
+    test_hid_mods();
+
+    return 0;
+}
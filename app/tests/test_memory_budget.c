@@ -0,0 +1,530 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+# include <unistd.h>
+# include <sys/socket.h>
+#endif
+#include <libavcodec/avcodec.h>
+#include <libavutil/frame.h>
+
+#include "controller.h"
+#include "delay_buffer.h"
+#include "memory_budget.h"
+#include "recorder.h"
+#include "util/thread.h"
+
+#define THREAD_COUNT 4
+#define ITERATIONS 100000
+// 1 MB, so that the controller quota is 100 kB
+#define BUDGET 1000000
+
+static void test_disabled(void) {
+    sc_memory_budget_init(0);
+    assert(!sc_memory_budget_is_enabled());
+
+    for (int i = 0; i < 100; ++i) {
+        bool ok = sc_memory_budget_acquire(SC_MEMORY_POOL_RECORDER, 1 << 30);
+        assert(ok);
+        (void) ok;
+    }
+    assert(sc_memory_budget_get_used(SC_MEMORY_POOL_RECORDER) == 0);
+}
+
+static void test_quotas(void) {
+    sc_memory_budget_init(BUDGET);
+    assert(sc_memory_budget_is_enabled());
+
+    uint64_t total = 0;
+    for (unsigned i = 0; i < SC_MEMORY_POOL_COUNT; ++i) {
+        uint64_t quota = sc_memory_budget_get_quota(i);
+        assert(quota);
+        total += quota;
+    }
+    assert(total <= BUDGET);
+    (void) total;
+
+    uint64_t quota = sc_memory_budget_get_quota(SC_MEMORY_POOL_CONTROLLER);
+    assert(quota == 100000);
+
+    // Fill the pool up to its quota
+    for (int i = 0; i < 100; ++i) {
+        bool ok = sc_memory_budget_acquire(SC_MEMORY_POOL_CONTROLLER, 1000);
+        assert(ok);
+        (void) ok;
+    }
+    assert(sc_memory_budget_get_used(SC_MEMORY_POOL_CONTROLLER) == quota);
+
+    bool ok = sc_memory_budget_acquire(SC_MEMORY_POOL_CONTROLLER, 1);
+    assert(!ok);
+
+    // The other pools are independent
+    ok = sc_memory_budget_acquire(SC_MEMORY_POOL_RECORDER, 1000);
+    assert(ok);
+    sc_memory_budget_release(SC_MEMORY_POOL_RECORDER, 1000);
+
+    sc_memory_budget_release(SC_MEMORY_POOL_CONTROLLER, 1000);
+    ok = sc_memory_budget_acquire(SC_MEMORY_POOL_CONTROLLER, 1000);
+    assert(ok);
+
+    // Forced acquisitions may exceed the quota
+    sc_memory_budget_force_acquire(SC_MEMORY_POOL_CONTROLLER, 5000);
+    assert(sc_memory_budget_get_used(SC_MEMORY_POOL_CONTROLLER)
+            == quota + 5000);
+    sc_memory_budget_release(SC_MEMORY_POOL_CONTROLLER, 5000);
+
+    for (int i = 0; i < 100; ++i) {
+        sc_memory_budget_release(SC_MEMORY_POOL_CONTROLLER, 1000);
+    }
+    assert(sc_memory_budget_get_used(SC_MEMORY_POOL_CONTROLLER) == 0);
+
+    // An item larger than the quota is accepted if the pool is empty
+    ok = sc_memory_budget_acquire(SC_MEMORY_POOL_CONTROLLER, 2 * quota);
+    assert(ok);
+    ok = sc_memory_budget_acquire(SC_MEMORY_POOL_CONTROLLER, 1);
+    assert(!ok);
+    sc_memory_budget_release(SC_MEMORY_POOL_CONTROLLER, 2 * quota);
+    assert(sc_memory_budget_get_used(SC_MEMORY_POOL_CONTROLLER) == 0);
+
+    (void) ok;
+}
+
+static int
+run_stress(void *data) {
+    unsigned seed = *(unsigned *) data;
+    uint64_t quota = sc_memory_budget_get_quota(SC_MEMORY_POOL_DELAY_BUFFER);
+
+    // Keep up to 16 items, as a bounded queue would
+    size_t items[16];
+    unsigned count = 0;
+
+    for (int i = 0; i < ITERATIONS; ++i) {
+        seed = seed * 1103515245 + 12345;
+        size_t size = 1 + (seed >> 16) % 20000;
+
+        if (count < 16 && (seed & 1)) {
+            if (sc_memory_budget_acquire(SC_MEMORY_POOL_DELAY_BUFFER, size)) {
+                items[count++] = size;
+            }
+        } else if (count) {
+            sc_memory_budget_release(SC_MEMORY_POOL_DELAY_BUFFER,
+                                     items[--count]);
+        }
+
+        uint64_t used =
+            sc_memory_budget_get_used(SC_MEMORY_POOL_DELAY_BUFFER);
+        assert(used <= quota);
+        (void) used;
+    }
+
+    while (count) {
+        sc_memory_budget_release(SC_MEMORY_POOL_DELAY_BUFFER, items[--count]);
+    }
+
+    (void) quota;
+    return 0;
+}
+
+static void test_concurrent_stress(void) {
+    sc_memory_budget_init(BUDGET);
+
+    sc_thread threads[THREAD_COUNT];
+    unsigned seeds[THREAD_COUNT];
+    for (unsigned i = 0; i < THREAD_COUNT; ++i) {
+        seeds[i] = 42 + i;
+        bool ok = sc_thread_create(&threads[i], run_stress, "test-stress",
+                                   &seeds[i]);
+        assert(ok);
+        (void) ok;
+    }
+
+    for (unsigned i = 0; i < THREAD_COUNT; ++i) {
+        sc_thread_join(&threads[i], NULL);
+    }
+
+    assert(sc_memory_budget_get_used(SC_MEMORY_POOL_DELAY_BUFFER) == 0);
+}
+
+static void
+assert_within_quota(enum sc_memory_pool pool) {
+    uint64_t used = sc_memory_budget_get_used(pool);
+    uint64_t quota = sc_memory_budget_get_quota(pool);
+    assert(used <= quota);
+    (void) used;
+    (void) quota;
+}
+
+static bool
+null_frame_sink_open(struct sc_frame_sink *sink, const AVCodecContext *ctx) {
+    (void) sink;
+    (void) ctx;
+    return true;
+}
+
+static void
+null_frame_sink_close(struct sc_frame_sink *sink) {
+    (void) sink;
+}
+
+static bool
+null_frame_sink_push(struct sc_frame_sink *sink, const AVFrame *frame) {
+    (void) sink;
+    (void) frame;
+    return true;
+}
+
+// Push frames to a delay buffer which never releases them (the delay is far
+// longer than the test)
+static void test_delay_buffer_queue(void) {
+    sc_memory_budget_init(BUDGET);
+
+    struct sc_delay_buffer db;
+    sc_delay_buffer_init(&db, SC_TICK_FROM_SEC(3600), false);
+
+    static const struct sc_frame_sink_ops null_ops = {
+        .open = null_frame_sink_open,
+        .close = null_frame_sink_close,
+        .push = null_frame_sink_push,
+    };
+    struct sc_frame_sink null_sink = {.ops = &null_ops};
+    sc_frame_source_add_sink(&db.frame_source, &null_sink);
+
+    struct sc_frame_sink *sink = &db.frame_sink;
+    bool ok = sink->ops->open(sink, NULL);
+    assert(ok);
+
+    AVFrame *frame = av_frame_alloc();
+    assert(frame);
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = 320;
+    frame->height = 240;
+    int r = av_frame_get_buffer(frame, 0);
+    assert(!r);
+
+    // About 115 kB per frame, for a quota of 400 kB
+    for (int i = 0; i < 100; ++i) {
+        frame->pts = (int64_t) i * 16666;
+        ok = sink->ops->push(sink, frame);
+        assert(ok);
+        assert_within_quota(SC_MEMORY_POOL_DELAY_BUFFER);
+    }
+
+    // The frames above the quota have been dropped
+    assert(db.dropped > 0);
+
+    sink->ops->close(sink);
+    assert(sc_memory_budget_get_used(SC_MEMORY_POOL_DELAY_BUFFER) == 0);
+
+    av_frame_free(&frame);
+    (void) ok;
+    (void) r;
+}
+
+#ifndef _WIN32
+// The receiver is not involved (nothing is received from the device)
+bool
+sc_receiver_init(struct sc_receiver *receiver, sc_socket control_socket,
+                 const struct sc_receiver_callbacks *cbs, void *cbs_userdata) {
+    (void) receiver;
+    (void) control_socket;
+    (void) cbs;
+    (void) cbs_userdata;
+    return true;
+}
+
+void
+sc_receiver_destroy(struct sc_receiver *receiver) {
+    (void) receiver;
+}
+
+bool
+sc_receiver_start(struct sc_receiver *receiver) {
+    (void) receiver;
+    return true;
+}
+
+void
+sc_receiver_join(struct sc_receiver *receiver) {
+    (void) receiver;
+}
+
+static void
+on_controller_ended(struct sc_controller *controller, bool error,
+                    void *userdata) {
+    (void) controller;
+    (void) error;
+    (void) userdata;
+}
+
+static const struct sc_controller_callbacks controller_cbs = {
+    .on_ended = on_controller_ended,
+};
+
+#define TEXT_LENGTH 300
+
+static void
+make_text_msg(struct sc_control_msg *msg) {
+    char *text = malloc(TEXT_LENGTH + 1);
+    assert(text);
+    memset(text, 'a', TEXT_LENGTH);
+    text[TEXT_LENGTH] = '\0';
+
+    msg->type = SC_CONTROL_MSG_TYPE_INJECT_TEXT;
+    msg->inject_text.text = text;
+}
+
+// Push messages to a controller whose socket is never read (and whose thread
+// is not started): once the socket buffer is full, the messages are queued
+static void test_controller_queue(void) {
+    // The controller quota is 10 kB, i.e. less than SC_CONTROL_MSG_QUEUE_LIMIT
+    // text messages
+    sc_memory_budget_init(BUDGET / 10);
+
+    int sockets[2];
+    int r = socketpair(AF_UNIX, SOCK_STREAM, 0, sockets);
+    assert(!r);
+
+    static struct sc_controller controller;
+    bool ok = sc_controller_init(&controller, sockets[0], &controller_cbs,
+                                 NULL);
+    assert(ok);
+
+    unsigned dropped = 0;
+    for (int i = 0; i < 5000; ++i) {
+        struct sc_control_msg msg;
+        make_text_msg(&msg);
+        if (!sc_controller_push_msg(&controller, &msg)) {
+            sc_control_msg_destroy(&msg);
+            ++dropped;
+        }
+        assert_within_quota(SC_MEMORY_POOL_CONTROLLER);
+    }
+    assert(dropped);
+
+    // Non-droppable messages are never refused (but they are accounted)
+    uint64_t used = sc_memory_budget_get_used(SC_MEMORY_POOL_CONTROLLER);
+    for (int i = 0; i < 10; ++i) {
+        struct sc_control_msg msg = {
+            .type = SC_CONTROL_MSG_TYPE_REQUEST_SYNC_FRAME,
+        };
+        ok = sc_controller_push_msg(&controller, &msg);
+        assert(ok);
+    }
+    assert(sc_memory_budget_get_used(SC_MEMORY_POOL_CONTROLLER) > used);
+
+    sc_controller_destroy(&controller);
+    assert(sc_memory_budget_get_used(SC_MEMORY_POOL_CONTROLLER) == 0);
+
+    close(sockets[0]);
+    close(sockets[1]);
+
+    (void) r;
+    (void) ok;
+    (void) used;
+}
+
+#define WAIT_MSG_COUNT 2000
+
+static int
+run_slow_reader(void *data) {
+    int fd = *(int *) data;
+
+    // INJECT_TEXT: type, u32 length, text
+    size_t expected = (size_t) WAIT_MSG_COUNT * (5 + TEXT_LENGTH);
+    size_t total = 0;
+    char buf[4096];
+    while (total < expected) {
+        usleep(100);
+        ssize_t r = read(fd, buf, sizeof(buf));
+        assert(r > 0);
+        total += r;
+    }
+
+    assert(total == expected);
+    return 0;
+}
+
+// Push messages with sc_controller_push_msg_wait() to a controller whose
+// socket is read slowly: they must never be dropped, and the memory must
+// remain within the quota
+static void test_controller_queue_wait(void) {
+    sc_memory_budget_init(BUDGET / 10);
+
+    int sockets[2];
+    int r = socketpair(AF_UNIX, SOCK_STREAM, 0, sockets);
+    assert(!r);
+
+    static struct sc_controller controller;
+    bool ok = sc_controller_init(&controller, sockets[0], &controller_cbs,
+                                 NULL);
+    assert(ok);
+
+    ok = sc_controller_start(&controller);
+    assert(ok);
+
+    sc_thread reader;
+    ok = sc_thread_create(&reader, run_slow_reader, "test-reader",
+                          &sockets[1]);
+    assert(ok);
+
+    for (int i = 0; i < WAIT_MSG_COUNT; ++i) {
+        struct sc_control_msg msg;
+        make_text_msg(&msg);
+        ok = sc_controller_push_msg_wait(&controller, &msg);
+        assert(ok);
+        assert_within_quota(SC_MEMORY_POOL_CONTROLLER);
+    }
+
+    // All the messages are received
+    sc_thread_join(&reader, NULL);
+
+    sc_controller_stop(&controller);
+    shutdown(sockets[0], SHUT_RDWR);
+    sc_controller_join(&controller);
+    sc_controller_destroy(&controller);
+    assert(sc_memory_budget_get_used(SC_MEMORY_POOL_CONTROLLER) == 0);
+
+    close(sockets[0]);
+    close(sockets[1]);
+
+    (void) r;
+    (void) ok;
+}
+
+static void
+on_recorder_ended(struct sc_recorder *recorder, bool success, void *userdata) {
+    (void) recorder;
+    (void) success;
+    (void) userdata;
+}
+
+#define VIDEO_PACKET_SIZE 10000
+
+struct video_producer {
+    struct sc_packet_sink *sink;
+    unsigned pushed;
+};
+
+static int
+run_video_producer(void *data) {
+    struct video_producer *producer = data;
+    struct sc_packet_sink *sink = producer->sink;
+
+    AVPacket *packet = av_packet_alloc();
+    assert(packet);
+
+    for (int i = 0; i < 10000; ++i) {
+        int r = av_new_packet(packet, VIDEO_PACKET_SIZE);
+        assert(!r);
+        (void) r;
+        memset(packet->data, 0, VIDEO_PACKET_SIZE);
+        // The first packet is a config packet
+        packet->pts = i ? (int64_t) i * 16666 : AV_NOPTS_VALUE;
+        packet->dts = packet->pts;
+
+        // Blocks while the quota is exhausted
+        bool ok = sink->ops->push(sink, packet);
+        av_packet_unref(packet);
+        if (!ok) {
+            // The recorder is stopped
+            break;
+        }
+        assert_within_quota(SC_MEMORY_POOL_RECORDER);
+        ++producer->pushed;
+    }
+
+    av_packet_free(&packet);
+    return 0;
+}
+
+// Push video packets to a recorder which never records them (it waits for the
+// audio stream, never opened): the producer must be blocked by the quota
+static void test_recorder_queue(void) {
+    sc_memory_budget_init(BUDGET);
+
+    char filename[] = "/tmp/scrcpy_test_memory_budget_XXXXXX";
+    int fd = mkstemp(filename);
+    assert(fd != -1);
+    close(fd);
+
+    static const struct sc_recorder_callbacks cbs = {
+        .on_ended = on_recorder_ended,
+    };
+
+    static struct sc_recorder recorder;
+    bool ok = sc_recorder_init(&recorder, filename, SC_RECORD_FORMAT_MKV,
+                               true, true, SC_ORIENTATION_0, &cbs, NULL);
+    assert(ok);
+
+    ok = sc_recorder_start(&recorder);
+    assert(ok);
+
+    // Let the recorder thread open the output file (the video stream is
+    // added to it)
+    usleep(100000);
+
+    AVCodecContext *ctx = avcodec_alloc_context3(NULL);
+    assert(ctx);
+    ctx->codec_type = AVMEDIA_TYPE_VIDEO;
+    ctx->codec_id = AV_CODEC_ID_H264;
+    ctx->width = 320;
+    ctx->height = 240;
+
+    struct sc_packet_sink *sink = &recorder.video_packet_sink;
+    ok = sink->ops->open(sink, ctx);
+    assert(ok);
+
+    struct video_producer producer = {
+        .sink = sink,
+        .pushed = 0,
+    };
+    sc_thread thread;
+    ok = sc_thread_create(&thread, run_video_producer, "test-producer",
+                          &producer);
+    assert(ok);
+
+    // Wait for the quota to be exhausted
+    uint64_t quota = sc_memory_budget_get_quota(SC_MEMORY_POOL_RECORDER);
+    while (sc_memory_budget_get_used(SC_MEMORY_POOL_RECORDER)
+            + VIDEO_PACKET_SIZE <= quota) {
+        usleep(1000);
+    }
+    // Let the producer attempt to push more packets
+    usleep(100000);
+    assert_within_quota(SC_MEMORY_POOL_RECORDER);
+
+    sc_recorder_stop(&recorder);
+    sc_thread_join(&thread, NULL);
+    // The producer has been blocked
+    assert(producer.pushed < 10000);
+
+    sink->ops->close(sink);
+    sc_recorder_join(&recorder);
+    sc_recorder_destroy(&recorder);
+    assert(sc_memory_budget_get_used(SC_MEMORY_POOL_RECORDER) == 0);
+
+    avcodec_free_context(&ctx);
+    unlink(filename);
+
+    (void) ok;
+    (void) quota;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_disabled();
+    test_quotas();
+    test_concurrent_stress();
+    test_delay_buffer_queue();
+#ifndef _WIN32
+    test_controller_queue();
+    test_controller_queue_wait();
+    test_recorder_queue();
+#endif
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+# include <signal.h>
+# include <unistd.h>
+# include <sys/wait.h>
+#endif
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+
+#include "compat.h"
+#include "recorder.h"
+
+#define SAMPLE_RATE 48000
+#define SAMPLES_PER_PACKET 1024
+// 3 seconds of AAC packets
+#define PACKET_COUNT (3 * SAMPLE_RATE / SAMPLES_PER_PACKET)
+// Fragments are written at least every second
+#define FRAGMENT_MAX_PACKETS (SAMPLE_RATE / SAMPLES_PER_PACKET + 2)
+
+#ifndef _WIN32
+static void
+on_recorder_ended(struct sc_recorder *recorder, bool success, void *userdata) {
+    (void) recorder;
+    (void) success;
+    (void) userdata;
+}
+
+static void
+push_packet(struct sc_packet_sink *sink, AVPacket *packet, int64_t pts,
+            uint8_t value) {
+    // The content is not decoded, but it must not start with an ADTS sync
+    // word (rejected by the MP4 muxer)
+    uint8_t data[64];
+    memset(data, value, sizeof(data));
+    data[0] = 0x21;
+
+    int r = av_new_packet(packet, sizeof(data));
+    assert(!r);
+    (void) r;
+    memcpy(packet->data, data, sizeof(data));
+    packet->pts = pts;
+    packet->dts = pts;
+
+    bool ok = sink->ops->push(sink, packet);
+    assert(ok);
+    (void) ok;
+
+    av_packet_unref(packet);
+}
+
+static bool
+recorder_queue_is_empty(struct sc_recorder *recorder) {
+    // Safe from any thread
+    return sc_spsc_queue_is_empty(&recorder->audio_queue);
+}
+
+// Record an AAC stream, then get killed before the recorder is stopped
+static void
+record_then_die(const char *filename) {
+    static const struct sc_recorder_callbacks cbs = {
+        .on_ended = on_recorder_ended,
+    };
+
+    struct sc_recorder recorder;
+    bool ok = sc_recorder_init(&recorder, filename, SC_RECORD_FORMAT_FMP4,
+                               false, true, SC_ORIENTATION_0, &cbs, NULL);
+    assert(ok);
+
+    ok = sc_recorder_start(&recorder);
+    assert(ok);
+
+    AVCodecContext *ctx = avcodec_alloc_context3(NULL);
+    assert(ctx);
+    ctx->codec_type = AVMEDIA_TYPE_AUDIO;
+    ctx->codec_id = AV_CODEC_ID_AAC;
+    ctx->sample_rate = SAMPLE_RATE;
+#ifdef SCRCPY_LAVU_HAS_CHLAYOUT
+    ctx->ch_layout = (AVChannelLayout) AV_CHANNEL_LAYOUT_STEREO;
+#else
+    ctx->channel_layout = AV_CH_LAYOUT_STEREO;
+    ctx->channels = 2;
+#endif
+
+    struct sc_packet_sink *sink = &recorder.audio_packet_sink;
+    ok = sink->ops->open(sink, ctx);
+    assert(ok);
+
+    AVPacket *packet = av_packet_alloc();
+    assert(packet);
+
+    // AudioSpecificConfig: AAC-LC, 48000 Hz, stereo
+    static const uint8_t config[] = {0x11, 0x90};
+    int r = av_new_packet(packet, sizeof(config));
+    assert(!r);
+    memcpy(packet->data, config, sizeof(config));
+    packet->pts = AV_NOPTS_VALUE;
+    packet->dts = AV_NOPTS_VALUE;
+    ok = sink->ops->push(sink, packet);
+    assert(ok);
+    av_packet_unref(packet);
+
+    for (int i = 0; i < PACKET_COUNT; ++i) {
+        int64_t pts = (int64_t) i * SAMPLES_PER_PACKET * 1000000 / SAMPLE_RATE;
+        push_packet(sink, packet, pts, i);
+    }
+
+    // Wait for the recorder to process all the packets
+    while (!recorder_queue_is_empty(&recorder)) {
+        usleep(10000);
+    }
+    usleep(100000);
+
+    // Simulate a crash: the trailer is never written
+    raise(SIGKILL);
+}
+
+static void test_recorder_fmp4_killed(void) {
+    char filename[] = "/tmp/scrcpy_test_recorder_XXXXXX";
+    int fd = mkstemp(filename);
+    assert(fd != -1);
+    close(fd);
+
+    pid_t pid = fork();
+    assert(pid != -1);
+    if (!pid) {
+        record_then_die(filename);
+        // not reached
+        _exit(1);
+    }
+
+    int status;
+    pid_t w = waitpid(pid, &status, 0);
+    assert(w == pid);
+    assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL);
+    (void) w;
+
+    // The file must be readable, with all the complete fragments
+    AVFormatContext *fmt = NULL;
+    int r = avformat_open_input(&fmt, filename, NULL, NULL);
+    assert(!r);
+    assert(fmt->nb_streams == 1);
+    assert(fmt->streams[0]->codecpar->codec_id == AV_CODEC_ID_AAC);
+
+    AVPacket *packet = av_packet_alloc();
+    assert(packet);
+
+    int count = 0;
+    int64_t last_pts = AV_NOPTS_VALUE;
+    while (!av_read_frame(fmt, packet)) {
+        assert(packet->size == 64);
+        // The content of each packet is its index
+        assert(packet->data[1] == (uint8_t) count);
+        assert(last_pts == AV_NOPTS_VALUE || packet->pts > last_pts);
+        last_pts = packet->pts;
+        ++count;
+        av_packet_unref(packet);
+    }
+
+    // At most the last fragment may be lost
+    assert(count >= PACKET_COUNT - FRAGMENT_MAX_PACKETS);
+    assert(count <= PACKET_COUNT);
+
+    av_packet_free(&packet);
+    avformat_close_input(&fmt);
+    (void) r;
+
+    unlink(filename);
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+#ifdef _WIN32
+    // fork() is not available
+    return 77; // skipped
+#else
+    test_recorder_fmp4_killed();
+    return 0;
+#endif
+}
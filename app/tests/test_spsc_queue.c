@@ -0,0 +1,172 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util/spsc_queue.h"
+#include "util/thread.h"
+
+#define ITEM(I) ((void *) (uintptr_t) ((I) + 1))
+
+static void test_spsc_queue_fifo(void) {
+    struct sc_spsc_queue queue;
+    bool ok = sc_spsc_queue_init(&queue, 4);
+    assert(ok);
+
+    assert(sc_spsc_queue_is_empty(&queue));
+    assert(!sc_spsc_queue_pop(&queue));
+
+    for (unsigned i = 0; i < 3; ++i) {
+        ok = sc_spsc_queue_push(&queue, ITEM(i));
+        assert(ok);
+    }
+    assert(sc_spsc_queue_size(&queue) == 3);
+
+    for (unsigned i = 0; i < 3; ++i) {
+        assert(sc_spsc_queue_pop(&queue) == ITEM(i));
+    }
+    assert(sc_spsc_queue_is_empty(&queue));
+    assert(!sc_spsc_queue_pop(&queue));
+
+    // Wrap around several times without growing
+    for (unsigned i = 0; i < 100; ++i) {
+        ok = sc_spsc_queue_push(&queue, ITEM(i));
+        assert(ok);
+        ok = sc_spsc_queue_push(&queue, ITEM(i + 1000));
+        assert(ok);
+        assert(sc_spsc_queue_pop(&queue) == ITEM(i));
+        assert(sc_spsc_queue_pop(&queue) == ITEM(i + 1000));
+    }
+    assert(queue.write_segment->mask == 3);
+
+    sc_spsc_queue_destroy(&queue);
+}
+
+static void test_spsc_queue_grow(void) {
+    struct sc_spsc_queue queue;
+    bool ok = sc_spsc_queue_init(&queue, 2);
+    assert(ok);
+
+    // Start in the middle of the first segment
+    ok = sc_spsc_queue_push(&queue, ITEM(42));
+    assert(ok);
+    assert(sc_spsc_queue_pop(&queue) == ITEM(42));
+
+    // Grow several times while the consumer does not read
+    for (unsigned i = 0; i < 100; ++i) {
+        ok = sc_spsc_queue_push(&queue, ITEM(i));
+        assert(ok);
+    }
+    assert(sc_spsc_queue_size(&queue) == 100);
+    assert(queue.write_segment != queue.read_segment);
+
+    // Read some items, then push more
+    for (unsigned i = 0; i < 50; ++i) {
+        assert(sc_spsc_queue_pop(&queue) == ITEM(i));
+    }
+    for (unsigned i = 100; i < 200; ++i) {
+        ok = sc_spsc_queue_push(&queue, ITEM(i));
+        assert(ok);
+    }
+    for (unsigned i = 50; i < 200; ++i) {
+        assert(sc_spsc_queue_pop(&queue) == ITEM(i));
+    }
+    assert(sc_spsc_queue_is_empty(&queue));
+
+    // All the previous segments have been released
+    assert(queue.read_segment == queue.write_segment);
+
+    sc_spsc_queue_destroy(&queue);
+}
+
+static void test_spsc_queue_prepare_growth(void) {
+    struct sc_spsc_queue queue;
+    bool ok = sc_spsc_queue_init(&queue, 8);
+    assert(ok);
+
+    // Below the high-water mark, nothing is allocated in advance
+    for (unsigned i = 0; i < 6; ++i) {
+        ok = sc_spsc_queue_push(&queue, ITEM(i));
+        assert(ok);
+    }
+    assert(sc_spsc_queue_pop(&queue) == ITEM(0));
+    assert(!queue.spare);
+
+    ok = sc_spsc_queue_push(&queue, ITEM(6));
+    assert(ok);
+    ok = sc_spsc_queue_push(&queue, ITEM(7));
+    assert(ok);
+
+    // 6 items remain after this pop, 3/4 of the capacity
+    assert(sc_spsc_queue_pop(&queue) == ITEM(1));
+    struct sc_spsc_segment *spare = queue.spare;
+    assert(spare);
+    assert(spare->mask == 15);
+
+    // Fill the segment, then the producer continues in the spare segment
+    for (unsigned i = 8; i < 11; ++i) {
+        ok = sc_spsc_queue_push(&queue, ITEM(i));
+        assert(ok);
+    }
+    assert(queue.write_segment == spare);
+    assert(!queue.spare);
+
+    for (unsigned i = 2; i < 11; ++i) {
+        assert(sc_spsc_queue_pop(&queue) == ITEM(i));
+    }
+    assert(sc_spsc_queue_is_empty(&queue));
+    assert(queue.read_segment == spare);
+
+    sc_spsc_queue_destroy(&queue);
+}
+
+#define STRESS_COUNT 1000000
+
+static int
+run_producer(void *data) {
+    struct sc_spsc_queue *queue = data;
+    for (uint32_t i = 0; i < STRESS_COUNT; ++i) {
+        bool ok = sc_spsc_queue_push(queue, ITEM(i));
+        assert(ok);
+        (void) ok;
+    }
+    return 0;
+}
+
+static void test_spsc_queue_threads(void) {
+    struct sc_spsc_queue queue;
+    bool ok = sc_spsc_queue_init(&queue, 16);
+    assert(ok);
+
+    sc_thread thread;
+    ok = sc_thread_create(&thread, run_producer, "test-producer", &queue);
+    assert(ok);
+
+    // The items must be received in order, without loss
+    uint32_t i = 0;
+    while (i < STRESS_COUNT) {
+        void *item = sc_spsc_queue_pop(&queue);
+        if (item) {
+            assert(item == ITEM(i));
+            ++i;
+        }
+    }
+
+    sc_thread_join(&thread, NULL);
+    assert(sc_spsc_queue_is_empty(&queue));
+
+    sc_spsc_queue_destroy(&queue);
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_spsc_queue_fifo();
+    test_spsc_queue_grow();
+    test_spsc_queue_prepare_growth();
+    test_spsc_queue_threads();
+
+    return 0;
+}
@@ -0,0 +1,364 @@
+#include "common.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+#include <SDL2/SDL_timer.h>
+#include <libavutil/frame.h>
+
+#include "delay_buffer.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/timeout.h"
+#include "util/vclock.h"
+
+#define START SC_TICK_FROM_SEC(1000)
+
+#define FRAME_INTERVAL SC_TICK_FROM_MS(10)
+#define BUFFERING_DELAY SC_TICK_FROM_MS(100)
+#define MAX_FRAMES 200
+
+struct waiter {
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    sc_tick deadline;
+    bool signaled; // the predicate
+    bool done;
+    bool result;
+};
+
+static int
+run_waiter(void *data) {
+    struct waiter *w = data;
+
+    sc_mutex_lock(&w->mutex);
+    bool result = true;
+    while (!w->signaled && result) {
+        result = sc_cond_timedwait(&w->cond, &w->mutex, w->deadline);
+    }
+    w->result = result;
+    w->done = true;
+    sc_mutex_unlock(&w->mutex);
+
+    return 0;
+}
+
+static void
+waiter_start(struct waiter *w, sc_tick deadline) {
+    bool ok = sc_mutex_init(&w->mutex);
+    assert(ok);
+    ok = sc_cond_init(&w->cond);
+    assert(ok);
+
+    w->deadline = deadline;
+    w->signaled = false;
+    w->done = false;
+
+    ok = sc_thread_create(&w->thread, run_waiter, "test-waiter", w);
+    assert(ok);
+}
+
+static bool
+waiter_is_done(struct waiter *w) {
+    sc_mutex_lock(&w->mutex);
+    bool done = w->done;
+    sc_mutex_unlock(&w->mutex);
+    return done;
+}
+
+static void
+waiter_join(struct waiter *w) {
+    sc_thread_join(&w->thread, NULL);
+    sc_cond_destroy(&w->cond);
+    sc_mutex_destroy(&w->mutex);
+}
+
+static void test_now(void) {
+    struct sc_vclock vclock;
+    bool ok = sc_vclock_init(&vclock, START, false);
+    assert(ok);
+
+    sc_vclock_install(&vclock);
+    assert(sc_tick_now() == START);
+
+    sc_vclock_advance(&vclock, SC_TICK_FROM_SEC(3600));
+    assert(sc_tick_now() == START + SC_TICK_FROM_SEC(3600));
+    assert(sc_vclock_now(&vclock) == START + SC_TICK_FROM_SEC(3600));
+
+    sc_vclock_uninstall(&vclock);
+    // Back to the system clock
+    sc_tick now = sc_tick_now();
+    assert(now - sc_tick_now_system() <= 0);
+
+    sc_vclock_destroy(&vclock);
+}
+
+static void test_manual_timeout(void) {
+    struct sc_vclock vclock;
+    bool ok = sc_vclock_init(&vclock, START, false);
+    assert(ok);
+    sc_vclock_install(&vclock);
+
+    struct waiter w;
+    waiter_start(&w, START + SC_TICK_FROM_SEC(10));
+
+    sc_vclock_advance(&vclock, SC_TICK_FROM_SEC(5));
+    // Let the waiter poll the virtual time
+    SDL_Delay(20);
+    assert(!waiter_is_done(&w));
+
+    sc_vclock_advance(&vclock, SC_TICK_FROM_SEC(5));
+    waiter_join(&w);
+    assert(w.done);
+    assert(!w.result); // timeout
+    assert(sc_tick_now() == START + SC_TICK_FROM_SEC(10));
+
+    sc_vclock_uninstall(&vclock);
+    sc_vclock_destroy(&vclock);
+}
+
+static void test_manual_signal(void) {
+    struct sc_vclock vclock;
+    bool ok = sc_vclock_init(&vclock, START, false);
+    assert(ok);
+    sc_vclock_install(&vclock);
+
+    struct waiter w;
+    waiter_start(&w, START + SC_TICK_FROM_SEC(10));
+
+    sc_mutex_lock(&w.mutex);
+    w.signaled = true;
+    sc_cond_signal(&w.cond);
+    sc_mutex_unlock(&w.mutex);
+
+    waiter_join(&w);
+    assert(w.done);
+    assert(w.result); // signaled
+    // The time did not change
+    assert(sc_tick_now() == START);
+
+    sc_vclock_uninstall(&vclock);
+    sc_vclock_destroy(&vclock);
+}
+
+static void
+on_timeout(struct sc_timeout *timeout, void *userdata) {
+    (void) timeout;
+    bool *timed_out = userdata;
+    *timed_out = true;
+}
+
+static void test_auto_timeout_one_hour(void) {
+    struct sc_vclock vclock;
+    bool ok = sc_vclock_init(&vclock, START, true);
+    assert(ok);
+    sc_vclock_install(&vclock);
+
+    sc_tick real_start = sc_tick_now_system();
+
+    struct sc_timeout timeout;
+    ok = sc_timeout_init(&timeout);
+    assert(ok);
+
+    static const struct sc_timeout_callbacks cbs = {
+        .on_timeout = on_timeout,
+    };
+
+    bool timed_out = false;
+    sc_tick deadline = sc_tick_now() + SC_TICK_FROM_SEC(3600);
+    ok = sc_timeout_start(&timeout, deadline, &cbs, &timed_out);
+    assert(ok);
+
+    sc_timeout_join(&timeout);
+    sc_timeout_destroy(&timeout);
+
+    assert(timed_out);
+    assert(sc_tick_now() == deadline);
+    // It did not actually wait for one hour
+    assert(sc_tick_now_system() - real_start < SC_TICK_FROM_SEC(10));
+
+    sc_vclock_uninstall(&vclock);
+    sc_vclock_destroy(&vclock);
+}
+
+// Frame sink recording the (virtual) date of each frame
+struct frame_recorder {
+    struct sc_frame_sink frame_sink;
+    // Only accessed from the buffering thread until it is joined
+    sc_tick dates[MAX_FRAMES];
+    unsigned count;
+};
+
+#define DOWNCAST(SINK) container_of(SINK, struct frame_recorder, frame_sink)
+
+static bool
+frame_recorder_open(struct sc_frame_sink *sink, const AVCodecContext *ctx) {
+    (void) sink;
+    (void) ctx;
+    return true;
+}
+
+static void
+frame_recorder_close(struct sc_frame_sink *sink) {
+    (void) sink;
+}
+
+static bool
+frame_recorder_push(struct sc_frame_sink *sink, const AVFrame *frame) {
+    struct frame_recorder *fr = DOWNCAST(sink);
+
+    // The frames are delivered in order
+    assert(frame->pts == fr->count * SC_TICK_TO_US(FRAME_INTERVAL));
+    assert(fr->count < MAX_FRAMES);
+    fr->dates[fr->count++] = sc_tick_now();
+    return true;
+}
+
+// Advance the virtual time up to the target, 1 ms at a time: the buffering
+// thread polls the virtual time, so it must be given the opportunity to
+// observe each step
+static void
+advance_to(struct sc_vclock *vclock, sc_tick target) {
+    while (sc_vclock_now(vclock) < target) {
+        sc_vclock_advance(vclock, SC_TICK_FROM_MS(1));
+        SDL_Delay(1);
+    }
+}
+
+// Push count frames (one every FRAME_INTERVAL in stream time) to a delay
+// buffer, each one at the (virtual) date provided by the callback, and
+// record the dates of the pushes and of the deliveries
+static void
+run_delay_buffer(unsigned count, sc_tick (*get_push_date)(unsigned i),
+                 sc_tick *push_dates, struct frame_recorder *fr) {
+    assert(count <= MAX_FRAMES);
+
+    struct sc_vclock vclock;
+    bool ok = sc_vclock_init(&vclock, START, false);
+    assert(ok);
+    sc_vclock_install(&vclock);
+
+    static const struct sc_frame_sink_ops ops = {
+        .open = frame_recorder_open,
+        .close = frame_recorder_close,
+        .push = frame_recorder_push,
+    };
+    fr->frame_sink.ops = &ops;
+    fr->count = 0;
+
+    struct sc_delay_buffer db;
+    sc_delay_buffer_init(&db, BUFFERING_DELAY, false);
+    sc_frame_source_add_sink(&db.frame_source, &fr->frame_sink);
+
+    struct sc_frame_sink *sink = &db.frame_sink;
+    ok = sink->ops->open(sink, NULL);
+    assert(ok);
+
+    AVFrame *frame = av_frame_alloc();
+    assert(frame);
+    frame->format = AV_PIX_FMT_YUV420P;
+    frame->width = 16;
+    frame->height = 16;
+    int r = av_frame_get_buffer(frame, 0);
+    assert(!r);
+
+    for (unsigned i = 0; i < count; ++i) {
+        advance_to(&vclock, get_push_date(i));
+        push_dates[i] = sc_tick_now();
+        // PTS are in microseconds
+        frame->pts = i * SC_TICK_TO_US(FRAME_INTERVAL);
+        ok = sink->ops->push(sink, frame);
+        assert(ok);
+    }
+
+    // Let the last frames be delivered
+    advance_to(&vclock, push_dates[count - 1] + 2 * BUFFERING_DELAY);
+
+    sink->ops->close(sink);
+    assert(fr->count == count);
+
+    av_frame_free(&frame);
+
+    sc_vclock_uninstall(&vclock);
+    sc_vclock_destroy(&vclock);
+
+    (void) ok;
+    (void) r;
+}
+
+static sc_tick
+jittery_push_date(unsigned i) {
+    // Every other frame is received 8 ms late
+    return START + i * FRAME_INTERVAL + (i % 2 ? SC_TICK_FROM_MS(8) : 0);
+}
+
+// The delay buffer must absorb the network jitter
+static void test_delay_buffer_jitter(void) {
+    sc_tick push_dates[80];
+    struct frame_recorder fr;
+    run_delay_buffer(80, jittery_push_date, push_dates, &fr);
+
+    // Once the clock estimation has converged (it averages the offset over
+    // 32 frames), the frames are delivered at their stream time plus the
+    // average transit delay (4 ms) plus the buffering delay, regardless of
+    // their actual reception date
+    for (unsigned i = 40; i < 80; ++i) {
+        sc_tick expected = START + i * FRAME_INTERVAL + SC_TICK_FROM_MS(4)
+                         + BUFFERING_DELAY;
+        // Up to a few ms late, the buffering thread polls the virtual time
+        assert(fr.dates[i] >= expected - SC_TICK_FROM_MS(1));
+        assert(fr.dates[i] <= expected + SC_TICK_FROM_MS(5));
+    }
+}
+
+static sc_tick
+drifting_push_date(unsigned i) {
+    // The device clock is 5% slower than the computer clock: each frame is
+    // received 10.5 ms after the previous one, while its PTS is only 10 ms
+    // later
+    return START + i * (FRAME_INTERVAL + FRAME_INTERVAL / 20);
+}
+
+// The clock estimation must follow the drift between the device and the
+// computer clocks, so that the latency does not diverge over time
+static void test_delay_buffer_clock_drift(void) {
+    sc_tick push_dates[200];
+    struct frame_recorder fr;
+    run_delay_buffer(200, drifting_push_date, push_dates, &fr);
+
+    // Without any estimation, the latency would decrease by 0.5 ms on every
+    // frame (by 35 ms over the frames checked). The estimation lags behind
+    // the actual offset (by about 15 ms for this drift), but it converges to
+    // a constant latency. The last frames are delivered once no more frames
+    // are received, so the estimation does not follow the drift anymore.
+    sc_tick min_latency = BUFFERING_DELAY;
+    sc_tick max_latency = 0;
+    for (unsigned i = 120; i < 190; ++i) {
+        sc_tick latency = fr.dates[i] - push_dates[i];
+        if (latency < min_latency) {
+            min_latency = latency;
+        }
+        if (latency > max_latency) {
+            max_latency = latency;
+        }
+    }
+
+    assert(min_latency >= BUFFERING_DELAY - SC_TICK_FROM_MS(20));
+    assert(max_latency <= BUFFERING_DELAY);
+    assert(max_latency - min_latency <= SC_TICK_FROM_MS(4));
+}
+
+int main(int argc, char *argv[]) {
+    (void) argc;
+    (void) argv;
+
+    test_now();
+    test_manual_timeout();
+    test_manual_signal();
+    test_auto_timeout_one_hour();
+    test_delay_buffer_jitter();
+    test_delay_buffer_clock_drift();
+
+    return 0;
+}
@@ -0,0 +1,432 @@
+/**
+ * scrcpy-automation-bench: load-test the automation socket of a running scrcpy
+ * instance (see --automation-socket).
+ *
+ * It injects a touch gesture (a DOWN, many MOVE and an UP events) as fast as
+ * possible (or at a target rate), using the binary protocol. A PING is sent
+ * every few events to measure the round-trip latency (the time for all the
+ * previous events to be forwarded to the controller), with at most two PINGs
+ * in flight.
+ *
+ * At the end, the number of injected events reported by the GET_STATE request
+ * is compared to the number of events sent, to detect any lost event.
+ *
+ * Exit codes: 0 on success, 1 on connection failure or lost events.
+ */
+
+#include "common.h"
+
+#include <assert.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <libavutil/time.h>
+
+#include "automation_msg.h"
+#include "control_msg.h"
+#include "util/binary.h"
+#include "util/log.h"
+#include "util/net.h"
+#include "util/str.h"
+#include "util/tick.h"
+
+// Number of serialized events sent in a single call
+#define SC_BENCH_BATCH_SIZE 64
+// Large enough for a touch event or a PING
+#define SC_BENCH_REQUEST_MAX_SIZE 32
+
+// Payload sizes of the binary events (without the type byte)
+#define SC_BENCH_PONG_SIZE 4
+#define SC_BENCH_STATE_SIZE 60
+
+struct sc_bench_params {
+    const char *socket_path;
+    uint32_t events;
+    uint32_t rate; // events per second, 0 for unlimited
+    uint32_t ping_interval; // in events
+};
+
+struct sc_bench {
+    const struct sc_bench_params *params;
+    sc_socket socket;
+
+    uint8_t batch[SC_BENCH_BATCH_SIZE * SC_BENCH_REQUEST_MAX_SIZE];
+    size_t batch_len;
+
+    // Send date of the PINGs in flight, indexed by token % 2
+    sc_tick ping_sent[2];
+    uint32_t next_token;
+    uint32_t pending_pongs;
+
+    uint32_t latency_count;
+    sc_tick latency_min;
+    sc_tick latency_max;
+    sc_tick latency_sum;
+};
+
+struct sc_bench_state {
+    struct sc_size video_size;
+    uint64_t injected_events;
+};
+
+static bool
+sc_bench_flush(struct sc_bench *bench) {
+    if (!bench->batch_len) {
+        return true;
+    }
+
+    ssize_t w = net_send_all(bench->socket, bench->batch, bench->batch_len);
+    if (w != (ssize_t) bench->batch_len) {
+        LOGE("Could not send requests");
+        return false;
+    }
+
+    bench->batch_len = 0;
+    return true;
+}
+
+static bool
+sc_bench_push(struct sc_bench *bench, const uint8_t *buf, size_t len) {
+    assert(len <= SC_BENCH_REQUEST_MAX_SIZE);
+    if (bench->batch_len + len > sizeof(bench->batch)) {
+        if (!sc_bench_flush(bench)) {
+            return false;
+        }
+    }
+
+    memcpy(&bench->batch[bench->batch_len], buf, len);
+    bench->batch_len += len;
+    return true;
+}
+
+static bool
+sc_bench_push_touch(struct sc_bench *bench, struct sc_size size,
+                    enum android_motionevent_action action, uint32_t i) {
+    // Sweep the whole screen
+    int32_t x = (int32_t) ((uint64_t) i * 7 % size.width);
+    int32_t y = (int32_t) ((uint64_t) i * 13 % size.height);
+
+    struct sc_control_msg msg = {
+        .type = SC_CONTROL_MSG_TYPE_INJECT_TOUCH_EVENT,
+        .inject_touch_event = {
+            .action = action,
+            .action_button = 0,
+            .buttons = 0,
+            .pointer_id = SC_POINTER_ID_VIRTUAL_FINGER,
+            .position = {
+                .screen_size = size,
+                .point = {x, y},
+            },
+            .pressure = action == AMOTION_EVENT_ACTION_UP ? 0.f : 1.f,
+        },
+    };
+
+    uint8_t buf[SC_BENCH_REQUEST_MAX_SIZE];
+    size_t len = sc_control_msg_serialize(&msg, buf);
+    assert(len && len <= sizeof(buf));
+    return sc_bench_push(bench, buf, len);
+}
+
+static bool
+sc_bench_recv_event(struct sc_bench *bench, uint8_t expected_type,
+                    uint8_t *payload, size_t len) {
+    uint8_t type;
+    ssize_t r = net_recv_all(bench->socket, &type, 1);
+    if (r != 1) {
+        LOGE("Connection closed by scrcpy");
+        return false;
+    }
+
+    if (type != expected_type) {
+        LOGE("Unexpected event type: %u", (unsigned) type);
+        return false;
+    }
+
+    r = net_recv_all(bench->socket, payload, len);
+    if (r != (ssize_t) len) {
+        LOGE("Connection closed by scrcpy");
+        return false;
+    }
+
+    return true;
+}
+
+static bool
+sc_bench_get_state(struct sc_bench *bench, struct sc_bench_state *state) {
+    uint8_t req = SC_AUTOMATION_MSG_TYPE_GET_STATE;
+    if (!sc_bench_push(bench, &req, 1) || !sc_bench_flush(bench)) {
+        return false;
+    }
+
+    uint8_t payload[SC_BENCH_STATE_SIZE];
+    if (!sc_bench_recv_event(bench, SC_AUTOMATION_MSG_TYPE_STATE, payload,
+                             sizeof(payload))) {
+        return false;
+    }
+
+    state->video_size.width = sc_read16be(payload);
+    state->video_size.height = sc_read16be(&payload[2]);
+    // Skip decoded, skipped and presented frames, video bytes and
+    // reconnections
+    state->injected_events = sc_read64be(&payload[4 + 5 * 8]);
+    return true;
+}
+
+static bool
+sc_bench_wait_pong(struct sc_bench *bench) {
+    assert(bench->pending_pongs);
+
+    uint8_t payload[SC_BENCH_PONG_SIZE];
+    if (!sc_bench_recv_event(bench, SC_AUTOMATION_MSG_TYPE_PONG, payload,
+                             sizeof(payload))) {
+        return false;
+    }
+
+    uint32_t token = sc_read32be(payload);
+    uint32_t expected = bench->next_token - bench->pending_pongs;
+    if (token != expected) {
+        LOGE("Unexpected PONG token: %" PRIu32 " (expected %" PRIu32 ")",
+             token, expected);
+        return false;
+    }
+    --bench->pending_pongs;
+
+    sc_tick latency = sc_tick_now() - bench->ping_sent[token % 2];
+    if (!bench->latency_count || latency < bench->latency_min) {
+        bench->latency_min = latency;
+    }
+    if (latency > bench->latency_max) {
+        bench->latency_max = latency;
+    }
+    bench->latency_sum += latency;
+    ++bench->latency_count;
+
+    return true;
+}
+
+static bool
+sc_bench_ping(struct sc_bench *bench) {
+    if (bench->pending_pongs == 2) {
+        // Keep at most two PINGs in flight
+        if (!sc_bench_wait_pong(bench)) {
+            return false;
+        }
+    }
+
+    uint32_t token = bench->next_token++;
+    uint8_t req[5];
+    req[0] = SC_AUTOMATION_MSG_TYPE_PING;
+    sc_write32be(&req[1], token);
+    if (!sc_bench_push(bench, req, sizeof(req))
+            || !sc_bench_flush(bench)) {
+        return false;
+    }
+
+    bench->ping_sent[token % 2] = sc_tick_now();
+    ++bench->pending_pongs;
+    return true;
+}
+
+static bool
+sc_bench_run(struct sc_bench *bench, struct sc_size size) {
+    const struct sc_bench_params *params = bench->params;
+
+    sc_tick start = sc_tick_now();
+    for (uint32_t i = 0; i < params->events; ++i) {
+        if (params->rate) {
+            sc_tick deadline = start
+                             + (sc_tick) i * SC_TICK_FREQ / params->rate;
+            sc_tick now = sc_tick_now();
+            if (deadline > now) {
+                // Do not delay the events already generated
+                if (!sc_bench_flush(bench)) {
+                    return false;
+                }
+                av_usleep(SC_TICK_TO_US(deadline - now));
+            }
+        }
+
+        enum android_motionevent_action action =
+            i == 0 ? AMOTION_EVENT_ACTION_DOWN
+                   : i == params->events - 1 ? AMOTION_EVENT_ACTION_UP
+                                             : AMOTION_EVENT_ACTION_MOVE;
+        if (!sc_bench_push_touch(bench, size, action, i)) {
+            return false;
+        }
+
+        if ((i + 1) % params->ping_interval == 0) {
+            if (!sc_bench_ping(bench)) {
+                return false;
+            }
+        }
+    }
+
+    // The last PONG is received once all the events have been processed
+    if (!sc_bench_ping(bench)) {
+        return false;
+    }
+    while (bench->pending_pongs) {
+        if (!sc_bench_wait_pong(bench)) {
+            return false;
+        }
+    }
+
+    sc_tick duration = sc_tick_now() - start;
+    uint64_t rate = duration ? (uint64_t) params->events * SC_TICK_FREQ
+                             / duration
+                             : 0;
+
+    LOGI("%" PRIu32 " events in %" PRItick " ms: %" PRIu64 " events/s",
+         params->events, SC_TICK_TO_MS(duration), rate);
+    assert(bench->latency_count);
+    LOGI("PING latency (%" PRIu32 " samples): min %" PRItick " us, avg %"
+         PRItick " us, max %" PRItick " us", bench->latency_count,
+         SC_TICK_TO_US(bench->latency_min),
+         SC_TICK_TO_US(bench->latency_sum / bench->latency_count),
+         SC_TICK_TO_US(bench->latency_max));
+
+    return true;
+}
+
+static bool
+parse_number(const char *s, long min, long max, const char *name, long *out) {
+    long value;
+    if (!sc_str_parse_integer(s, &value) || value < min || value > max) {
+        LOGE("Could not parse %s (expected a value in [%ld; %ld]): %s", name,
+             min, max, s);
+        return false;
+    }
+    *out = value;
+    return true;
+}
+
+static bool
+parse_args(struct sc_bench_params *params, int argc, char *argv[]) {
+    static const struct option longopts[] = {
+        {"events",        required_argument, NULL, 'n'},
+        {"rate",          required_argument, NULL, 'r'},
+        {"ping-interval", required_argument, NULL, 'p'},
+        {NULL,            0,                 NULL, 0  },
+    };
+
+    long value;
+    int c;
+    while ((c = getopt_long(argc, argv, "", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'n':
+                // At least a DOWN and an UP
+                if (!parse_number(optarg, 2, 0x7FFFFFFF, "events", &value)) {
+                    return false;
+                }
+                params->events = value;
+                break;
+            case 'r':
+                if (!parse_number(optarg, 0, 1000000, "rate", &value)) {
+                    return false;
+                }
+                params->rate = value;
+                break;
+            case 'p':
+                if (!parse_number(optarg, 1, 0x7FFFFFFF, "ping interval",
+                                  &value)) {
+                    return false;
+                }
+                params->ping_interval = value;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    if (optind != argc - 1) {
+        LOGE("Expected the path of the automation socket");
+        return false;
+    }
+
+    params->socket_path = argv[optind];
+    return true;
+}
+
+int
+main(int argc, char *argv[]) {
+    struct sc_bench_params params = {
+        .socket_path = NULL,
+        .events = 100000,
+        .rate = 0,
+        .ping_interval = 1000,
+    };
+
+    if (!parse_args(&params, argc, argv)) {
+        return 1;
+    }
+
+    if (!net_init()) {
+        return 1;
+    }
+
+    sc_log_configure();
+
+    int ret = 1;
+
+    struct sc_bench bench = {
+        .params = &params,
+        .batch_len = 0,
+        .next_token = 0,
+        .pending_pongs = 0,
+        .latency_count = 0,
+        .latency_min = 0,
+        .latency_max = 0,
+        .latency_sum = 0,
+    };
+
+    bench.socket = net_socket_unix();
+    if (bench.socket == SC_SOCKET_NONE) {
+        LOGE("Could not create socket");
+        goto end;
+    }
+
+    if (!net_connect_unix(bench.socket, params.socket_path)) {
+        LOGE("Could not connect to %s", params.socket_path);
+        goto close;
+    }
+
+    struct sc_bench_state before;
+    if (!sc_bench_get_state(&bench, &before)) {
+        goto close;
+    }
+
+    if (!before.video_size.width || !before.video_size.height) {
+        LOGE("No video frame decoded yet (is video enabled?)");
+        goto close;
+    }
+
+    LOGI("Injecting %" PRIu32 " touch events on a %" PRIu16 "x%" PRIu16
+         " screen", params.events, before.video_size.width,
+         before.video_size.height);
+
+    if (!sc_bench_run(&bench, before.video_size)) {
+        goto close;
+    }
+
+    struct sc_bench_state after;
+    if (!sc_bench_get_state(&bench, &after)) {
+        goto close;
+    }
+
+    uint64_t injected = after.injected_events - before.injected_events;
+    if (injected != params.events) {
+        LOGE("Lost events: %" PRIu64 " injected, %" PRIu32 " sent", injected,
+             params.events);
+        goto close;
+    }
+
+    ret = 0;
+
+close:
+    net_close(bench.socket);
+end:
+    net_cleanup();
+
+    return ret;
+}
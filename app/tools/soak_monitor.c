@@ -0,0 +1,348 @@
+#include "soak_monitor.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+#ifdef __linux__
+# include <dirent.h>
+# include <unistd.h>
+#endif
+
+#include "memory_budget.h"
+#include "util/log.h"
+
+// Ignore the first samples (allocations on startup, encoder warm-up...)
+#define SC_SOAK_WARMUP_PERCENT 20
+#define SC_SOAK_MIN_SAMPLES 3
+
+static int64_t
+sc_soak_read_rss(void) {
+#ifdef __linux__
+    FILE *file = fopen("/proc/self/statm", "r");
+    if (!file) {
+        return -1;
+    }
+
+    unsigned long size;
+    unsigned long resident;
+    int r = fscanf(file, "%lu %lu", &size, &resident);
+    fclose(file);
+    if (r != 2) {
+        return -1;
+    }
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) {
+        return -1;
+    }
+
+    return (int64_t) resident * page_size / 1024;
+#else
+    return -1;
+#endif
+}
+
+static int64_t
+sc_soak_count_fds(void) {
+#ifdef __linux__
+    DIR *dir = opendir("/proc/self/fd");
+    if (!dir) {
+        return -1;
+    }
+
+    int64_t count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] != '.') {
+            ++count;
+        }
+    }
+    closedir(dir);
+
+    // Do not count the fd used to read the directory
+    return count - 1;
+#else
+    return -1;
+#endif
+}
+
+static bool
+sc_soak_monitor_sample(struct sc_soak_monitor *monitor) {
+    struct sc_soak_sample sample;
+
+    sample.frames = atomic_load_explicit(&monitor->checker->received,
+                                         memory_order_relaxed);
+    sample.time = (double) sample.frames / monitor->fps;
+    sample.rss = sc_soak_read_rss();
+    sample.fds = sc_soak_count_fds();
+    sample.queued =
+        sc_memory_budget_get_used(SC_MEMORY_POOL_DELAY_BUFFER) / 1024;
+
+    // Latencies of the frames received since the previous sample
+    uint64_t histogram[SC_FRAME_CHECKER_LATENCY_BUCKETS];
+    sc_frame_checker_get_latency_histogram(monitor->checker, histogram);
+    uint64_t window[SC_FRAME_CHECKER_LATENCY_BUCKETS];
+    for (unsigned i = 0; i < SC_FRAME_CHECKER_LATENCY_BUCKETS; ++i) {
+        window[i] = histogram[i] - monitor->histogram[i];
+    }
+    memcpy(monitor->histogram, histogram, sizeof(histogram));
+
+    sample.latency_p50 = sc_frame_checker_get_latency_percentile(window, 50);
+    sample.latency_p99 = sc_frame_checker_get_latency_percentile(window, 99);
+
+    bool ok = sc_vector_push(&monitor->samples, sample);
+    if (!ok) {
+        LOG_OOM();
+        return false;
+    }
+
+    return true;
+}
+
+static int
+run_soak_monitor(void *data) {
+    struct sc_soak_monitor *monitor = data;
+
+    sc_tick deadline = sc_tick_now();
+
+    for (;;) {
+        deadline += monitor->interval;
+
+        sc_mutex_lock(&monitor->mutex);
+        bool timed_out = false;
+        while (!monitor->stopped && !timed_out) {
+            timed_out = !sc_cond_timedwait(&monitor->cond, &monitor->mutex,
+                                           deadline);
+        }
+        bool stopped = monitor->stopped;
+        sc_mutex_unlock(&monitor->mutex);
+
+        // Also take a last sample on stop
+        if (!sc_soak_monitor_sample(monitor) || stopped) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+bool
+sc_soak_monitor_init(struct sc_soak_monitor *monitor,
+                     struct sc_frame_checker *checker, unsigned fps,
+                     sc_tick interval) {
+    assert(fps);
+    assert(interval > 0);
+
+    bool ok = sc_mutex_init(&monitor->mutex);
+    if (!ok) {
+        return false;
+    }
+
+    ok = sc_cond_init(&monitor->cond);
+    if (!ok) {
+        sc_mutex_destroy(&monitor->mutex);
+        return false;
+    }
+
+    monitor->checker = checker;
+    monitor->fps = fps;
+    monitor->interval = interval;
+    monitor->stopped = false;
+    sc_vector_init(&monitor->samples);
+    memset(monitor->histogram, 0, sizeof(monitor->histogram));
+
+    return true;
+}
+
+void
+sc_soak_monitor_destroy(struct sc_soak_monitor *monitor) {
+    sc_vector_destroy(&monitor->samples);
+    sc_cond_destroy(&monitor->cond);
+    sc_mutex_destroy(&monitor->mutex);
+}
+
+bool
+sc_soak_monitor_start(struct sc_soak_monitor *monitor) {
+    bool ok = sc_thread_create(&monitor->thread, run_soak_monitor,
+                               "scrcpy-soak", monitor);
+    if (!ok) {
+        LOGE("Could not start soak monitor thread");
+        return false;
+    }
+
+    return true;
+}
+
+void
+sc_soak_monitor_stop(struct sc_soak_monitor *monitor) {
+    sc_mutex_lock(&monitor->mutex);
+    monitor->stopped = true;
+    sc_cond_signal(&monitor->cond);
+    sc_mutex_unlock(&monitor->mutex);
+
+    sc_thread_join(&monitor->thread, NULL);
+}
+
+static inline int64_t
+sc_soak_sample_get_rss(const struct sc_soak_sample *sample) {
+    return sample->rss;
+}
+
+static inline int64_t
+sc_soak_sample_get_latency_p50(const struct sc_soak_sample *sample) {
+    return sample->latency_p50;
+}
+
+/**
+ * Compute the slope (per simulated hour) of a metric by linear regression
+ *
+ * The samples for which the metric is not available (-1) are ignored.
+ */
+static double
+sc_soak_compute_slope(const struct sc_soak_sample *samples, size_t count,
+                      int64_t (*get)(const struct sc_soak_sample *)) {
+    double sum_t = 0;
+    double sum_v = 0;
+    double sum_tt = 0;
+    double sum_tv = 0;
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        int64_t value = get(&samples[i]);
+        if (value < 0) {
+            continue;
+        }
+
+        double t = samples[i].time / 3600; // in hours
+        sum_t += t;
+        sum_v += value;
+        sum_tt += t * t;
+        sum_tv += t * value;
+        ++n;
+    }
+
+    if (n < 2) {
+        return 0;
+    }
+
+    double den = n * sum_tt - sum_t * sum_t;
+    if (den <= 0) {
+        // No simulated time elapsed
+        return 0;
+    }
+
+    return (n * sum_tv - sum_t * sum_v) / den;
+}
+
+bool
+sc_soak_monitor_analyze(struct sc_soak_monitor *monitor,
+                        const struct sc_soak_thresholds *thresholds,
+                        struct sc_soak_trends *trends) {
+    size_t count = monitor->samples.size;
+    size_t first = count * SC_SOAK_WARMUP_PERCENT / 100;
+
+    memset(trends, 0, sizeof(*trends));
+
+    if (count - first < SC_SOAK_MIN_SAMPLES) {
+        LOGE("Soak: not enough samples (%zu), the run is too short", count);
+        return false;
+    }
+
+    const struct sc_soak_sample *samples = &monitor->samples.data[first];
+    size_t n = count - first;
+    const struct sc_soak_sample *last = &samples[n - 1];
+
+    trends->rss_growth = sc_soak_compute_slope(samples, n,
+                                               sc_soak_sample_get_rss);
+    trends->latency_drift =
+        sc_soak_compute_slope(samples, n, sc_soak_sample_get_latency_p50);
+    trends->fd_growth = last->fds >= 0 && samples[0].fds >= 0
+                      ? last->fds - samples[0].fds : 0;
+    trends->queue_growth = last->queued - samples[0].queued;
+
+    trends->max_latency_p99 = -1;
+    for (size_t i = 0; i < n; ++i) {
+        trends->max_latency_p99 = MAX(trends->max_latency_p99,
+                                      samples[i].latency_p99);
+    }
+
+    bool pass = true;
+    if (trends->rss_growth > thresholds->max_rss_growth) {
+        LOGE("Soak: RSS growth %.0f kB/h exceeds %" PRIi64 " kB/h",
+             trends->rss_growth, thresholds->max_rss_growth);
+        pass = false;
+    }
+    if (trends->fd_growth > thresholds->max_fd_growth) {
+        LOGE("Soak: fd count growth %" PRIi64 " exceeds %" PRIi64,
+             trends->fd_growth, thresholds->max_fd_growth);
+        pass = false;
+    }
+    if (trends->queue_growth > thresholds->max_queue_growth) {
+        LOGE("Soak: queue growth %" PRIi64 " kB exceeds %" PRIi64 " kB",
+             trends->queue_growth, thresholds->max_queue_growth);
+        pass = false;
+    }
+    if (trends->max_latency_p99 > thresholds->max_latency) {
+        LOGE("Soak: latency p99 %" PRItick "us exceeds %" PRItick "us",
+             trends->max_latency_p99, thresholds->max_latency);
+        pass = false;
+    }
+    if (trends->latency_drift > thresholds->max_latency_drift
+            || trends->latency_drift < -thresholds->max_latency_drift) {
+        LOGE("Soak: latency drift %.0f us/h exceeds %" PRItick "us/h",
+             trends->latency_drift, thresholds->max_latency_drift);
+        pass = false;
+    }
+
+    return pass;
+}
+
+bool
+sc_soak_monitor_write_report(struct sc_soak_monitor *monitor,
+                             const struct sc_soak_thresholds *thresholds,
+                             const struct sc_soak_trends *trends, bool pass,
+                             FILE *file) {
+    fprintf(file, "{\n");
+    fprintf(file, "  \"result\": \"%s\",\n", pass ? "pass" : "fail");
+    fprintf(file, "  \"thresholds\": {\n"
+                  "    \"max_rss_growth_kb_per_hour\": %" PRIi64 ",\n"
+                  "    \"max_fd_growth\": %" PRIi64 ",\n"
+                  "    \"max_queue_growth_kb\": %" PRIi64 ",\n"
+                  "    \"max_latency_p99_us\": %" PRItick ",\n"
+                  "    \"max_latency_drift_us_per_hour\": %" PRItick "\n"
+                  "  },\n",
+            thresholds->max_rss_growth, thresholds->max_fd_growth,
+            thresholds->max_queue_growth, thresholds->max_latency,
+            thresholds->max_latency_drift);
+    fprintf(file, "  \"trends\": {\n"
+                  "    \"rss_growth_kb_per_hour\": %.1f,\n"
+                  "    \"fd_growth\": %" PRIi64 ",\n"
+                  "    \"queue_growth_kb\": %" PRIi64 ",\n"
+                  "    \"max_latency_p99_us\": %" PRItick ",\n"
+                  "    \"latency_drift_us_per_hour\": %.1f\n"
+                  "  },\n",
+            trends->rss_growth, trends->fd_growth, trends->queue_growth,
+            trends->max_latency_p99, trends->latency_drift);
+
+    fprintf(file, "  \"samples\": [\n");
+    for (size_t i = 0; i < monitor->samples.size; ++i) {
+        const struct sc_soak_sample *s = &monitor->samples.data[i];
+        fprintf(file, "    {\"time\": %.3f, \"frames\": %" PRIu64 ", "
+                      "\"rss_kb\": %" PRIi64 ", \"fds\": %" PRIi64 ", "
+                      "\"queued_kb\": %" PRIi64 ", "
+                      "\"latency_p50_us\": %" PRItick ", "
+                      "\"latency_p99_us\": %" PRItick "}%s\n",
+                s->time, s->frames, s->rss, s->fds, s->queued,
+                s->latency_p50, s->latency_p99,
+                i + 1 < monitor->samples.size ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+
+    if (ferror(file)) {
+        LOGE("Could not write soak report");
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,111 @@
+#ifndef SC_SOAK_MONITOR_H
+#define SC_SOAK_MONITOR_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "frame_checker.h"
+#include "util/thread.h"
+#include "util/tick.h"
+#include "util/vector.h"
+
+/**
+ * Soak monitor: periodically sample the resources used by the process and the
+ * state of the pipeline during a long run, then detect the metrics which
+ * drift over time (leaks, queue growth, clock drift, latency increase).
+ *
+ * The time is expressed in simulated time, computed from the number of frames
+ * received, so that a run accelerated by a factor N simulates N times its
+ * duration.
+ *
+ * The memory of the queued frames is read from the memory budget accounting
+ * (see memory_budget.h), which must be enabled.
+ */
+
+struct sc_soak_sample {
+    double time; // simulated time, in seconds
+    int64_t rss; // resident set size in kB, -1 if not available
+    int64_t fds; // number of open file descriptors, -1 if not available
+    uint64_t frames; // number of frames received
+    // latency percentiles of the frames received since the previous sample,
+    // -1 if no frame has been received
+    sc_tick latency_p50;
+    sc_tick latency_p99;
+    // memory of the frames queued in the delay buffer (0 if there is no
+    // delay buffer), in kB
+    int64_t queued;
+};
+
+struct sc_soak_thresholds {
+    int64_t max_rss_growth; // in kB per simulated hour
+    int64_t max_fd_growth;
+    sc_tick max_latency; // maximum 99th percentile
+    int64_t max_queue_growth; // in kB
+    // maximum drift of the median latency per simulated hour (e.g. caused by
+    // a clock drift in the delay buffer)
+    sc_tick max_latency_drift;
+};
+
+struct sc_soak_trends {
+    // slopes per simulated hour, computed by linear regression over the
+    // samples after the warm-up
+    double rss_growth; // kB per hour
+    double latency_drift; // us per hour
+    // differences between the last and first samples after the warm-up
+    int64_t fd_growth;
+    int64_t queue_growth;
+    sc_tick max_latency_p99;
+};
+
+struct sc_soak_monitor {
+    struct sc_frame_checker *checker;
+    unsigned fps; // simulated frame rate
+    sc_tick interval; // sampling interval (wall clock)
+
+    sc_thread thread;
+    sc_mutex mutex;
+    sc_cond cond;
+    bool stopped;
+
+    // only accessed from the monitor thread until it is joined
+    struct SC_VECTOR(struct sc_soak_sample) samples;
+    uint64_t histogram[SC_FRAME_CHECKER_LATENCY_BUCKETS];
+};
+
+bool
+sc_soak_monitor_init(struct sc_soak_monitor *monitor,
+                     struct sc_frame_checker *checker, unsigned fps,
+                     sc_tick interval);
+
+void
+sc_soak_monitor_destroy(struct sc_soak_monitor *monitor);
+
+bool
+sc_soak_monitor_start(struct sc_soak_monitor *monitor);
+
+// Stop and join the monitor thread (a last sample is taken)
+void
+sc_soak_monitor_stop(struct sc_soak_monitor *monitor);
+
+/**
+ * Compute the trends and compare them to the thresholds
+ *
+ * The monitor must be stopped. Return true if all the metrics are within the
+ * thresholds.
+ */
+bool
+sc_soak_monitor_analyze(struct sc_soak_monitor *monitor,
+                        const struct sc_soak_thresholds *thresholds,
+                        struct sc_soak_trends *trends);
+
+// Write a JSON report of the samples and the trends
+bool
+sc_soak_monitor_write_report(struct sc_soak_monitor *monitor,
+                             const struct sc_soak_thresholds *thresholds,
+                             const struct sc_soak_trends *trends, bool pass,
+                             FILE *file);
+
+#endif
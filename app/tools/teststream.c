@@ -0,0 +1,778 @@
+/**
+ * scrcpy-teststream: generate a synthetic video stream in the scrcpy wire
+ * format and run it through the client pipeline (demuxer and decoder), without
+ * any device.
+ *
+ * Each frame carries a marker (see frame_marker.h) containing its number and
+ * generation timestamp, which is read back by a frame checker after the
+ * decoder to detect dropped, duplicated or reordered frames and to measure
+ * the pipeline latency.
+ *
+ * The stream is sent over a local TCP socket, exactly like the server would.
+ *
+ * For soak testing, the stream may be generated faster than real time (the
+ * timestamps follow the generation, so the pipeline behaves as with a device
+ * at a higher frame rate) for a long simulated duration, through a delay
+ * buffer. With --report, the resources used by the process are sampled during
+ * the run (see soak_monitor.h), and the run fails if any of them drifts beyond
+ * its threshold.
+ *
+ * Exit codes: 0 on success, 1 on pipeline failure, inconsistent frames or
+ * drifting resources, 77 (skipped) if no encoder is available for the
+ * requested codec.
+ */
+
+#include "common.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/time.h>
+
+#include "decoder.h"
+#include "delay_buffer.h"
+#include "demuxer.h"
+#include "frame_checker.h"
+#include "frame_marker.h"
+#include "memory_budget.h"
+#include "soak_monitor.h"
+#include "util/binary.h"
+#include "util/log.h"
+#include "util/net.h"
+#include "util/str.h"
+#include "util/thread.h"
+#include "util/tick.h"
+
+#define SC_TESTSTREAM_EXIT_SKIPPED 77
+
+#define SC_PACKET_HEADER_SIZE 12
+#define SC_PACKET_FLAG_CONFIG (UINT64_C(1) << 63)
+#define SC_PACKET_FLAG_KEY_FRAME (UINT64_C(1) << 62)
+
+#define SC_CODEC_ID_H264 UINT32_C(0x68323634) // "h264" in ASCII
+#define SC_CODEC_ID_H265 UINT32_C(0x68323635) // "h265" in ASCII
+#define SC_CODEC_ID_AV1 UINT32_C(0x00617631) // "av1" in ASCII
+
+struct sc_teststream_params {
+    const char *codec;
+    const char *encoder;
+    uint32_t frames;
+    uint16_t width;
+    uint16_t height;
+    uint16_t fps;
+    uint16_t speed; // generation speed factor
+    sc_tick video_buffer; // 0 for no delay buffer
+    const char *report; // NULL for no soak monitoring, "-" for stdout
+    sc_tick sample_interval;
+    struct sc_soak_thresholds thresholds;
+};
+
+struct sc_teststream {
+    const struct sc_teststream_params *params;
+    uint16_t port;
+    uint32_t raw_codec_id;
+    const AVCodec *encoder;
+    bool generator_failed;
+};
+
+static const char *
+get_default_encoder(enum AVCodecID codec_id) {
+    switch (codec_id) {
+        case AV_CODEC_ID_H264:
+            return "libx264";
+        case AV_CODEC_ID_HEVC:
+            return "libx265";
+#ifdef SCRCPY_LAVC_HAS_AV1
+        case AV_CODEC_ID_AV1:
+            return "libaom-av1";
+#endif
+        default:
+            return NULL;
+    }
+}
+
+static bool
+sc_teststream_find_encoder(struct sc_teststream *ts) {
+    const char *codec = ts->params->codec;
+
+    enum AVCodecID codec_id;
+    if (!strcmp(codec, "h264")) {
+        codec_id = AV_CODEC_ID_H264;
+        ts->raw_codec_id = SC_CODEC_ID_H264;
+    } else if (!strcmp(codec, "h265")) {
+        codec_id = AV_CODEC_ID_HEVC;
+        ts->raw_codec_id = SC_CODEC_ID_H265;
+#ifdef SCRCPY_LAVC_HAS_AV1
+    } else if (!strcmp(codec, "av1")) {
+        codec_id = AV_CODEC_ID_AV1;
+        ts->raw_codec_id = SC_CODEC_ID_AV1;
+#endif
+    } else {
+        LOGE("Unsupported codec: %s", codec);
+        return false;
+    }
+
+    const char *name = ts->params->encoder;
+    if (name) {
+        ts->encoder = avcodec_find_encoder_by_name(name);
+        if (!ts->encoder) {
+            LOGE("Encoder not found: %s", name);
+            return false;
+        }
+        if (ts->encoder->id != codec_id) {
+            LOGE("Encoder %s does not encode %s", name, codec);
+            return false;
+        }
+        return true;
+    }
+
+    name = get_default_encoder(codec_id);
+    ts->encoder = name ? avcodec_find_encoder_by_name(name) : NULL;
+    if (!ts->encoder) {
+        // Fallback to any encoder for this codec (e.g. an FFmpeg native one)
+        ts->encoder = avcodec_find_encoder(codec_id);
+    }
+
+    return true;
+}
+
+static void
+sc_teststream_set_low_latency_options(const AVCodec *encoder,
+                                      AVDictionary **opts) {
+    // The pipeline expects frames in presentation order, without delay, as
+    // produced by the device encoders
+    const char *name = encoder->name;
+    if (!strcmp(name, "libx264") || !strcmp(name, "libx265")) {
+        av_dict_set(opts, "preset", "ultrafast", 0);
+        av_dict_set(opts, "tune", "zerolatency", 0);
+    } else if (!strcmp(name, "libaom-av1")) {
+        av_dict_set(opts, "usage", "realtime", 0);
+        av_dict_set(opts, "cpu-used", "8", 0);
+        av_dict_set(opts, "lag-in-frames", "0", 0);
+    }
+}
+
+static void
+sc_teststream_draw_frame(AVFrame *frame, uint32_t number) {
+    // Moving gradient, so that the encoder has some work to do
+    for (int y = 0; y < frame->height; ++y) {
+        uint8_t *line = frame->data[0] + y * frame->linesize[0];
+        for (int x = 0; x < frame->width; ++x) {
+            line[x] = (uint8_t) (x + y + number * 4);
+        }
+    }
+
+    for (int y = 0; y < frame->height / 2; ++y) {
+        memset(frame->data[1] + y * frame->linesize[1], 128, frame->width / 2);
+        memset(frame->data[2] + y * frame->linesize[2], 128, frame->width / 2);
+    }
+
+    // The timestamp is set as late as possible, just before encoding
+    struct sc_frame_marker marker = {
+        .number = number,
+        .timestamp = sc_tick_now(),
+    };
+    sc_frame_marker_draw(frame->data[0], frame->linesize[0], &marker);
+}
+
+static bool
+sc_teststream_send_packet(sc_socket socket, uint64_t pts_flags,
+                          const uint8_t *data, uint32_t size) {
+    uint8_t header[SC_PACKET_HEADER_SIZE];
+    sc_write64be(header, pts_flags);
+    sc_write32be(&header[8], size);
+
+    ssize_t w = net_send_all(socket, header, sizeof(header));
+    if (w != sizeof(header)) {
+        return false;
+    }
+
+    w = net_send_all(socket, data, size);
+    return w == (ssize_t) size;
+}
+
+static bool
+sc_teststream_send_packets(sc_socket socket, AVCodecContext *ctx,
+                           AVPacket *packet) {
+    for (;;) {
+        int ret = avcodec_receive_packet(ctx, packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        }
+
+        if (ret) {
+            LOGE("Could not receive packet: %d", ret);
+            return false;
+        }
+
+        assert(packet->pts >= 0);
+        uint64_t pts = av_rescale_q(packet->pts, ctx->time_base,
+                                    (AVRational) {1, 1000000});
+        if (packet->flags & AV_PKT_FLAG_KEY) {
+            pts |= SC_PACKET_FLAG_KEY_FRAME;
+        }
+
+        bool ok = sc_teststream_send_packet(socket, pts, packet->data,
+                                            packet->size);
+        av_packet_unref(packet);
+        if (!ok) {
+            LOGE("Could not send packet");
+            return false;
+        }
+    }
+}
+
+static bool
+sc_teststream_generate(struct sc_teststream *ts, sc_socket socket) {
+    const struct sc_teststream_params *params = ts->params;
+
+    uint8_t header[12];
+    sc_write32be(header, ts->raw_codec_id);
+    sc_write32be(&header[4], params->width);
+    sc_write32be(&header[8], params->height);
+    if (net_send_all(socket, header, sizeof(header)) != sizeof(header)) {
+        LOGE("Could not send stream header");
+        return false;
+    }
+
+    AVCodecContext *ctx = avcodec_alloc_context3(ts->encoder);
+    if (!ctx) {
+        LOG_OOM();
+        return false;
+    }
+
+    ctx->width = params->width;
+    ctx->height = params->height;
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    // The frames are generated (and timestamped) at the accelerated rate
+    unsigned rate = params->fps * params->speed;
+    ctx->time_base = (AVRational) {1, rate};
+    ctx->framerate = (AVRational) {rate, 1};
+    ctx->gop_size = rate * 10;
+    ctx->max_b_frames = 0;
+    // Like the device, send the codec configuration in a separate config
+    // packet, before the media packets
+    ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    AVDictionary *opts = NULL;
+    sc_teststream_set_low_latency_options(ts->encoder, &opts);
+
+    bool ret = false;
+
+    int r = avcodec_open2(ctx, ts->encoder, &opts);
+    av_dict_free(&opts);
+    if (r < 0) {
+        LOGE("Could not open encoder %s", ts->encoder->name);
+        goto free_context;
+    }
+
+    if (!ctx->extradata_size) {
+        LOGE("Encoder %s provided no codec configuration",
+             ts->encoder->name);
+        goto free_context;
+    }
+
+    if (!sc_teststream_send_packet(socket, SC_PACKET_FLAG_CONFIG,
+                                   ctx->extradata, ctx->extradata_size)) {
+        LOGE("Could not send config packet");
+        goto free_context;
+    }
+
+    AVFrame *frame = av_frame_alloc();
+    if (!frame) {
+        LOG_OOM();
+        goto free_context;
+    }
+
+    frame->format = ctx->pix_fmt;
+    frame->width = ctx->width;
+    frame->height = ctx->height;
+    if (av_frame_get_buffer(frame, 0)) {
+        LOG_OOM();
+        goto free_frame;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        LOG_OOM();
+        goto free_frame;
+    }
+
+    sc_tick start = sc_tick_now();
+    for (uint32_t i = 0; i < params->frames; ++i) {
+        sc_tick deadline = start + (sc_tick) i * SC_TICK_FREQ / rate;
+        sc_tick now = sc_tick_now();
+        if (deadline > now) {
+            av_usleep(SC_TICK_TO_US(deadline - now));
+        }
+
+        if (av_frame_make_writable(frame)) {
+            LOG_OOM();
+            goto free_packet;
+        }
+
+        sc_teststream_draw_frame(frame, i);
+        frame->pts = i;
+
+        if (avcodec_send_frame(ctx, frame) < 0) {
+            LOGE("Could not encode frame %" PRIu32, i);
+            goto free_packet;
+        }
+
+        if (!sc_teststream_send_packets(socket, ctx, packet)) {
+            goto free_packet;
+        }
+    }
+
+    // Flush the encoder
+    if (avcodec_send_frame(ctx, NULL) < 0
+            || !sc_teststream_send_packets(socket, ctx, packet)) {
+        goto free_packet;
+    }
+
+    ret = true;
+
+free_packet:
+    av_packet_free(&packet);
+free_frame:
+    av_frame_free(&frame);
+free_context:
+    avcodec_free_context(&ctx);
+
+    return ret;
+}
+
+static int
+run_generator(void *data) {
+    struct sc_teststream *ts = data;
+
+    sc_socket socket = net_socket();
+    if (socket == SC_SOCKET_NONE) {
+        ts->generator_failed = true;
+        return 0;
+    }
+
+    if (!net_connect(socket, IPV4_LOCALHOST, ts->port)) {
+        LOGE("Could not connect to localhost:%" PRIu16, ts->port);
+        ts->generator_failed = true;
+        net_close(socket);
+        return 0;
+    }
+
+    bool ok = sc_teststream_generate(ts, socket);
+    if (!ok) {
+        ts->generator_failed = true;
+    }
+
+    // Closing the socket notifies the demuxer of the end of stream
+    net_close(socket);
+
+    return 0;
+}
+
+static sc_socket
+listen_on_port_range(uint16_t *port) {
+    for (uint16_t p = DEFAULT_LOCAL_PORT_RANGE_FIRST;
+            p <= DEFAULT_LOCAL_PORT_RANGE_LAST; ++p) {
+        sc_socket server_socket = net_socket();
+        if (server_socket == SC_SOCKET_NONE) {
+            return SC_SOCKET_NONE;
+        }
+
+        if (net_listen(server_socket, IPV4_LOCALHOST, p, 1)) {
+            *port = p;
+            return server_socket;
+        }
+
+        net_close(server_socket);
+    }
+
+    LOGE("Could not listen on any port in range %d:%d",
+         DEFAULT_LOCAL_PORT_RANGE_FIRST, DEFAULT_LOCAL_PORT_RANGE_LAST);
+    return SC_SOCKET_NONE;
+}
+
+static void
+sc_teststream_on_demuxer_ended(struct sc_demuxer *demuxer,
+                               enum sc_demuxer_status status, void *userdata) {
+    (void) demuxer;
+
+    bool *failed = userdata;
+    *failed = status != SC_DEMUXER_STATUS_EOS;
+}
+
+static bool
+parse_number(const char *s, long min, long max, const char *name, long *out) {
+    long value;
+    if (!sc_str_parse_integer(s, &value) || value < min || value > max) {
+        LOGE("Could not parse %s (expected a value in [%ld; %ld]): %s", name,
+             min, max, s);
+        return false;
+    }
+    *out = value;
+    return true;
+}
+
+static bool
+parse_args(struct sc_teststream_params *params, int argc, char *argv[]) {
+    static const struct option longopts[] = {
+        {"video-codec",   required_argument, NULL, 'c'},
+        {"video-encoder", required_argument, NULL, 'e'},
+        {"frames",        required_argument, NULL, 'n'},
+        {"fps",           required_argument, NULL, 'r'},
+        {"width",         required_argument, NULL, 'w'},
+        {"height",        required_argument, NULL, 'h'},
+        {"duration",      required_argument, NULL, 'd'},
+        {"speed",         required_argument, NULL, 's'},
+        {"video-buffer",  required_argument, NULL, 'b'},
+        {"report",        required_argument, NULL, 'o'},
+        {"sample-interval", required_argument, NULL, 'i'},
+        {"max-rss-growth", required_argument, NULL, 'R'},
+        {"max-fd-growth", required_argument, NULL, 'F'},
+        {"max-queue-growth", required_argument, NULL, 'Q'},
+        {"max-latency",   required_argument, NULL, 'L'},
+        {"max-latency-drift", required_argument, NULL, 'D'},
+        {NULL,            0,                 NULL, 0  },
+    };
+
+    long duration = 0; // simulated duration in seconds, 0 if not set
+    struct sc_soak_thresholds *thresholds = &params->thresholds;
+
+    long value;
+    int c;
+    while ((c = getopt_long(argc, argv, "", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'c':
+                params->codec = optarg;
+                break;
+            case 'e':
+                params->encoder = optarg;
+                break;
+            case 'n':
+                if (!parse_number(optarg, 1, 0x7FFFFFFF, "frames", &value)) {
+                    return false;
+                }
+                params->frames = value;
+                break;
+            case 'r':
+                if (!parse_number(optarg, 1, 1000, "fps", &value)) {
+                    return false;
+                }
+                params->fps = value;
+                break;
+            case 'w':
+            case 'h':
+                // Even dimensions for YUV 4:2:0, large enough for the marker
+                if (!parse_number(optarg, c == 'w' ? SC_FRAME_MARKER_WIDTH
+                                                   : SC_FRAME_MARKER_HEIGHT,
+                                  0xFFFE, c == 'w' ? "width" : "height",
+                                  &value)
+                        || value % 2) {
+                    LOGE("Invalid %s: %s", c == 'w' ? "width" : "height",
+                         optarg);
+                    return false;
+                }
+                if (c == 'w') {
+                    params->width = value;
+                } else {
+                    params->height = value;
+                }
+                break;
+            case 'd':
+                if (!parse_number(optarg, 1, 0x7FFFFFFF, "duration",
+                                  &duration)) {
+                    return false;
+                }
+                break;
+            case 's':
+                if (!parse_number(optarg, 1, 1000, "speed", &value)) {
+                    return false;
+                }
+                params->speed = value;
+                break;
+            case 'b':
+                if (!parse_number(optarg, 0, 10000, "video buffer", &value)) {
+                    return false;
+                }
+                params->video_buffer = SC_TICK_FROM_MS(value);
+                break;
+            case 'o':
+                params->report = optarg;
+                break;
+            case 'i':
+                if (!parse_number(optarg, 10, 3600000, "sample interval",
+                                  &value)) {
+                    return false;
+                }
+                params->sample_interval = SC_TICK_FROM_MS(value);
+                break;
+            case 'R':
+                if (!parse_number(optarg, 0, 0x7FFFFFFF, "max RSS growth",
+                                  &value)) {
+                    return false;
+                }
+                thresholds->max_rss_growth = value;
+                break;
+            case 'F':
+                if (!parse_number(optarg, 0, 0x7FFFFFFF, "max fd growth",
+                                  &value)) {
+                    return false;
+                }
+                thresholds->max_fd_growth = value;
+                break;
+            case 'Q':
+                if (!parse_number(optarg, 0, 0x7FFFFFFF, "max queue growth",
+                                  &value)) {
+                    return false;
+                }
+                thresholds->max_queue_growth = value;
+                break;
+            case 'L':
+                if (!parse_number(optarg, 1, 0x7FFFFFFF, "max latency",
+                                  &value)) {
+                    return false;
+                }
+                thresholds->max_latency = SC_TICK_FROM_MS(value);
+                break;
+            case 'D':
+                if (!parse_number(optarg, 0, 0x7FFFFFFF, "max latency drift",
+                                  &value)) {
+                    return false;
+                }
+                thresholds->max_latency_drift = SC_TICK_FROM_MS(value);
+                break;
+            default:
+                return false;
+        }
+    }
+
+    if (optind < argc) {
+        LOGE("Unexpected additional argument: %s", argv[optind]);
+        return false;
+    }
+
+    if (duration) {
+        if (duration > 0x7FFFFFFF / params->fps) {
+            LOGE("Duration too long: %ld seconds", duration);
+            return false;
+        }
+        params->frames = duration * params->fps;
+    }
+
+    if (thresholds->max_latency == -1) {
+        // The frames are delayed by the delay buffer
+        thresholds->max_latency = params->video_buffer + SC_TICK_FROM_MS(100);
+    }
+
+    return true;
+}
+
+int
+main(int argc, char *argv[]) {
+    struct sc_teststream_params params = {
+        .codec = "h264",
+        .encoder = NULL,
+        .frames = 300,
+        .width = 1280,
+        .height = 720,
+        .fps = 60,
+        .speed = 1,
+        .video_buffer = 0,
+        .report = NULL,
+        .sample_interval = SC_TICK_FROM_SEC(1),
+        .thresholds = {
+            .max_rss_growth = 4096, // 4 MB per simulated hour
+            .max_fd_growth = 0,
+            .max_queue_growth = 10240,
+            .max_latency = -1, // depends on the video buffer
+            .max_latency_drift = SC_TICK_FROM_MS(50),
+        },
+    };
+
+    if (!parse_args(&params, argc, argv)) {
+        return 1;
+    }
+
+    SC_MAIN_THREAD_ID = sc_thread_get_id();
+
+#ifdef SCRCPY_LAVF_REQUIRES_REGISTER_ALL
+    av_register_all();
+#endif
+
+    if (!net_init()) {
+        return 1;
+    }
+
+    sc_log_configure();
+
+    int ret = 1;
+
+    struct sc_teststream ts = {
+        .params = &params,
+        .generator_failed = false,
+    };
+
+    if (!sc_teststream_find_encoder(&ts)) {
+        goto end;
+    }
+
+    if (!ts.encoder) {
+        LOGW("No encoder available for %s, skipped", params.codec);
+        ret = SC_TESTSTREAM_EXIT_SKIPPED;
+        goto end;
+    }
+
+    LOGI("Generating %" PRIu32 " frames %" PRIu16 "x%" PRIu16 " at %" PRIu16
+         " fps (speed x%" PRIu16 ") using %s", params.frames, params.width,
+         params.height, params.fps, params.speed, ts.encoder->name);
+
+    if (params.report) {
+        // Only to account the memory of the queued frames, never exhausted
+        sc_memory_budget_init(UINT64_C(1) << 62);
+    }
+
+    sc_socket server_socket = listen_on_port_range(&ts.port);
+    if (server_socket == SC_SOCKET_NONE) {
+        goto end;
+    }
+
+    sc_thread generator_thread;
+    bool ok = sc_thread_create(&generator_thread, run_generator,
+                               "scrcpy-gen", &ts);
+    if (!ok) {
+        LOGE("Could not start generator thread");
+        net_close(server_socket);
+        goto end;
+    }
+
+    sc_socket socket = net_accept(server_socket);
+    net_close(server_socket);
+    if (socket == SC_SOCKET_NONE) {
+        LOGE("Could not accept generator connection");
+        // The generator could not connect, so its thread terminates
+        sc_thread_join(&generator_thread, NULL);
+        goto end;
+    }
+
+    static const struct sc_demuxer_callbacks demuxer_cbs = {
+        .on_ended = sc_teststream_on_demuxer_ended,
+    };
+
+    bool demuxer_failed = false;
+
+    struct sc_demuxer demuxer;
+    sc_demuxer_init(&demuxer, "video", socket, NULL, &demuxer_cbs,
+                    &demuxer_failed);
+
+    struct sc_decoder decoder;
+    sc_decoder_init(&decoder, "video", NULL);
+    sc_packet_source_add_sink(&demuxer.packet_source, &decoder.packet_sink);
+
+    struct sc_frame_checker checker;
+    sc_frame_checker_init(&checker);
+
+    struct sc_delay_buffer delay_buffer;
+    if (params.video_buffer) {
+        sc_delay_buffer_init(&delay_buffer, params.video_buffer, true);
+        sc_frame_source_add_sink(&decoder.frame_source,
+                                 &delay_buffer.frame_sink);
+        sc_frame_source_add_sink(&delay_buffer.frame_source,
+                                 &checker.frame_sink);
+    } else {
+        sc_frame_source_add_sink(&decoder.frame_source, &checker.frame_sink);
+    }
+
+    struct sc_soak_monitor monitor;
+    bool monitor_started = false;
+    if (params.report) {
+        ok = sc_soak_monitor_init(&monitor, &checker, params.fps,
+                                  params.sample_interval);
+        if (ok) {
+            ok = sc_soak_monitor_start(&monitor);
+            if (ok) {
+                monitor_started = true;
+            } else {
+                sc_soak_monitor_destroy(&monitor);
+            }
+        }
+    } else {
+        ok = true;
+    }
+
+    if (ok) {
+        ok = sc_demuxer_start(&demuxer);
+    }
+    if (ok) {
+        sc_demuxer_join(&demuxer);
+    } else {
+        // Interrupt the generator
+        net_interrupt(socket);
+    }
+
+    if (monitor_started) {
+        sc_soak_monitor_stop(&monitor);
+    }
+
+    sc_thread_join(&generator_thread, NULL);
+    net_close(socket);
+
+    if (!ok || demuxer_failed || ts.generator_failed) {
+        goto destroy_monitor;
+    }
+
+    // With a delay buffer, the frames still buffered on end of stream are
+    // discarded
+    uint64_t max_missing = 0;
+    if (params.video_buffer) {
+        unsigned rate = params.fps * params.speed;
+        max_missing = SC_TICK_TO_MS(params.video_buffer) * rate / 1000 + rate;
+    }
+
+    const struct sc_frame_checker_stats *stats = &checker.stats;
+    if (stats->frames > params.frames
+            || stats->frames + max_missing < params.frames
+            || stats->unreadable || stats->dropped || stats->duplicated
+            || stats->reordered || stats->too_late) {
+        LOGE("Inconsistent frames: %" PRIu64 "/%" PRIu32 " received",
+             stats->frames, params.frames);
+        goto destroy_monitor;
+    }
+
+    ret = 0;
+
+    if (monitor_started) {
+        struct sc_soak_trends trends;
+        bool pass = sc_soak_monitor_analyze(&monitor, &params.thresholds,
+                                            &trends);
+
+        bool to_stdout = !strcmp(params.report, "-");
+        FILE *file = to_stdout ? stdout : fopen(params.report, "w");
+        if (file) {
+            ok = sc_soak_monitor_write_report(&monitor, &params.thresholds,
+                                              &trends, pass, file);
+            if (!to_stdout) {
+                fclose(file);
+            }
+        } else {
+            LOGE("Could not open report file: %s", params.report);
+            ok = false;
+        }
+
+        if (!pass || !ok) {
+            ret = 1;
+        }
+    }
+
+destroy_monitor:
+    if (monitor_started) {
+        sc_soak_monitor_destroy(&monitor);
+    }
+end:
+    net_cleanup();
+
+    return ret;
+}
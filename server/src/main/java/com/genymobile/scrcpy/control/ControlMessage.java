@@ -1,6 +1,7 @@
 package com.genymobile.scrcpy.control;
 
 import com.genymobile.scrcpy.device.Position;
+import com.genymobile.scrcpy.device.Size;
 
 /**
  * Union of all supported event types, identified by their {@code type}.
@@ -25,6 +26,8 @@ public final class ControlMessage {
     public static final int TYPE_OPEN_HARD_KEYBOARD_SETTINGS = 15;
     public static final int TYPE_START_APP = 16;
     public static final int TYPE_RESET_VIDEO = 17;
+    public static final int TYPE_REQUEST_SYNC_FRAME = 18;
+    public static final int TYPE_SET_CROP = 19;
 
     public static final long SEQUENCE_INVALID = 0;
 
@@ -53,6 +56,7 @@ public final class ControlMessage {
     private boolean on;
     private int vendorId;
     private int productId;
+    private Size size;
 
     private ControlMessage() {
     }
@@ -166,6 +170,20 @@ public final class ControlMessage {
         return msg;
     }
 
+    /**
+     * Create a message to crop the video to a region of the current video.
+     *
+     * @param position the top-left corner of the region, relative to the current video
+     * @param size the size of the region, or {@code null} to restore the initial crop
+     */
+    public static ControlMessage createSetCrop(Position position, Size size) {
+        ControlMessage msg = new ControlMessage();
+        msg.type = TYPE_SET_CROP;
+        msg.position = position;
+        msg.size = size;
+        return msg;
+    }
+
     public int getType() {
         return type;
     }
@@ -249,4 +267,8 @@ public final class ControlMessage {
     public int getProductId() {
         return productId;
     }
+
+    public Size getSize() {
+        return size;
+    }
 }
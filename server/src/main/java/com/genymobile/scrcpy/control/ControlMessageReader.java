@@ -1,6 +1,7 @@
 package com.genymobile.scrcpy.control;
 
 import com.genymobile.scrcpy.device.Position;
+import com.genymobile.scrcpy.device.Size;
 import com.genymobile.scrcpy.util.Binary;
 
 import java.io.BufferedInputStream;
@@ -47,6 +48,7 @@ public class ControlMessageReader {
             case ControlMessage.TYPE_ROTATE_DEVICE:
             case ControlMessage.TYPE_OPEN_HARD_KEYBOARD_SETTINGS:
             case ControlMessage.TYPE_RESET_VIDEO:
+            case ControlMessage.TYPE_REQUEST_SYNC_FRAME:
                 return ControlMessage.createEmpty(type);
             case ControlMessage.TYPE_UHID_CREATE:
                 return parseUhidCreate();
@@ -56,6 +58,8 @@ public class ControlMessageReader {
                 return parseUhidDestroy();
             case ControlMessage.TYPE_START_APP:
                 return parseStartApp();
+            case ControlMessage.TYPE_SET_CROP:
+                return parseSetCrop();
             default:
                 throw new ControlProtocolException("Unknown event type: " + type);
         }
@@ -166,6 +170,15 @@ public class ControlMessageReader {
         return ControlMessage.createStartApp(name);
     }
 
+    private ControlMessage parseSetCrop() throws IOException {
+        Position position = parsePosition();
+        int width = dis.readUnsignedShort();
+        int height = dis.readUnsignedShort();
+        // An empty region restores the initial crop
+        Size size = width != 0 && height != 0 ? new Size(width, height) : null;
+        return ControlMessage.createSetCrop(position, size);
+    }
+
     private Position parsePosition() throws IOException {
         int x = dis.readInt();
         int y = dis.readInt();
@@ -97,7 +97,7 @@ public class Controller implements AsyncProcessor, VirtualDisplayListener {
 
     private boolean keepDisplayPowerOff;
 
-    // Used for resetting video encoding on RESET_VIDEO message
+    // Used for resetting video encoding on RESET_VIDEO message, and requesting a sync frame on REQUEST_SYNC_FRAME message
     private SurfaceCapture surfaceCapture;
 
     public Controller(ControlChannel controlChannel, CleanUp cleanUp, Options options) {
@@ -331,6 +331,12 @@ public class Controller implements AsyncProcessor, VirtualDisplayListener {
             case ControlMessage.TYPE_RESET_VIDEO:
                 resetVideo();
                 break;
+            case ControlMessage.TYPE_REQUEST_SYNC_FRAME:
+                requestSyncFrame();
+                break;
+            case ControlMessage.TYPE_SET_CROP:
+                setCrop(msg.getPosition(), msg.getSize());
+                break;
             default:
                 // do nothing
         }
@@ -754,4 +760,20 @@ public class Controller implements AsyncProcessor, VirtualDisplayListener {
             surfaceCapture.requestInvalidate();
         }
     }
+
+    private void requestSyncFrame() {
+        if (surfaceCapture != null) {
+            Ln.d("Sync frame requested");
+            surfaceCapture.requestSyncFrame();
+        }
+    }
+
+    private void setCrop(Position position, Size size) {
+        if (surfaceCapture != null) {
+            boolean ok = surfaceCapture.setCrop(position, size);
+            if (!ok) {
+                Ln.w("Could not change the video crop");
+            }
+        }
+    }
 }
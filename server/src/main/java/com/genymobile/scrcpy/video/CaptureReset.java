@@ -1,6 +1,7 @@
 package com.genymobile.scrcpy.video;
 
 import android.media.MediaCodec;
+import android.os.Bundle;
 
 import java.util.concurrent.atomic.AtomicBoolean;
 
@@ -34,4 +35,17 @@ public class CaptureReset implements SurfaceCapture.CaptureListener {
     public void onInvalidated() {
         reset();
     }
+
+    @Override
+    public synchronized void onSyncFrameRequested() {
+        if (runningMediaCodec != null) {
+            Bundle params = new Bundle();
+            params.putInt(MediaCodec.PARAMETER_KEY_REQUEST_SYNC_FRAME, 0);
+            try {
+                runningMediaCodec.setParameters(params);
+            } catch (IllegalStateException e) {
+                // ignore
+            }
+        }
+    }
 }
@@ -7,6 +7,8 @@ import com.genymobile.scrcpy.device.ConfigurationException;
 import com.genymobile.scrcpy.device.Device;
 import com.genymobile.scrcpy.device.DisplayInfo;
 import com.genymobile.scrcpy.device.Orientation;
+import com.genymobile.scrcpy.device.Point;
+import com.genymobile.scrcpy.device.Position;
 import com.genymobile.scrcpy.device.Size;
 import com.genymobile.scrcpy.opengl.AffineOpenGLFilter;
 import com.genymobile.scrcpy.opengl.OpenGLFilter;
@@ -31,7 +33,9 @@ public class ScreenCapture extends SurfaceCapture {
     private final VirtualDisplayListener vdListener;
     private final int displayId;
     private int maxSize;
-    private final Rect crop;
+    private final Rect initialCrop;
+    // May be changed at runtime (protected by this)
+    private Rect crop;
     private Orientation.Lock captureOrientationLock;
     private Orientation captureOrientation;
     private final float angle;
@@ -54,7 +58,8 @@ public class ScreenCapture extends SurfaceCapture {
         this.displayId = options.getDisplayId();
         assert displayId != Device.DISPLAY_ID_NONE;
         this.maxSize = options.getMaxSize();
-        this.crop = options.getCrop();
+        this.initialCrop = options.getCrop();
+        this.crop = initialCrop;
         this.captureOrientationLock = options.getCaptureOrientationLock();
         this.captureOrientation = options.getCaptureOrientation();
         assert captureOrientationLock != null;
@@ -69,7 +74,7 @@ public class ScreenCapture extends SurfaceCapture {
     }
 
     @Override
-    public void prepare() throws ConfigurationException {
+    public synchronized void prepare() throws ConfigurationException {
         displayInfo = ServiceManager.getDisplayManager().getDisplayInfo(displayId);
         if (displayInfo == null) {
             Ln.e("Display " + displayId + " not found\n" + LogUtils.buildDisplayListMessage(false));
@@ -223,4 +228,61 @@ public class ScreenCapture extends SurfaceCapture {
     public void requestInvalidate() {
         invalidate();
     }
+
+    @Override
+    public synchronized boolean setCrop(Position position, Size size) {
+        if (size == null) {
+            if (crop == initialCrop) {
+                // Nothing to do
+                return true;
+            }
+            crop = initialCrop;
+        } else {
+            Rect region = mapToDisplay(position, size);
+            if (region == null) {
+                return false;
+            }
+            crop = region;
+        }
+
+        Ln.i("Video crop: " + (crop != null ? crop.width() + ":" + crop.height() + ":" + crop.left + ":" + crop.top : "none"));
+        invalidate();
+        return true;
+    }
+
+    /**
+     * Map a region of the current video to a crop rectangle of the display (in the same coordinates as {@code --crop}).
+     */
+    private Rect mapToDisplay(Position position, Size size) {
+        if (displayInfo == null) {
+            // Not prepared yet
+            return null;
+        }
+
+        Size displaySize = displayInfo.getSize();
+        PositionMapper positionMapper = PositionMapper.create(videoSize, transform, displaySize);
+
+        Point p0 = positionMapper.map(position);
+        Point point = position.getPoint();
+        Position end = new Position(point.getX() + size.getWidth(), point.getY() + size.getHeight(), videoSize.getWidth(),
+                videoSize.getHeight());
+        Point p1 = positionMapper.map(end);
+        if (p0 == null || p1 == null) {
+            // The region is relative to a previous video size
+            return null;
+        }
+
+        // The transform may include a rotation or a flip, and the region must not exceed the display
+        int left = Math.max(0, Math.min(p0.getX(), p1.getX()));
+        int top = Math.max(0, Math.min(p0.getY(), p1.getY()));
+        int right = Math.min(displaySize.getWidth(), Math.max(p0.getX(), p1.getX()));
+        int bottom = Math.min(displaySize.getHeight(), Math.max(p0.getY(), p1.getY()));
+        if (left >= right || top >= bottom) {
+            return null;
+        }
+
+        Rect rect = new Rect(left, top, right, bottom);
+        boolean transposed = (displayInfo.getRotation() % 2) != 0;
+        return transposed ? VideoFilter.transposeRect(rect) : rect;
+    }
 }
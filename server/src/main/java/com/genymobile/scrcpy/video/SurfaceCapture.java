@@ -1,6 +1,7 @@
 package com.genymobile.scrcpy.video;
 
 import com.genymobile.scrcpy.device.ConfigurationException;
+import com.genymobile.scrcpy.device.Position;
 import com.genymobile.scrcpy.device.Size;
 
 import android.view.Surface;
@@ -14,6 +15,8 @@ public abstract class SurfaceCapture {
 
     public interface CaptureListener {
         void onInvalidated();
+
+        void onSyncFrameRequested();
     }
 
     private CaptureListener listener;
@@ -93,4 +96,26 @@ public abstract class SurfaceCapture {
      * The capture implementation is free to ignore the request and do nothing.
      */
     public abstract void requestInvalidate();
+
+    /**
+     * Crop the capture to a region of the current video (typically a user request), or restore the initial crop.
+     * <p>
+     * On success, the capture is invalidated, so that the new video has the size of the region (at the native resolution if possible).
+     *
+     * @param position the top-left corner of the region, relative to the current video
+     * @param size the size of the region, or {@code null} to restore the initial crop
+     * @return {@code true} if the crop is changed, {@code false} if it is not supported or invalid
+     */
+    public boolean setCrop(Position position, Size size) {
+        return false;
+    }
+
+    /**
+     * Request the encoder to produce a key frame as soon as possible, without resetting the capture.
+     */
+    public void requestSyncFrame() {
+        if (listener != null) {
+            listener.onSyncFrameRequested();
+        }
+    }
 }
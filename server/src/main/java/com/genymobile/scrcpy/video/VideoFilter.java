@@ -43,7 +43,7 @@ public class VideoFilter {
         return transform.invert();
     }
 
-    private static Rect transposeRect(Rect rect) {
+    static Rect transposeRect(Rect rect) {
         return new Rect(rect.top, rect.left, rect.bottom, rect.right);
     }
 